@@ -28,6 +28,7 @@ APP_SOURCES = \
     $$MAIN_PATH/DateUtility.cpp \
     $$MAIN_PATH/RotationUtility.cpp \
     $$MAIN_PATH/ChebyshevPolyTrajectory.cpp \
+    $$MAIN_PATH/ChebyshevCachedTrajectory.cpp \
     $$MAIN_PATH/GalleryView.cpp \
     $$MAIN_PATH/InterpolatedRotation.cpp \
     $$MAIN_PATH/InterpolatedStateTrajectory.cpp \
@@ -39,7 +40,10 @@ APP_SOURCES = \
     $$MAIN_PATH/NumberFormat.cpp \
     $$MAIN_PATH/ObserverAction.cpp \
     $$MAIN_PATH/SkyLabelLayer.cpp \
+    $$MAIN_PATH/ThreadPoolTaskExecutor.cpp \
     $$MAIN_PATH/TleTrajectory.cpp \
+    $$MAIN_PATH/TleCatalogPropagator.cpp \
+    $$MAIN_PATH/TleSwarm.cpp \
     $$MAIN_PATH/TwoVectorFrame.cpp \
     $$MAIN_PATH/UnitConversion.cpp \
     $$MAIN_PATH/WMSRequester.cpp \
@@ -56,7 +60,14 @@ APP_SOURCES = \
     $$MAIN_PATH/astro/TASS17.cpp \
     $$MAIN_PATH/catalog/AstorbLoader.cpp \
     $$MAIN_PATH/catalog/BodyInfo.cpp \
+    $$MAIN_PATH/catalog/CatalogFileReader.cpp \
+    $$MAIN_PATH/catalog/CatalogSnapshot.cpp \
     $$MAIN_PATH/catalog/ChebyshevPolyFileLoader.cpp \
+    $$MAIN_PATH/catalog/CompiledCache.cpp \
+    $$MAIN_PATH/catalog/CompiledMesh.cpp \
+    $$MAIN_PATH/catalog/JsonParser.cpp \
+    $$MAIN_PATH/catalog/SampledDataPack.cpp \
+    $$MAIN_PATH/catalog/StarCatalogLoader.cpp \
     $$MAIN_PATH/catalog/UniverseCatalog.cpp \
     $$MAIN_PATH/catalog/UniverseLoader.cpp \
     $$MAIN_PATH/geometry/FeatureLabelSetGeometry.cpp \
@@ -93,6 +104,7 @@ APP_HEADERS = \
     $$MAIN_PATH/DateUtility.h \
     $$MAIN_PATH/RotationUtility.h \
     $$MAIN_PATH/ChebyshevPolyTrajectory.h \
+    $$MAIN_PATH/ChebyshevCachedTrajectory.h \
     $$MAIN_PATH/GalleryView.h \
     $$MAIN_PATH/InterpolatedRotation.h \
     $$MAIN_PATH/InterpolatedStateTrajectory.h \
@@ -104,7 +116,10 @@ APP_HEADERS = \
     $$MAIN_PATH/NumberFormat.h \
     $$MAIN_PATH/ObserverAction.h \
     $$MAIN_PATH/SkyLabelLayer.h \
+    $$MAIN_PATH/ThreadPoolTaskExecutor.h \
     $$MAIN_PATH/TleTrajectory.h \
+    $$MAIN_PATH/TleCatalogPropagator.h \
+    $$MAIN_PATH/TleSwarm.h \
     $$MAIN_PATH/TwoVectorFrame.h \
     $$MAIN_PATH/UnitConversion.h \
     $$MAIN_PATH/WMSRequester.h \
@@ -122,7 +137,14 @@ APP_HEADERS = \
     $$MAIN_PATH/astro/TASS17.h \
     $$MAIN_PATH/catalog/AstorbLoader.h \
     $$MAIN_PATH/catalog/BodyInfo.h \
+    $$MAIN_PATH/catalog/CatalogFileReader.h \
+    $$MAIN_PATH/catalog/CatalogSnapshot.h \
     $$MAIN_PATH/catalog/ChebyshevPolyFileLoader.h \
+    $$MAIN_PATH/catalog/CompiledCache.h \
+    $$MAIN_PATH/catalog/CompiledMesh.h \
+    $$MAIN_PATH/catalog/JsonParser.h \
+    $$MAIN_PATH/catalog/SampledDataPack.h \
+    $$MAIN_PATH/catalog/StarCatalogLoader.h \
     $$MAIN_PATH/catalog/UniverseCatalog.h \
     $$MAIN_PATH/catalog/UniverseLoader.h \
     $$MAIN_PATH/geometry/FeatureLabelSetGeometry.h \
@@ -232,9 +254,12 @@ VESTA_SOURCES = \
     $$VESTA_PATH/interaction/ObserverController.cpp \
     $$VESTA_PATH/internal/DefaultFont.cpp \
     $$VESTA_PATH/internal/EclipseShadowVolumeSet.cpp \
+    $$VESTA_PATH/internal/EntityBoundingHierarchy.cpp \
     $$VESTA_PATH/internal/InputDataStream.cpp \
     $$VESTA_PATH/internal/OutputDataStream.cpp \
-    $$VESTA_PATH/internal/ObjLoader.cpp
+    $$VESTA_PATH/internal/ObjLoader.cpp \
+    $$VESTA_PATH/internal/TileMeshCache.cpp \
+    $$VESTA_PATH/internal/TriangleBVH.cpp
 
 VESTA_HEADERS = \
     $$VESTA_PATH/AlignedEllipsoid.h \
@@ -313,6 +338,7 @@ VESTA_HEADERS = \
     $$VESTA_PATH/StarsLayer.h \
     $$VESTA_PATH/StateVector.h \
     $$VESTA_PATH/Submesh.h \
+    $$VESTA_PATH/TaskExecutor.h \
     $$VESTA_PATH/TextureFont.h \
     $$VESTA_PATH/TextureMap.h \
     $$VESTA_PATH/TextureMapLoader.h \
@@ -337,9 +363,12 @@ VESTA_HEADERS = \
     $$VESTA_PATH/internal/AtomicInt.h \
     $$VESTA_PATH/internal/DefaultFont.h \
     $$VESTA_PATH/internal/EclipseShadowVolumeSet.h \
+    $$VESTA_PATH/internal/EntityBoundingHierarchy.h \
     $$VESTA_PATH/internal/InputDataStream.h \
     $$VESTA_PATH/internal/OutputDataStream.h \
-    $$VESTA_PATH/internal/ObjLoader.h
+    $$VESTA_PATH/internal/ObjLoader.h \
+    $$VESTA_PATH/internal/TileMeshCache.h \
+    $$VESTA_PATH/internal/TriangleBVH.h
 
 
 ### particle system module ###
@@ -571,6 +600,21 @@ spice {
     INCLUDEPATH += $$SPICE_HEADER_PATH
     DEFINES += SPICE_ENABLED
     SOURCES += $$MAIN_PATH/spice/SpiceTrajectory.cpp $$MAIN_PATH/spice/SpiceRotationModel.cpp
+    SOURCES += $$MAIN_PATH/spice/SpiceMutex.cpp \
+               $$MAIN_PATH/spice/DafFile.cpp \
+               $$MAIN_PATH/spice/SpkSegment.cpp \
+               $$MAIN_PATH/spice/CkSegment.cpp \
+               $$MAIN_PATH/spice/SpiceKernelIndex.cpp \
+               $$MAIN_PATH/spice/NativeSpiceTrajectory.cpp \
+               $$MAIN_PATH/spice/NativeSpiceRotationModel.cpp
+    HEADERS += $$MAIN_PATH/spice/SpiceTrajectory.h $$MAIN_PATH/spice/SpiceRotationModel.h
+    HEADERS += $$MAIN_PATH/spice/SpiceMutex.h \
+               $$MAIN_PATH/spice/DafFile.h \
+               $$MAIN_PATH/spice/SpkSegment.h \
+               $$MAIN_PATH/spice/CkSegment.h \
+               $$MAIN_PATH/spice/SpiceKernelIndex.h \
+               $$MAIN_PATH/spice/NativeSpiceTrajectory.h \
+               $$MAIN_PATH/spice/NativeSpiceRotationModel.h
     LIBS += $$SPICE_LIB_PATH/cspice.a
 }
 
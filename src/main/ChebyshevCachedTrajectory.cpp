@@ -0,0 +1,490 @@
+// ChebyshevCachedTrajectory.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ChebyshevCachedTrajectory.h"
+#include <vesta/Units.h>
+#include <QThread>
+#include <QWaitCondition>
+#include <QList>
+#include <QPair>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Worker thread that fits blocks for all cached trajectories. Requests are
+// handled in the order they're received.
+class ChebyshevFitThread : public QThread
+{
+public:
+    ChebyshevFitThread() :
+        m_current(NULL),
+        m_stopping(false)
+    {
+    }
+
+    void request(ChebyshevCachedTrajectory* trajectory, qint64 blockIndex)
+    {
+        QMutexLocker lock(&m_mutex);
+        m_requests.append(qMakePair(trajectory, blockIndex));
+        m_requestAdded.wakeOne();
+    }
+
+    // Remove all requests for a trajectory and wait for any fit of it in
+    // progress to finish.
+    void cancel(ChebyshevCachedTrajectory* trajectory)
+    {
+        QMutexLocker lock(&m_mutex);
+        for (int i = m_requests.size() - 1; i >= 0; --i)
+        {
+            if (m_requests.at(i).first == trajectory)
+            {
+                m_requests.removeAt(i);
+            }
+        }
+
+        while (m_current == trajectory)
+        {
+            m_fitFinished.wait(&m_mutex);
+        }
+    }
+
+    // Drop all requests and wait for the thread to exit. A fit in progress
+    // is allowed to finish.
+    void stop()
+    {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_requests.clear();
+            m_stopping = true;
+            m_requestAdded.wakeOne();
+        }
+
+        wait();
+    }
+
+protected:
+    void run()
+    {
+        for (;;)
+        {
+            m_mutex.lock();
+            while (m_requests.isEmpty() && !m_stopping)
+            {
+                m_requestAdded.wait(&m_mutex);
+            }
+
+            if (m_stopping)
+            {
+                m_mutex.unlock();
+                return;
+            }
+
+            QPair<ChebyshevCachedTrajectory*, qint64> fitRequest = m_requests.takeFirst();
+            m_current = fitRequest.first;
+            m_mutex.unlock();
+
+            fitRequest.first->fitBlock(fitRequest.second);
+
+            m_mutex.lock();
+            m_current = NULL;
+            m_fitFinished.wakeAll();
+            m_mutex.unlock();
+        }
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_requestAdded;
+    QWaitCondition m_fitFinished;
+    QList<QPair<ChebyshevCachedTrajectory*, qint64> > m_requests;
+    ChebyshevCachedTrajectory* m_current;
+    bool m_stopping;
+};
+
+
+static QMutex FitThreadMutex;
+static ChebyshevFitThread* FitThread = NULL;
+static bool FitThreadStopped = false;
+
+// The fitting thread is started when the first fit is requested and runs until
+// stopFitThread() is called. Returns null once the thread has been stopped.
+static ChebyshevFitThread*
+fitThread()
+{
+    QMutexLocker lock(&FitThreadMutex);
+    if (!FitThread && !FitThreadStopped)
+    {
+        FitThread = new ChebyshevFitThread();
+        FitThread->start(QThread::LowPriority);
+    }
+
+    return FitThread;
+}
+
+
+/** Create a new cached trajectory.
+  *
+  * \param source the trajectory to approximate
+  * \param blockDuration the length of time covered by each fitted block (in seconds)
+  * \param tolerance maximum allowed position error of the fit (in kilometers)
+  */
+ChebyshevCachedTrajectory::ChebyshevCachedTrajectory(Trajectory* source, double blockDuration, double tolerance) :
+    m_source(source),
+    m_blockDuration(blockDuration),
+    m_tolerance(tolerance),
+    m_useCounter(0)
+{
+    setValidTimeRange(source->startTime(), source->endTime());
+}
+
+
+ChebyshevCachedTrajectory::~ChebyshevCachedTrajectory()
+{
+    {
+        QMutexLocker lock(&FitThreadMutex);
+        if (FitThread)
+        {
+            FitThread->cancel(this);
+        }
+    }
+
+    for (QHash<qint64, Block>::iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+    {
+        delete iter.value().fit;
+    }
+}
+
+
+qint64
+ChebyshevCachedTrajectory::blockIndex(double tdbSec) const
+{
+    return qint64(floor(tdbSec / m_blockDuration));
+}
+
+
+// Only blocks entirely within the valid time range of the source are fit.
+bool
+ChebyshevCachedTrajectory::blockInRange(qint64 index) const
+{
+    double blockStart = index * m_blockDuration;
+    return blockStart >= m_source->startTime() && blockStart + m_blockDuration <= m_source->endTime();
+}
+
+
+// Find the block for the specified block index, queuing a fit if this is the first time
+// that the block has been requested. Returns null if the block hasn't been fit (yet.)
+// Nothing is recorded for blocks outside the valid time range of the source.
+// Must be called with the mutex locked.
+const ChebyshevCachedTrajectory::Block*
+ChebyshevCachedTrajectory::findBlock(qint64 index) const
+{
+    if (!blockInRange(index))
+    {
+        return NULL;
+    }
+
+    QHash<qint64, Block>::iterator iter = m_blocks.find(index);
+    if (iter == m_blocks.end())
+    {
+        ChebyshevFitThread* thread = fitThread();
+        if (thread)
+        {
+            Block block;
+            block.status = BlockPending;
+            block.fit = NULL;
+            block.lastUse = ++m_useCounter;
+            m_blocks.insert(index, block);
+
+            thread->request(const_cast<ChebyshevCachedTrajectory*>(this), index);
+        }
+
+        return NULL;
+    }
+
+    iter.value().lastUse = ++m_useCounter;
+    if (iter.value().status == BlockReady)
+    {
+        return &iter.value();
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+
+// Evict least recently used blocks until no more than MaxCachedBlocks remain. Failed
+// blocks count toward the limit along with fitted ones. Pending blocks count too,
+// but aren't evicted because a fit of them is already queued. Must be called with
+// the mutex locked.
+void
+ChebyshevCachedTrajectory::evictBlocks()
+{
+    while (m_blocks.size() > MaxCachedBlocks)
+    {
+        QHash<qint64, Block>::iterator oldest = m_blocks.end();
+        for (QHash<qint64, Block>::iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+        {
+            if (iter.value().status != BlockPending)
+            {
+                if (oldest == m_blocks.end() || iter.value().lastUse < oldest.value().lastUse)
+                {
+                    oldest = iter;
+                }
+            }
+        }
+
+        if (oldest == m_blocks.end())
+        {
+            break;
+        }
+
+        delete oldest.value().fit;
+        m_blocks.erase(oldest);
+    }
+}
+
+
+StateVector
+ChebyshevCachedTrajectory::state(double tdbSec) const
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        const Block* block = findBlock(blockIndex(tdbSec));
+        if (block)
+        {
+            return block->fit->state(tdbSec);
+        }
+    }
+
+    return m_source->state(tdbSec);
+}
+
+
+/** Compute states at a sequence of times. Consecutive times that fall in the
+  * same fitted block are evaluated as a batch.
+  */
+void
+ChebyshevCachedTrajectory::states(const double* tdbSec, unsigned int count, StateVector* out) const
+{
+    // Mark the states that must be computed by the source trajectory
+    const unsigned int MaxBatchSize = 64;
+    bool fromSource[MaxBatchSize];
+
+    for (unsigned int batchStart = 0; batchStart < count; batchStart += MaxBatchSize)
+    {
+        unsigned int batchSize = min(MaxBatchSize, count - batchStart);
+        const double* t = tdbSec + batchStart;
+        StateVector* batchOut = out + batchStart;
+        bool anyFromSource = false;
+
+        {
+            QMutexLocker lock(&m_mutex);
+            unsigned int i = 0;
+            while (i < batchSize)
+            {
+                qint64 index = blockIndex(t[i]);
+                unsigned int runEnd = i + 1;
+                while (runEnd < batchSize && blockIndex(t[runEnd]) == index)
+                {
+                    ++runEnd;
+                }
+
+                const Block* block = findBlock(index);
+                for (unsigned int j = i; j < runEnd; ++j)
+                {
+                    fromSource[j] = block == NULL;
+                }
+
+                if (block)
+                {
+                    block->fit->states(t + i, runEnd - i, batchOut + i);
+                }
+                else
+                {
+                    anyFromSource = true;
+                }
+
+                i = runEnd;
+            }
+        }
+
+        if (anyFromSource)
+        {
+            for (unsigned int i = 0; i < batchSize; ++i)
+            {
+                if (fromSource[i])
+                {
+                    batchOut[i] = m_source->state(t[i]);
+                }
+            }
+        }
+    }
+}
+
+
+/** Queue fits for all blocks that overlap the specified time span. At most
+  * MaxCachedBlocks blocks are queued, starting at startTime; fitting more
+  * would just evict the first ones again.
+  */
+void
+ChebyshevCachedTrajectory::prefetch(double startTime, double endTime) const
+{
+    QMutexLocker lock(&m_mutex);
+    qint64 firstIndex = blockIndex(startTime);
+    qint64 lastIndex = min(blockIndex(endTime), firstIndex + MaxCachedBlocks - 1);
+    for (qint64 index = firstIndex; index <= lastIndex; ++index)
+    {
+        findBlock(index);
+    }
+}
+
+
+// Fit a set of equal length granules to the source trajectory. Returns null if the
+// fit doesn't meet the tolerance.
+ChebyshevPolyTrajectory*
+ChebyshevCachedTrajectory::fitGranules(double startTime, unsigned int granuleCount) const
+{
+    const unsigned int n = FitDegree + 1;
+    double granuleLength = m_blockDuration / granuleCount;
+
+    // Interpolate at the Chebyshev nodes (the zeros of T_n), which gives nearly the
+    // minimax polynomial.
+    double nodes[n];
+    for (unsigned int k = 0; k < n; ++k)
+    {
+        nodes[k] = cos(PI * (k + 0.5) / n);
+    }
+
+    vector<double> coeffs(granuleCount * n * 3);
+    for (unsigned int granule = 0; granule < granuleCount; ++granule)
+    {
+        double granuleStart = startTime + granule * granuleLength;
+        double* granuleCoeffs = &coeffs[granule * n * 3];
+
+        Vector3d samples[n];
+        for (unsigned int k = 0; k < n; ++k)
+        {
+            samples[k] = m_source->position(granuleStart + (nodes[k] + 1.0) * 0.5 * granuleLength);
+        }
+
+        // Coefficients are stored as x0 ... xn y0 ... yn z0 ... zn
+        for (unsigned int j = 0; j < n; ++j)
+        {
+            Vector3d c = Vector3d::Zero();
+            for (unsigned int k = 0; k < n; ++k)
+            {
+                c += samples[k] * cos(PI * j * (k + 0.5) / n);
+            }
+            c *= (j == 0 ? 1.0 : 2.0) / n;
+
+            granuleCoeffs[j]         = c.x();
+            granuleCoeffs[j + n]     = c.y();
+            granuleCoeffs[j + 2 * n] = c.z();
+        }
+    }
+
+    ChebyshevPolyTrajectory* fit = new ChebyshevPolyTrajectory(&coeffs[0], FitDegree, granuleCount, startTime, granuleLength);
+
+    // Check the fit at the extrema of T_n, which lie between the interpolation
+    // nodes and include the ends of each granule.
+    for (unsigned int granule = 0; granule < granuleCount; ++granule)
+    {
+        double granuleStart = startTime + granule * granuleLength;
+        for (unsigned int k = 0; k <= n; ++k)
+        {
+            double u = cos(PI * k / n);
+            double t = min(granuleStart + (u + 1.0) * 0.5 * granuleLength, startTime + m_blockDuration);
+            if ((fit->position(t) - m_source->position(t)).norm() > m_tolerance)
+            {
+                delete fit;
+                return NULL;
+            }
+        }
+    }
+
+    return fit;
+}
+
+
+/** Fit the block with the specified index. This is called on the fitting thread.
+  */
+void
+ChebyshevCachedTrajectory::fitBlock(qint64 blockIndex)
+{
+    double blockStart = blockIndex * m_blockDuration;
+
+    ChebyshevPolyTrajectory* fit = NULL;
+    for (unsigned int granuleCount = InitialGranuleCount; granuleCount <= MaxGranuleCount && !fit; granuleCount *= 2)
+    {
+        fit = fitGranules(blockStart, granuleCount);
+    }
+
+    QMutexLocker lock(&m_mutex);
+
+    Block block;
+    block.status = fit ? BlockReady : BlockFailed;
+    block.fit = fit;
+    block.lastUse = ++m_useCounter;
+    m_blocks.insert(blockIndex, block);
+
+    evictBlocks();
+}
+
+
+/** Stop the thread used to fit blocks for all cached trajectories, waiting for
+  * any fit in progress to finish. This should be called before the application
+  * exits. Afterward, cached trajectories just use their source trajectories for
+  * blocks that haven't been fit.
+  */
+void
+ChebyshevCachedTrajectory::stopFitThread()
+{
+    QMutexLocker lock(&FitThreadMutex);
+    if (FitThread)
+    {
+        FitThread->stop();
+        delete FitThread;
+        FitThread = NULL;
+    }
+    FitThreadStopped = true;
+}
+
+
+double
+ChebyshevCachedTrajectory::boundingSphereRadius() const
+{
+    return m_source->boundingSphereRadius();
+}
+
+
+bool
+ChebyshevCachedTrajectory::isPeriodic() const
+{
+    return m_source->isPeriodic();
+}
+
+
+double
+ChebyshevCachedTrajectory::period() const
+{
+    return m_source->period();
+}
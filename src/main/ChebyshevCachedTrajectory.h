@@ -0,0 +1,125 @@
+// ChebyshevCachedTrajectory.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CHEBYSHEV_CACHED_TRAJECTORY_H_
+#define _CHEBYSHEV_CACHED_TRAJECTORY_H_
+
+#include "ChebyshevPolyTrajectory.h"
+#include <vesta/Trajectory.h>
+#include <QHash>
+#include <QMutex>
+
+
+/** ChebyshevCachedTrajectory speeds up an expensive trajectory (typically
+  * an analytic theory with long trigonometric series) by fitting piecewise
+  * Chebyshev polynomials to it.
+  *
+  * Time is divided into fixed length blocks. The first time a state is
+  * requested in a block, a fit of that block is queued on a background
+  * thread and the state is computed by the source trajectory. Once the fit
+  * is complete, states in the block are evaluated from the polynomials.
+  * Fits are adaptive: the granule length within a block is halved until
+  * the fitted positions agree with the source trajectory to within the
+  * tolerance. Blocks that can't be fit (or that extend beyond the valid
+  * time range of the source) always use the source trajectory.
+  *
+  * The source trajectory must allow state() to be called from the fitting
+  * thread while it is also being used by the main thread.
+  */
+class ChebyshevCachedTrajectory : public vesta::Trajectory
+{
+public:
+    ChebyshevCachedTrajectory(vesta::Trajectory* source, double blockDuration, double tolerance);
+    ~ChebyshevCachedTrajectory();
+
+    virtual vesta::StateVector state(double tdbSec) const;
+    virtual void states(const double* tdbSec, unsigned int count, vesta::StateVector* out) const;
+    virtual double boundingSphereRadius() const;
+    virtual bool isPeriodic() const;
+    virtual double period() const;
+
+    vesta::Trajectory* source() const
+    {
+        return m_source.ptr();
+    }
+
+    /** Get the duration in seconds of the blocks that are fit.
+      */
+    double blockDuration() const
+    {
+        return m_blockDuration;
+    }
+
+    /** Get the maximum allowed difference in kilometers between fitted
+      * positions and positions from the source trajectory.
+      */
+    double tolerance() const
+    {
+        return m_tolerance;
+    }
+
+    void prefetch(double startTime, double endTime) const;
+
+    void fitBlock(qint64 blockIndex);
+
+    static void stopFitThread();
+
+    // Polynomial degree of each fitted granule
+    static const unsigned int FitDegree = 14;
+
+    // Granules per block for the first fit attempt; doubled until the
+    // tolerance is met or the maximum is reached.
+    static const unsigned int InitialGranuleCount = 4;
+    static const unsigned int MaxGranuleCount = 256;
+
+    // Maximum number of blocks (fitted, failed, or pending) kept for each trajectory
+    static const int MaxCachedBlocks = 32;
+
+private:
+    enum BlockStatus
+    {
+        BlockPending,
+        BlockReady,
+        BlockFailed,
+    };
+
+    struct Block
+    {
+        BlockStatus status;
+        ChebyshevPolyTrajectory* fit;
+        unsigned int lastUse;
+    };
+
+    qint64 blockIndex(double tdbSec) const;
+    const Block* findBlock(qint64 index) const;
+    void evictBlocks();
+    bool blockInRange(qint64 index) const;
+    ChebyshevPolyTrajectory* fitGranules(double startTime, unsigned int granuleCount) const;
+
+private:
+    vesta::counted_ptr<vesta::Trajectory> m_source;
+    double m_blockDuration;
+    double m_tolerance;
+
+    // Blocks are added by the fitting thread and looked up by the main thread;
+    // all access (including evaluation of fitted blocks, which may be evicted
+    // by the fitting thread) happens with the mutex locked.
+    mutable QMutex m_mutex;
+    mutable QHash<qint64, Block> m_blocks;
+    mutable unsigned int m_useCounter;
+};
+
+#endif // _CHEBYSHEV_CACHED_TRAJECTORY_H_
@@ -18,6 +18,13 @@
 #include <vesta/Debug.h>
 #include <algorithm>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHEBYSHEV_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CHEBYSHEV_USE_SSE2 0
+#endif
+
 using namespace vesta;
 using namespace Eigen;
 using namespace std;
@@ -39,6 +46,10 @@ ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(const double coeffs[],
                                                  double startTimeTdbSec,
                                                  double granuleLengthSec) :
     m_coeffs(NULL),
+    m_ownsCoeffs(true),
+    m_granulesPerRecord(1),
+    m_recordStride((degree + 1) * 3),
+    m_byteSwapped(false),
     m_degree(degree),
     m_granuleCount(granuleCount),
     m_startTime(startTimeTdbSec),
@@ -48,8 +59,9 @@ ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(const double coeffs[],
 {
     // assert(degree <= MaxChebyshevDegree);
     unsigned int coeffCount = (degree + 1) * granuleCount * 3;
-    m_coeffs = new double[coeffCount];
-    copy(coeffs, coeffs + coeffCount, m_coeffs);
+    double* ownedCoeffs = new double[coeffCount];
+    copy(coeffs, coeffs + coeffCount, ownedCoeffs);
+    m_coeffs = ownedCoeffs;
 
     setStartTime(startTimeTdbSec);
     setEndTime(startTimeTdbSec + granuleCount * granuleLengthSec);
@@ -71,58 +83,419 @@ ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(const double coeffs[],
 }
 
 
+/** Create a new Chebyshev polynomial trajectory that evaluates coefficients directly from
+  * external storage (typically a memory mapped ephemeris file) instead of keeping its own
+  * copy. Granules are grouped into records; the coefficients of a record are contiguous
+  * and each granule is laid out as x0 ... xn y0 ... yn z0 ... zn. Nothing is read from
+  * the storage until a granule is actually evaluated.
+  *
+  * \param mappedCoeffs pointer to the first coefficient of the first record
+  * \param degree the degree of the polynomial (there will be degree + 1 coefficients)
+  * \param granuleCount the total number of granules in the trajectory
+  * \param granulesPerRecord the number of consecutive granules stored in each record
+  * \param recordStride distance in doubles between the starts of two consecutive records
+  * \param byteSwapped true if the coefficients are stored with the opposite byte order of the host
+  * \param startTimeTdbSec the first instant of the trajectory in seconds since J2000 (TDB time scale)
+  * \param granuleLengthSec the time span covered by each granule
+  * \param boundingRadius radius of a sphere large enough to contain the trajectory
+  * \param storage object that owns the coefficient storage; the trajectory keeps a reference to it
+  */
+ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(const double* mappedCoeffs,
+                                                 unsigned int degree,
+                                                 unsigned int granuleCount,
+                                                 unsigned int granulesPerRecord,
+                                                 unsigned int recordStride,
+                                                 bool byteSwapped,
+                                                 double startTimeTdbSec,
+                                                 double granuleLengthSec,
+                                                 double boundingRadius,
+                                                 Object* storage) :
+    m_coeffs(mappedCoeffs),
+    m_ownsCoeffs(false),
+    m_granulesPerRecord(max(1u, granulesPerRecord)),
+    m_recordStride(recordStride),
+    m_byteSwapped(byteSwapped),
+    m_storage(storage),
+    m_degree(degree),
+    m_granuleCount(granuleCount),
+    m_startTime(startTimeTdbSec),
+    m_granuleLength(granuleLengthSec),
+    m_period(0.0),
+    m_boundingRadius(boundingRadius)
+{
+    setStartTime(startTimeTdbSec);
+    setEndTime(startTimeTdbSec + granuleCount * granuleLengthSec);
+}
+
+
 ChebyshevPolyTrajectory::~ChebyshevPolyTrajectory()
 {
-    delete[] m_coeffs;
+    if (m_ownsCoeffs)
+    {
+        delete[] m_coeffs;
+    }
 }
 
 
-StateVector
-ChebyshevPolyTrajectory::state(double tdbSec) const
+// Get a pointer to the coefficients for the specified granule. Coefficients stored
+// in the host byte order are used in place; otherwise, they're decoded into the
+// scratch buffer, which must have room for 3 * (degree + 1) values.
+const double*
+ChebyshevPolyTrajectory::granuleCoeffs(unsigned int granuleIndex, double* scratch) const
 {
-    tdbSec = max(startTime(), min(endTime(), tdbSec));
+    const double* coeffs = m_coeffs +
+                           (granuleIndex / m_granulesPerRecord) * m_recordStride +
+                           (granuleIndex % m_granulesPerRecord) * (m_degree + 1) * 3;
+    if (!m_byteSwapped)
+    {
+        return coeffs;
+    }
+
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(coeffs);
+    unsigned char* dest = reinterpret_cast<unsigned char*>(scratch);
+    unsigned int coeffCount = (m_degree + 1) * 3;
+    for (unsigned int i = 0; i < coeffCount; ++i)
+    {
+        for (unsigned int j = 0; j < sizeof(double); ++j)
+        {
+            dest[i * sizeof(double) + j] = src[i * sizeof(double) + sizeof(double) - 1 - j];
+        }
+    }
+
+    return scratch;
+}
+
 
-    int granuleIndex = int((tdbSec - m_startTime) / m_granuleLength);
-    double granuleStartTime = m_startTime + m_granuleLength * granuleIndex;
+// Find the granule containing the specified time and the interpolation parameter u,
+// which has a value in [-1, 1].
+void
+ChebyshevPolyTrajectory::locate(double tdbSec, unsigned int* granuleIndex, double* u) const
+{
+    tdbSec = max(startTime(), min(endTime(), tdbSec));
 
-    // The interpolation parameter is u, which has a value in [-1, 1]
-    double u = 2.0 * (tdbSec - granuleStartTime) / m_granuleLength - 1.0;
+    int index = int((tdbSec - m_startTime) / m_granuleLength);
+    double granuleStartTime = m_startTime + m_granuleLength * index;
+    double v = 2.0 * (tdbSec - granuleStartTime) / m_granuleLength - 1.0;
 
     // Clamp times outside the time span covered by the trajectory
-    if (granuleIndex < 0)
+    if (index < 0)
+    {
+        v = -1.0;
+        index = 0;
+    }
+    else if (index >= int(m_granuleCount))
+    {
+        v = 1.0;
+        index = m_granuleCount - 1;
+    }
+
+    *granuleIndex = (unsigned int) index;
+    *u = v;
+}
+
+
+namespace
+{
+
+// Evaluate the Chebyshev series for a single granule at the point u. The coefficients are
+// arranged as x0 ... xn y0 ... yn z0 ... zn. When CoeffCount is non-zero, the number of
+// coefficients is known at compile time and the recurrence can be fully unrolled;
+// otherwise the runtime count n is used.
+template<unsigned int CoeffCount, bool WithVelocity>
+inline void
+evaluateGranule(const double* coeffs, unsigned int n, double u, double* pos, double* vel)
+{
+    const unsigned int N = CoeffCount != 0 ? CoeffCount : n;
+    const double* cx = coeffs;
+    const double* cy = coeffs + N;
+    const double* cz = coeffs + 2 * N;
+
+    // T_0 = 1, T_1 = u; T_0' = 0, T_1' = 1
+    double px = cx[0];
+    double py = cy[0];
+    double pz = cz[0];
+    double vx = 0.0;
+    double vy = 0.0;
+    double vz = 0.0;
+    if (N > 1)
+    {
+        px += cx[1] * u;
+        py += cy[1] * u;
+        pz += cz[1] * u;
+        vx = cx[1];
+        vy = cy[1];
+        vz = cz[1];
+    }
+
+    double t0 = 1.0;
+    double t1 = u;
+    double d0 = 0.0;
+    double d1 = 1.0;
+    double twoU = 2.0 * u;
+
+    for (unsigned int i = 2; i < N; ++i)
     {
-        u = -1.0;
-        granuleIndex = 0;
+        double t2 = twoU * t1 - t0;
+        px += cx[i] * t2;
+        py += cy[i] * t2;
+        pz += cz[i] * t2;
+
+        if (WithVelocity)
+        {
+            double d2 = twoU * d1 - d0 + 2.0 * t1;
+            vx += cx[i] * d2;
+            vy += cy[i] * d2;
+            vz += cz[i] * d2;
+            d0 = d1;
+            d1 = d2;
+        }
+
+        t0 = t1;
+        t1 = t2;
     }
-    else if (granuleIndex >= int(m_granuleCount))
+
+    pos[0] = px;
+    pos[1] = py;
+    pos[2] = pz;
+    if (WithVelocity)
     {
-        u = 1.0;
-        granuleIndex = m_granuleCount - 1;
+        vel[0] = vx;
+        vel[1] = vy;
+        vel[2] = vz;
     }
+}
+
 
-    // Position terms
-    double x[MaxChebyshevDegree + 1];
-    x[0] = 1.0;
-    x[1] = u;
+#if CHEBYSHEV_USE_SSE2
+// Evaluate the same granule at two points at once; lane 0 holds the result for u0
+// and lane 1 the result for u1.
+template<unsigned int CoeffCount, bool WithVelocity>
+inline void
+evaluateGranulePair(const double* coeffs, unsigned int n, double u0, double u1, double* pos, double* vel)
+{
+    const unsigned int N = CoeffCount != 0 ? CoeffCount : n;
+    const double* cx = coeffs;
+    const double* cy = coeffs + N;
+    const double* cz = coeffs + 2 * N;
 
-    // Velocity terms (derivatives of position)
-    double v[MaxChebyshevDegree + 1];
-    v[0] = 0.0;
-    v[1] = 1.0;
+    __m128d u = _mm_set_pd(u1, u0);
+    __m128d two = _mm_set1_pd(2.0);
+    __m128d twoU = _mm_mul_pd(two, u);
 
-    for (unsigned int i = 2; i <= m_degree; ++i)
+    __m128d px = _mm_set1_pd(cx[0]);
+    __m128d py = _mm_set1_pd(cy[0]);
+    __m128d pz = _mm_set1_pd(cz[0]);
+    __m128d vx = _mm_setzero_pd();
+    __m128d vy = _mm_setzero_pd();
+    __m128d vz = _mm_setzero_pd();
+    if (N > 1)
     {
-        x[i] = 2.0 * u * x[i - 1] - x[i - 2];
-        v[i] = 2.0 * u * v[i - 1] - v[i - 2] + 2.0 * x[i - 1];
+        px = _mm_add_pd(px, _mm_mul_pd(_mm_set1_pd(cx[1]), u));
+        py = _mm_add_pd(py, _mm_mul_pd(_mm_set1_pd(cy[1]), u));
+        pz = _mm_add_pd(pz, _mm_mul_pd(_mm_set1_pd(cz[1]), u));
+        vx = _mm_set1_pd(cx[1]);
+        vy = _mm_set1_pd(cy[1]);
+        vz = _mm_set1_pd(cz[1]);
     }
 
-    // TODO: We can reduce numerical errors by summing high order terms first; should
-    // find out if this matters enough to be worth the trouble.
-    double* granuleCoeffs = m_coeffs + granuleIndex * (m_degree + 1) * 3;
-    Vector3d position = Map<MatrixXd>(granuleCoeffs, m_degree + 1, 3).transpose() * Map<MatrixXd>(x, m_degree + 1, 1);
-    Vector3d velocity = Map<MatrixXd>(granuleCoeffs, m_degree + 1, 3).transpose() * Map<MatrixXd>(v, m_degree + 1, 1);
+    __m128d t0 = _mm_set1_pd(1.0);
+    __m128d t1 = u;
+    __m128d d0 = _mm_setzero_pd();
+    __m128d d1 = _mm_set1_pd(1.0);
+
+    for (unsigned int i = 2; i < N; ++i)
+    {
+        __m128d t2 = _mm_sub_pd(_mm_mul_pd(twoU, t1), t0);
+        px = _mm_add_pd(px, _mm_mul_pd(_mm_set1_pd(cx[i]), t2));
+        py = _mm_add_pd(py, _mm_mul_pd(_mm_set1_pd(cy[i]), t2));
+        pz = _mm_add_pd(pz, _mm_mul_pd(_mm_set1_pd(cz[i]), t2));
 
-    return StateVector(position, velocity * (2.0 / m_granuleLength));
+        if (WithVelocity)
+        {
+            __m128d d2 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(twoU, d1), d0), _mm_mul_pd(two, t1));
+            vx = _mm_add_pd(vx, _mm_mul_pd(_mm_set1_pd(cx[i]), d2));
+            vy = _mm_add_pd(vy, _mm_mul_pd(_mm_set1_pd(cy[i]), d2));
+            vz = _mm_add_pd(vz, _mm_mul_pd(_mm_set1_pd(cz[i]), d2));
+            d0 = d1;
+            d1 = d2;
+        }
+
+        t0 = t1;
+        t1 = t2;
+    }
+
+    // Transpose from lanes to (x, y, z) triples
+    _mm_storel_pd(pos + 0, px);
+    _mm_storel_pd(pos + 1, py);
+    _mm_storel_pd(pos + 2, pz);
+    _mm_storeh_pd(pos + 3, px);
+    _mm_storeh_pd(pos + 4, py);
+    _mm_storeh_pd(pos + 5, pz);
+    if (WithVelocity)
+    {
+        _mm_storel_pd(vel + 0, vx);
+        _mm_storel_pd(vel + 1, vy);
+        _mm_storel_pd(vel + 2, vz);
+        _mm_storeh_pd(vel + 3, vx);
+        _mm_storeh_pd(vel + 4, vy);
+        _mm_storeh_pd(vel + 5, vz);
+    }
+}
+#endif
+
+}
+
+
+// Evaluate positions (and velocities when WithVelocity is true) at a list of times.
+// Consecutive times falling in the same granule share a single coefficient fetch,
+// and pairs of them are evaluated together when SSE2 is available.
+template<unsigned int CoeffCount, bool WithVelocity>
+void
+ChebyshevPolyTrajectory::evaluateBatch(const double* tdbSec,
+                                       unsigned int count,
+                                       Vector3d* positions,
+                                       Vector3d* velocities) const
+{
+    double scratch[(MaxChebyshevDegree + 1) * 3];
+    const double* coeffs = NULL;
+    unsigned int currentGranule = m_granuleCount;
+    unsigned int n = m_degree + 1;
+    double velocityScale = 2.0 / m_granuleLength;
+
+    double pos[6];
+    double vel[6];
+
+    unsigned int i = 0;
+    while (i < count)
+    {
+        unsigned int granule = 0;
+        double u = 0.0;
+        locate(tdbSec[i], &granule, &u);
+        if (granule != currentGranule)
+        {
+            coeffs = granuleCoeffs(granule, scratch);
+            currentGranule = granule;
+        }
+
+#if CHEBYSHEV_USE_SSE2
+        if (i + 1 < count)
+        {
+            unsigned int nextGranule = 0;
+            double nextU = 0.0;
+            locate(tdbSec[i + 1], &nextGranule, &nextU);
+            if (nextGranule == granule)
+            {
+                evaluateGranulePair<CoeffCount, WithVelocity>(coeffs, n, u, nextU, pos, vel);
+                positions[i] = Vector3d(pos[0], pos[1], pos[2]);
+                positions[i + 1] = Vector3d(pos[3], pos[4], pos[5]);
+                if (WithVelocity)
+                {
+                    velocities[i] = Vector3d(vel[0], vel[1], vel[2]) * velocityScale;
+                    velocities[i + 1] = Vector3d(vel[3], vel[4], vel[5]) * velocityScale;
+                }
+                i += 2;
+                continue;
+            }
+        }
+#endif
+
+        evaluateGranule<CoeffCount, WithVelocity>(coeffs, n, u, pos, vel);
+        positions[i] = Vector3d(pos[0], pos[1], pos[2]);
+        if (WithVelocity)
+        {
+            velocities[i] = Vector3d(vel[0], vel[1], vel[2]) * velocityScale;
+        }
+        ++i;
+    }
+}
+
+
+// Dispatch to a batch evaluator specialized for the degree of the polynomials. Fixed
+// size instantiations cover the degrees used by the JPL DE ephemerides and by the
+// Chebyshev trajectory files distributed with Cosmographia; other degrees use the
+// generic evaluator. Velocities are only computed when the velocities array is non-null.
+void
+ChebyshevPolyTrajectory::evaluate(const double* tdbSec, unsigned int count, Vector3d* positions, Vector3d* velocities) const
+{
+#define CHEBYSHEV_BATCH_CASE(n) \
+    case n: \
+        if (velocities) evaluateBatch<n, true>(tdbSec, count, positions, velocities); \
+        else evaluateBatch<n, false>(tdbSec, count, positions, NULL); \
+        break;
+
+    switch (m_degree + 1)
+    {
+    CHEBYSHEV_BATCH_CASE(6)
+    CHEBYSHEV_BATCH_CASE(7)
+    CHEBYSHEV_BATCH_CASE(8)
+    CHEBYSHEV_BATCH_CASE(9)
+    CHEBYSHEV_BATCH_CASE(10)
+    CHEBYSHEV_BATCH_CASE(11)
+    CHEBYSHEV_BATCH_CASE(12)
+    CHEBYSHEV_BATCH_CASE(13)
+    CHEBYSHEV_BATCH_CASE(14)
+    CHEBYSHEV_BATCH_CASE(15)
+    default:
+        if (velocities) evaluateBatch<0, true>(tdbSec, count, positions, velocities);
+        else evaluateBatch<0, false>(tdbSec, count, positions, NULL);
+        break;
+    }
+
+#undef CHEBYSHEV_BATCH_CASE
+}
+
+
+StateVector
+ChebyshevPolyTrajectory::state(double tdbSec) const
+{
+    Vector3d position;
+    Vector3d velocity;
+    evaluate(&tdbSec, 1, &position, &velocity);
+
+    return StateVector(position, velocity);
+}
+
+
+Vector3d
+ChebyshevPolyTrajectory::position(double tdbSec) const
+{
+    Vector3d position;
+    evaluate(&tdbSec, 1, &position, NULL);
+
+    return position;
+}
+
+
+/** Compute state vectors at count instants. This is much cheaper than calling state()
+  * for each time, especially when the times are sorted so that consecutive times
+  * often fall within the same granule.
+  */
+void
+ChebyshevPolyTrajectory::states(const double* tdbSec, unsigned int count, StateVector* out) const
+{
+    const unsigned int BatchSize = 64;
+    Vector3d positions[BatchSize];
+    Vector3d velocities[BatchSize];
+
+    for (unsigned int batchStart = 0; batchStart < count; batchStart += BatchSize)
+    {
+        unsigned int batchCount = min(BatchSize, count - batchStart);
+        evaluate(tdbSec + batchStart, batchCount, positions, velocities);
+        for (unsigned int i = 0; i < batchCount; ++i)
+        {
+            out[batchStart + i] = StateVector(positions[i], velocities[i]);
+        }
+    }
+}
+
+
+/** Compute positions at count instants. Velocities aren't calculated, which
+  * roughly halves the cost of evaluation.
+  */
+void
+ChebyshevPolyTrajectory::positions(const double* tdbSec, unsigned int count, Vector3d* out) const
+{
+    evaluate(tdbSec, count, out, NULL);
 }
 
 
@@ -18,6 +18,7 @@
 #define _CHEBYSHEV_POLY_TRAJECTORY_H_
 
 #include <vesta/Trajectory.h>
+#include <vesta/Object.h>
 
 
 class ChebyshevPolyTrajectory : public vesta::Trajectory
@@ -28,10 +29,23 @@ public:
                             double granuleCount,
                             double startTimeTdbSec,
                             double granuleLengthSec);
+    ChebyshevPolyTrajectory(const double* mappedCoeffs,
+                            unsigned int degree,
+                            unsigned int granuleCount,
+                            unsigned int granulesPerRecord,
+                            unsigned int recordStride,
+                            bool byteSwapped,
+                            double startTimeTdbSec,
+                            double granuleLengthSec,
+                            double boundingRadius,
+                            vesta::Object* storage);
 
     ~ChebyshevPolyTrajectory();
 
     virtual vesta::StateVector state(double tdbSec) const;
+    virtual Eigen::Vector3d position(double tdbSec) const;
+    virtual void states(const double* tdbSec, unsigned int count, vesta::StateVector* out) const;
+    virtual void positions(const double* tdbSec, unsigned int count, Eigen::Vector3d* out) const;
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
@@ -41,7 +55,21 @@ public:
     static const unsigned int MaxChebyshevDegree = 32;
 
 private:
-    double* m_coeffs;
+    const double* granuleCoeffs(unsigned int granuleIndex, double* scratch) const;
+    void locate(double tdbSec, unsigned int* granuleIndex, double* u) const;
+    void evaluate(const double* tdbSec, unsigned int count, Eigen::Vector3d* positions, Eigen::Vector3d* velocities) const;
+    template<unsigned int CoeffCount, bool WithVelocity> void evaluateBatch(const double* tdbSec,
+                                                                           unsigned int count,
+                                                                           Eigen::Vector3d* positions,
+                                                                           Eigen::Vector3d* velocities) const;
+
+private:
+    const double* m_coeffs;
+    bool m_ownsCoeffs;
+    unsigned int m_granulesPerRecord;
+    unsigned int m_recordStride;
+    bool m_byteSwapped;
+    vesta::counted_ptr<vesta::Object> m_storage;
     unsigned int m_degree;
     unsigned int m_granuleCount;
     double m_startTime;
@@ -20,6 +20,8 @@
 #include "GalleryView.h"
 #include "catalog/UniverseCatalog.h"
 #include "catalog/UniverseLoader.h"
+#include "catalog/JsonParser.h"
+#include "catalog/StarCatalogLoader.h"
 #include "qtwrapper/UniverseCatalogObject.h"
 #include "Cosmographia.h"
 #if FFMPEG_SUPPORT
@@ -30,6 +32,7 @@
 #include "JPLEphemeris.h"
 #include "NetworkTextureLoader.h"
 #include "LinearCombinationTrajectory.h"
+#include "ChebyshevCachedTrajectory.h"
 #include "astro/IAULunarRotationModel.h"
 #include "astro/MarsSat.h"
 #include "astro/L1.h"
@@ -50,7 +53,6 @@
 #include <vesta/WorldGeometry.h>
 #include <vesta/Units.h>
 #include <vesta/StarsLayer.h>
-#include <qjson/parser.h>
 #include <qjson/serializer.h>
 #include <algorithm>
 #include <QAction>
@@ -152,6 +154,8 @@ Cosmographia::~Cosmographia()
 {
     saveSettings();
     delete m_catalogWrapper;
+
+    ChebyshevCachedTrajectory::stopFitThread();
 }
 
 
@@ -540,43 +544,10 @@ Cosmographia::initializeUniverse()
 
     m_universe->addEntity(sun);
 
-    StarCatalog* stars = NULL;
-    QFile starFile("tycho2.stars");
-    if (starFile.open(QFile::ReadOnly))
+    // The star catalog is indexed by sky cell the first time that it's loaded
+    StarCatalog* stars = LoadStarCatalog("tycho2.stars");
+    if (stars)
     {
-        stars = new StarCatalog();
-        QDataStream in(&starFile);
-        in.setVersion(QDataStream::Qt_4_4);
-        in.setByteOrder(QDataStream::BigEndian);
-
-        bool ok = true;
-        while (ok)
-        {
-            quint32 id = 0;
-            float ra = 0.0f;
-            float dec = 0.0f;
-            float vmag = 0.0f;
-            float bv = 0.0f;
-            in >> id >> ra >> dec >> vmag >> bv;
-
-            // Constrain maximum B-V color index; conversion to RGB color is not
-            // valid for large values. TODO: Fix this in VESTA
-            if (bv > 2.5f)
-            {
-                bv = 2.5f;
-            }
-
-            if (in.status() == QDataStream::Ok)
-            {
-                stars->addStar(id, (float) toRadians(ra), (float) toRadians(dec), vmag, bv);
-            }
-            else
-            {
-                ok = false;
-            }
-        }
-
-        stars->buildCatalogIndex();
         m_universe->setStarCatalog(stars);
     }
 }
@@ -593,6 +564,23 @@ createSunRelativeTrajectory(const JPLEphemeris* eph, JPLEphemeris::JplObjectId i
 }
 
 
+// Wrap an analytic satellite theory in a cache of fitted Chebyshev polynomials.
+// The cache can be disabled or its tolerance changed in the settings.
+static Trajectory*
+createCachedTheory(Trajectory* theory, double blockDays)
+{
+    QSettings settings;
+    if (!settings.value("analyticOrbitCache", true).toBool())
+    {
+        return theory;
+    }
+
+    // Default tolerance is one meter, well below the accuracy of the theories
+    double tolerance = settings.value("analyticOrbitCacheTolerance", 0.001).toDouble();
+    return new ChebyshevCachedTrajectory(theory, daysToSeconds(blockDays), tolerance);
+}
+
+
 static QString cacheFilePath(const QString& fileName)
 {
 #if 0
@@ -686,32 +674,34 @@ Cosmographia::initialize()
         //std::cout << "Earth @ J2000: " << earthTrajectory->position(0.0).transpose().format(16) << std::endl;
     }
 
-    // Martian satellites
-    m_loader->addBuiltinOrbit("Phobos", MarsSatOrbit::Create(MarsSatOrbit::Phobos));
-    m_loader->addBuiltinOrbit("Deimos", MarsSatOrbit::Create(MarsSatOrbit::Deimos));
+    // Martian satellites. Satellites of the same planet are fit with the same
+    // block length so that TASS17 can share work between the Saturnian satellites
+    // while blocks are fit.
+    m_loader->addBuiltinOrbit("Phobos", createCachedTheory(MarsSatOrbit::Create(MarsSatOrbit::Phobos), 1.0));
+    m_loader->addBuiltinOrbit("Deimos", createCachedTheory(MarsSatOrbit::Create(MarsSatOrbit::Deimos), 1.0));
 
     // Galilean satellites
-    m_loader->addBuiltinOrbit("Io", L1Orbit::Create(L1Orbit::Io));
-    m_loader->addBuiltinOrbit("Europa", L1Orbit::Create(L1Orbit::Europa));
-    m_loader->addBuiltinOrbit("Ganymede", L1Orbit::Create(L1Orbit::Ganymede));
-    m_loader->addBuiltinOrbit("Callisto", L1Orbit::Create(L1Orbit::Callisto));
+    m_loader->addBuiltinOrbit("Io",       createCachedTheory(L1Orbit::Create(L1Orbit::Io), 4.0));
+    m_loader->addBuiltinOrbit("Europa",   createCachedTheory(L1Orbit::Create(L1Orbit::Europa), 4.0));
+    m_loader->addBuiltinOrbit("Ganymede", createCachedTheory(L1Orbit::Create(L1Orbit::Ganymede), 4.0));
+    m_loader->addBuiltinOrbit("Callisto", createCachedTheory(L1Orbit::Create(L1Orbit::Callisto), 4.0));
 
     // Saturnian satellites
-    m_loader->addBuiltinOrbit("Mimas",     TASS17Orbit::Create(TASS17Orbit::Mimas));
-    m_loader->addBuiltinOrbit("Enceladus", TASS17Orbit::Create(TASS17Orbit::Enceladus));
-    m_loader->addBuiltinOrbit("Tethys",    TASS17Orbit::Create(TASS17Orbit::Tethys));
-    m_loader->addBuiltinOrbit("Dione",     TASS17Orbit::Create(TASS17Orbit::Dione));
-    m_loader->addBuiltinOrbit("Rhea",      TASS17Orbit::Create(TASS17Orbit::Rhea));
-    m_loader->addBuiltinOrbit("Titan",     TASS17Orbit::Create(TASS17Orbit::Titan));
-    m_loader->addBuiltinOrbit("Hyperion",  TASS17Orbit::Create(TASS17Orbit::Hyperion));
-    m_loader->addBuiltinOrbit("Iapetus",   TASS17Orbit::Create(TASS17Orbit::Iapetus));
+    m_loader->addBuiltinOrbit("Mimas",     createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Mimas), 4.0));
+    m_loader->addBuiltinOrbit("Enceladus", createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Enceladus), 4.0));
+    m_loader->addBuiltinOrbit("Tethys",    createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Tethys), 4.0));
+    m_loader->addBuiltinOrbit("Dione",     createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Dione), 4.0));
+    m_loader->addBuiltinOrbit("Rhea",      createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Rhea), 4.0));
+    m_loader->addBuiltinOrbit("Titan",     createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Titan), 4.0));
+    m_loader->addBuiltinOrbit("Hyperion",  createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Hyperion), 4.0));
+    m_loader->addBuiltinOrbit("Iapetus",   createCachedTheory(TASS17Orbit::Create(TASS17Orbit::Iapetus), 4.0));
 
     // Uranian satellites
-    m_loader->addBuiltinOrbit("Miranda",   Gust86Orbit::Create(Gust86Orbit::Miranda));
-    m_loader->addBuiltinOrbit("Ariel",     Gust86Orbit::Create(Gust86Orbit::Ariel));
-    m_loader->addBuiltinOrbit("Umbriel",   Gust86Orbit::Create(Gust86Orbit::Umbriel));
-    m_loader->addBuiltinOrbit("Titania",   Gust86Orbit::Create(Gust86Orbit::Titania));
-    m_loader->addBuiltinOrbit("Oberon",    Gust86Orbit::Create(Gust86Orbit::Oberon));
+    m_loader->addBuiltinOrbit("Miranda",   createCachedTheory(Gust86Orbit::Create(Gust86Orbit::Miranda), 4.0));
+    m_loader->addBuiltinOrbit("Ariel",     createCachedTheory(Gust86Orbit::Create(Gust86Orbit::Ariel), 4.0));
+    m_loader->addBuiltinOrbit("Umbriel",   createCachedTheory(Gust86Orbit::Create(Gust86Orbit::Umbriel), 4.0));
+    m_loader->addBuiltinOrbit("Titania",   createCachedTheory(Gust86Orbit::Create(Gust86Orbit::Titania), 4.0));
+    m_loader->addBuiltinOrbit("Oberon",    createCachedTheory(Gust86Orbit::Create(Gust86Orbit::Oberon), 4.0));
 
     // Set up builtin rotation models
     m_loader->addBuiltinRotationModel("IAU Moon", new IAULunarRotationModel());
@@ -1338,7 +1328,7 @@ Cosmographia::loadStarNamesFile(const QString &fileName, StarCatalog* starCatalo
         return;
     }
 
-    QJson::Parser parser;
+    JsonParser parser;
     bool parseOk = false;
     QVariant nameListVar = parser.parse(&namesFile, &parseOk);
     if (!parseOk)
@@ -1613,7 +1603,7 @@ Cosmographia::loadGallery(const QString& fileName)
         return;
     }
 
-    QJson::Parser parser;
+    JsonParser parser;
     bool parseOk = false;
     QVariant nameListVar = parser.parse(&galleryFile, &parseOk);
     if (!parseOk)
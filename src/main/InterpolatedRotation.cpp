@@ -23,25 +23,50 @@ using namespace Eigen;
 using namespace std;
 
 
-// A weak ordering on time/state records used for binary search by
-// time.
-class TimeOrientationOrdering
+/** Create a new interpolated rotation model with the specified list
+  * of time/orientation records.
+  */
+InterpolatedRotation::InterpolatedRotation(const TimeOrientationList& orientations) :
+    m_recordCount(orientations.size()),
+    m_times(NULL),
+    m_orientations(NULL)
 {
-public:
-    bool operator()(const InterpolatedRotation::TimeOrientation& t0,
-                    const InterpolatedRotation::TimeOrientation& t1)
+    m_data.resize(max(1u, m_recordCount * 5));
+    double* times = &m_data[0];
+    double* q = times + m_recordCount;
+    for (unsigned int i = 0; i < m_recordCount; ++i)
     {
-        return t0.tsec < t1.tsec;
+        times[i] = orientations[i].tsec;
+        q[i * 4 + 0] = orientations[i].orientation.w();
+        q[i * 4 + 1] = orientations[i].orientation.x();
+        q[i * 4 + 2] = orientations[i].orientation.y();
+        q[i * 4 + 3] = orientations[i].orientation.z();
     }
-};
 
+    m_times = times;
+    m_orientations = q;
+}
 
-/** Create a new interpolated rotation model with the specified list
-  * of time/orientation records.
+
+/** Create a new interpolated rotation model from arrays of times and
+  * quaternions. The arrays are not copied; the storage object is retained
+  * by the rotation model and must keep the arrays valid for as long as it
+  * exists.
+  *
+  * \param recordCount the number of records
+  * \param times record times in seconds since J2000 TDB, in increasing order
+  * \param orientations 4 * recordCount values, w, x, y, and z for each record
+  * \param storage the owner of the arrays (may be null for static data)
   */
-InterpolatedRotation::InterpolatedRotation(const TimeOrientationList& orientations)
+InterpolatedRotation::InterpolatedRotation(unsigned int recordCount,
+                                           const double* times,
+                                           const double* orientations,
+                                           Object* storage) :
+    m_recordCount(recordCount),
+    m_times(times),
+    m_orientations(orientations),
+    m_storage(storage)
 {
-    m_orientations = orientations;
 }
 
 
@@ -50,6 +75,15 @@ InterpolatedRotation::~InterpolatedRotation()
 }
 
 
+// Return the index of the first record with a time greater than or equal to
+// tdbSec (or the record count if there is no such record.)
+unsigned int
+InterpolatedRotation::findRecord(double tdbSec) const
+{
+    return lower_bound(m_times, m_times + m_recordCount, tdbSec) - m_times;
+}
+
+
 /** Calculate the orientation at the specified time (seconds since J2000 TDB).
   * The interpolation technique is spherical linear (slerp).
   *
@@ -59,27 +93,25 @@ InterpolatedRotation::~InterpolatedRotation()
 Quaterniond
 InterpolatedRotation::orientation(double tdbSec) const
 {
-    if (!m_orientations.empty())
+    if (m_recordCount > 0)
     {
-        TimeOrientation t;
-        t.tsec = tdbSec;
-        TimeOrientationList::const_iterator iter = lower_bound(m_orientations.begin(), m_orientations.end(), t, TimeOrientationOrdering());
+        unsigned int index = findRecord(tdbSec);
 
-        if (iter == m_orientations.begin())
+        if (index == 0)
         {
-            return m_orientations.front().orientation;
+            return recordOrientation(0);
         }
-        else if (iter == m_orientations.end())
+        else if (index == m_recordCount)
         {
-            return m_orientations.back().orientation;
+            return recordOrientation(m_recordCount - 1);
         }
         else
         {
-            TimeOrientation s0 = *(iter - 1);
-            TimeOrientation s1 = *iter;
-            double t = (tdbSec - s0.tsec) / (s1.tsec - s0.tsec);
+            double t0 = m_times[index - 1];
+            double t1 = m_times[index];
+            double t = (tdbSec - t0) / (t1 - t0);
 
-            return s0.orientation.slerp(t, s1.orientation);
+            return recordOrientation(index - 1).slerp(t, recordOrientation(index));
         }
     }
     else
@@ -92,33 +124,19 @@ InterpolatedRotation::orientation(double tdbSec) const
 Vector3d
 InterpolatedRotation::angularVelocity(double tdbSec) const
 {
-    if (m_orientations.size() > 1)
+    if (m_recordCount > 1)
     {
-        TimeOrientation t0;
-        TimeOrientation t1;
-
-        TimeOrientation t;
-        t.tsec = tdbSec;
-        TimeOrientationList::const_iterator iter = lower_bound(m_orientations.begin(), m_orientations.end(), t, TimeOrientationOrdering());
-
-        if (iter == m_orientations.begin())
-        {
-            t0 = m_orientations[0];
-            t1 = m_orientations[1];
-        }
-        else if (iter == m_orientations.end())
+        unsigned int index = findRecord(tdbSec);
+        if (index == 0)
         {
-            unsigned int n = m_orientations.size();
-            t0 = m_orientations[n - 2];
-            t1 = m_orientations[n - 1];
+            index = 1;
         }
-        else
+        else if (index == m_recordCount)
         {
-            t0 = *(iter - 1);
-            t1 = *iter;
+            index = m_recordCount - 1;
         }
 
-        double h = t1.tsec - t0.tsec;
+        double h = m_times[index] - m_times[index - 1];
 
         // The derivative of a quaternion function q(t) (where t is a scalar) is
         // given by:
@@ -127,7 +145,7 @@ InterpolatedRotation::angularVelocity(double tdbSec) const
         // Where w(t) given by a * v(t), with a the scalar angular velocity and
         // v(t) a unit direction vector.
 
-        Quaterniond dq = t1.orientation * t0.orientation.conjugate();
+        Quaterniond dq = recordOrientation(index) * recordOrientation(index - 1).conjugate();
         const double one = 1.0 - machine_epsilon<double>();
 
         if (abs(dq.w()) > one)
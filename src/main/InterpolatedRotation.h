@@ -47,13 +47,51 @@ public:
     typedef std::vector<TimeOrientation, Eigen::aligned_allocator<TimeOrientation> > TimeOrientationList;
 
     InterpolatedRotation(const TimeOrientationList& orientations);
+    InterpolatedRotation(unsigned int recordCount,
+                         const double* times,
+                         const double* orientations,
+                         vesta::Object* storage);
     ~InterpolatedRotation();
 
     virtual Eigen::Quaterniond orientation(double tdbSec) const;
     virtual Eigen::Vector3d angularVelocity(double tdbSec) const;
 
+    unsigned int recordCount() const
+    {
+        return m_recordCount;
+    }
+
+    /** Get the array of record times (recordCount() values.) */
+    const double* timeArray() const
+    {
+        return m_times;
+    }
+
+    /** Get the array of record orientations (4 * recordCount() values, w x y z
+      * for each quaternion.)
+      */
+    const double* orientationArray() const
+    {
+        return m_orientations;
+    }
+
+private:
+    unsigned int findRecord(double tdbSec) const;
+
+    Eigen::Quaterniond recordOrientation(unsigned int index) const
+    {
+        const double* q = m_orientations + index * 4;
+        return Eigen::Quaterniond(q[0], q[1], q[2], q[3]);
+    }
+
 private:
-    TimeOrientationList m_orientations;
+    // Records are either stored in m_data or in memory owned by m_storage
+    // (typically a memory mapped file.)
+    unsigned int m_recordCount;
+    const double* m_times;
+    const double* m_orientations;
+    std::vector<double> m_data;
+    vesta::counted_ptr<vesta::Object> m_storage;
 };
 
 #endif // _INTERPOLATED_ROTATION_H_
@@ -23,48 +23,74 @@ using namespace Eigen;
 using namespace std;
 
 
-// A weak ordering on time/orientation records used for binary search by
-// time.
-class TimeStateOrdering
+/** Create a new interpolated state trajectory with the specified list
+  * of time/state records.
+  */
+InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimeStateList& states) :
+    m_period(0.0),
+    m_boundingRadius(0.0),
+    m_recordCount(0),
+    m_times(NULL),
+    m_positions(NULL),
+    m_velocities(NULL)
 {
-public:
-    bool operator()(const InterpolatedStateTrajectory::TimeState& t0,
-                    const InterpolatedStateTrajectory::TimeState& t1)
+    if (!states.empty())
     {
-        return t0.tsec < t1.tsec;
+        setValidTimeRange(states.front().tsec, states.back().tsec);
     }
-};
 
+    allocateRecords(states.size());
+    double* times = &m_data[0];
+    double* positions = times + m_recordCount;
+    double* velocities = positions + m_recordCount * 3;
 
-// A weak ordering on time/position records used for binary search by
-// time.
-class TimePositionOrdering
-{
-public:
-    bool operator()(const InterpolatedStateTrajectory::TimePosition& t0,
-                    const InterpolatedStateTrajectory::TimePosition& t1)
+    for (unsigned int index = 0; index < m_recordCount; ++index)
     {
-        return t0.tsec < t1.tsec;
+        const TimeState& record = states[index];
+        m_boundingRadius = std::max(m_boundingRadius, record.state.position().norm());
+
+        times[index] = record.tsec;
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            positions[index * 3 + i] = record.state.position()[i];
+            velocities[index * 3 + i] = record.state.velocity()[i];
+        }
     }
-};
+}
 
 
-/** Create a new interpolated state trajectory with the specified list
-  * of time/state records.
-  */
-InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimeStateList& states) :
-    m_period(0.0),
-    m_boundingRadius(0.0)
+static Vector3d
+estimateVelocity(const InterpolatedStateTrajectory::TimePositionList& positions, unsigned int index)
 {
-    m_states = states;
-    if (!states.empty())
+    assert(index < positions.size());
+
+    if (positions.size() < 2)
     {
-        setValidTimeRange(states.front().tsec, states.back().tsec);
+        return Vector3d::Zero();
     }
+    else if (index == 0)
+    {
+        // One-sided difference for first point
+        double h = positions[1].tsec - positions[0].tsec;
+        return (positions[1].position - positions[0].position) / h;
+    }
+    else if (index == positions.size() - 1)
+    {
+        assert(index > 0);
 
-    for (TimeStateList::const_iterator iter = states.begin(); iter != states.end(); ++iter)
+        // One-sided difference for last point
+        double h = positions[index].tsec - positions[index - 1].tsec;
+        return (positions[index].position - positions[index - 1].position) / h;
+    }
+    else
     {
-        m_boundingRadius = std::max(m_boundingRadius, iter->state.position().norm());
+        assert(index > 0 && index + 1 < positions.size());
+
+        // Three-point difference for points in the middle
+        double h0 = positions[index].tsec - positions[index - 1].tsec;
+        double h1 = positions[index + 1].tsec - positions[index].tsec;
+        return 0.5 * ((positions[index].position - positions[index - 1].position) / h0 +
+                      (positions[index + 1].position - positions[index].position) / h1);
     }
 }
 
@@ -75,17 +101,65 @@ InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimeStateList& st
   */
 InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimePositionList& positions) :
     m_period(0.0),
-    m_boundingRadius(0.0)
+    m_boundingRadius(0.0),
+    m_recordCount(0),
+    m_times(NULL),
+    m_positions(NULL),
+    m_velocities(NULL)
 {
-    m_positions = positions;
     if (!positions.empty())
     {
         setValidTimeRange(positions.front().tsec, positions.back().tsec);
     }
 
-    for (TimePositionList::const_iterator iter = positions.begin(); iter != positions.end(); ++iter)
+    allocateRecords(positions.size());
+    double* times = &m_data[0];
+    double* recordPositions = times + m_recordCount;
+    double* velocities = recordPositions + m_recordCount * 3;
+
+    for (unsigned int index = 0; index < m_recordCount; ++index)
+    {
+        m_boundingRadius = std::max(m_boundingRadius, positions[index].position.norm());
+
+        Vector3d velocity = estimateVelocity(positions, index);
+        times[index] = positions[index].tsec;
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            recordPositions[index * 3 + i] = positions[index].position[i];
+            velocities[index * 3 + i] = velocity[i];
+        }
+    }
+}
+
+
+/** Create a new interpolated state trajectory from arrays of times, positions,
+  * and velocities. The arrays are not copied; the storage object is retained
+  * by the trajectory and must keep the arrays valid for as long as it exists.
+  *
+  * \param recordCount the number of records
+  * \param times record times in seconds since J2000 TDB, in increasing order
+  * \param positions 3 * recordCount values, x, y, and z for each record
+  * \param velocities 3 * recordCount values, x, y, and z for each record
+  * \param boundingRadius the largest distance of any record from the center
+  * \param storage the owner of the arrays (may be null for static data)
+  */
+InterpolatedStateTrajectory::InterpolatedStateTrajectory(unsigned int recordCount,
+                                                         const double* times,
+                                                         const double* positions,
+                                                         const double* velocities,
+                                                         double boundingRadius,
+                                                         Object* storage) :
+    m_period(0.0),
+    m_boundingRadius(boundingRadius),
+    m_recordCount(recordCount),
+    m_times(times),
+    m_positions(positions),
+    m_velocities(velocities),
+    m_storage(storage)
+{
+    if (recordCount > 0)
     {
-        m_boundingRadius = std::max(m_boundingRadius, iter->position.norm());
+        setValidTimeRange(times[0], times[recordCount - 1]);
     }
 }
 
@@ -95,6 +169,19 @@ InterpolatedStateTrajectory::~InterpolatedStateTrajectory()
 }
 
 
+// Allocate space for the records in a single block: all times, followed by
+// all positions, followed by all velocities.
+void
+InterpolatedStateTrajectory::allocateRecords(unsigned int recordCount)
+{
+    m_recordCount = recordCount;
+    m_data.resize(max(1u, recordCount * 7));
+    m_times = &m_data[0];
+    m_positions = m_times + recordCount;
+    m_velocities = m_positions + recordCount * 3;
+}
+
+
 // Perform cubici Hermite interpolation on the unit interval with
 // the position and tangent at 0 given by r0, v0; and the position
 // and tangent at 1 by r1, v1.
@@ -124,36 +211,58 @@ cubicHermitInterpolate(const Vector3d& r0, const Vector3d& v0,
 }
 
 
-static Vector3d
-estimateVelocity(const InterpolatedStateTrajectory::TimePositionList& positions, unsigned int index)
+// Return the index of the first record with a time greater than or equal to
+// tdbSec (or the record count if there is no such record.) The hint and the
+// record after it are checked before falling back to a binary search, so that
+// lookups are constant time when time advances smoothly.
+unsigned int
+InterpolatedStateTrajectory::findRecord(double tdbSec, unsigned int hint) const
 {
-    assert(index < positions.size());
+    unsigned int recordCount = m_recordCount;
 
-    if (index == 0)
+    if (hint < recordCount && m_times[hint] >= tdbSec && (hint == 0 || m_times[hint - 1] < tdbSec))
     {
-        assert(positions.size() > 1);
-
-        // One-sided difference for first point
-        double h = positions[1].tsec - positions[0].tsec;
-        return (positions[1].position - positions[0].position) / h;
+        return hint;
     }
-    else if (index == positions.size() - 1)
+    else if (hint + 1 < recordCount && m_times[hint + 1] >= tdbSec && m_times[hint] < tdbSec)
     {
-        assert(index > 0);
+        return hint + 1;
+    }
+    else
+    {
+        return lower_bound(m_times, m_times + m_recordCount, tdbSec) - m_times;
+    }
+}
 
-        // One-sided difference for last point
-        double h = positions[index].tsec - positions[index - 1].tsec;
-        return (positions[index].position - positions[index - 1].position) / h;
+
+// Interpolate between the record at index and the one preceding it. The
+// index is the value returned by findRecord(), and times outside the
+// span of the table are clamped to the first or last record.
+StateVector
+InterpolatedStateTrajectory::interpolate(unsigned int index, double tdbSec) const
+{
+    if (m_recordCount == 0)
+    {
+        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+    }
+    else if (index == 0)
+    {
+        return StateVector(recordPosition(0), recordVelocity(0));
+    }
+    else if (index >= m_recordCount)
+    {
+        unsigned int last = m_recordCount - 1;
+        return StateVector(recordPosition(last), recordVelocity(last));
     }
     else
     {
-        assert(index > 0 && index + 1 < positions.size());
+        double h = m_times[index] - m_times[index - 1];
+        double t = (tdbSec - m_times[index - 1]) / h;
 
-        // Three-point difference for points in the middle
-        double h0 = positions[index].tsec - positions[index - 1].tsec;
-        double h1 = positions[index + 1].tsec - positions[index].tsec;
-        return 0.5 * ((positions[index].position - positions[index - 1].position) / h0 +
-                      (positions[index + 1].position - positions[index].position) / h1);
+        StateVector s = cubicHermitInterpolate(recordPosition(index - 1), recordVelocity(index - 1) * h,
+                                               recordPosition(index), recordVelocity(index) * h,
+                                               t);
+        return StateVector(s.position(), s.velocity() / h);
     }
 }
 
@@ -162,73 +271,43 @@ estimateVelocity(const InterpolatedStateTrajectory::TimePositionList& positions,
   *
   * The input time is clamped to so that it lies within the range between
   * the first and last record.
+  *
+  * No state is kept between calls, so the record is found with a binary
+  * search; use the cursor version of state() or states() when evaluating
+  * a sequence of nearby times.
   */
 StateVector
 InterpolatedStateTrajectory::state(double tdbSec) const
 {
-    if (!m_states.empty())
-    {
-        // Use state vector table
-        TimeState ts;
-        ts.tsec = tdbSec;
-        TimeStateList::const_iterator iter = lower_bound(m_states.begin(), m_states.end(), ts, TimeStateOrdering());
-
-        if (iter == m_states.begin())
-        {
-            return m_states.front().state;
-        }
-        else if (iter == m_states.end())
-        {
-            return m_states.back().state;
-        }
-        else
-        {
-            TimeState s0 = *(iter - 1);
-            TimeState s1 = *iter;
-            double h = s1.tsec - s0.tsec;
-            double t = (tdbSec - s0.tsec) / h;
+    unsigned int index = lower_bound(m_times, m_times + m_recordCount, tdbSec) - m_times;
+    return interpolate(index, tdbSec);
+}
 
 
-            StateVector s = cubicHermitInterpolate(s0.state.position(), s0.state.velocity() * h,
-                                                   s1.state.position(), s1.state.velocity() * h,
-                                                   t);
-            return StateVector(s.position(), s.velocity() / h);
-        }
-    }
-    else if (!m_positions.empty())
-    {
-        // Use position table
+/** Calculate the state vector at the specified time, using a caller-supplied
+  * cursor to speed up the record search. The cursor should be initialized to
+  * zero; it is updated on each call. Lookups are constant time when successive
+  * calls with the same cursor have nearby times.
+  */
+StateVector
+InterpolatedStateTrajectory::state(double tdbSec, unsigned int* cursor) const
+{
+    unsigned int index = findRecord(tdbSec, *cursor);
+    *cursor = index;
+    return interpolate(index, tdbSec);
+}
 
-        TimePosition ts;
-        ts.tsec = tdbSec;
-        TimePositionList::const_iterator iter = lower_bound(m_positions.begin(), m_positions.end(), ts, TimePositionOrdering());
 
-        if (iter == m_positions.begin())
-        {
-            Vector3d velocity = estimateVelocity(m_positions, 0);
-            return StateVector(m_positions.front().position, velocity);
-        }
-        else if (iter == m_positions.end())
-        {
-            Vector3d velocity = estimateVelocity(m_positions, m_positions.size() - 1);
-            return StateVector(m_positions.back().position, velocity);
-        }
-        else
-        {
-            TimePosition s0 = *(iter - 1);
-            TimePosition s1 = *iter;
-            Vector3d v0 = estimateVelocity(m_positions, iter - m_positions.begin() - 1);
-            Vector3d v1 = estimateVelocity(m_positions, iter - m_positions.begin());
-            double h = s1.tsec - s0.tsec;
-            double t = (tdbSec - s0.tsec) / h;
-
-            StateVector s = cubicHermitInterpolate(s0.position, v0 * h, s1.position, v1 * h, t);
-            return StateVector(s.position(), s.velocity() / h);
-        }
-    }
-    else
+/** Calculate states at a list of times. When the times are in increasing
+  * order, no searching is required.
+  */
+void
+InterpolatedStateTrajectory::states(const double* tdbSec, unsigned int count, StateVector* out) const
+{
+    unsigned int cursor = 0;
+    for (unsigned int i = 0; i < count; ++i)
     {
-        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+        out[i] = state(tdbSec[i], &cursor);
     }
 }
 
@@ -264,40 +343,19 @@ InterpolatedStateTrajectory::setPeriod(double period)
 unsigned int
 InterpolatedStateTrajectory::stateCount() const
 {
-    if (!m_states.empty())
-    {
-        return m_states.size();
-    }
-    else
-    {
-        return m_positions.size();
-    }
+    return m_recordCount;
 }
 
 
 double
 InterpolatedStateTrajectory::time(unsigned int index) const
 {
-    if (!m_states.empty())
+    if (index < m_recordCount)
     {
-        if (index < m_states.size())
-        {
-            return m_states[index].tsec;
-        }
-        else
-        {
-            return 0.0;
-        }
+        return m_times[index];
     }
     else
     {
-        if (index < m_positions.size())
-        {
-            return m_positions[index].tsec;
-        }
-        else
-        {
-            return 0.0;
-        }
+        return 0.0;
     }
 }
@@ -34,6 +34,11 @@
   * available, velocities should be given; if memory is constrained, it is
   * better accuracy can be achieved by reducing the number of records by
   * half rather than using postions instead of state vectors.
+  *
+  * Records are stored as separate arrays of times, positions, and velocities;
+  * velocities for position-only tables are estimated once at construction.
+  * The arrays may also be supplied by the caller (e.g. from a memory mapped
+  * sampled data pack), in which case they are used without copying.
   */
 class InterpolatedStateTrajectory : public vesta::Trajectory
 {
@@ -55,23 +60,72 @@ public:
 
     InterpolatedStateTrajectory(const TimeStateList& states);
     InterpolatedStateTrajectory(const TimePositionList& positions);
+    InterpolatedStateTrajectory(unsigned int recordCount,
+                                const double* times,
+                                const double* positions,
+                                const double* velocities,
+                                double boundingRadius,
+                                vesta::Object* storage);
     ~InterpolatedStateTrajectory();
 
     virtual vesta::StateVector state(double tdbSec) const;
+    virtual void states(const double* tdbSec, unsigned int count, vesta::StateVector* out) const;
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
 
+    vesta::StateVector state(double tdbSec, unsigned int* cursor) const;
+
     void setPeriod(double period);
 
     unsigned int stateCount() const;
     double time(unsigned int index) const;
 
+    /** Get the array of record times (stateCount() values.) */
+    const double* timeArray() const
+    {
+        return m_times;
+    }
+
+    /** Get the array of record positions (3 * stateCount() values, xyz packed.) */
+    const double* positionArray() const
+    {
+        return m_positions;
+    }
+
+    /** Get the array of record velocities (3 * stateCount() values, xyz packed.) */
+    const double* velocityArray() const
+    {
+        return m_velocities;
+    }
+
+private:
+    void allocateRecords(unsigned int recordCount);
+    unsigned int findRecord(double tdbSec, unsigned int hint) const;
+    vesta::StateVector interpolate(unsigned int index, double tdbSec) const;
+
+    Eigen::Vector3d recordPosition(unsigned int index) const
+    {
+        return Eigen::Vector3d(m_positions[index * 3], m_positions[index * 3 + 1], m_positions[index * 3 + 2]);
+    }
+
+    Eigen::Vector3d recordVelocity(unsigned int index) const
+    {
+        return Eigen::Vector3d(m_velocities[index * 3], m_velocities[index * 3 + 1], m_velocities[index * 3 + 2]);
+    }
+
 private:
     double m_period;
     double m_boundingRadius;
-    TimeStateList m_states;
-    TimePositionList m_positions;
+
+    // Records are either stored in m_data or in memory owned by m_storage
+    // (typically a memory mapped file.)
+    unsigned int m_recordCount;
+    const double* m_times;
+    const double* m_positions;
+    const double* m_velocities;
+    std::vector<double> m_data;
+    vesta::counted_ptr<vesta::Object> m_storage;
 };
 
 #endif // _INTERPOLATED_STATE_TRAJECTORY_H_
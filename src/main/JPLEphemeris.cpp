@@ -16,9 +16,10 @@
 
 #include "JPLEphemeris.h"
 #include <vesta/Units.h>
-#include <QDataStream>
 #include <QFile>
 #include <QDebug>
+#include <cmath>
+#include <cstring>
 
 using namespace vesta;
 using namespace std;
@@ -67,133 +68,228 @@ struct JplEphCoeffInfo
 };
 
 
-JPLEphemeris*
-JPLEphemeris::load(const string& filename)
+// JplEphemerisFile keeps a binary JPL ephemeris file mapped into memory for as long
+// as any trajectory still refers to it.
+class JplEphemerisFile : public Object
 {
-    const int JplEph_LabelSize                      =   84;
-    const unsigned int JplEph_ConstantCount         =  400;
-    const unsigned int JplEph_ConstantNameLength    =    6;
-    const unsigned int JplEph_ObjectCount           =   12; // Sun, Moon, planets (incl. Pluto), Earth-Moon bary.
-
-    const unsigned int DE406_RecordSize             =  728;
-
-    QFile ephemFile(filename.c_str());
-    if (!ephemFile.open(QIODevice::ReadOnly))
+public:
+    JplEphemerisFile(const QString& fileName) :
+        m_file(fileName),
+        m_data(NULL),
+        m_size(0)
     {
-        qDebug() << "Ephemeris file is missing!";
-        return NULL;
     }
 
-    QDataStream in(&ephemFile);
-    in.setByteOrder(QDataStream::BigEndian);
+    ~JplEphemerisFile()
+    {
+        if (m_data)
+        {
+            m_file.unmap(m_data);
+        }
+    }
 
-    in.skipRawData(JplEph_LabelSize * 3);
-    if (in.status() != QDataStream::Ok)
+    bool map()
     {
-        return NULL;
+        if (!m_file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+
+        m_size = m_file.size();
+        m_data = m_file.map(0, m_size);
+
+        return m_data != NULL;
     }
 
-    // Skip past the constant names
-    in.skipRawData(JplEph_ConstantCount * JplEph_ConstantNameLength);
-    if (in.status() != QDataStream::Ok)
+    const uchar* data() const
     {
-        return NULL;
+        return m_data;
     }
 
-    double startJd = 0.0;
-    double endJd = 0.0;
-    double daysPerRecord = 0.0;
-    in >> startJd;
-    in >> endJd;
-    in >> daysPerRecord;
-    if (in.status() != QDataStream::Ok)
+    qint64 size() const
     {
-        return NULL;
+        return m_size;
     }
 
-    // Skip number of constants with values
-    in.skipRawData(sizeof(quint32));
+private:
+    QFile m_file;
+    uchar* m_data;
+    qint64 m_size;
+};
 
-    double kmPerAu = 0.0;
-    in >> kmPerAu;
-    double earthMoonMassRatio = 0.0;
-    in >> earthMoonMassRatio;
 
-    JplEphCoeffInfo coeffInfo[JplEph_ObjectCount];
-    for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount; ++objectIndex)
-    {
-        in >> coeffInfo[objectIndex].offset;
-        in >> coeffInfo[objectIndex].coeffCount;
-        in >> coeffInfo[objectIndex].granuleCount;
+static quint32 swapBytes(quint32 x)
+{
+    return ((x & 0x000000ffu) << 24) | ((x & 0x0000ff00u) << 8) |
+           ((x & 0x00ff0000u) >> 8)  | ((x & 0xff000000u) >> 24);
+}
 
-        if (in.status() != QDataStream::Ok)
-        {
-            return NULL;
-        }
 
-        // Convert to a zero-based offset
-        coeffInfo[objectIndex].offset--;
+static qint32 readInt32(const uchar* p, bool byteSwapped)
+{
+    quint32 x;
+    memcpy(&x, p, sizeof(x));
+    return qint32(byteSwapped ? swapBytes(x) : x);
+}
+
+
+static double readDouble(const uchar* p, bool byteSwapped)
+{
+    uchar bytes[sizeof(double)];
+    for (unsigned int i = 0; i < sizeof(double); ++i)
+    {
+        bytes[i] = byteSwapped ? p[sizeof(double) - 1 - i] : p[i];
     }
 
-    qint32 ephemNumber = 0;
-    in >> ephemNumber;
-    if (ephemNumber != 406)
+    double x;
+    memcpy(&x, bytes, sizeof(x));
+    return x;
+}
+
+
+static bool isPlausibleEphemerisNumber(qint32 ephemNumber)
+{
+    return ephemNumber > 0 && ephemNumber < 10000;
+}
+
+
+/** Load a binary JPL DE ephemeris file. Any of the DE4xx ephemerides (e.g. DE405, DE406,
+  * DE421, DE430, DE440) may be used; the record size is derived from the coefficient
+  * pointers in the header and the byte order of the file is detected automatically.
+  *
+  * The file is memory mapped rather than read: the trajectories evaluate coefficients
+  * directly from the mapping, so only the granules that are actually used are ever
+  * paged in. Coefficients are byte swapped at evaluation time when the byte order of
+  * the file differs from that of the host.
+  */
+JPLEphemeris*
+JPLEphemeris::load(const string& filename)
+{
+    const unsigned int JplEph_LabelSize             =   84;
+    const unsigned int JplEph_ConstantCount         =  400;
+    const unsigned int JplEph_ConstantNameLength    =    6;
+    const unsigned int JplEph_ObjectCount           =   12; // Sun, Moon, planets (incl. Pluto), nutations
+
+    // Byte offsets of fields in the header record
+    const unsigned int TimeSpanOffset        = JplEph_LabelSize * 3 + JplEph_ConstantCount * JplEph_ConstantNameLength;
+    const unsigned int ConstantCountOffset   = TimeSpanOffset + 3 * sizeof(double);
+    const unsigned int AuOffset              = ConstantCountOffset + sizeof(qint32);
+    const unsigned int EmratOffset           = AuOffset + sizeof(double);
+    const unsigned int CoeffInfoOffset       = EmratOffset + sizeof(double);
+    const unsigned int EphemNumberOffset     = CoeffInfoOffset + JplEph_ObjectCount * 3 * sizeof(qint32);
+    const unsigned int LibrationInfoOffset   = EphemNumberOffset + sizeof(qint32);
+    const unsigned int ExtendedHeaderOffset  = LibrationInfoOffset + 3 * sizeof(qint32);
+
+    // Number of components per coefficient set in the order: objects 0-11 (the
+    // last of which is nutations), librations, and--in DE430 and later--lunar
+    // mantle angular velocity and TT-TDB.
+    const unsigned int PointerCount = JplEph_ObjectCount + 3;
+    const unsigned int componentCounts[PointerCount] = { 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 3, 3, 1 };
+
+    counted_ptr<JplEphemerisFile> ephemFile(new JplEphemerisFile(filename.c_str()));
+    if (!ephemFile->map())
     {
+        qDebug() << "Ephemeris file is missing!";
         return NULL;
     }
 
-    // Skip libration information (offset, coeff. count, granule count)
-    in.skipRawData(sizeof(quint32) * 3);
-    if (in.status() != QDataStream::Ok)
+    const uchar* data = ephemFile->data();
+    if (ephemFile->size() < qint64(ExtendedHeaderOffset + 6 * sizeof(qint32)))
     {
         return NULL;
     }
 
-    // Skip the rest of the record
-    in.skipRawData(DE406_RecordSize * 8 - 2856);
-    // Skip the constants
-    in.skipRawData(DE406_RecordSize * 8);
-    if (in.status() != QDataStream::Ok)
+    // Detect the byte order of the file from the ephemeris number
+    bool byteSwapped = false;
+    qint32 ephemNumber = readInt32(data + EphemNumberOffset, false);
+    if (!isPlausibleEphemerisNumber(ephemNumber))
     {
-        return NULL;
+        byteSwapped = true;
+        ephemNumber = readInt32(data + EphemNumberOffset, true);
+        if (!isPlausibleEphemerisNumber(ephemNumber))
+        {
+            qDebug() << "Not a JPL ephemeris file: " << filename.c_str();
+            return NULL;
+        }
     }
 
-    unsigned int recordCount = (unsigned int) ((endJd - startJd) / daysPerRecord);
+    double startJd       = readDouble(data + TimeSpanOffset, byteSwapped);
+    double endJd         = readDouble(data + TimeSpanOffset + sizeof(double), byteSwapped);
+    double daysPerRecord = readDouble(data + TimeSpanOffset + 2 * sizeof(double), byteSwapped);
+    if (!(daysPerRecord > 0.0) || !(endJd > startJd))
+    {
+        return NULL;
+    }
 
-    vector<double> objectCoeffs[JplEph_ObjectCount];
+    qint32 constantCount = readInt32(data + ConstantCountOffset, byteSwapped);
+    double kmPerAu = readDouble(data + AuOffset, byteSwapped);
+    double earthMoonMassRatio = readDouble(data + EmratOffset, byteSwapped);
 
-    for (unsigned int i = 0; i < recordCount; ++i)
+    JplEphCoeffInfo coeffInfo[PointerCount];
+    for (unsigned int i = 0; i < PointerCount; ++i)
     {
-        double startTime = 0.0;
-        double endTime = 0.0;
-        in >> startTime >> endTime;
-
-        for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount; ++objectIndex)
+        const uchar* p = NULL;
+        if (i < JplEph_ObjectCount)
+        {
+            p = data + CoeffInfoOffset + i * 3 * sizeof(qint32);
+        }
+        else if (i == JplEph_ObjectCount)
+        {
+            p = data + LibrationInfoOffset;
+        }
+        else
         {
-            unsigned int coeffCount = coeffInfo[objectIndex].coeffCount * coeffInfo[objectIndex].granuleCount;
-            if (coeffCount != 0)
+            // Newer ephemerides store the names of constants beyond the first 400
+            // ahead of the remaining pointers. In older files this part of the
+            // header record is zero padding.
+            unsigned int extraNames = constantCount > qint32(JplEph_ConstantCount) ? constantCount - JplEph_ConstantCount : 0;
+            p = data + ExtendedHeaderOffset + extraNames * JplEph_ConstantNameLength + (i - JplEph_ObjectCount - 1) * 3 * sizeof(qint32);
+            if (p + 3 * sizeof(qint32) > data + ephemFile->size())
             {
-                for (unsigned int j = 0; j < coeffCount; ++j)
-                {
-                    double x = 0.0;
-                    double y = 0.0;
-                    double z = 0.0;
-                    in >> x >> y >> z;
-                    objectCoeffs[objectIndex].push_back(x);
-                    objectCoeffs[objectIndex].push_back(y);
-                    objectCoeffs[objectIndex].push_back(z);
-                }
+                return NULL;
             }
         }
 
-        // Make sure that we read this record successfully
-        if (in.status() != QDataStream::Ok)
+        coeffInfo[i].offset       = readInt32(p, byteSwapped);
+        coeffInfo[i].coeffCount   = readInt32(p + sizeof(qint32), byteSwapped);
+        coeffInfo[i].granuleCount = readInt32(p + 2 * sizeof(qint32), byteSwapped);
+    }
+
+    // The size of a record isn't stored in the file; it is the end of the last
+    // coefficient set. Records are all the same size, including the two header records.
+    unsigned int recordDoubles = 2;
+    for (unsigned int i = 0; i < PointerCount; ++i)
+    {
+        const JplEphCoeffInfo& info = coeffInfo[i];
+        if (info.offset > 0 && info.coeffCount > 0 && info.granuleCount > 0)
         {
-            return NULL;
+            recordDoubles = max(recordDoubles, info.offset - 1 + componentCounts[i] * info.coeffCount * info.granuleCount);
         }
     }
 
-    JPLEphemeris* eph = new JPLEphemeris;
+    qint64 recordSize = qint64(recordDoubles) * sizeof(double);
+    qint64 availableRecords = ephemFile->size() / recordSize - 2;
+    unsigned int recordCount = (unsigned int) floor((endJd - startJd) / daysPerRecord + 0.5);
+    if (availableRecords < 1 || recordCount < 1)
+    {
+        return NULL;
+    }
+
+    if (qint64(recordCount) > availableRecords)
+    {
+        qDebug() << "Ephemeris file " << filename.c_str() << " is truncated; using first " << availableRecords << " records.";
+        recordCount = (unsigned int) availableRecords;
+    }
+
+    // Verify the record size by checking the time span of the first data record
+    const uchar* records = data + 2 * recordSize;
+    if (readDouble(records, byteSwapped) != startJd ||
+        readDouble(records + sizeof(double), byteSwapped) != startJd + daysPerRecord)
+    {
+        qDebug() << "Unrecognized layout in JPL ephemeris file DE" << ephemNumber;
+        return NULL;
+    }
+
     double startSec = daysToSeconds(startJd - vesta::J2000);
     double secsPerRecord = daysToSeconds(daysPerRecord);
 
@@ -205,14 +301,41 @@ JPLEphemeris::load(const string& filename)
         27.32158 / 365.25 // Earth, about Earth-Moon barycenter
     };
 
+    // Conservative bounding radii in AU (the aphelion distances plus a margin for
+    // the motion of the Sun about the SSB), used instead of scanning every granule
+    // so that nothing is paged in until it is needed.
+    const double boundingRadii[] =
+    {
+        0.48, 0.74, 1.04, 1.69, 5.51, 10.2, 20.3, 30.6, 50.0,
+        0.0029, // Moon, geocentric
+        0.012,
+        0.0029
+    };
+
+    JPLEphemeris* eph = new JPLEphemeris;
+
     for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount - 1; ++objectIndex)
     {
+        const JplEphCoeffInfo& info = coeffInfo[objectIndex];
+        if (info.offset < 3 || info.coeffCount < 2 || info.coeffCount > ChebyshevPolyTrajectory::MaxChebyshevDegree + 1 || info.granuleCount == 0)
+        {
+            qDebug() << "Bad coefficient information in JPL ephemeris DE" << ephemNumber;
+            delete eph;
+            return NULL;
+        }
+
+        const double* coeffs = reinterpret_cast<const double*>(records) + (info.offset - 1);
         ChebyshevPolyTrajectory* trajectory =
-                new ChebyshevPolyTrajectory(&objectCoeffs[objectIndex][0],
-                                            coeffInfo[objectIndex].coeffCount - 1,
-                                            coeffInfo[objectIndex].granuleCount * recordCount,
+                new ChebyshevPolyTrajectory(coeffs,
+                                            info.coeffCount - 1,
+                                            info.granuleCount * recordCount,
+                                            info.granuleCount,
+                                            recordDoubles,
+                                            byteSwapped,
                                             startSec,
-                                            secsPerRecord / coeffInfo[objectIndex].granuleCount);
+                                            secsPerRecord / info.granuleCount,
+                                            boundingRadii[objectIndex] * kmPerAu,
+                                            ephemFile.ptr());
         trajectory->setPeriod(daysToSeconds(orbitalPeriods[objectIndex] * 365.25));
         eph->setTrajectory(JplObjectId(objectIndex), trajectory);
     }
@@ -294,6 +294,36 @@ KeplerianSwarm::nearPlaneDistance(const Eigen::Vector3f& cameraPosition) const
 
 void
 KeplerianSwarm::addObject(const OrbitalElements& elements, double discoveryTime)
+{
+    KeplerianObject k = makeObject(elements, discoveryTime);
+    addObjects(&k, 1);
+}
+
+
+/** Append an array of objects to the swarm. The objects must have been
+  * created for the current epoch of the swarm (see makeObject().)
+  */
+void
+KeplerianSwarm::addObjects(const KeplerianObject* objects, unsigned int count)
+{
+    m_objects.insert(m_objects.end(), objects, objects + count);
+
+    float boundingRadius = m_boundingRadius;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        boundingRadius = max(boundingRadius, float(objects[i].sma * (1.0 + objects[i].ecc)));
+    }
+    m_boundingRadius = boundingRadius;
+}
+
+
+/** Convert orbital elements to the form stored in the swarm. The mean anomaly
+  * and discovery time are relative to the current epoch of the swarm. This
+  * method doesn't modify the swarm, so it may be called from multiple threads
+  * at once.
+  */
+KeplerianSwarm::KeplerianObject
+KeplerianSwarm::makeObject(const OrbitalElements& elements, double discoveryTime) const
 {
     Quaterniond orbitOrientation = OrbitalElements::orbitOrientation(elements.inclination,
                                                                      elements.longitudeOfAscendingNode,
@@ -314,9 +344,7 @@ KeplerianSwarm::addObject(const OrbitalElements& elements, double discoveryTime)
     k.qz = float(orbitOrientation.z());
     k.discoveryDate = discoveryTime - m_epoch;
 
-    m_objects.push_back(k);
-
-    m_boundingRadius = max(m_boundingRadius, float(k.sma * (1.0 + elements.eccentricity)));
+    return k;
 }
 
 
@@ -106,23 +106,42 @@ public:
         m_fadeSize = fadeSize;
     }
     
-    void addObject(const OrbitalElements& elements, double discoveryTime);
-    void clear();
-
-private:
+    /** A single object in the swarm, in the layout of the vertex
+      * array used for rendering.
+      */
     struct KeplerianObject
     {
-        float sma;
+        float sma;              // semi-major axis (km)
         float ecc;
-        float meanAnomaly;
-        float meanMotion;
-        float qw;
+        float meanAnomaly;      // radians, at the epoch of the swarm
+        float meanMotion;       // radians per second
+        float qw;               // orientation of the orbital plane
         float qx;
         float qy;
         float qz;
-        float discoveryDate;
+        float discoveryDate;    // seconds since the epoch of the swarm
     };
 
+    void addObject(const OrbitalElements& elements, double discoveryTime);
+    void addObjects(const KeplerianObject* objects, unsigned int count);
+    KeplerianObject makeObject(const OrbitalElements& elements, double discoveryTime) const;
+    void clear();
+
+    /** Get the number of objects in the swarm.
+      */
+    unsigned int objectCount() const
+    {
+        return (unsigned int) m_objects.size();
+    }
+
+    /** Get a pointer to the array of objectCount() objects in the swarm.
+      */
+    const KeplerianObject* objects() const
+    {
+        return m_objects.empty() ? NULL : &m_objects[0];
+    }
+
+private:
     VertexSpec* m_vertexSpec;
     std::vector<KeplerianObject> m_objects;
 
@@ -102,6 +102,14 @@ LinearCombinationTrajectory::period() const
 }
 
 
+bool
+LinearCombinationTrajectory::isThreadSafe() const
+{
+    return (m_trajectory0.isNull() || m_trajectory0->isThreadSafe()) &&
+           (m_trajectory1.isNull() || m_trajectory1->isThreadSafe());
+}
+
+
 /** Set the period of the trajectory in seconds. If the period is set
   * to zero, the trajectory is treated as aperiodic. The period is
   * relevant for plotting.
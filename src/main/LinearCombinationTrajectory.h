@@ -44,6 +44,7 @@ public:
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
+    virtual bool isThreadSafe() const;
     void setPeriod(double period);
 
 private:
@@ -14,62 +14,212 @@
 
 #include "LocalImageLoader.h"
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
 
 using namespace vesta;
 
 
-LocalImageLoader::LocalImageLoader() :
-    m_searchPath(".")
+// Drop requests for textures that haven't been used in this many frames
+static const unsigned int DefaultCancelAge = 30;
+
+// Weight given to the most recent load when updating the average decode latency
+static const double LatencyAverageWeight = 1.0 / 16.0;
+
+
+// Loads the highest priority request in the queue on a thread pool thread. One
+// runner is started for every request, but a runner doesn't take a particular
+// request: the queue may have been reordered by the time it runs.
+class ImageDecodeRunner : public QRunnable
+{
+public:
+    ImageDecodeRunner(LocalImageLoader* loader) :
+        m_loader(loader)
+    {
+    }
+
+    void run()
+    {
+        LocalImageLoader::Request request;
+        if (m_loader->takeRequest(&request))
+        {
+            bool loaded = m_loader->load(request);
+            m_loader->finishRequest(request, loaded);
+        }
+    }
+
+private:
+    LocalImageLoader* m_loader;
+};
+
+
+/** Create a new image loader.
+  *
+  * \param threadCount the number of worker threads used to load images. If zero,
+  * images are loaded immediately on the thread that requests them.
+  */
+LocalImageLoader::LocalImageLoader(unsigned int threadCount) :
+    m_searchPath("."),
+    m_threadCount(threadCount),
+    m_cancelAge(DefaultCancelAge),
+    m_nextSequence(0),
+    m_averageDecodeLatency(0.0)
 {
+    m_clock.start();
+    if (m_threadCount > 0)
+    {
+        m_threadPool.setMaxThreadCount(int(m_threadCount));
+    }
 }
 
 
 LocalImageLoader::~LocalImageLoader()
 {
+    stop();
 }
 
 
+/** Request that a texture be loaded. If the loader has worker threads,
+  * the request is queued and this method returns immediately.
+  */
 void
 LocalImageLoader::loadTexture(TextureMap* texture)
 {
-    if (texture)
+    if (!texture)
     {
-        QString textureName = QString::fromUtf8(texture->name().c_str());
-        QFileInfo info(textureName);
+        return;
+    }
 
-        qDebug() << "loadTexture: " << textureName;
+    Request request;
+    request.texture = texture;
+    request.fileName = QString::fromUtf8(texture->name().c_str());
+    request.lastUsed = texture->lastUsed();
+    request.requestTime = m_clock.nsecsElapsed();
 
-        if (info.suffix() == "dds" || info.suffix() == "dxt5nm")
-        {
-            // Handle DDS textures
-            QFile ddsFile(textureName);
-            ddsFile.open(QIODevice::ReadOnly);
-            QByteArray data = ddsFile.readAll();
+    if (m_threadCount == 0)
+    {
+        bool loaded = load(request);
+        finishRequest(request, loaded);
+        return;
+    }
+
+    {
+        QMutexLocker lock(&m_mutex);
+        request.sequence = m_nextSequence++;
+        m_queue.append(request);
+    }
+
+    m_threadPool.start(new ImageDecodeRunner(this));
+}
+
+
+/** Refresh the priorities of pending requests from the last used frame of
+  * their textures, and drop requests for textures that haven't been used in
+  * the last cancelAge() frames. textureLoadCancelled is emitted for every
+  * dropped request that was still in the queue; requests already being
+  * decoded are marked and reported by the worker thread when it notices.
+  *
+  * This must be called from the thread that uses the textures, since that's
+  * the thread that updates their last used frames.
+  */
+void
+LocalImageLoader::updatePriorities(v_int64 currentFrame)
+{
+    QList<TextureMap*> dropped;
+    v_int64 oldestAllowed = currentFrame - v_int64(m_cancelAge);
+
+    {
+        QMutexLocker lock(&m_mutex);
 
-            if (!data.isEmpty())
+        int i = 0;
+        while (i < m_queue.size())
+        {
+            Request& request = m_queue[i];
+            request.lastUsed = request.texture->lastUsed();
+            if (request.lastUsed < oldestAllowed)
             {
-                emit ddsTextureLoaded(texture, new DataChunk(data.data(), data.size()));
+                dropped << request.texture;
+                m_queue.removeAt(i);
             }
             else
             {
-                emit textureLoadFailed(texture);
+                ++i;
             }
         }
-        else
+
+        for (QHash<TextureMap*, Request>::iterator iter = m_activeRequests.begin(); iter != m_activeRequests.end(); ++iter)
         {
-            // Let Qt handle all file formats other than DDS
-            QImage image(textureName);
-            if (!image.isNull())
-            {
-                emit textureLoaded(texture, image);
-            }
-            else
+            if (iter.key()->lastUsed() < oldestAllowed)
             {
-                emit textureLoadFailed(texture);
+                iter.value().cancelled = true;
             }
         }
     }
+
+    foreach (TextureMap* texture, dropped)
+    {
+        emit textureLoadCancelled(texture);
+    }
+}
+
+
+/** Set the number of frames that a texture may go unused before a pending
+  * request to load it is dropped.
+  */
+void
+LocalImageLoader::setCancelAge(unsigned int frames)
+{
+    m_cancelAge = frames;
+}
+
+
+/** Drop all queued requests and wait for any images being decoded to finish.
+  * No signals are emitted for the dropped requests.
+  */
+void
+LocalImageLoader::stop()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_queue.clear();
+    }
+
+    m_threadPool.waitForDone();
+}
+
+
+/** Get the number of requests waiting for a worker thread.
+  */
+unsigned int
+LocalImageLoader::queuedCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return (unsigned int) m_queue.size();
+}
+
+
+/** Get the number of requests currently being decoded.
+  */
+unsigned int
+LocalImageLoader::activeCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return (unsigned int) m_activeRequests.size();
+}
+
+
+/** Get the average time in milliseconds from a texture being requested until
+  * its image has been decoded. Only images that were loaded successfully are
+  * counted; the time to upload the image to the graphics card isn't included.
+  * Recent loads count more heavily in the average.
+  */
+double
+LocalImageLoader::averageDecodeLatency() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_averageDecodeLatency;
 }
 
 
@@ -78,3 +228,133 @@ LocalImageLoader::setSearchPath(const QString& path)
 {
     m_searchPath = path;
 }
+
+
+// Remove the highest priority request from the queue and record it as active:
+// the most recently used texture is loaded first, and the oldest request is
+// chosen among textures last used in the same frame.
+bool
+LocalImageLoader::takeRequest(Request* request)
+{
+    QMutexLocker lock(&m_mutex);
+
+    if (m_queue.isEmpty())
+    {
+        return false;
+    }
+
+    int best = 0;
+    for (int i = 1; i < m_queue.size(); ++i)
+    {
+        const Request& r = m_queue.at(i);
+        const Request& b = m_queue.at(best);
+        if (r.lastUsed > b.lastUsed || (r.lastUsed == b.lastUsed && r.sequence < b.sequence))
+        {
+            best = i;
+        }
+    }
+
+    *request = m_queue.takeAt(best);
+    m_activeRequests.insert(request->texture, *request);
+
+    return true;
+}
+
+
+// Return true if a request being decoded has been cancelled
+bool
+LocalImageLoader::isCancelled(TextureMap* texture)
+{
+    if (m_threadCount == 0)
+    {
+        return false;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    return m_activeRequests.value(texture).cancelled;
+}
+
+
+// Remove a request from the active table. The latency of successful loads is
+// added to the average; cancelled and failed loads would skew it.
+void
+LocalImageLoader::finishRequest(const Request& request, bool loaded)
+{
+    double latency = double(m_clock.nsecsElapsed() - request.requestTime) * 1.0e-6;
+
+    QMutexLocker lock(&m_mutex);
+
+    // A cancelled texture may have been requested again already; leave the
+    // new request alone.
+    QHash<TextureMap*, Request>::iterator iter = m_activeRequests.find(request.texture);
+    if (iter != m_activeRequests.end() && iter.value().sequence == request.sequence)
+    {
+        m_activeRequests.erase(iter);
+    }
+
+    if (loaded)
+    {
+        m_averageDecodeLatency += (latency - m_averageDecodeLatency) * LatencyAverageWeight;
+    }
+}
+
+
+// Read and decode an image, emitting a signal with the result. The request is
+// checked for cancellation after the file is read and again after decoding, so
+// that an image that is no longer needed is neither decoded nor uploaded.
+// Returns true if the image was loaded.
+bool
+LocalImageLoader::load(const Request& request)
+{
+    TextureMap* texture = request.texture;
+    QFileInfo info(request.fileName);
+
+    qDebug() << "loadTexture: " << request.fileName;
+
+    // Read the whole file first so that no time is spent on decoding if the
+    // request is cancelled while waiting for the disk.
+    QFile file(request.fileName);
+    QByteArray data;
+    if (file.open(QIODevice::ReadOnly))
+    {
+        data = file.readAll();
+    }
+
+    if (isCancelled(texture))
+    {
+        emit textureLoadCancelled(texture);
+        return false;
+    }
+
+    if (data.isEmpty())
+    {
+        emit textureLoadFailed(texture);
+        return false;
+    }
+    else if (info.suffix() == "dds" || info.suffix() == "dxt5nm")
+    {
+        // Handle DDS textures
+        emit ddsTextureLoaded(texture, new DataChunk(data.data(), data.size()));
+        return true;
+    }
+    else
+    {
+        // Let Qt handle all file formats other than DDS
+        QImage image;
+        if (!image.loadFromData(data))
+        {
+            emit textureLoadFailed(texture);
+            return false;
+        }
+        else if (isCancelled(texture))
+        {
+            emit textureLoadCancelled(texture);
+            return false;
+        }
+        else
+        {
+            emit textureLoaded(texture, image);
+            return true;
+        }
+    }
+}
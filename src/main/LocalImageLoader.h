@@ -19,17 +19,30 @@
 #include <vesta/TextureMap.h>
 #include <QImage>
 #include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QThreadPool>
 
 
-/** LocalImageLoader handles loading of images from disk. It uses signals and slots
-  * to communicate so that it can be run in a separate thread.
+/** LocalImageLoader handles loading of images from disk. It uses signals to
+  * report loaded images so that it can decode on threads other than the one
+  * that requested the image.
+  *
+  * Requests are decoded by a pool of worker threads, most recently used
+  * textures first; requests made in the same frame are handled in the order
+  * that they were made. Requests for textures that haven't been used for a
+  * while are dropped, whether still waiting in the queue or already being
+  * decoded. With no worker threads, images are loaded immediately when they
+  * are requested.
   */
 class LocalImageLoader : public QObject
 {
     Q_OBJECT
 
 public:
-    LocalImageLoader();
+    LocalImageLoader(unsigned int threadCount = 0);
     ~LocalImageLoader();
 
     QString searchPath() const
@@ -37,6 +50,31 @@ public:
         return m_searchPath;
     }
 
+    /** Get the number of threads used for loading images. When zero,
+      * images are loaded on the thread that calls loadTexture().
+      */
+    unsigned int threadCount() const
+    {
+        return m_threadCount;
+    }
+
+    /** Get the number of frames that a texture may go unused before
+      * a pending request to load it is dropped.
+      */
+    unsigned int cancelAge() const
+    {
+        return m_cancelAge;
+    }
+
+    void setCancelAge(unsigned int frames);
+
+    void updatePriorities(vesta::v_int64 currentFrame);
+    void stop();
+
+    unsigned int queuedCount() const;
+    unsigned int activeCount() const;
+    double averageDecodeLatency() const;
+
 public slots:
     void loadTexture(vesta::TextureMap* texture);
     void setSearchPath(const QString& path);
@@ -54,8 +92,53 @@ signals:
       */
     void textureLoadFailed(vesta::TextureMap* texture);
 
+    /** This signal is emitted when a request to load a texture is dropped
+      * because the texture hasn't been used recently.
+      */
+    void textureLoadCancelled(vesta::TextureMap* texture);
+
+private:
+    struct Request
+    {
+        Request() :
+            texture(NULL),
+            lastUsed(0),
+            sequence(0),
+            requestTime(0),
+            cancelled(false)
+        {
+        }
+
+        vesta::TextureMap* texture;
+        QString fileName;
+        vesta::v_int64 lastUsed;
+        quint64 sequence;
+        qint64 requestTime;
+        bool cancelled;
+    };
+
+    friend class ImageDecodeRunner;
+
+    bool load(const Request& request);
+    bool takeRequest(Request* request);
+    bool isCancelled(vesta::TextureMap* texture);
+    void finishRequest(const Request& request, bool loaded);
+
 private:
     QString m_searchPath;
+    unsigned int m_threadCount;
+    unsigned int m_cancelAge;
+
+    // The request queue and the table of requests being decoded are shared with
+    // the worker threads, and must only be accessed with the mutex held.
+    mutable QMutex m_mutex;
+    QList<Request> m_queue;
+    QHash<vesta::TextureMap*, Request> m_activeRequests;
+    quint64 m_nextSequence;
+    double m_averageDecodeLatency;
+
+    QElapsedTimer m_clock;
+    QThreadPool m_threadPool;
 };
 
 #endif // _LOCAL_IMAGE_LOADER_H_
@@ -70,15 +70,18 @@ NetworkTextureLoader::NetworkTextureLoader(QObject* parent, bool asynchronous) :
     m_totalMemoryUsage(0),
     m_textureMemoryLimit(150)
 {
-    // Construct an ImageLoader and WMSRequester object. Both of these will can in a separate thread
+    // Construct an ImageLoader and WMSRequester object. Both of these run in other threads
     // so that reading images from disk and decompressing them won't cause the frame rate to stutter.
-    // Loading of textures over the network happens in QNetworkAccessManager threads, *not* the disk
-    // load/decompression thread.
+    // The image loader decodes on a pool of worker threads, one per core, so that tiles of a high
+    // resolution map fill in as quickly as the machine allows. The WMS requester runs in a single
+    // thread of its own; loading of textures over the network happens in QNetworkAccessManager
+    // threads, *not* the image load thread.
     //
     // For synchronization, NetworkTextureLoader relies on Qt's queued signals.
 
     // Create and connect the local image loader
-    m_localImageLoader = new LocalImageLoader();
+    unsigned int decodeThreadCount = asynchronous ? (unsigned int) qMax(1, QThread::idealThreadCount()) : 0;
+    m_localImageLoader = new LocalImageLoader(decodeThreadCount);
     connect(this, SIGNAL(localTextureRequested(vesta::TextureMap*)), m_localImageLoader, SLOT(loadTexture(vesta::TextureMap*)));
     connect(m_localImageLoader, SIGNAL(ddsTextureLoaded(vesta::TextureMap*, vesta::DataChunk*)),
             this, SLOT(queueTexture(vesta::TextureMap*, vesta::DataChunk*)));
@@ -86,6 +89,8 @@ NetworkTextureLoader::NetworkTextureLoader(QObject* parent, bool asynchronous) :
             this, SLOT(queueTexture(vesta::TextureMap*, const QImage&)));
     connect(m_localImageLoader, SIGNAL(textureLoadFailed(vesta::TextureMap*)),
             this, SLOT(reportTextureLoadFailure(vesta::TextureMap*)));
+    connect(m_localImageLoader, SIGNAL(textureLoadCancelled(vesta::TextureMap*)),
+            this, SLOT(cancelTextureLoad(vesta::TextureMap*)));
 
     // Create and connect the network tile loader
     m_wmsHandler = new WMSRequester(NULL);
@@ -98,7 +103,6 @@ NetworkTextureLoader::NetworkTextureLoader(QObject* parent, bool asynchronous) :
     {
         m_imageLoadThread = new QThread();
         m_wmsHandler->moveToThread(m_imageLoadThread);
-        m_localImageLoader->moveToThread(m_imageLoadThread);
         m_imageLoadThread->start();
     }
 }
@@ -115,7 +119,10 @@ NetworkTextureLoader::~NetworkTextureLoader()
         m_imageLoadThread->deleteLater();
     }
     m_wmsHandler->deleteLater();
-    m_localImageLoader->deleteLater();
+
+    // The image loader lives in this thread; deleting it waits for any images
+    // still being decoded.
+    delete m_localImageLoader;
 }
 
 
@@ -215,7 +222,8 @@ NetworkTextureLoader::handleMakeResident(TextureMap* texture)
 }
 
 
-/** Stop the image loading thread.
+/** Stop the image loading threads. Pending requests for local images are
+  * dropped.
   */
 void
 NetworkTextureLoader::stop()
@@ -224,6 +232,7 @@ NetworkTextureLoader::stop()
     {
         m_imageLoadThread->quit();
     }
+    m_localImageLoader->stop();
 }
 
 
@@ -256,6 +265,10 @@ NetworkTextureLoader::evictTextures()
 void
 NetworkTextureLoader::realizeLoadedTextures()
 {
+    // Reorder pending image loads now that the textures used in the last
+    // frame are known, and drop loads of textures that are no longer used.
+    m_localImageLoader->updatePriorities(frameCount());
+
     foreach (LoadedTexture t, m_loadedTextures)
     {
         bool ok = false;
@@ -332,6 +345,17 @@ NetworkTextureLoader::reportTextureLoadFailure(vesta::TextureMap* texture)
 }
 
 
+/** Called when a texture load is dropped because the texture hasn't been used
+  * recently. The texture is returned to the uninitialized state, so that it will
+  * be requested again the next time that it's made resident.
+  */
+void
+NetworkTextureLoader::cancelTextureLoad(vesta::TextureMap* texture)
+{
+    texture->setStatus(TextureMap::Uninitialized);
+}
+
+
 QString
 NetworkTextureLoader::localSearchPath() const
 {
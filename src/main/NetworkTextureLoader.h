@@ -39,6 +39,11 @@ public:
         return m_wmsHandler;
     }
 
+    LocalImageLoader* localImageLoader() const
+    {
+        return m_localImageLoader;
+    }
+
     unsigned int textureMemoryLimit() const
     {
         return m_textureMemoryLimit;
@@ -58,6 +63,7 @@ public slots:
     void queueTexture(vesta::TextureMap* texture, vesta::DataChunk* ddsData);
     void queueTexture(const QString& textureName, const QImage& image);
     void reportTextureLoadFailure(vesta::TextureMap* texture);
+    void cancelTextureLoad(vesta::TextureMap* texture);
 
 signals:
     void wmsTileRequested(const QString& tileName,
@@ -0,0 +1,108 @@
+// ThreadPoolTaskExecutor.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ThreadPoolTaskExecutor.h"
+#include <QThread>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <algorithm>
+
+using namespace vesta;
+using namespace std;
+
+
+// Run items of a task until none are left unclaimed
+static void
+runItems(ParallelTask* task, unsigned int itemCount, QAtomicInt* nextItem)
+{
+    for (;;)
+    {
+        unsigned int item = (unsigned int) nextItem->fetchAndAddOrdered(1);
+        if (item >= itemCount)
+        {
+            break;
+        }
+
+        task->run(item);
+    }
+}
+
+
+// Runs items of a task on a thread pool thread
+class TaskItemRunner : public QRunnable
+{
+public:
+    TaskItemRunner(ParallelTask* task, unsigned int itemCount, QAtomicInt* nextItem) :
+        m_task(task),
+        m_itemCount(itemCount),
+        m_nextItem(nextItem)
+    {
+    }
+
+    void run()
+    {
+        runItems(m_task, m_itemCount, m_nextItem);
+    }
+
+private:
+    ParallelTask* m_task;
+    unsigned int m_itemCount;
+    QAtomicInt* m_nextItem;
+};
+
+
+ThreadPoolTaskExecutor::ThreadPoolTaskExecutor()
+{
+    m_threadPool.setMaxThreadCount(max(1, QThread::idealThreadCount()));
+}
+
+
+ThreadPoolTaskExecutor::~ThreadPoolTaskExecutor()
+{
+    m_threadPool.waitForDone();
+}
+
+
+/** Get the number of threads used to run a task, including the calling thread.
+  */
+unsigned int
+ThreadPoolTaskExecutor::threadCount() const
+{
+    return (unsigned int) max(1, QThread::idealThreadCount());
+}
+
+
+/** Run all items of a task, returning when every item has finished. The
+  * calling thread runs items too, so only threadCount() - 1 pool threads
+  * are started.
+  */
+void
+ThreadPoolTaskExecutor::execute(ParallelTask* task, unsigned int itemCount)
+{
+    QAtomicInt nextItem(0);
+
+    unsigned int helperCount = min(threadCount(), itemCount);
+    for (unsigned int i = 1; i < helperCount; ++i)
+    {
+        m_threadPool.start(new TaskItemRunner(task, itemCount, &nextItem));
+    }
+
+    runItems(task, itemCount, &nextItem);
+
+    // waitForDone() synchronizes with the pool threads, so everything the
+    // task wrote is visible once it returns.
+    m_threadPool.waitForDone();
+}
@@ -0,0 +1,42 @@
+// ThreadPoolTaskExecutor.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _THREAD_POOL_TASK_EXECUTOR_H_
+#define _THREAD_POOL_TASK_EXECUTOR_H_
+
+#include <vesta/TaskExecutor.h>
+#include <QThreadPool>
+
+
+/** ThreadPoolTaskExecutor runs vesta parallel tasks on a private Qt thread
+  * pool. The calling thread works on the task along with the pool threads,
+  * and every thread claims the next unclaimed item as soon as it finishes
+  * the previous one.
+  */
+class ThreadPoolTaskExecutor : public vesta::TaskExecutor
+{
+public:
+    ThreadPoolTaskExecutor();
+    ~ThreadPoolTaskExecutor();
+
+    unsigned int threadCount() const;
+    void execute(vesta::ParallelTask* task, unsigned int itemCount);
+
+private:
+    QThreadPool m_threadPool;
+};
+
+#endif // _THREAD_POOL_TASK_EXECUTOR_H_
@@ -0,0 +1,443 @@
+// TleCatalogPropagator.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TleCatalogPropagator.h"
+#include "TleTrajectory.h"
+#include "astro/OsculatingElements.h"
+#include <noradtle/norad_in.h>
+#include <QThread>
+#include <QRunnable>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TLE_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define TLE_USE_SSE2 0
+#endif
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Indices of values in the SGP4 parameter array (see sgp4.cpp)
+enum
+{
+    Sgp4_x3thm1  = 0,
+    Sgp4_x1mth2  = 1,
+    Sgp4_c1      = 2,
+    Sgp4_c4      = 3,
+    Sgp4_xnodcf  = 4,
+    Sgp4_t2cof   = 5,
+    Sgp4_xlcof   = 6,
+    Sgp4_aycof   = 7,
+    Sgp4_x7thm1  = 8,
+    Sgp4_aodp    = 9,
+    Sgp4_cosio   = 10,
+    Sgp4_sinio   = 11,
+    Sgp4_omgdot  = 12,
+    Sgp4_xmdot   = 13,
+    Sgp4_xnodot  = 14,
+    Sgp4_xnodp   = 15,
+    Sgp4_c5      = 16,
+    Sgp4_d2      = 17,
+    Sgp4_d3      = 18,
+    Sgp4_d4      = 19,
+    Sgp4_delmo   = 20,
+    Sgp4_eta     = 21,
+    Sgp4_omgcof  = 22,
+    Sgp4_sinmo   = 23,
+    Sgp4_t3cof   = 24,
+    Sgp4_t4cof   = 25,
+    Sgp4_t5cof   = 26,
+    Sgp4_xmcof   = 27,
+    Sgp4_simple  = 28
+};
+
+// Only the parameters used by sxpx_posn_vel are kept in the per-object array
+static const unsigned int PositionParamCount = 9;
+
+
+// A chunk of objects to be propagated on a thread pool thread
+class TlePropagationTask : public QRunnable
+{
+public:
+    TlePropagationTask(const TleCatalogPropagator* propagator,
+                       bool deepSpace,
+                       double tdbSec,
+                       unsigned int begin,
+                       unsigned int end,
+                       double* positions) :
+        m_propagator(propagator),
+        m_deepSpace(deepSpace),
+        m_tdbSec(tdbSec),
+        m_begin(begin),
+        m_end(end),
+        m_positions(positions)
+    {
+    }
+
+    void run()
+    {
+        if (m_deepSpace)
+        {
+            m_propagator->propagateDeepSpaceRange(m_tdbSec, m_begin, m_end, m_positions);
+        }
+        else
+        {
+            m_propagator->propagateSgp4Range(m_tdbSec, m_begin, m_end, m_positions);
+        }
+    }
+
+private:
+    const TleCatalogPropagator* m_propagator;
+    bool m_deepSpace;
+    double m_tdbSec;
+    unsigned int m_begin;
+    unsigned int m_end;
+    double* m_positions;
+};
+
+
+TleCatalogPropagator::TleCatalogPropagator()
+{
+    m_threadPool.setMaxThreadCount(max(1, QThread::idealThreadCount()));
+}
+
+
+TleCatalogPropagator::~TleCatalogPropagator()
+{
+    m_threadPool.waitForDone();
+}
+
+
+/** Add an object to the catalog. The model parameters are copied from
+  * the trajectory, which isn't referenced afterward.
+  */
+void
+TleCatalogPropagator::addObject(const TleTrajectory* trajectory)
+{
+    unsigned int objectIndex = objectCount();
+
+    ObjectRecord record;
+    record.epoch = trajectory->epoch();
+    record.keplerianLimit = trajectory->keplerianApproximationLimit();
+    record.keplerianBefore = trajectory->keplerianElementsBefore();
+    record.keplerianAfter = trajectory->keplerianElementsAfter();
+    m_objects.push_back(record);
+
+    const tle_t* tle = trajectory->tle();
+    const double* params = trajectory->satParams();
+
+    if (trajectory->ephemerisType() == TLE_EPHEMERIS_TYPE_SGP4)
+    {
+        int simpleFlag = 0;
+        memcpy(&simpleFlag, params + Sgp4_simple, sizeof(simpleFlag));
+        bool simple = simpleFlag != 0;
+
+        // Parameters only used for the full model aren't initialized for
+        // simple objects.
+        double fields[Sgp4FieldCount];
+        fields[Epoch]  = trajectory->epoch();
+        fields[Xmo]    = tle->xmo;
+        fields[Omegao] = tle->omegao;
+        fields[Xnodeo] = tle->xnodeo;
+        fields[Bstar]  = tle->bstar;
+        fields[Eo]     = tle->eo;
+        fields[Xincl]  = tle->xincl;
+        fields[Xmdot]  = params[Sgp4_xmdot];
+        fields[Omgdot] = params[Sgp4_omgdot];
+        fields[Xnodot] = params[Sgp4_xnodot];
+        fields[Xnodcf] = params[Sgp4_xnodcf];
+        fields[C1]     = params[Sgp4_c1];
+        fields[C4]     = params[Sgp4_c4];
+        fields[C5]     = params[Sgp4_c5];
+        fields[T2cof]  = params[Sgp4_t2cof];
+        fields[T3cof]  = simple ? 0.0 : params[Sgp4_t3cof];
+        fields[T4cof]  = simple ? 0.0 : params[Sgp4_t4cof];
+        fields[T5cof]  = simple ? 0.0 : params[Sgp4_t5cof];
+        fields[D2]     = simple ? 0.0 : params[Sgp4_d2];
+        fields[D3]     = simple ? 0.0 : params[Sgp4_d3];
+        fields[D4]     = simple ? 0.0 : params[Sgp4_d4];
+        fields[Aodp]   = params[Sgp4_aodp];
+        fields[Xnodp]  = params[Sgp4_xnodp];
+        fields[Cosio]  = params[Sgp4_cosio];
+        fields[Sinio]  = params[Sgp4_sinio];
+        fields[Delmo]  = simple ? 0.0 : params[Sgp4_delmo];
+        fields[Eta]    = params[Sgp4_eta];
+        fields[Omgcof] = simple ? 0.0 : params[Sgp4_omgcof];
+        fields[Sinmo]  = simple ? 0.0 : params[Sgp4_sinmo];
+        fields[Xmcof]  = simple ? 0.0 : params[Sgp4_xmcof];
+        fields[Simple] = simple ? 1.0 : 0.0;
+
+        for (unsigned int i = 0; i < Sgp4FieldCount; ++i)
+        {
+            m_sgp4Fields[i].push_back(fields[i]);
+        }
+
+        m_sgp4Params.insert(m_sgp4Params.end(), params, params + PositionParamCount);
+        m_sgp4Objects.push_back(objectIndex);
+    }
+    else
+    {
+        m_deepSpaceTles.push_back(*tle);
+        m_deepSpaceParams.insert(m_deepSpaceParams.end(), params, params + N_SAT_PARAMS);
+        m_deepSpaceObjects.push_back(objectIndex);
+    }
+}
+
+
+/** Remove all objects from the catalog.
+  */
+void
+TleCatalogPropagator::clear()
+{
+    m_objects.clear();
+    for (unsigned int i = 0; i < Sgp4FieldCount; ++i)
+    {
+        m_sgp4Fields[i].clear();
+    }
+    m_sgp4Params.clear();
+    m_sgp4Objects.clear();
+    m_deepSpaceTles.clear();
+    m_deepSpaceParams.clear();
+    m_deepSpaceObjects.clear();
+}
+
+
+// TleTrajectory switches to a Keplerian orbit far from the TLE epoch. Compute
+// the Keplerian position and return true if the time is outside the range in
+// which SGP4/SDP4 is used.
+bool
+TleCatalogPropagator::keplerianPosition(unsigned int objectIndex, double tdbSec, double* position) const
+{
+    const ObjectRecord& record = m_objects[objectIndex];
+    Vector3d p;
+    if (tdbSec < record.epoch - record.keplerianLimit)
+    {
+        p = ElementsToStateVector(record.keplerianBefore, tdbSec).position();
+    }
+    else if (tdbSec > record.epoch + record.keplerianLimit)
+    {
+        p = ElementsToStateVector(record.keplerianAfter, tdbSec).position();
+    }
+    else
+    {
+        return false;
+    }
+
+    position[0] = p.x();
+    position[1] = p.y();
+    position[2] = p.z();
+
+    return true;
+}
+
+
+/** Propagate near-Earth objects begin through end - 1 (indices into the list
+  * of SGP4 objects) and store their positions in the catalog position array.
+  */
+void
+TleCatalogPropagator::propagateSgp4Range(double tdbSec, unsigned int begin, unsigned int end, double* positions) const
+{
+    // Secular terms, computed for a batch of objects at a time
+    double tsince[ChunkSize];
+    double xmdf[ChunkSize];
+    double omgadf[ChunkSize];
+    double xnode[ChunkSize];
+    double tempa[ChunkSize];
+    double tempe[ChunkSize];
+    double templ[ChunkSize];
+
+    for (unsigned int batchStart = begin; batchStart < end; batchStart += ChunkSize)
+    {
+        unsigned int n = min(end - batchStart, (unsigned int) ChunkSize);
+
+        const double* epoch  = &m_sgp4Fields[Epoch][batchStart];
+        const double* xmo    = &m_sgp4Fields[Xmo][batchStart];
+        const double* omegao = &m_sgp4Fields[Omegao][batchStart];
+        const double* xnodeo = &m_sgp4Fields[Xnodeo][batchStart];
+        const double* bstar  = &m_sgp4Fields[Bstar][batchStart];
+        const double* xmdot  = &m_sgp4Fields[Xmdot][batchStart];
+        const double* omgdot = &m_sgp4Fields[Omgdot][batchStart];
+        const double* xnodot = &m_sgp4Fields[Xnodot][batchStart];
+        const double* xnodcf = &m_sgp4Fields[Xnodcf][batchStart];
+        const double* c1     = &m_sgp4Fields[C1][batchStart];
+        const double* c4     = &m_sgp4Fields[C4][batchStart];
+        const double* t2cof  = &m_sgp4Fields[T2cof][batchStart];
+        const double* t3cof  = &m_sgp4Fields[T3cof][batchStart];
+        const double* t4cof  = &m_sgp4Fields[T4cof][batchStart];
+        const double* t5cof  = &m_sgp4Fields[T5cof][batchStart];
+        const double* d2     = &m_sgp4Fields[D2][batchStart];
+        const double* d3     = &m_sgp4Fields[D3][batchStart];
+        const double* d4     = &m_sgp4Fields[D4][batchStart];
+        const double* simple = &m_sgp4Fields[Simple][batchStart];
+
+        // Secular gravity and atmospheric drag. The operations are the same (and
+        // in the same order) as in SGP4(), so the results are identical.
+        unsigned int i = 0;
+#if TLE_USE_SSE2
+        const __m128d one = _mm_set1_pd(1.0);
+        const __m128d t = _mm_set1_pd(tdbSec);
+        const __m128d minutesPerSecond = _mm_set1_pd(60.0);
+        for (; i + 1 < n; i += 2)
+        {
+            __m128d ts = _mm_div_pd(_mm_sub_pd(t, _mm_loadu_pd(epoch + i)), minutesPerSecond);
+            __m128d tsq = _mm_mul_pd(ts, ts);
+            __m128d tcube = _mm_mul_pd(tsq, ts);
+            __m128d tfour = _mm_mul_pd(ts, tcube);
+
+            _mm_storeu_pd(tsince + i, ts);
+            _mm_storeu_pd(xmdf + i, _mm_add_pd(_mm_loadu_pd(xmo + i), _mm_mul_pd(_mm_loadu_pd(xmdot + i), ts)));
+            _mm_storeu_pd(omgadf + i, _mm_add_pd(_mm_loadu_pd(omegao + i), _mm_mul_pd(_mm_loadu_pd(omgdot + i), ts)));
+            __m128d xnoddf = _mm_add_pd(_mm_loadu_pd(xnodeo + i), _mm_mul_pd(_mm_loadu_pd(xnodot + i), ts));
+            _mm_storeu_pd(xnode + i, _mm_add_pd(xnoddf, _mm_mul_pd(_mm_loadu_pd(xnodcf + i), tsq)));
+            _mm_storeu_pd(tempe + i, _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(bstar + i), _mm_loadu_pd(c4 + i)), ts));
+
+            __m128d a = _mm_sub_pd(one, _mm_mul_pd(_mm_loadu_pd(c1 + i), ts));
+            __m128d l = _mm_mul_pd(_mm_loadu_pd(t2cof + i), tsq);
+
+            // Full model terms, discarded for simple objects
+            __m128d fullA = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(a, _mm_mul_pd(_mm_loadu_pd(d2 + i), tsq)),
+                                                  _mm_mul_pd(_mm_loadu_pd(d3 + i), tcube)),
+                                       _mm_mul_pd(_mm_loadu_pd(d4 + i), tfour));
+            __m128d fullL = _mm_add_pd(_mm_add_pd(l, _mm_mul_pd(_mm_loadu_pd(t3cof + i), tcube)),
+                                       _mm_mul_pd(tfour, _mm_add_pd(_mm_loadu_pd(t4cof + i),
+                                                                    _mm_mul_pd(ts, _mm_loadu_pd(t5cof + i)))));
+
+            __m128d isSimple = _mm_cmpneq_pd(_mm_loadu_pd(simple + i), _mm_setzero_pd());
+            _mm_storeu_pd(tempa + i, _mm_or_pd(_mm_and_pd(isSimple, a), _mm_andnot_pd(isSimple, fullA)));
+            _mm_storeu_pd(templ + i, _mm_or_pd(_mm_and_pd(isSimple, l), _mm_andnot_pd(isSimple, fullL)));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            double ts = (tdbSec - epoch[i]) / 60.0;
+            double tsq = ts * ts;
+            tsince[i] = ts;
+            xmdf[i] = xmo[i] + xmdot[i] * ts;
+            omgadf[i] = omegao[i] + omgdot[i] * ts;
+            double xnoddf = xnodeo[i] + xnodot[i] * ts;
+            xnode[i] = xnoddf + xnodcf[i] * tsq;
+            tempa[i] = 1 - c1[i] * ts;
+            tempe[i] = bstar[i] * c4[i] * ts;
+            templ[i] = t2cof[i] * tsq;
+            if (simple[i] == 0.0)
+            {
+                double tcube = tsq * ts;
+                double tfour = ts * tcube;
+                tempa[i] = tempa[i] - d2[i] * tsq - d3[i] * tcube - d4[i] * tfour;
+                templ[i] = templ[i] + t3cof[i] * tcube + tfour * (t4cof[i] + ts * t5cof[i]);
+            }
+        }
+
+        // Periodic terms and the position; see SGP4()
+        for (i = 0; i < n; ++i)
+        {
+            unsigned int sgp4Index = batchStart + i;
+            unsigned int objectIndex = m_sgp4Objects[sgp4Index];
+            double* position = positions + objectIndex * 3;
+            if (keplerianPosition(objectIndex, tdbSec, position))
+            {
+                continue;
+            }
+
+            double omega = omgadf[i];
+            double xmp = xmdf[i];
+            double e_tempe = tempe[i];
+            if (simple[i] == 0.0)
+            {
+                const double delomg = m_sgp4Fields[Omgcof][sgp4Index] * tsince[i];
+                double delm = 1. + m_sgp4Fields[Eta][sgp4Index] * cos(xmdf[i]);
+                delm = m_sgp4Fields[Xmcof][sgp4Index] * (delm * delm * delm - m_sgp4Fields[Delmo][sgp4Index]);
+                double temp = delomg + delm;
+                xmp = xmdf[i] + temp;
+                omega = omgadf[i] - temp;
+                e_tempe = e_tempe + bstar[i] * m_sgp4Fields[C5][sgp4Index] * (sin(xmp) - m_sgp4Fields[Sinmo][sgp4Index]);
+            }
+
+            double a = m_sgp4Fields[Aodp][sgp4Index] * tempa[i] * tempa[i];
+            double e = m_sgp4Fields[Eo][sgp4Index] - e_tempe;
+            double xl = xmp + omega + xnode[i] + m_sgp4Fields[Xnodp][sgp4Index] * templ[i];
+
+            sxpx_posn_vel(xnode[i], a, e,
+                          &m_sgp4Params[sgp4Index * PositionParamCount],
+                          m_sgp4Fields[Cosio][sgp4Index], m_sgp4Fields[Sinio][sgp4Index],
+                          m_sgp4Fields[Xincl][sgp4Index], omega, xl,
+                          position, NULL);
+        }
+    }
+}
+
+
+/** Propagate deep space objects begin through end - 1 (indices into the list
+  * of SDP4 objects) and store their positions in the catalog position array.
+  */
+void
+TleCatalogPropagator::propagateDeepSpaceRange(double tdbSec, unsigned int begin, unsigned int end, double* positions) const
+{
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        unsigned int objectIndex = m_deepSpaceObjects[i];
+        double* position = positions + objectIndex * 3;
+        if (!keplerianPosition(objectIndex, tdbSec, position))
+        {
+            double tmin = (tdbSec - m_objects[objectIndex].epoch) / 60.0;
+            SDP4(tmin, &m_deepSpaceTles[i], &m_deepSpaceParams[i * N_SAT_PARAMS], position, NULL);
+        }
+    }
+}
+
+
+/** Compute the positions of all objects in the catalog at the specified time.
+  * Positions are in kilometers in the same frame as TleTrajectory; they're
+  * stored in order of addition, three values (x, y, z) per object.
+  *
+  * This method may not be called from more than one thread at a time.
+  */
+void
+TleCatalogPropagator::propagate(double tdbSec, double* positions) const
+{
+    unsigned int sgp4Count = m_sgp4Objects.size();
+    unsigned int deepSpaceCount = m_deepSpaceObjects.size();
+
+    if (objectCount() < ParallelThreshold || m_threadPool.maxThreadCount() < 2)
+    {
+        propagateSgp4Range(tdbSec, 0, sgp4Count, positions);
+        propagateDeepSpaceRange(tdbSec, 0, deepSpaceCount, positions);
+        return;
+    }
+
+    // Each task writes a disjoint set of positions. Deep space objects are much
+    // more expensive, so they're split into smaller chunks.
+    const unsigned int deepSpaceChunkSize = ChunkSize / 8;
+    for (unsigned int begin = 0; begin < deepSpaceCount; begin += deepSpaceChunkSize)
+    {
+        unsigned int end = min(deepSpaceCount, begin + deepSpaceChunkSize);
+        m_threadPool.start(new TlePropagationTask(this, true, tdbSec, begin, end, positions));
+    }
+
+    for (unsigned int begin = 0; begin < sgp4Count; begin += ChunkSize)
+    {
+        unsigned int end = min(sgp4Count, begin + ChunkSize);
+        m_threadPool.start(new TlePropagationTask(this, false, tdbSec, begin, end, positions));
+    }
+
+    m_threadPool.waitForDone();
+}
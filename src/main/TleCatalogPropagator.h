@@ -0,0 +1,132 @@
+// TleCatalogPropagator.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _TLE_CATALOG_PROPAGATOR_H_
+#define _TLE_CATALOG_PROPAGATOR_H_
+
+#include <vesta/OrbitalElements.h>
+#include <noradtle/norad.h>
+#include <QThreadPool>
+#include <vector>
+
+class TleTrajectory;
+
+
+/** TleCatalogPropagator computes the positions of all objects in a catalog of
+  * two-line element sets at once. The result for each object is identical to
+  * the position returned by its TleTrajectory.
+  *
+  * Parameters of near-Earth (SGP4) objects are stored as a structure of arrays.
+  * The secular update, which is pure arithmetic, is computed for two objects at
+  * a time with SSE2 instructions; the periodic terms use the same scalar code as
+  * TleTrajectory. Deep space (SDP4) objects are propagated individually. Large
+  * catalogs are split into chunks that are propagated in parallel.
+  */
+class TleCatalogPropagator
+{
+public:
+    TleCatalogPropagator();
+    ~TleCatalogPropagator();
+
+    void addObject(const TleTrajectory* trajectory);
+    void clear();
+
+    /** Get the number of objects in the catalog.
+      */
+    unsigned int objectCount() const
+    {
+        return (unsigned int) m_objects.size();
+    }
+
+    void propagate(double tdbSec, double* positions) const;
+
+    // Number of objects handled by each task
+    static const unsigned int ChunkSize = 256;
+
+    // Catalogs smaller than this are propagated on the calling thread
+    static const unsigned int ParallelThreshold = 1024;
+
+    void propagateSgp4Range(double tdbSec, unsigned int begin, unsigned int end, double* positions) const;
+    void propagateDeepSpaceRange(double tdbSec, unsigned int begin, unsigned int end, double* positions) const;
+
+private:
+    // Per-object values used by the SGP4 secular update, stored as one array per
+    // value. The remaining near-Earth model parameters are stored per object in
+    // m_sgp4Params (the layout expected by the NORAD code.)
+    enum Sgp4Field
+    {
+        Epoch,
+        Xmo,
+        Omegao,
+        Xnodeo,
+        Bstar,
+        Eo,
+        Xincl,
+        Xmdot,
+        Omgdot,
+        Xnodot,
+        Xnodcf,
+        C1,
+        C4,
+        C5,
+        T2cof,
+        T3cof,
+        T4cof,
+        T5cof,
+        D2,
+        D3,
+        D4,
+        Aodp,
+        Xnodp,
+        Cosio,
+        Sinio,
+        Delmo,
+        Eta,
+        Omgcof,
+        Sinmo,
+        Xmcof,
+        Simple,
+        Sgp4FieldCount
+    };
+
+    struct ObjectRecord
+    {
+        double epoch;
+        double keplerianLimit;
+        vesta::OrbitalElements keplerianBefore;
+        vesta::OrbitalElements keplerianAfter;
+    };
+
+    bool keplerianPosition(unsigned int objectIndex, double tdbSec, double* position) const;
+
+private:
+    std::vector<ObjectRecord> m_objects;
+
+    // Near-Earth objects
+    std::vector<double> m_sgp4Fields[Sgp4FieldCount];
+    std::vector<double> m_sgp4Params;
+    std::vector<unsigned int> m_sgp4Objects;
+
+    // Deep space objects. The deep space model updates its parameters (the
+    // resonance integrator state) while propagating.
+    std::vector<tle_t> m_deepSpaceTles;
+    mutable std::vector<double> m_deepSpaceParams;
+    std::vector<unsigned int> m_deepSpaceObjects;
+
+    mutable QThreadPool m_threadPool;
+};
+
+#endif // _TLE_CATALOG_PROPAGATOR_H_
@@ -0,0 +1,153 @@
+// TleSwarm.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TleSwarm.h"
+#include "TleTrajectory.h"
+#include <vesta/RenderContext.h>
+#include <vesta/Material.h>
+#include <algorithm>
+#include <limits>
+
+using namespace vesta;
+using namespace std;
+
+
+TleSwarm::TleSwarm() :
+    m_boundingRadius(0.0f),
+    m_color(Spectrum(1.0f, 1.0f, 1.0f)),
+    m_opacity(1.0f),
+    m_pointSize(1.0f),
+    m_lastUpdateTime(numeric_limits<double>::quiet_NaN())
+{
+#ifndef VESTA_OGLES2
+    setClippingPolicy(PreventClipping);
+#endif
+}
+
+
+TleSwarm::~TleSwarm()
+{
+}
+
+
+/** Add an object to the swarm. The TLE is copied, so later changes to the
+  * trajectory aren't reflected in the swarm.
+  */
+void
+TleSwarm::addObject(const TleTrajectory* trajectory)
+{
+    m_propagator.addObject(trajectory);
+
+    // Use the Keplerian orbits at the ends of the SGP4 interval to estimate
+    // the apoapsis distance.
+    const OrbitalElements* elements[2] = { &trajectory->keplerianElementsBefore(), &trajectory->keplerianElementsAfter() };
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        double e = elements[i]->eccentricity;
+        if (e < 1.0)
+        {
+            double apoapsis = elements[i]->periapsisDistance * (1.0 + e) / (1.0 - e);
+            m_boundingRadius = max(m_boundingRadius, float(apoapsis));
+        }
+    }
+
+    m_lastUpdateTime = numeric_limits<double>::quiet_NaN();
+}
+
+
+/** Remove all objects.
+  */
+void
+TleSwarm::clear()
+{
+    m_propagator.clear();
+    m_boundingRadius = 0.0f;
+    m_positions.clear();
+    m_vertices.clear();
+    m_lastUpdateTime = numeric_limits<double>::quiet_NaN();
+}
+
+
+void
+TleSwarm::update(double clock) const
+{
+    if (clock == m_lastUpdateTime)
+    {
+        return;
+    }
+
+    unsigned int count = m_propagator.objectCount();
+    m_positions.resize(count * 3);
+    m_vertices.resize(count * 3);
+
+    m_propagator.propagate(clock, &m_positions[0]);
+    for (unsigned int i = 0; i < count * 3; ++i)
+    {
+        m_vertices[i] = float(m_positions[i]);
+    }
+
+    m_lastUpdateTime = clock;
+}
+
+
+void
+TleSwarm::render(RenderContext& rc, double clock) const
+{
+    if (m_propagator.objectCount() == 0)
+    {
+        return;
+    }
+
+    // Contents are never treated as opaque; always draw during the translucent pass
+    if (rc.pass() != RenderContext::TranslucentPass)
+    {
+        return;
+    }
+
+    update(clock);
+
+    Material material;
+    material.setDiffuse(Spectrum(0.0f, 0.0f, 0.0f));
+    material.setEmission(m_color);
+    material.setOpacity(std::min(0.99f, m_opacity));
+    rc.bindMaterial(&material);
+
+#ifndef VESTA_OGLES2
+    glPointSize(m_pointSize);
+#endif
+
+    rc.bindVertexArray(VertexSpec::Position, &m_vertices[0], sizeof(float) * 3);
+    rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, m_propagator.objectCount()));
+    rc.unbindVertexArray();
+
+#ifndef VESTA_OGLES2
+    glPointSize(1.0f);
+#endif
+}
+
+
+float
+TleSwarm::boundingSphereRadius() const
+{
+    return m_boundingRadius;
+}
+
+
+bool
+TleSwarm::isOpaque() const
+{
+    return false;
+}
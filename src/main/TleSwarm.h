@@ -0,0 +1,95 @@
+// TleSwarm.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _TLE_SWARM_H_
+#define _TLE_SWARM_H_
+
+#include "TleCatalogPropagator.h"
+#include <vesta/Geometry.h>
+#include <vesta/Spectrum.h>
+#include <vector>
+
+
+/** TleSwarm is geometry that draws every object in a catalog of two-line
+  * element sets (e.g. all tracked Earth satellites) as a point. Positions
+  * for the whole catalog are recomputed with a TleCatalogPropagator each
+  * time the clock changes.
+  */
+class TleSwarm : public vesta::Geometry
+{
+public:
+    TleSwarm();
+    ~TleSwarm();
+
+    virtual void render(vesta::RenderContext& rc, double clock) const;
+    virtual float boundingSphereRadius() const;
+    virtual bool isOpaque() const;
+
+    vesta::Spectrum color() const
+    {
+        return m_color;
+    }
+
+    void setColor(const vesta::Spectrum& color)
+    {
+        m_color = color;
+    }
+
+    float opacity() const
+    {
+        return m_opacity;
+    }
+
+    void setOpacity(float opacity)
+    {
+        m_opacity = opacity;
+    }
+
+    float pointSize() const
+    {
+        return m_pointSize;
+    }
+
+    void setPointSize(float pointSize)
+    {
+        m_pointSize = pointSize;
+    }
+
+    unsigned int objectCount() const
+    {
+        return m_propagator.objectCount();
+    }
+
+    void addObject(const TleTrajectory* trajectory);
+    void clear();
+
+private:
+    void update(double clock) const;
+
+private:
+    TleCatalogPropagator m_propagator;
+    float m_boundingRadius;
+    vesta::Spectrum m_color;
+    float m_opacity;
+    float m_pointSize;
+
+    // Positions are only recomputed when the time changes
+    mutable double m_lastUpdateTime;
+    mutable std::vector<double> m_positions;
+    mutable std::vector<float> m_vertices;
+};
+
+#endif // _TLE_SWARM_H_
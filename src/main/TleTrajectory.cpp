@@ -133,6 +133,18 @@ TleTrajectory::tleState(double tsec) const
 }
 
 
+/** The deep space models (SDP4 and SDP8) store integrator state in the
+  * model parameter block on every call, so a TLE trajectory using one of
+  * them must not be evaluated by more than one thread at a time.
+  */
+bool
+TleTrajectory::isThreadSafe() const
+{
+    return m_ephemerisType != TLE_EPHEMERIS_TYPE_SDP4 &&
+           m_ephemerisType != TLE_EPHEMERIS_TYPE_SDP8;
+}
+
+
 double
 TleTrajectory::boundingSphereRadius() const
 {
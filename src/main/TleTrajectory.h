@@ -34,6 +34,7 @@ public:
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
+    virtual bool isThreadSafe() const;
 
     double epoch() const
     {
@@ -44,6 +45,39 @@ public:
 
     void setKeplerianApproximationLimit(double tsec);
 
+    double keplerianApproximationLimit() const
+    {
+        return m_keplerianApproxLimit;
+    }
+
+    const vesta::OrbitalElements& keplerianElementsBefore() const
+    {
+        return m_keplerianBefore;
+    }
+
+    const vesta::OrbitalElements& keplerianElementsAfter() const
+    {
+        return m_keplerianAfter;
+    }
+
+    const tle_t* tle() const
+    {
+        return m_tle;
+    }
+
+    int ephemerisType() const
+    {
+        return m_ephemerisType;
+    }
+
+    /** Get the model parameters computed from the TLE by the initialization
+      * function for the ephemeris type; there are N_SAT_PARAMS values.
+      */
+    const double* satParams() const
+    {
+        return m_satParams;
+    }
+
     static TleTrajectory* Create(const std::string& line1, const std::string& line2);
 
 private:
@@ -122,6 +122,11 @@ public:
     virtual Eigen::Quaterniond orientation(double tdbSec) const;
     virtual Eigen::Vector3d angularVelocity(double tdbSec) const;
 
+    virtual bool isThreadSafe() const
+    {
+        return false;
+    }
+
     TwoVectorFrameDirection* primaryDirection() const
     {
         return m_primary.ptr();
@@ -39,6 +39,8 @@
 #include "geometry/FeatureLabelSetGeometry.h"
 
 #include "NumberFormat.h"
+#include "ThreadPoolTaskExecutor.h"
+#include "LocalImageLoader.h"
 
 #if FFMPEG_SUPPORT
 #include "QVideoEncoder.h"
@@ -106,6 +108,7 @@
 #include <QDesktopServices>
 #include <QLocale>
 #include <QPinchGesture>
+#include <QElapsedTimer>
 
 #include <QDeclarativeEngine>
 #include <QDeclarativeComponent>
@@ -408,6 +411,12 @@ UniverseView::UniverseView(QWidget *parent, Universe* universe, UniverseCatalog*
     m_frameCount(0),
     m_frameCountStartTime(0.0),
     m_framesPerSecond(0.0),
+    m_updateStageTime(0.0),
+    m_drawStageTime(0.0),
+    m_averageUpdateStageTime(0.0),
+    m_averageDrawStageTime(0.0),
+    m_stateCacheHitRate(0.0),
+    m_frameStatisticsVisible(false),
     m_reflectionsEnabled(false),
     m_stereoMode(Mono),
     m_antialiasingSamples(1),
@@ -437,6 +446,7 @@ UniverseView::UniverseView(QWidget *parent, Universe* universe, UniverseCatalog*
     m_textureLoader = new NetworkTextureLoader(this);
     m_renderer = new UniverseRenderer();
     m_renderer->setDefaultSunEnabled(false);
+    m_renderer->setTaskExecutor(new ThreadPoolTaskExecutor());
 
     m_labelFont = new TextureFont();
     m_textFont = new TextureFont();
@@ -1250,12 +1260,26 @@ UniverseView::drawInfoOverlay()
                 }
             }
 
-            /*
-            QString frameCountString = QString("%1 fps").arg(m_framesPerSecond);
-            QString texMemString = QString("%1 MB textures").arg(double(m_textureLoader->textureMemoryUsed()) / (1024 * 1024));
-            m_textFont->render(frameCountString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 30.0f));
-            m_textFont->render(texMemString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 10.0f));
-            */
+            if (m_frameStatisticsVisible)
+            {
+                QString frameCountString = QString("%1 fps").arg(m_framesPerSecond, 0, 'f', 1);
+                QString updateString = QString("Update: %1 ms (%2 threads, %3% cached)").
+                        arg(m_averageUpdateStageTime, 0, 'f', 2).
+                        arg(m_renderer->taskExecutor()->threadCount()).
+                        arg(m_stateCacheHitRate, 0, 'f', 0);
+                QString drawString = QString("Cull+draw: %1 ms").arg(m_averageDrawStageTime, 0, 'f', 2);
+                QString texMemString = QString("%1 MB textures").arg(double(m_textureLoader->textureMemoryUsed()) / (1024 * 1024), 0, 'f', 1);
+                const LocalImageLoader* imageLoader = m_textureLoader->localImageLoader();
+                QString imageLoadString = QString("Image loads: %1 pending, %2 ms decode (%3 threads)").
+                        arg(imageLoader->queuedCount() + imageLoader->activeCount()).
+                        arg(imageLoader->averageDecodeLatency(), 0, 'f', 1).
+                        arg(imageLoader->threadCount());
+                m_textFont->render(frameCountString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 90.0f));
+                m_textFont->render(updateString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 70.0f));
+                m_textFont->render(drawString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 50.0f));
+                m_textFont->render(texMemString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 30.0f));
+                m_textFont->render(imageLoadString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 10.0f));
+            }
 
             // Display information about the selection
             if (m_selectedBody.isValid())
@@ -1497,6 +1521,16 @@ void UniverseView::paintGL()
     else if (elapsedTime - m_frameCountStartTime > 1.0)
     {
         m_framesPerSecond = m_frameCount / (elapsedTime - m_frameCountStartTime);
+        m_averageUpdateStageTime = m_updateStageTime / m_frameCount;
+        m_averageDrawStageTime = m_drawStageTime / m_frameCount;
+
+        Entity::StateCacheStatistics cacheStatistics = Entity::stateCacheStatistics();
+        unsigned long stateRequests = cacheStatistics.hits + cacheStatistics.misses;
+        m_stateCacheHitRate = stateRequests == 0 ? 0.0 : 100.0 * cacheStatistics.hits / stateRequests;
+        Entity::resetStateCacheStatistics();
+
+        m_updateStageTime = 0.0;
+        m_drawStageTime = 0.0;
         m_frameCount = 0;
         m_frameCountStartTime = elapsedTime;
     }
@@ -1515,8 +1549,17 @@ void UniverseView::paintGL()
         m_glareOverlay->setGlareSize(max(width(), height()) / 20.0f);
     }
 
+    // The update stage (evaluation of entity positions and orientations) runs in
+    // beginViewSet; culling and drawing happen in the rest of the view set. Draw
+    // times only measure the CPU side of rendering, since OpenGL is asynchronous.
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+
     m_renderer->beginViewSet(m_universe.ptr(), m_simulationTime);
 
+    m_updateStageTime += stageTimer.nsecsElapsed() * 1.0e-6;
+    stageTimer.restart();
+
     if (m_reflectionsEnabled && !m_reflectionMap.isNull())
     {
         // Draw the reflection map; disable sky layers because they look bad when rendered
@@ -1685,6 +1728,8 @@ void UniverseView::paintGL()
 
     m_renderer->endViewSet();
 
+    m_drawStageTime += stageTimer.nsecsElapsed() * 1.0e-6;
+
     // Capture the framebuffer *before* rendering the UI
     if (m_captureNextImage)
     {
@@ -2049,6 +2094,12 @@ UniverseView::keyReleaseEvent(QKeyEvent* event)
     {
         m_wireframe = !m_wireframe;
     }
+
+    // Alt+Shift+F shows the frame rate and the time spent in each stage of rendering
+    if (event->key() == Qt::Key_F && (event->modifiers() & Qt::AltModifier) && (event->modifiers() & Qt::ShiftModifier))
+    {
+        m_frameStatisticsVisible = !m_frameStatisticsVisible;
+    }
 }
 
 
@@ -3189,10 +3240,24 @@ UniverseView::plotTrajectory(Entity* body, const BodyInfo* info)
         // Special handling for interpolated trajectories: we just use the states from the
         // trajectory for the plot so that the plotted line follows the spacecraft motion
         // exactly (both plotting and InterpolateStateTrajectory use cubic Hermite interpolation)
-        for (unsigned int i = 0; i < interpolatedTraj->stateCount(); ++i)
+        const unsigned int BatchSize = 64;
+        double times[BatchSize];
+        StateVector states[BatchSize];
+
+        unsigned int stateCount = interpolatedTraj->stateCount();
+        for (unsigned int first = 0; first < stateCount; first += BatchSize)
         {
-            double t = interpolatedTraj->time(i);
-            plot->addSample(t, interpolatedTraj->state(t));
+            unsigned int count = std::min(BatchSize, stateCount - first);
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                times[i] = interpolatedTraj->time(first + i);
+            }
+
+            interpolatedTraj->states(times, count, states);
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                plot->addSample(times[i], states[i]);
+            }
         }
         plotEntry.trajectory = NULL;
     }
@@ -451,6 +451,18 @@ private:
     double m_frameCountStartTime;
     double m_framesPerSecond;
 
+    // Milliseconds spent in the update and draw stages of the renderer, summed
+    // over the frames counted for the frame rate and then averaged.
+    double m_updateStageTime;
+    double m_drawStageTime;
+    double m_averageUpdateStageTime;
+    double m_averageDrawStageTime;
+
+    // Percentage of entity state requests satisfied from the state cache
+    // over the same frames
+    double m_stateCacheHitRate;
+    bool m_frameStatisticsVisible;
+
     vesta::counted_ptr<vesta::Entity> m_selectedBody;
 
     vesta::counted_ptr<NetworkTextureLoader> m_textureLoader;
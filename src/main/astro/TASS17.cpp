@@ -64,7 +64,9 @@ My modifications are:
 #include "Constants.h"
 #include <vesta/Units.h>
 #include <vesta/InertialFrame.h>
+#include <QMutex>
 #include <cmath>
+#include <cstring>
 
 using namespace vesta;
 using namespace Eigen;
@@ -3088,6 +3090,47 @@ CalcLon(double t,double lon[7])
   }
 }
 
+// The longitudes computed by CalcLon depend only on time, so they're shared by
+// all of the satellites. Recently used epochs are kept in a small direct mapped
+// cache; when the satellites are all evaluated at the same time, CalcLon is only
+// computed once. Orbits may be evaluated from more than one thread, so access to
+// the cache is serialized.
+struct Tass17LongitudeCacheEntry
+{
+  bool valid;
+  double t;
+  double lon[7];
+};
+
+static const unsigned int LongitudeCacheSize = 1024;
+static Tass17LongitudeCacheEntry LongitudeCache[LongitudeCacheSize];
+static QMutex LongitudeCacheMutex;
+
+static void
+SharedCalcLon(double t,double lon[7])
+{
+  quint64 bits;
+  memcpy(&bits,&t,sizeof(bits));
+  unsigned int slot = (unsigned int) ((bits * 0x9e3779b97f4a7c15ull) >> 54) % LongitudeCacheSize;
+
+  {
+    QMutexLocker lock(&LongitudeCacheMutex);
+    const Tass17LongitudeCacheEntry& entry = LongitudeCache[slot];
+    if (entry.valid && entry.t == t) {
+      memcpy(lon,entry.lon,sizeof(entry.lon));
+      return;
+    }
+  }
+
+  CalcLon(t,lon);
+
+  QMutexLocker lock(&LongitudeCacheMutex);
+  Tass17LongitudeCacheEntry& entry = LongitudeCache[slot];
+  entry.valid = true;
+  entry.t = t;
+  memcpy(entry.lon,lon,sizeof(entry.lon));
+}
+
 static void
 CalcTass17Elem(double t,const double lon[7],int body,double elem[6]) {
   const struct Tass17MultiTerm *tmt_begin,*tmt;
@@ -3255,7 +3298,7 @@ TASS17Orbit::state(double tdbSec) const
 
     double longitudes[7];
     double elements[6];
-    CalcLon(t, longitudes);
+    SharedCalcLon(t, longitudes);
     CalcTass17Elem(t, longitudes, satIndex, elements);
 
     double x[6];
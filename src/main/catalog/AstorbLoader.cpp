@@ -15,26 +15,485 @@
 // limitations under the License.
 
 #include "AstorbLoader.h"
+#include "CompiledCache.h"
 #include "../astro/Constants.h"
 #include <vesta/Units.h>
 #include <vesta/GregorianDate.h>
 #include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QHash>
+#include <QtEndian>
 #include <QDebug>
-#include <QRegExp>
 #include <QDataStream>
+#include <vector>
+#include <cmath>
+#include <cstring>
 
 using namespace vesta;
 
 
+/* A compiled swarm file contains the objects of a Keplerian swarm in the
+ * layout of the swarm's vertex array, so that it can be loaded with a single
+ * copy. Compiled swarms are written the first time that an astorb file (text
+ * or binary) is loaded, either next to the source file or in the cache
+ * directory. A compiled swarm file may also be loaded directly as a binary
+ * astorb file.
+ *
+ * Header (64 bytes)
+ *   8 bytes - header "COSMSWRM"
+ *   4 bytes - uint32 - format version (1)
+ *   4 bytes - uint32 - record size (36)
+ *   8 bytes - uint64 - object count
+ *   8 bytes - double - swarm epoch (seconds since J2000.0 TDB)
+ *   8 bytes - int64 - size of the source file in bytes (zero if none)
+ *   8 bytes - int64 - modification time of the source file (seconds since 1970-01-01 UTC)
+ *  16 bytes - reserved (zero)
+ *
+ * Objects (one KeplerianSwarm::KeplerianObject per record; nine floats)
+ *
+ * Byte order is little endian (Intel x86). Compiled swarms are neither read
+ * nor written on big endian systems.
+ */
+
+static const char SwarmMagic[8] = { 'C', 'O', 'S', 'M', 'S', 'W', 'R', 'M' };
+static const quint32 SwarmVersion = 1;
+
+struct SwarmHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 recordSize;
+    quint64 objectCount;
+    double epoch;
+    qint64 sourceSize;
+    qint64 sourceModifiedTime;
+    char reserved[16];
+};
+
+// Size of a record in the binary astorb format written by astorb2bin.py
+static const unsigned int BinaryAstorbRecordSize = 6 * 4 + 8 + 4;
+
+// Minimum length of a line in an astorb text file; the last field used is the
+// semi-major axis in columns 170-181.
+static const unsigned int AstorbMinRecordLength = 181;
+
+// Files are split into chunks of about this many bytes (at line boundaries)
+// which are parsed in parallel.
+static const qint64 AstorbChunkSize = 1024 * 1024;
+
+
+static bool
+compiledSwarmsSupported()
+{
+    return QSysInfo::ByteOrder == QSysInfo::LittleEndian && sizeof(KeplerianSwarm::KeplerianObject) == 36;
+}
+
+
+// Get the possible locations of the compiled swarm for a source file: next
+// to the source file first, then in the cache directory.
+static QStringList
+compiledSwarmFileNames(const QString& sourceFileName)
+{
+    return CompiledFileNames(sourceFileName, "swarms", ".swarm");
+}
+
+
+// Create a swarm from the contents of a compiled swarm file. If sourceInfo is
+// not null, the swarm is only created if it's up to date with respect to the
+// source file.
+static KeplerianSwarm*
+readCompiledSwarm(const uchar* data, qint64 size, const QFileInfo* sourceInfo)
+{
+    if (!compiledSwarmsSupported() || size < qint64(sizeof(SwarmHeader)))
+    {
+        return NULL;
+    }
+
+    SwarmHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SwarmMagic, sizeof(SwarmMagic)) != 0 ||
+        header.version != SwarmVersion ||
+        header.recordSize != sizeof(KeplerianSwarm::KeplerianObject) ||
+        header.objectCount == 0 ||
+        header.objectCount > quint64(size - sizeof(SwarmHeader)) / sizeof(KeplerianSwarm::KeplerianObject))
+    {
+        return NULL;
+    }
+
+    if (sourceInfo && !SourceUnchanged(*sourceInfo, header.sourceSize, header.sourceModifiedTime))
+    {
+        return NULL;
+    }
+
+    // Records start at a four byte aligned offset, so they can be used in place
+    const KeplerianSwarm::KeplerianObject* objects = reinterpret_cast<const KeplerianSwarm::KeplerianObject*>(data + sizeof(SwarmHeader));
+
+    KeplerianSwarm* swarm = new KeplerianSwarm();
+    swarm->setEpoch(header.epoch);
+    swarm->addObjects(objects, (unsigned int) header.objectCount);
+
+    return swarm;
+}
+
+
+// Load the compiled version of a source file, if there is one that's up to date
+static KeplerianSwarm*
+loadCompiledSwarm(const QString& sourceFileName)
+{
+    if (!compiledSwarmsSupported())
+    {
+        return NULL;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+    foreach (QString fileName, compiledSwarmFileNames(sourceFileName))
+    {
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly))
+        {
+            qint64 size = file.size();
+            uchar* data = file.map(0, size);
+            if (data)
+            {
+                KeplerianSwarm* swarm = readCompiledSwarm(data, size, &sourceInfo);
+                file.unmap(data);
+                if (swarm)
+                {
+                    return swarm;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+// Write the compiled version of a source file
+static bool
+writeCompiledSwarm(const QString& sourceFileName, const KeplerianSwarm* swarm)
+{
+    if (!compiledSwarmsSupported() || swarm->objectCount() == 0)
+    {
+        return false;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+
+    SwarmHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SwarmMagic, sizeof(SwarmMagic));
+    header.version = SwarmVersion;
+    header.recordSize = sizeof(KeplerianSwarm::KeplerianObject);
+    header.objectCount = swarm->objectCount();
+    header.epoch = swarm->epoch();
+    header.sourceSize = sourceInfo.size();
+    header.sourceModifiedTime = SourceModifiedTime(sourceInfo);
+
+    qint64 objectBytes = qint64(swarm->objectCount()) * sizeof(KeplerianSwarm::KeplerianObject);
+
+    QByteArray data;
+    data.reserve(int(sizeof(header) + objectBytes));
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(swarm->objects()), int(objectBytes));
+
+    foreach (QString fileName, compiledSwarmFileNames(sourceFileName))
+    {
+        if (WriteCacheFile(fileName, data))
+        {
+            return true;
+        }
+    }
+
+    qDebug() << "Unable to write compiled swarm for " << sourceFileName;
+    return false;
+}
+
+
+static const double PowersOfTen[] =
+{
+    1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+    1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
+
+// Parse a decimal number in a fixed width field. Leading and trailing spaces
+// are ignored and a blank field is zero (the same as QString::toDouble().)
+// Numbers with up to 15 significant digits are converted exactly (both the
+// digits and the power of ten are exactly representable, so the quotient is
+// correctly rounded); anything else is left to QByteArray::toDouble().
+static double
+parseFixedDouble(const char* field, unsigned int width)
+{
+    const char* s = field;
+    const char* end = field + width;
+    while (s != end && *s == ' ')
+    {
+        ++s;
+    }
+
+    const char* numberStart = s;
+    bool negative = false;
+    if (s != end && (*s == '-' || *s == '+'))
+    {
+        negative = *s == '-';
+        ++s;
+    }
+
+    qint64 mantissa = 0;
+    unsigned int digitCount = 0;
+    unsigned int fractionDigits = 0;
+    bool seenPoint = false;
+    for (; s != end && *s != ' '; ++s)
+    {
+        if (*s >= '0' && *s <= '9')
+        {
+            if (digitCount < 16)
+            {
+                mantissa = mantissa * 10 + (*s - '0');
+            }
+            ++digitCount;
+            if (seenPoint)
+            {
+                ++fractionDigits;
+            }
+        }
+        else if (*s == '.' && !seenPoint)
+        {
+            seenPoint = true;
+        }
+        else
+        {
+            // Exponent or other unexpected character
+            digitCount = 16;
+            break;
+        }
+    }
+
+    bool trailingSpace = true;
+    for (const char* t = s; t != end; ++t)
+    {
+        trailingSpace = trailingSpace && *t == ' ';
+    }
+
+    if (digitCount > 15 || !trailingSpace)
+    {
+        return QByteArray(numberStart, int(end - numberStart)).trimmed().toDouble();
+    }
+
+    double value = double(mantissa) / PowersOfTen[fractionDigits];
+    return negative ? -value : value;
+}
+
+
+// Parse an unsigned integer in a fixed width field of digits
+static int
+parseFixedInt(const char* field, unsigned int width)
+{
+    int value = 0;
+    for (unsigned int i = 0; i < width; ++i)
+    {
+        if (field[i] >= '0' && field[i] <= '9')
+        {
+            value = value * 10 + (field[i] - '0');
+        }
+    }
+
+    return value;
+}
+
+
+static bool
+isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+static bool
+isUpper(char c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+
+// Parses astorb records. A separate parser is used by each thread; the parser
+// caches the conversions of epoch dates, since a catalog typically contains
+// only a handful of distinct epochs.
+class AstorbRecordParser
+{
+public:
+    AstorbRecordParser() :
+        m_lastEpochDate(-1),
+        m_lastEpoch(0.0)
+    {
+    }
+
+    bool parse(const char* record, unsigned int length, OrbitalElements* el, double* discoveryTime)
+    {
+        if (length < AstorbMinRecordLength)
+        {
+            return false;
+        }
+
+        // Approximate the discovery date from the provisional designation
+        // (e.g. '1999 JM8': year and half month of discovery)
+        const char* name = record + 7;
+        unsigned int nameLength = 19;
+        while (nameLength > 0 && *name == ' ')
+        {
+            ++name;
+            --nameLength;
+        }
+
+        *discoveryTime = -daysToSeconds(365.25 * 100);
+        if (nameLength >= 7 &&
+            isDigit(name[0]) && isDigit(name[1]) && isDigit(name[2]) && isDigit(name[3]) &&
+            name[4] == ' ' && isUpper(name[5]) && isUpper(name[6]))
+        {
+            double year = parseFixedInt(name, 4);
+            double halfMonth = name[5] - 'A';
+            *discoveryTime = (year - 2000.0) * 365.25 + halfMonth * (365.25 / 24.0);
+            *discoveryTime *= 86400.0;
+        }
+
+        double smaAU = parseFixedDouble(record + 169, 12);
+        double periodYears = pow(smaAU, 1.5);
+
+        el->eccentricity = parseFixedDouble(record + 158, 10);
+        el->periapsisDistance = (1.0 - el->eccentricity) * smaAU * astro::AU;
+        el->inclination = toRadians(parseFixedDouble(record + 148, 9));
+        el->longitudeOfAscendingNode = toRadians(parseFixedDouble(record + 137, 10));
+        el->argumentOfPeriapsis = toRadians(parseFixedDouble(record + 126, 10));
+        el->meanAnomalyAtEpoch = toRadians(parseFixedDouble(record + 115, 10));
+        el->meanMotion = 2.0 * PI / daysToSeconds(365.25 * periodYears);
+        el->epoch = epoch(parseFixedInt(record + 106, 8));
+
+        return true;
+    }
+
+private:
+    // Convert an epoch date (YYYYMMDD, at 12:00 TT) to seconds since J2000 TDB
+    double epoch(int date)
+    {
+        if (date != m_lastEpochDate)
+        {
+            QHash<int, double>::const_iterator iter = m_epochs.find(date);
+            if (iter != m_epochs.end())
+            {
+                m_lastEpoch = iter.value();
+            }
+            else
+            {
+                GregorianDate epochDate(date / 10000, (date / 100) % 100, date % 100, 12, 0, 0);
+                epochDate.setTimeScale(TimeScale_TT);
+                m_lastEpoch = epochDate.toTDBSec();
+                m_epochs.insert(date, m_lastEpoch);
+            }
+            m_lastEpochDate = date;
+        }
+
+        return m_lastEpoch;
+    }
+
+private:
+    QHash<int, double> m_epochs;
+    int m_lastEpochDate;
+    double m_lastEpoch;
+};
+
+
+// Get the length of a line, excluding the line terminator
+static unsigned int
+lineLength(const char* line, const char* lineEnd)
+{
+    if (lineEnd != line && lineEnd[-1] == '\r')
+    {
+        --lineEnd;
+    }
+    return (unsigned int) (lineEnd - line);
+}
+
+
+// Parse all of the records in a range of lines
+static void
+parseAstorbRecords(const char* begin,
+                   const char* end,
+                   const KeplerianSwarm* swarm,
+                   std::vector<KeplerianSwarm::KeplerianObject>* objects)
+{
+    AstorbRecordParser parser;
+
+    const char* line = begin;
+    while (line < end)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd)
+        {
+            lineEnd = end;
+        }
+
+        OrbitalElements el;
+        double discoveryTime = 0.0;
+        if (parser.parse(line, lineLength(line, lineEnd), &el, &discoveryTime))
+        {
+            objects->push_back(swarm->makeObject(el, discoveryTime));
+        }
+
+        line = lineEnd + 1;
+    }
+}
+
+
+class AstorbParseTask : public QRunnable
+{
+public:
+    AstorbParseTask(const char* begin,
+                    const char* end,
+                    const KeplerianSwarm* swarm,
+                    std::vector<KeplerianSwarm::KeplerianObject>* objects) :
+        m_begin(begin),
+        m_end(end),
+        m_swarm(swarm),
+        m_objects(objects)
+    {
+    }
+
+    void run()
+    {
+        parseAstorbRecords(m_begin, m_end, m_swarm, m_objects);
+    }
+
+private:
+    const char* m_begin;
+    const char* m_end;
+    const KeplerianSwarm* m_swarm;
+    std::vector<KeplerianSwarm::KeplerianObject>* m_objects;
+};
+
+
 /** Load a text file containing minor planet data in the ASTORB format used in
   * the catalog maintained by Ted Bowell. Information about the format and a link
   * to the must current data is here:
   *
   *   ftp://ftp.lowell.edu/pub/elgb/astorb.html
+  *
+  * The file is memory mapped and split into chunks that are parsed in parallel.
+  * A compiled version of the swarm is saved, and it's used instead of the text
+  * file until the text file is modified.
   */
 KeplerianSwarm*
 LoadAstorbFile(const QString& fileName)
 {
+    KeplerianSwarm* swarm = loadCompiledSwarm(fileName);
+    if (swarm)
+    {
+        return swarm;
+    }
+
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly))
     {
@@ -42,86 +501,106 @@ LoadAstorbFile(const QString& fileName)
         return NULL;
     }
 
-    KeplerianSwarm* swarm = new KeplerianSwarm();
+    qint64 size = file.size();
+    const uchar* data = size > 0 ? file.map(0, size) : NULL;
+    if (!data)
+    {
+        qDebug() << "astorb file " << fileName << " contains no records";
+        return NULL;
+    }
 
-    unsigned int objectCount = 0;
+    const char* text = reinterpret_cast<const char*>(data);
+    const char* textEnd = text + size;
 
-    QRegExp provisionalDesignation("\\d\\d\\d\\d [A-Z][A-Z]\\d*");
+    swarm = new KeplerianSwarm();
 
-    QTextStream in(&file);
-    while (!in.atEnd() && in.status() == QTextStream::Ok)
+    // Automatically set epoch for the swarm geometry to that of the first record
+    // in the file. This must be known before any records are converted.
     {
-        QString record = in.readLine();
-        if (in.status() == QTextStream::Ok)
+        AstorbRecordParser parser;
+        const char* line = text;
+        bool found = false;
+        while (line < textEnd && !found)
         {
-            QString epochYear = record.mid(106, 4);
-            QString epochMonth = record.mid(110, 2);
-            QString epochDay = record.mid(112, 2);
-            QString meanAnomaly = record.mid(115, 10);
-            QString argOfPeri = record.mid(126, 10);
-            QString ascendingNode = record.mid(137, 10);
-            QString inclination = record.mid(148, 9);
-            QString eccentricity = record.mid(158, 10);
-            QString sma = record.mid(169, 12);
-
-            QString name = record.mid(7, 19).trimmed();
-
-            //bool isNEO = el.periapsisDistance / AU < 1.3;
-            //bool isHilda = el.inclination < toRadians(20.0) && el.eccentricity < 0.3 && smaAU > 3.7 && smaAU < 4.1;
-            //bool isJupiterTrojan = smaAU > 5.1 && smaAU < 5.35 && el.eccentricity < 0.25;
-            //bool isKBO = smaAU >= 30.0;
-
-
-            double discoveryTime = -daysToSeconds(365.25 * 100);
-            if (provisionalDesignation.indexIn(name) == 0)
+            const char* lineEnd = static_cast<const char*>(memchr(line, '\n', textEnd - line));
+            if (!lineEnd)
             {
-                double year = name.mid(0, 4).toDouble();
-                double halfMonth = name.at(5).toLatin1() - 'A';
-                discoveryTime = (year - 2000.0) * 365.25 + halfMonth * (365.25 / 24.0);
-                discoveryTime *= 86400.0;
+                lineEnd = textEnd;
             }
 
-            // float absMag = record.mid(43, 5).toFloat();
-
-            // Epoch is Terrestrial Time
-            GregorianDate epoch(epochYear.toInt(), epochMonth.toInt(), epochDay.toInt(), 12, 0, 0);
-            epoch.setTimeScale(TimeScale_TT);
-            double smaAU = sma.toDouble();
-            double periodYears = pow(smaAU, 1.5);
-
             OrbitalElements el;
-            el.eccentricity = eccentricity.toDouble();
-            el.periapsisDistance = (1.0 - el.eccentricity) * smaAU * astro::AU;
-            el.inclination = toRadians(inclination.toDouble());
-            el.longitudeOfAscendingNode = toRadians(ascendingNode.toDouble());
-            el.argumentOfPeriapsis = toRadians(argOfPeri.toDouble());
-            el.meanAnomalyAtEpoch = toRadians(meanAnomaly.toDouble());
-            el.meanMotion = 2.0 * PI / daysToSeconds(365.25 * periodYears);
-            el.epoch = epoch.toTDBSec();
-
-            // Automatically set epoch for the swarm geometry to that of the first record in the file
-            if (objectCount == 0)
+            double discoveryTime = 0.0;
+            if (parser.parse(line, lineLength(line, lineEnd), &el, &discoveryTime))
             {
                 swarm->setEpoch(el.epoch);
+                found = true;
             }
 
-            swarm->addObject(el, discoveryTime);
-            objectCount++;
+            line = lineEnd + 1;
         }
     }
 
-    if (objectCount == 0)
+    // Split the file into chunks at line boundaries
+    std::vector<const char*> chunkStarts;
+    const char* chunkStart = text;
+    while (chunkStart < textEnd)
+    {
+        chunkStarts.push_back(chunkStart);
+        if (textEnd - chunkStart <= AstorbChunkSize)
+        {
+            break;
+        }
+
+        const char* lineEnd = static_cast<const char*>(memchr(chunkStart + AstorbChunkSize, '\n', textEnd - (chunkStart + AstorbChunkSize)));
+        chunkStart = lineEnd ? lineEnd + 1 : textEnd;
+    }
+    chunkStarts.push_back(textEnd);
+
+    unsigned int chunkCount = (unsigned int) chunkStarts.size() - 1;
+    std::vector<std::vector<KeplerianSwarm::KeplerianObject> > chunkObjects(chunkCount);
+    if (chunkCount == 1)
+    {
+        parseAstorbRecords(chunkStarts[0], chunkStarts[1], swarm, &chunkObjects[0]);
+    }
+    else
+    {
+        QThreadPool threadPool;
+        for (unsigned int i = 0; i < chunkCount; ++i)
+        {
+            threadPool.start(new AstorbParseTask(chunkStarts[i], chunkStarts[i + 1], swarm, &chunkObjects[i]));
+        }
+        threadPool.waitForDone();
+    }
+
+    file.unmap(const_cast<uchar*>(data));
+
+    for (unsigned int i = 0; i < chunkCount; ++i)
+    {
+        if (!chunkObjects[i].empty())
+        {
+            swarm->addObjects(&chunkObjects[i][0], (unsigned int) chunkObjects[i].size());
+        }
+    }
+
+    if (swarm->objectCount() == 0)
     {
         qDebug() << "astorb file " << fileName << " contains no records";
         delete swarm;
         swarm = NULL;
     }
+    else
+    {
+        writeCompiledSwarm(fileName, swarm);
+    }
 
     return swarm;
 }
 
 
-/** Load a binary file containing minor planet data. Each record contains the following:
+/** Load a binary file containing minor planet data. The file is either a
+  * compiled swarm file (see above), which is loaded as is, or a file in the
+  * format written by astorb2bin.py. The latter contains the following for each
+  * record (big endian):
   *
   * semi-major axis      (32-bit float, AU)
   * eccentricity         (32-bit float)
@@ -131,6 +610,9 @@ LoadAstorbFile(const QString& fileName)
   * mean anomaly         (32-bit float, degrees)
   * epoch                (64-bit double, Julian date TT)
   * discovery date       (32-bit float, Julian date TT)
+  *
+  * A compiled version of an astorb2bin.py file is saved and used until the
+  * source file is modified.
   */
 KeplerianSwarm*
 LoadBinaryAstorbFile(const QString& fileName)
@@ -142,61 +624,83 @@ LoadBinaryAstorbFile(const QString& fileName)
         return NULL;
     }
 
-    KeplerianSwarm* swarm = new KeplerianSwarm();
+    qint64 size = file.size();
+    const uchar* data = size > 0 ? file.map(0, size) : NULL;
+    if (!data)
+    {
+        qDebug() << "Binary astorb file " << fileName << " contains no records";
+        return NULL;
+    }
 
-    unsigned int objectCount = 0;
+    KeplerianSwarm* swarm = readCompiledSwarm(data, size, NULL);
+    if (!swarm)
+    {
+        swarm = loadCompiledSwarm(fileName);
+    }
 
-    QDataStream in(&file);
+    if (!swarm)
+    {
+        swarm = new KeplerianSwarm();
 
-    // Set the stream version to 4.5; more recent versions can read single or double precision
-    // floating point values, but not both from the same stream.
-    in.setVersion(QDataStream::Qt_4_5);
+        unsigned int recordCount = (unsigned int) (size / BinaryAstorbRecordSize);
+        std::vector<KeplerianSwarm::KeplerianObject> objects;
+        objects.reserve(recordCount);
 
-    while (!in.atEnd() && in.status() == QDataStream::Ok)
-    {
-        float smaAU = 0.0f;
-        float eccentricity = 0.0f;
-        float inclination = 0.0f;
-        float ascendingNode = 0.0f;
-        float argOfPeriapsis = 0.0f;
-        float meanAnomaly = 0.0f;
-        double epoch = 0.0;
-        float discoveryDate = 0.0f;
+        for (unsigned int i = 0; i < recordCount; ++i)
+        {
+            const uchar* record = data + qint64(i) * BinaryAstorbRecordSize;
 
-        // Read orbital elements
-        in >> smaAU >> eccentricity >> inclination >> ascendingNode >> argOfPeriapsis >> meanAnomaly;
+            // Values are big endian (the QDataStream default)
+            float fields[6];
+            for (unsigned int j = 0; j < 6; ++j)
+            {
+                quint32 bits = qFromBigEndian<quint32>(record + j * 4);
+                memcpy(&fields[j], &bits, sizeof(bits));
+            }
 
-        // Read dates
-        in >> epoch >> discoveryDate;
+            double epoch = 0.0;
+            quint64 epochBits = qFromBigEndian<quint64>(record + 24);
+            memcpy(&epoch, &epochBits, sizeof(epochBits));
 
-        double periodYears = pow(double(smaAU), 1.5);
+            float discoveryDate = 0.0f;
+            quint32 discoveryBits = qFromBigEndian<quint32>(record + 32);
+            memcpy(&discoveryDate, &discoveryBits, sizeof(discoveryBits));
+
+            float smaAU = fields[0];
+            float eccentricity = fields[1];
+            double periodYears = pow(double(smaAU), 1.5);
 
-        if (in.status() == QDataStream::Ok)
-        {
             OrbitalElements el;
             el.eccentricity = eccentricity;
             el.periapsisDistance = (1.0 - eccentricity) * smaAU * astro::AU;
-            el.inclination = toRadians(inclination);
-            el.longitudeOfAscendingNode = toRadians(ascendingNode);
-            el.argumentOfPeriapsis = toRadians(argOfPeriapsis);
-            el.meanAnomalyAtEpoch = toRadians(meanAnomaly);
+            el.inclination = toRadians(fields[2]);
+            el.longitudeOfAscendingNode = toRadians(fields[3]);
+            el.argumentOfPeriapsis = toRadians(fields[4]);
+            el.meanAnomalyAtEpoch = toRadians(fields[5]);
             el.meanMotion = 2.0 * PI / daysToSeconds(365.25 * periodYears);
             el.epoch = daysToSeconds(epoch - J2000);
 
             float discoveryTime = (float) daysToSeconds(discoveryDate - J2000);
 
             // Automatically set epoch for the swarm geometry to that of the first record in the file
-            if (objectCount == 0)
+            if (i == 0)
             {
                 swarm->setEpoch(el.epoch);
             }
 
-            swarm->addObject(el, discoveryTime);
-            objectCount++;
+            objects.push_back(swarm->makeObject(el, discoveryTime));
+        }
+
+        if (!objects.empty())
+        {
+            swarm->addObjects(&objects[0], (unsigned int) objects.size());
+            writeCompiledSwarm(fileName, swarm);
         }
     }
 
-    if (objectCount == 0)
+    file.unmap(const_cast<uchar*>(data));
+
+    if (swarm->objectCount() == 0)
     {
         qDebug() << "Binary astorb file " << fileName << " contains no records";
         delete swarm;
@@ -204,7 +708,7 @@ LoadBinaryAstorbFile(const QString& fileName)
     }
     else
     {
-        qDebug() << "Binary astorb file contains " << objectCount << " objects";
+        qDebug() << "Binary astorb file contains " << swarm->objectCount() << " objects";
     }
 
     return swarm;
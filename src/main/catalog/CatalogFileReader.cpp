@@ -0,0 +1,288 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CatalogFileReader.h"
+#include "JsonParser.h"
+#include "../compatibility/CatalogParser.h"
+#include "../compatibility/TransformCatalog.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QBuffer>
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+
+
+class CatalogReadTask : public QRunnable
+{
+public:
+    CatalogReadTask(CatalogFileReader* reader, const QString& path, unsigned int requireDepth) :
+        m_reader(reader),
+        m_path(path),
+        m_requireDepth(requireDepth)
+    {
+    }
+
+    void run()
+    {
+        m_reader->readFile(m_path, m_requireDepth);
+    }
+
+private:
+    CatalogFileReader* m_reader;
+    QString m_path;
+    unsigned int m_requireDepth;
+};
+
+
+CatalogFileReader::CatalogFileReader()
+{
+}
+
+
+CatalogFileReader::~CatalogFileReader()
+{
+    m_threadPool.waitForDone();
+}
+
+
+/** Read and parse a catalog file and all of the JSON catalog files in its
+  * require tree. This method blocks until all files have been parsed.
+  *
+  * \param path canonical path of the catalog file
+  */
+void
+CatalogFileReader::readRequireTree(const QString& path)
+{
+    m_rootPath = path;
+    m_snapshot.open(path);
+
+    queueFile(path, 0);
+    m_threadPool.waitForDone();
+}
+
+
+/** Get the parsed contents of a file read by readRequireTree().
+  *
+  * \return false if the file hasn't been read
+  */
+bool
+CatalogFileReader::find(const QString& path, ParsedFile* file) const
+{
+    QMutexLocker lock(&m_mutex);
+    QHash<QString, ParsedFile>::const_iterator iter = m_files.find(path);
+    if (iter == m_files.end())
+    {
+        return false;
+    }
+
+    *file = iter.value();
+    return true;
+}
+
+
+/** Write a new snapshot of the require tree read by the last call to
+  * readRequireTree() if any of the files weren't found in the current
+  * snapshot. Files with errors are recorded with just their error message.
+  */
+void
+CatalogFileReader::updateSnapshot()
+{
+    m_threadPool.waitForDone();
+    m_snapshot.close();
+
+    QMutexLocker lock(&m_mutex);
+
+    bool changed = false;
+    QList<CatalogSnapshot::Document> documents;
+    for (QHash<QString, ParsedFile>::const_iterator iter = m_files.begin(); iter != m_files.end(); ++iter)
+    {
+        const ParsedFile& file = iter.value();
+        CatalogSnapshot::Document document;
+        document.path = iter.key();
+        document.source = file.source;
+        document.error = file.error;
+        if (file.error.isEmpty())
+        {
+            document.contents = file.contents;
+        }
+        documents << document;
+        changed = changed || !file.fromSnapshot;
+    }
+
+    if (changed && !m_rootPath.isEmpty())
+    {
+        CatalogSnapshot::Write(m_rootPath, documents);
+    }
+}
+
+
+/** Discard the contents of all parsed files.
+  */
+void
+CatalogFileReader::clear()
+{
+    m_threadPool.waitForDone();
+    m_snapshot.close();
+
+    QMutexLocker lock(&m_mutex);
+    m_files.clear();
+    m_queuedFiles.clear();
+    m_rootPath = QString();
+}
+
+
+void
+CatalogFileReader::queueFile(const QString& path, unsigned int requireDepth)
+{
+    if (path.isEmpty() || requireDepth > MaxRequireDepth)
+    {
+        return;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    if (!m_queuedFiles.contains(path))
+    {
+        m_queuedFiles.insert(path);
+        m_threadPool.start(new CatalogReadTask(this, path, requireDepth));
+    }
+}
+
+
+/** Parse a file and queue all of the JSON catalog files that it requires.
+  * This is called on a thread pool thread.
+  */
+void
+CatalogFileReader::readFile(const QString& path, unsigned int requireDepth)
+{
+    ParsedFile file;
+    QElapsedTimer timer;
+    timer.start();
+    if (m_snapshot.find(path, &file.contents, &file.source, &file.error))
+    {
+        file.fromSnapshot = true;
+        file.parseTime = timer.elapsed();
+    }
+    else if (!ReadFile(path, &file))
+    {
+        // Leave the error to be reported when the loader tries to open the file
+        return;
+    }
+
+    QVariant requireVar = file.contents.value("require");
+    if (requireVar.type() == QVariant::List)
+    {
+        foreach (QVariant v, requireVar.toList())
+        {
+            QString fileName = v.toString();
+            if (v.type() == QVariant::String)
+            {
+                queueFile(RequiredFilePath(path, fileName), requireDepth + 1);
+            }
+        }
+    }
+
+    QMutexLocker lock(&m_mutex);
+    m_files.insert(path, file);
+}
+
+
+// Convert the objects in a Celestia SSC file to catalog items
+static QVariantList
+readSscItems(QIODevice* in)
+{
+    QVariantList items;
+
+    CatalogParser parser(in);
+    QVariant obj = parser.nextSscObject();
+    while (obj.type() == QVariant::Map)
+    {
+        QVariantMap map = obj.toMap();
+        TransformSscObject(&map);
+
+        QString fullName = map.value("_parent").toString() + "/" + map.value("name").toString();
+        map.insert("name", fullName);
+        items << map;
+
+        obj = parser.nextSscObject();
+    }
+
+    return items;
+}
+
+
+/** Read and parse a catalog file (JSON or SSC, depending on the file name
+  * extension.) Errors in the JSON are recorded in the parsed file.
+  *
+  * \return false if the file couldn't be opened
+  */
+bool
+CatalogFileReader::ReadFile(const QString& path, ParsedFile* file)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile catalogFile(path);
+    if (!catalogFile.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QFileInfo info(path);
+    QByteArray data = catalogFile.readAll();
+    file->source.size = data.size();
+    file->source.modifiedTime = info.lastModified().toMSecsSinceEpoch();
+    file->source.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+    if (path.toLower().endsWith(".ssc"))
+    {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        file->contents.insert("items", readSscItems(&buffer));
+    }
+    else
+    {
+        // Comments are handled by the parser
+        JsonParser parser;
+        bool parseOk = false;
+        QVariant result = parser.parse(data, &parseOk);
+        if (parseOk)
+        {
+            file->contents = result.toMap();
+        }
+        else
+        {
+            file->error = QString("Error in %1, line %2: %3").arg(path).arg(parser.errorLine()).arg(parser.errorString());
+        }
+    }
+
+    file->parseTime = timer.elapsed();
+
+    return true;
+}
+
+
+/** Get the canonical path of a file named in the require list of a
+  * catalog file. Required files are found relative to the directory
+  * containing the requiring catalog.
+  */
+QString
+CatalogFileReader::RequiredFilePath(const QString& parentPath, const QString& fileName)
+{
+    QFileInfo parentInfo(parentPath);
+    return QFileInfo(parentInfo.absolutePath() + "/" + fileName).canonicalFilePath();
+}
@@ -0,0 +1,85 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CATALOG_FILE_READER_H_
+#define _CATALOG_FILE_READER_H_
+
+#include "CatalogSnapshot.h"
+#include <QString>
+#include <QVariant>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+
+
+/** CatalogFileReader reads and parses a catalog file and every catalog
+  * file that it requires (directly or indirectly.) Files are parsed
+  * concurrently on a thread pool; the parsed contents are kept until
+  * clear() is called so that the loader can build the catalog objects
+  * in the original order on the main thread.
+  *
+  * Parsed contents are saved in a snapshot of the require tree, which is
+  * used instead of parsing files that haven't changed the next time that
+  * the same top level catalog is read.
+  *
+  * JSON catalogs are parsed to a map. Celestia SSC files are converted to
+  * a map containing a single property, items, with the list of objects
+  * in the file.
+  */
+class CatalogFileReader
+{
+public:
+    struct ParsedFile
+    {
+        ParsedFile() : parseTime(0), fromSnapshot(false) {}
+
+        QVariantMap contents;
+        QString error;
+        qint64 parseTime;   // milliseconds spent reading and parsing
+        CatalogSnapshot::SourceInfo source;
+        bool fromSnapshot;
+    };
+
+    CatalogFileReader();
+    ~CatalogFileReader();
+
+    void readRequireTree(const QString& path);
+    bool find(const QString& path, ParsedFile* file) const;
+    void updateSnapshot();
+    void clear();
+
+    static bool ReadFile(const QString& path, ParsedFile* file);
+    static QString RequiredFilePath(const QString& parentPath, const QString& fileName);
+
+    // Matches the require nesting limit enforced by UniverseLoader
+    static const unsigned int MaxRequireDepth = 10;
+
+    void readFile(const QString& path, unsigned int requireDepth);
+
+private:
+    void queueFile(const QString& path, unsigned int requireDepth);
+
+private:
+    QThreadPool m_threadPool;
+    CatalogSnapshot m_snapshot;
+    QString m_rootPath;
+    mutable QMutex m_mutex;
+    QHash<QString, ParsedFile> m_files;
+    QSet<QString> m_queuedFiles;
+};
+
+#endif // _CATALOG_FILE_READER_H_
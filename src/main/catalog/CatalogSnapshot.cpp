@@ -0,0 +1,268 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CatalogSnapshot.h"
+#include "CompiledCache.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <cstring>
+
+
+/* A catalog snapshot file has the following format. All values are written
+ * with QDataStream (big endian, Qt 5.0 serialization format.)
+ *
+ * Header
+ *   8 bytes - header "COSMSNAP"
+ *   quint32 - format version (2)
+ *   quint32 - document count
+ *
+ * Index (one entry per document)
+ *   QString    - canonical path of the source file
+ *   qint64     - size of the source file in bytes
+ *   qint64     - modification time of the source file (ms since 1970-01-01 UTC)
+ *   QByteArray - SHA-1 hash of the source file
+ *   QString    - parse error message (empty if the file was parsed successfully)
+ *   quint64    - offset of the document contents, from the start of the file
+ *   quint64    - length of the document contents
+ *
+ * Document contents (one QVariantMap per document; empty for documents with errors)
+ */
+
+static const char SnapshotMagic[8] = { 'C', 'O', 'S', 'M', 'S', 'N', 'A', 'P' };
+static const quint32 SnapshotVersion = 2;
+static const QDataStream::Version SnapshotStreamVersion = QDataStream::Qt_5_0;
+
+
+CatalogSnapshot::CatalogSnapshot() :
+    m_data(NULL),
+    m_size(0)
+{
+}
+
+
+CatalogSnapshot::~CatalogSnapshot()
+{
+    close();
+}
+
+
+/** Get the name of the snapshot file for a top level catalog file.
+  */
+QString
+CatalogSnapshot::SnapshotFileName(const QString& catalogPath)
+{
+    return CompiledCachePath(catalogPath, "catalogs", ".snapshot");
+}
+
+
+/** Open the snapshot for a top level catalog file and read the index.
+  *
+  * \return false if there's no snapshot or it isn't valid
+  */
+bool
+CatalogSnapshot::open(const QString& catalogPath)
+{
+    close();
+
+    m_file.setFileName(SnapshotFileName(catalogPath));
+    if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+    {
+        close();
+        return false;
+    }
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), int(m_size));
+    QDataStream in(data);
+    in.setVersion(SnapshotStreamVersion);
+
+    char magic[sizeof(SnapshotMagic)];
+    quint32 version = 0;
+    quint32 documentCount = 0;
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) ||
+        memcmp(magic, SnapshotMagic, sizeof(magic)) != 0)
+    {
+        close();
+        return false;
+    }
+
+    in >> version >> documentCount;
+    if (version != SnapshotVersion)
+    {
+        close();
+        return false;
+    }
+
+    for (quint32 i = 0; i < documentCount && in.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        IndexEntry entry;
+        in >> path >> entry.source.size >> entry.source.modifiedTime >> entry.source.hash >> entry.error >> entry.offset >> entry.length;
+        if (entry.offset + entry.length > quint64(m_size))
+        {
+            break;
+        }
+        m_index.insert(path, entry);
+    }
+
+    if (in.status() != QDataStream::Ok || quint32(m_index.size()) != documentCount)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void
+CatalogSnapshot::close()
+{
+    m_index.clear();
+    if (m_data)
+    {
+        m_file.unmap(const_cast<uchar*>(m_data));
+        m_data = NULL;
+    }
+    m_size = 0;
+    m_file.close();
+}
+
+
+/** Get the contents of a catalog file from the snapshot. The contents are
+  * only returned if the source file hasn't changed since the snapshot was
+  * written: the size and modification time must match, or when only the
+  * modification time differs (e.g. after a checkout), the hash must match.
+  * If the file had a parse error when the snapshot was written, the error
+  * message is returned and the contents are left empty.
+  *
+  * This method may be called from multiple threads at once.
+  */
+bool
+CatalogSnapshot::find(const QString& path, QVariantMap* contents, SourceInfo* source, QString* error) const
+{
+    QHash<QString, IndexEntry>::const_iterator iter = m_index.find(path);
+    if (iter == m_index.end())
+    {
+        return false;
+    }
+
+    const IndexEntry& entry = iter.value();
+
+    QFileInfo info(path);
+    if (info.size() != entry.source.size)
+    {
+        return false;
+    }
+
+    *source = entry.source;
+    qint64 modifiedTime = info.lastModified().toMSecsSinceEpoch();
+    if (modifiedTime != entry.source.modifiedTime)
+    {
+        QFile sourceFile(path);
+        if (!sourceFile.open(QIODevice::ReadOnly) ||
+            QCryptographicHash::hash(sourceFile.readAll(), QCryptographicHash::Sha1) != entry.source.hash)
+        {
+            return false;
+        }
+        source->modifiedTime = modifiedTime;
+    }
+
+    *error = entry.error;
+    if (!entry.error.isEmpty())
+    {
+        return true;
+    }
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + entry.offset), int(entry.length));
+    QDataStream in(data);
+    in.setVersion(SnapshotStreamVersion);
+    in >> *contents;
+
+    return in.status() == QDataStream::Ok;
+}
+
+
+/** Write a snapshot of the parsed contents of all catalog files in the require
+  * tree of a top level catalog file.
+  */
+bool
+CatalogSnapshot::Write(const QString& catalogPath, const QList<Document>& documents)
+{
+    QString fileName = SnapshotFileName(catalogPath);
+
+    // Serialize the documents first so that the offsets are known when
+    // the index is written.
+    QList<QByteArray> contents;
+    foreach (const Document& document, documents)
+    {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(SnapshotStreamVersion);
+        if (document.error.isEmpty())
+        {
+            out << document.contents;
+        }
+        contents << data;
+    }
+
+    // The index size depends on the offsets only through their (fixed) width,
+    // so it can be measured with placeholder offsets.
+    QByteArray index;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        quint64 offset = sizeof(SnapshotMagic) + 2 * sizeof(quint32) + quint64(index.size());
+
+        index.clear();
+        QDataStream out(&index, QIODevice::WriteOnly);
+        out.setVersion(SnapshotStreamVersion);
+        for (int i = 0; i < documents.size(); ++i)
+        {
+            const Document& document = documents.at(i);
+            out << document.path << document.source.size << document.source.modifiedTime << document.source.hash << document.error;
+            out << offset << quint64(contents.at(i).size());
+            offset += contents.at(i).size();
+        }
+    }
+
+    QByteArray snapshot;
+    QDataStream out(&snapshot, QIODevice::WriteOnly);
+    out.setVersion(SnapshotStreamVersion);
+    out.writeRawData(SnapshotMagic, sizeof(SnapshotMagic));
+    out << SnapshotVersion << quint32(documents.size());
+    out.writeRawData(index.constData(), index.size());
+    foreach (const QByteArray& data, contents)
+    {
+        out.writeRawData(data.constData(), data.size());
+    }
+
+    if (out.status() != QDataStream::Ok || !WriteCacheFile(fileName, snapshot))
+    {
+        qDebug() << "Error writing catalog snapshot " << fileName;
+        return false;
+    }
+
+    return true;
+}
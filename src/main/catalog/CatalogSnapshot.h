@@ -0,0 +1,87 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CATALOG_SNAPSHOT_H_
+#define _CATALOG_SNAPSHOT_H_
+
+#include <QString>
+#include <QVariant>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+#include <QList>
+
+
+/** CatalogSnapshot is a binary cache of the parsed contents of every
+  * catalog file in the require tree of a top level catalog. Each file's
+  * contents are stored with the size, modification time, and SHA-1 hash
+  * of the source file; contents are only used when the source file is
+  * unchanged. The snapshot is memory mapped, and the contents of a file
+  * aren't decoded until they're requested.
+  *
+  * Files that couldn't be parsed are stored with their error message and
+  * no contents, so that an unchanged file with errors doesn't cause the
+  * snapshot to be rewritten.
+  */
+class CatalogSnapshot
+{
+public:
+    /** Information about the source of a parsed catalog file.
+      */
+    struct SourceInfo
+    {
+        SourceInfo() : size(0), modifiedTime(0) {}
+
+        qint64 size;
+        qint64 modifiedTime;   // milliseconds since 1970-01-01 UTC
+        QByteArray hash;       // SHA-1 hash of the contents
+    };
+
+    struct Document
+    {
+        QString path;
+        SourceInfo source;
+        QVariantMap contents;
+        QString error;      // parse error; contents are empty when set
+    };
+
+    CatalogSnapshot();
+    ~CatalogSnapshot();
+
+    bool open(const QString& catalogPath);
+    void close();
+
+    bool find(const QString& path, QVariantMap* contents, SourceInfo* source, QString* error) const;
+
+    static bool Write(const QString& catalogPath, const QList<Document>& documents);
+    static QString SnapshotFileName(const QString& catalogPath);
+
+private:
+    struct IndexEntry
+    {
+        SourceInfo source;
+        QString error;
+        quint64 offset;
+        quint64 length;
+    };
+
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    QHash<QString, IndexEntry> m_index;
+};
+
+#endif // _CATALOG_SNAPSHOT_H_
@@ -0,0 +1,113 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CompiledCache.h"
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+
+/* Compiled files (sampled data packs, indexed star catalogs, compiled swarms
+ * and meshes, and catalog snapshots) are derived from source files and can be
+ * rebuilt at any time. They're stored either next to the source file or in a
+ * subdirectory of the user's cache directory, named by a hash of a key that
+ * identifies the source.
+ */
+
+
+/** Get the name of a compiled file in the cache directory.
+  *
+  * \param key string identifying the source, usually its absolute path
+  * \param subdirectory subdirectory of the cache directory for this kind of file
+  * \param extension file name extension, including the dot
+  */
+QString
+CompiledCachePath(const QString& key, const QString& subdirectory, const QString& extension)
+{
+    QByteArray keyHash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + subdirectory + "/" +
+           QString::fromLatin1(keyHash.constData()) + extension;
+}
+
+
+/** Get the possible locations of the compiled version of a source file, in
+  * the order that they should be tried: next to the source file first, then
+  * in the cache directory.
+  */
+QStringList
+CompiledFileNames(const QString& sourceFileName, const QString& subdirectory, const QString& extension)
+{
+    QString absolutePath = QFileInfo(sourceFileName).absoluteFilePath();
+
+    QStringList fileNames;
+    fileNames << absolutePath + extension;
+    fileNames << CompiledCachePath(absolutePath, subdirectory, extension);
+
+    return fileNames;
+}
+
+
+/** Get the modification time of a source file as recorded in compiled
+  * files, in seconds since 1970-01-01 UTC.
+  */
+qint64
+SourceModifiedTime(const QFileInfo& sourceInfo)
+{
+    return sourceInfo.lastModified().toMSecsSinceEpoch() / 1000;
+}
+
+
+/** Return true if a source file still has the size and modification time
+  * recorded when a compiled file was written from it.
+  */
+bool
+SourceUnchanged(const QFileInfo& sourceInfo, qint64 sourceSize, qint64 sourceModifiedTime)
+{
+    return sourceInfo.size() == sourceSize && SourceModifiedTime(sourceInfo) == sourceModifiedTime;
+}
+
+
+/** Write a compiled file, creating its directory if necessary. The data is
+  * written to a temporary file that is renamed once complete, so a partially
+  * written file is never seen by readers.
+  *
+  * \return true if the file was written successfully
+  */
+bool
+WriteCacheFile(const QString& fileName, const QByteArray& data)
+{
+    QDir dir = QFileInfo(fileName).absoluteDir();
+    if (!dir.exists() && !dir.mkpath("."))
+    {
+        return false;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    if (file.write(data) != data.size())
+    {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
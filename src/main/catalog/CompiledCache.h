@@ -0,0 +1,33 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _COMPILED_CACHE_H_
+#define _COMPILED_CACHE_H_
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFileInfo>
+
+QString CompiledCachePath(const QString& key, const QString& subdirectory, const QString& extension);
+QStringList CompiledFileNames(const QString& sourceFileName, const QString& subdirectory, const QString& extension);
+
+qint64 SourceModifiedTime(const QFileInfo& sourceInfo);
+bool SourceUnchanged(const QFileInfo& sourceInfo, qint64 sourceSize, qint64 sourceModifiedTime);
+
+bool WriteCacheFile(const QString& fileName, const QByteArray& data);
+
+#endif // _COMPILED_CACHE_H_
@@ -0,0 +1,536 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CompiledMesh.h"
+#include "CompiledCache.h"
+#include <vesta/Submesh.h>
+#include <vesta/VertexArray.h>
+#include <vesta/PrimitiveBatch.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QSysInfo>
+#include <QDebug>
+#include <cstring>
+
+using namespace vesta;
+
+
+/* A compiled mesh is a mesh that has already been through the optimizations
+ * applied when a model file is loaded (merging submeshes and materials,
+ * removing duplicate vertices, and compressing indices.) Compiled meshes are
+ * written to the cache directory the first time that a model file is loaded.
+ * The file name is a hash of the model file path and the texture search path,
+ * because texture names in the model are resolved relative to the search path.
+ *
+ * Values are written with QDataStream (big endian, Qt 5.0 serialization format,
+ * single precision floats) except for vertex and index data, which is written
+ * in little endian byte order, aligned to four bytes, in the form that it's
+ * stored in memory.
+ *
+ * Header
+ *   8 bytes - header "COSMMESH"
+ *   quint32 - format version (2)
+ *   qint64  - size of the source file in bytes
+ *   qint64  - modification time of the source file (seconds since 1970-01-01 UTC)
+ *
+ * Materials
+ *   quint32 - material count
+ *   for each material:
+ *     qint32 BRDF, float opacity, 3 floats diffuse, 3 floats specular,
+ *     float Phong exponent, float Fresnel reflectance, 3 floats emission,
+ *     qint32 blend mode, qint32 specular modifier source, and the
+ *     base, normal, and specular textures
+ *   for each texture:
+ *     quint8 - 1 if present, 0 if not; the remaining fields are omitted for absent textures
+ *     QByteArray - UTF-8 resource name
+ *     qint32 S address mode, qint32 T address mode, qint32 usage, quint8 use mipmaps,
+ *     quint32 max anisotropy, quint32 max mipmap level
+ *
+ * Submeshes
+ *   quint32 - submesh count
+ *   for each submesh:
+ *     quint32 - vertex count
+ *     quint32 - vertex stride in bytes
+ *     quint32 - attribute count
+ *     for each attribute: qint32 semantic, qint32 format, quint32 offset
+ *     vertex data (count * stride bytes)
+ *     quint32 - primitive batch count
+ *     for each primitive batch:
+ *       quint32 primitive type, quint32 material index, quint32 primitive count,
+ *       quint32 first vertex, quint8 index size in bits (0 for batches without indices)
+ *       index data
+ *
+ * Compiled meshes are neither read nor written on big endian systems.
+ */
+
+static const char MeshFileMagic[8] = { 'C', 'O', 'S', 'M', 'M', 'E', 'S', 'H' };
+static const quint32 MeshFileVersion = 2;
+static const QDataStream::Version MeshStreamVersion = QDataStream::Qt_5_0;
+
+
+static bool
+compiledMeshesSupported()
+{
+    return QSysInfo::ByteOrder == QSysInfo::LittleEndian;
+}
+
+
+static QString
+compiledMeshFileName(const QString& sourceFileName, const QString& textureSearchPath)
+{
+    QString key = QFileInfo(sourceFileName).absoluteFilePath() + "\n" + textureSearchPath;
+    return CompiledCachePath(key, "meshes", ".mesh");
+}
+
+
+// Get the number of padding bytes required to align raw data at the current
+// stream position.
+static int
+alignmentPadding(const QDataStream& stream)
+{
+    return int((4 - stream.device()->pos() % 4) % 4);
+}
+
+
+static void
+writeSpectrum(QDataStream& out, const Spectrum& s)
+{
+    out << s.red() << s.green() << s.blue();
+}
+
+
+static Spectrum
+readSpectrum(QDataStream& in)
+{
+    float r = 0.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+    in >> r >> g >> b;
+    return Spectrum(r, g, b);
+}
+
+
+// Texture names are written relative to the texture search path (when they're
+// inside it) so that the texture loader resolves them to the same texture.
+static void
+writeTexture(QDataStream& out, const TextureMap* texture, const QString& textureSearchPath)
+{
+    if (!texture || texture->name().empty())
+    {
+        out << quint8(0);
+        return;
+    }
+
+    QString name = QString::fromUtf8(texture->name().c_str());
+    QString searchPrefix = textureSearchPath + "/";
+    if (!textureSearchPath.isEmpty() && name.startsWith(searchPrefix))
+    {
+        name = name.mid(searchPrefix.length());
+    }
+
+    const TextureProperties& properties = texture->properties();
+    out << quint8(1) << name.toUtf8();
+    out << qint32(properties.addressS) << qint32(properties.addressT) << qint32(properties.usage);
+    out << quint8(properties.useMipmaps ? 1 : 0) << quint32(properties.maxAnisotropy) << quint32(properties.maxMipmapLevel);
+}
+
+
+static TextureMap*
+readTexture(QDataStream& in, TextureMapLoader* textureLoader)
+{
+    quint8 present = 0;
+    in >> present;
+    if (!present)
+    {
+        return NULL;
+    }
+
+    QByteArray name;
+    qint32 addressS = 0;
+    qint32 addressT = 0;
+    qint32 usage = 0;
+    quint8 useMipmaps = 0;
+    quint32 maxAnisotropy = 0;
+    quint32 maxMipmapLevel = 0;
+    in >> name >> addressS >> addressT >> usage >> useMipmaps >> maxAnisotropy >> maxMipmapLevel;
+
+    if (in.status() != QDataStream::Ok || !textureLoader)
+    {
+        return NULL;
+    }
+
+    TextureProperties properties;
+    properties.addressS = TextureProperties::AddressMode(addressS);
+    properties.addressT = TextureProperties::AddressMode(addressT);
+    properties.usage = TextureProperties::TextureUsage(usage);
+    properties.useMipmaps = useMipmaps != 0;
+    properties.maxAnisotropy = maxAnisotropy;
+    properties.maxMipmapLevel = maxMipmapLevel;
+
+    return textureLoader->loadTexture(std::string(name.constData(), name.size()), properties);
+}
+
+
+static void
+writeMaterial(QDataStream& out, const Material* material, const QString& textureSearchPath)
+{
+    out << qint32(material->brdf()) << material->opacity();
+    writeSpectrum(out, material->diffuse());
+    writeSpectrum(out, material->specular());
+    out << material->phongExponent() << material->fresnelReflectance();
+    writeSpectrum(out, material->emission());
+    out << qint32(material->blendMode()) << qint32(material->specularModifier());
+    writeTexture(out, material->baseTexture(), textureSearchPath);
+    writeTexture(out, material->normalTexture(), textureSearchPath);
+    writeTexture(out, material->specularTexture(), textureSearchPath);
+}
+
+
+static Material*
+readMaterial(QDataStream& in, TextureMapLoader* textureLoader)
+{
+    Material* material = new Material();
+
+    qint32 brdf = 0;
+    float opacity = 1.0f;
+    in >> brdf >> opacity;
+    material->setBrdf(Material::BRDF(brdf));
+    material->setOpacity(opacity);
+    material->setDiffuse(readSpectrum(in));
+    material->setSpecular(readSpectrum(in));
+
+    float phongExponent = 1.0f;
+    float fresnelReflectance = 1.0f;
+    in >> phongExponent >> fresnelReflectance;
+    material->setPhongExponent(phongExponent);
+    material->setFresnelReflectance(fresnelReflectance);
+    material->setEmission(readSpectrum(in));
+
+    qint32 blendMode = 0;
+    qint32 specularModifier = 0;
+    in >> blendMode >> specularModifier;
+    material->setBlendMode(Material::BlendMode(blendMode));
+    material->setSpecularModifier(Material::SpecularModifierSource(specularModifier));
+
+    material->setBaseTexture(readTexture(in, textureLoader));
+    material->setNormalTexture(readTexture(in, textureLoader));
+    material->setSpecularTexture(readTexture(in, textureLoader));
+
+    return material;
+}
+
+
+static void
+writeSubmesh(QDataStream& out, const Submesh* submesh)
+{
+    static const char zeros[4] = { 0, 0, 0, 0 };
+
+    const VertexArray* vertices = submesh->vertices();
+    const VertexSpec& spec = vertices->vertexSpec();
+    out << quint32(vertices->count()) << quint32(vertices->stride()) << quint32(spec.attributeCount());
+    for (unsigned int i = 0; i < spec.attributeCount(); ++i)
+    {
+        out << qint32(spec.attribute(i).semantic()) << qint32(spec.attribute(i).format()) << quint32(spec.attributeOffset(i));
+    }
+
+    out.writeRawData(zeros, alignmentPadding(out));
+    out.writeRawData(reinterpret_cast<const char*>(vertices->data()), vertices->count() * vertices->stride());
+
+    const std::vector<PrimitiveBatch*>& batches = submesh->primitiveBatches();
+    out << quint32(batches.size());
+    for (unsigned int i = 0; i < batches.size(); ++i)
+    {
+        const PrimitiveBatch* batch = batches[i];
+        quint8 indexBits = 0;
+        if (batch->isIndexed())
+        {
+            indexBits = batch->indexSize() == PrimitiveBatch::Index16 ? 16 : 32;
+        }
+
+        out << quint32(batch->primitiveType()) << quint32(submesh->materials()[i]) << quint32(batch->primitiveCount()) << quint32(batch->firstVertex()) << indexBits;
+        if (indexBits != 0)
+        {
+            out.writeRawData(zeros, alignmentPadding(out));
+            out.writeRawData(reinterpret_cast<const char*>(batch->indexData()), batch->indexCount() * (indexBits / 8));
+        }
+    }
+}
+
+
+// Read a submesh. The stream must be reading from data, which is used to
+// access the index arrays without an extra copy. Batches must refer only to
+// vertices in the submesh and to one of the mesh's materials (or the default
+// material.)
+static Submesh*
+readSubmesh(QDataStream& in, const QByteArray& data, quint32 materialCount)
+{
+    quint32 vertexCount = 0;
+    quint32 stride = 0;
+    quint32 attributeCount = 0;
+    in >> vertexCount >> stride >> attributeCount;
+    if (in.status() != QDataStream::Ok || attributeCount == 0 || attributeCount > 16)
+    {
+        return NULL;
+    }
+
+    VertexAttribute attributes[16];
+    quint32 offsets[16];
+    for (quint32 i = 0; i < attributeCount; ++i)
+    {
+        qint32 semantic = 0;
+        qint32 format = 0;
+        in >> semantic >> format >> offsets[i];
+        if (semantic < VertexAttribute::Position || semantic > VertexAttribute::Tangent ||
+            format < VertexAttribute::Float1 || format > VertexAttribute::UByte4)
+        {
+            return NULL;
+        }
+        attributes[i] = VertexAttribute(VertexAttribute::Semantic(semantic), VertexAttribute::Format(format));
+    }
+
+    // Vertex attributes are packed in all meshes produced by the loaders
+    VertexSpec spec(attributeCount, attributes);
+    for (quint32 i = 0; i < attributeCount; ++i)
+    {
+        if (spec.attributeOffset(i) != offsets[i])
+        {
+            return NULL;
+        }
+    }
+
+    qint64 vertexDataSize = qint64(vertexCount) * stride;
+    int padding = alignmentPadding(in);
+    if (in.status() != QDataStream::Ok ||
+        stride < spec.size() || stride % 4 != 0 ||
+        in.skipRawData(padding) != padding ||
+        vertexDataSize > data.size() - in.device()->pos())
+    {
+        return NULL;
+    }
+
+    char* vertexData = new char[vertexDataSize];
+    in.readRawData(vertexData, int(vertexDataSize));
+    Submesh* submesh = new Submesh(new VertexArray(vertexData, vertexCount, spec, stride));
+
+    quint32 batchCount = 0;
+    in >> batchCount;
+    for (quint32 i = 0; i < batchCount && in.status() == QDataStream::Ok; ++i)
+    {
+        quint32 primitiveType = 0;
+        quint32 materialIndex = 0;
+        quint32 primitiveCount = 0;
+        quint32 firstVertex = 0;
+        quint8 indexBits = 0;
+        in >> primitiveType >> materialIndex >> primitiveCount >> firstVertex >> indexBits;
+        if (in.status() != QDataStream::Ok ||
+            primitiveType > PrimitiveBatch::Points ||
+            primitiveCount > 0x7fffffff ||
+            (indexBits != 0 && indexBits != 16 && indexBits != 32) ||
+            (materialIndex >= materialCount && materialIndex != Submesh::DefaultMaterialIndex))
+        {
+            delete submesh;
+            return NULL;
+        }
+
+        PrimitiveBatch::PrimitiveType type = PrimitiveBatch::PrimitiveType(primitiveType);
+        PrimitiveBatch* batch = new PrimitiveBatch(type, int(primitiveCount), firstVertex);
+        if (indexBits == 0 && qint64(firstVertex) + batch->indexCount() > qint64(vertexCount))
+        {
+            delete batch;
+            delete submesh;
+            return NULL;
+        }
+        else if (indexBits != 0)
+        {
+            qint64 indexDataSize = qint64(batch->indexCount()) * (indexBits / 8);
+            padding = alignmentPadding(in);
+            if (in.skipRawData(padding) != padding || indexDataSize > data.size() - in.device()->pos())
+            {
+                delete batch;
+                delete submesh;
+                return NULL;
+            }
+
+            const char* indexData = data.constData() + in.device()->pos();
+            delete batch;
+            if (indexBits == 16)
+            {
+                batch = new PrimitiveBatch(type, reinterpret_cast<const v_uint16*>(indexData), int(primitiveCount));
+            }
+            else
+            {
+                batch = new PrimitiveBatch(type, reinterpret_cast<const v_uint32*>(indexData), int(primitiveCount));
+            }
+            in.skipRawData(int(indexDataSize));
+
+            if (batch->indexCount() > 0 && batch->maxVertexIndex() >= vertexCount)
+            {
+                delete batch;
+                delete submesh;
+                return NULL;
+            }
+        }
+
+        submesh->addPrimitiveBatch(batch, materialIndex);
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        delete submesh;
+        return NULL;
+    }
+
+    return submesh;
+}
+
+
+static MeshGeometry*
+readCompiledMesh(const QByteArray& data, const QFileInfo& sourceInfo, TextureMapLoader* textureLoader)
+{
+    QDataStream in(data);
+    in.setVersion(MeshStreamVersion);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    char magic[sizeof(MeshFileMagic)];
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) ||
+        memcmp(magic, MeshFileMagic, sizeof(magic)) != 0)
+    {
+        return NULL;
+    }
+
+    quint32 version = 0;
+    qint64 sourceSize = 0;
+    qint64 modifiedTime = 0;
+    in >> version >> sourceSize >> modifiedTime;
+    if (in.status() != QDataStream::Ok ||
+        version != MeshFileVersion ||
+        !SourceUnchanged(sourceInfo, sourceSize, modifiedTime))
+    {
+        return NULL;
+    }
+
+    MeshGeometry* mesh = new MeshGeometry();
+
+    quint32 materialCount = 0;
+    in >> materialCount;
+    for (quint32 i = 0; i < materialCount && in.status() == QDataStream::Ok; ++i)
+    {
+        mesh->addMaterial(readMaterial(in, textureLoader));
+    }
+
+    quint32 submeshCount = 0;
+    in >> submeshCount;
+    for (quint32 i = 0; i < submeshCount && in.status() == QDataStream::Ok; ++i)
+    {
+        Submesh* submesh = readSubmesh(in, data, materialCount);
+        if (!submesh)
+        {
+            delete mesh;
+            return NULL;
+        }
+        mesh->addSubmesh(submesh);
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        delete mesh;
+        return NULL;
+    }
+
+    return mesh;
+}
+
+
+/** Load the compiled version of a mesh file. Returns null if there's no compiled
+  * mesh or if it's out of date with respect to the source file.
+  *
+  * \param textureSearchPath the search path of the texture loader while the mesh is loaded
+  */
+MeshGeometry*
+LoadCompiledMesh(const QString& sourceFileName, const QString& textureSearchPath, TextureMapLoader* textureLoader)
+{
+    if (!compiledMeshesSupported())
+    {
+        return NULL;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+    QFile file(compiledMeshFileName(sourceFileName, textureSearchPath));
+    if (!sourceInfo.exists() || !file.exists() || !file.open(QIODevice::ReadOnly))
+    {
+        return NULL;
+    }
+
+    qint64 size = file.size();
+    uchar* mappedData = size > 0 ? file.map(0, size) : NULL;
+    if (!mappedData)
+    {
+        return NULL;
+    }
+
+    QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(mappedData), int(size));
+    MeshGeometry* mesh = readCompiledMesh(data, sourceInfo, textureLoader);
+    file.unmap(mappedData);
+
+    return mesh;
+}
+
+
+/** Write the compiled version of a mesh loaded from the specified source file.
+  * The mesh should already have been optimized.
+  *
+  * \param textureSearchPath the search path of the texture loader while the mesh was loaded
+  */
+bool
+WriteCompiledMesh(const QString& sourceFileName, const QString& textureSearchPath, const MeshGeometry* mesh)
+{
+    if (!compiledMeshesSupported())
+    {
+        return false;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+    QString fileName = compiledMeshFileName(sourceFileName, textureSearchPath);
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(MeshStreamVersion);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    out.writeRawData(MeshFileMagic, sizeof(MeshFileMagic));
+    out << MeshFileVersion << qint64(sourceInfo.size()) << SourceModifiedTime(sourceInfo);
+
+    out << quint32(mesh->materialCount());
+    for (unsigned int i = 0; i < mesh->materialCount(); ++i)
+    {
+        writeMaterial(out, mesh->material(i), textureSearchPath);
+    }
+
+    out << quint32(mesh->submeshCount());
+    for (unsigned int i = 0; i < mesh->submeshCount(); ++i)
+    {
+        writeSubmesh(out, mesh->submesh(i));
+    }
+
+    if (out.status() == QDataStream::Ok && WriteCacheFile(fileName, data))
+    {
+        return true;
+    }
+
+    qDebug() << "Unable to write compiled mesh for " << sourceFileName;
+    return false;
+}
@@ -0,0 +1,31 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _COMPILED_MESH_H_
+#define _COMPILED_MESH_H_
+
+#include <vesta/MeshGeometry.h>
+#include <vesta/TextureMapLoader.h>
+#include <QString>
+
+vesta::MeshGeometry* LoadCompiledMesh(const QString& sourceFileName,
+                                      const QString& textureSearchPath,
+                                      vesta::TextureMapLoader* textureLoader);
+bool WriteCompiledMesh(const QString& sourceFileName,
+                       const QString& textureSearchPath,
+                       const vesta::MeshGeometry* mesh);
+
+#endif // _COMPILED_MESH_H_
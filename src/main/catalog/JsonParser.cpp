@@ -0,0 +1,665 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "JsonParser.h"
+#include <QIODevice>
+#include <QStringList>
+
+
+// Powers of ten that are exactly representable as doubles
+static const double ExactPowersOfTen[] =
+{
+    1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+    1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
+static const int MaxExactPowerOfTen = 22;
+
+// Largest integer such that all smaller integers are exactly representable as doubles
+static const quint64 MaxExactMantissa = Q_UINT64_C(1) << 53;
+
+// More digits than this may overflow the 64-bit mantissa
+static const int MaxMantissaDigits = 19;
+
+// Magnitude of the most negative 64-bit integer
+static const quint64 MaxNegativeMantissa = Q_UINT64_C(1) << 63;
+
+
+static inline bool
+isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+static inline int
+hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+
+JsonParser::JsonParser() :
+    m_current(NULL),
+    m_end(NULL),
+    m_line(1),
+    m_depth(0),
+    m_errorLine(0)
+{
+}
+
+
+/** Parse a JSON document. An empty document (containing nothing but
+  * whitespace and comments) gives an invalid QVariant.
+  *
+  * \param ok set to false if there's an error in the JSON text
+  */
+QVariant
+JsonParser::parse(const QByteArray& text, bool* ok)
+{
+    m_current = text.constData();
+    m_end = m_current + text.size();
+    m_line = 1;
+    m_depth = 0;
+    m_errorLine = 0;
+    m_errorString = QString();
+
+    // Skip the UTF-8 byte order mark
+    if (text.startsWith("\xef\xbb\xbf"))
+    {
+        m_current += 3;
+    }
+
+    QVariant result;
+    bool parseOk = skipWhitespace();
+    if (parseOk && m_current != m_end)
+    {
+        parseOk = parseValue(&result) && skipWhitespace();
+        if (parseOk && m_current != m_end)
+        {
+            parseOk = setError("Unexpected text after end of JSON value");
+        }
+    }
+
+    if (ok)
+    {
+        *ok = parseOk;
+    }
+
+    m_current = NULL;
+    m_end = NULL;
+
+    return parseOk ? result : QVariant();
+}
+
+
+/** Read the entire contents of an open device and parse them as JSON.
+  */
+QVariant
+JsonParser::parse(QIODevice* device, bool* ok)
+{
+    return parse(device->readAll(), ok);
+}
+
+
+bool
+JsonParser::setError(const QString& message)
+{
+    m_errorLine = m_line;
+    m_errorString = message;
+    return false;
+}
+
+
+// Skip whitespace and comments. Returns false if there's an unterminated comment.
+bool
+JsonParser::skipWhitespace()
+{
+    while (m_current != m_end)
+    {
+        char c = *m_current;
+        if (c == '\n')
+        {
+            ++m_line;
+            ++m_current;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+        {
+            ++m_current;
+        }
+        else if (c == '/' && m_end - m_current > 1 && m_current[1] == '/')
+        {
+            m_current += 2;
+            while (m_current != m_end && *m_current != '\n')
+            {
+                ++m_current;
+            }
+        }
+        else if (c == '/' && m_end - m_current > 1 && m_current[1] == '*')
+        {
+            m_current += 2;
+            for (;;)
+            {
+                if (m_end - m_current < 2)
+                {
+                    m_current = m_end;
+                    return setError("Unterminated comment");
+                }
+                else if (m_current[0] == '*' && m_current[1] == '/')
+                {
+                    m_current += 2;
+                    break;
+                }
+                else if (m_current[0] == '\n')
+                {
+                    ++m_line;
+                }
+                ++m_current;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+
+bool
+JsonParser::parseValue(QVariant* value)
+{
+    if (m_current == m_end)
+    {
+        return setError("Unexpected end of file");
+    }
+
+    char c = *m_current;
+    if (c == '{')
+    {
+        return parseObject(value);
+    }
+    else if (c == '[')
+    {
+        return parseArray(value);
+    }
+    else if (c == '"')
+    {
+        QString s;
+        if (!parseString(&s))
+        {
+            return false;
+        }
+        *value = s;
+        return true;
+    }
+    else if (c == '-' || isDigit(c))
+    {
+        return parseNumber(value);
+    }
+    else
+    {
+        return parseKeyword(value);
+    }
+}
+
+
+bool
+JsonParser::parseObject(QVariant* value)
+{
+    if (++m_depth > MaxDepth)
+    {
+        return setError("Objects and arrays are nested too deeply");
+    }
+
+    ++m_current; // skip the opening brace
+
+    QVariantMap map;
+    if (!skipWhitespace())
+    {
+        return false;
+    }
+
+    if (m_current != m_end && *m_current == '}')
+    {
+        ++m_current;
+    }
+    else
+    {
+        for (;;)
+        {
+            if (m_current == m_end || *m_current != '"')
+            {
+                return setError("Expected string for object key");
+            }
+
+            QString key;
+            if (!parseString(&key) || !skipWhitespace())
+            {
+                return false;
+            }
+
+            if (m_current == m_end || *m_current != ':')
+            {
+                return setError("Expected ':' after object key");
+            }
+            ++m_current;
+
+            QVariant v;
+            if (!skipWhitespace() || !parseValue(&v) || !skipWhitespace())
+            {
+                return false;
+            }
+
+            if (!map.contains(key))
+            {
+                map.insert(key, v);
+            }
+
+            if (m_current != m_end && *m_current == ',')
+            {
+                ++m_current;
+                if (!skipWhitespace())
+                {
+                    return false;
+                }
+            }
+            else if (m_current != m_end && *m_current == '}')
+            {
+                ++m_current;
+                break;
+            }
+            else
+            {
+                return setError("Expected ',' or '}' in object");
+            }
+        }
+    }
+
+    --m_depth;
+    *value = map;
+
+    return true;
+}
+
+
+bool
+JsonParser::parseArray(QVariant* value)
+{
+    if (++m_depth > MaxDepth)
+    {
+        return setError("Objects and arrays are nested too deeply");
+    }
+
+    ++m_current; // skip the opening bracket
+
+    QVariantList list;
+    if (!skipWhitespace())
+    {
+        return false;
+    }
+
+    if (m_current != m_end && *m_current == ']')
+    {
+        ++m_current;
+    }
+    else
+    {
+        for (;;)
+        {
+            QVariant v;
+            if (!parseValue(&v) || !skipWhitespace())
+            {
+                return false;
+            }
+
+            list.append(v);
+
+            if (m_current != m_end && *m_current == ',')
+            {
+                ++m_current;
+                if (!skipWhitespace())
+                {
+                    return false;
+                }
+            }
+            else if (m_current != m_end && *m_current == ']')
+            {
+                ++m_current;
+                break;
+            }
+            else
+            {
+                return setError("Expected ',' or ']' in array");
+            }
+        }
+    }
+
+    --m_depth;
+    *value = list;
+
+    return true;
+}
+
+
+// Parse a string. The current character must be the opening quote.
+bool
+JsonParser::parseString(QString* s)
+{
+    ++m_current; // skip the opening quote
+
+    // Most strings have no escape sequences and can be converted directly
+    const char* start = m_current;
+    while (m_current != m_end && *m_current != '"' && *m_current != '\\')
+    {
+        if (*m_current == '\n')
+        {
+            ++m_line;
+        }
+        ++m_current;
+    }
+
+    if (m_current == m_end)
+    {
+        return setError("Unterminated string");
+    }
+
+    if (*m_current == '"')
+    {
+        *s = QString::fromUtf8(start, int(m_current - start));
+        ++m_current;
+        return true;
+    }
+
+    // Escape sequences are present; UTF-8 text is accumulated until a \u
+    // escape or the end of the string.
+    QString result;
+    QByteArray segment(start, int(m_current - start));
+    while (m_current != m_end)
+    {
+        char c = *m_current++;
+        if (c == '"')
+        {
+            result += QString::fromUtf8(segment.constData(), segment.size());
+            *s = result;
+            return true;
+        }
+        else if (c == '\\')
+        {
+            if (m_current == m_end)
+            {
+                break;
+            }
+
+            char escaped = *m_current++;
+            switch (escaped)
+            {
+            case 'b':
+                segment += '\b';
+                break;
+            case 'f':
+                segment += '\f';
+                break;
+            case 'n':
+                segment += '\n';
+                break;
+            case 'r':
+                segment += '\r';
+                break;
+            case 't':
+                segment += '\t';
+                break;
+            case 'u':
+                {
+                    if (m_end - m_current < 4)
+                    {
+                        return setError("Bad unicode escape sequence in string");
+                    }
+
+                    int code = 0;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        int digit = hexDigitValue(m_current[i]);
+                        if (digit < 0)
+                        {
+                            return setError("Bad unicode escape sequence in string");
+                        }
+                        code = code * 16 + digit;
+                    }
+                    m_current += 4;
+
+                    // Surrogate pairs are just two consecutive UTF-16 code units
+                    result += QString::fromUtf8(segment.constData(), segment.size());
+                    segment.clear();
+                    result += QChar(ushort(code));
+                }
+                break;
+            case '\n':
+                ++m_line;
+                segment += escaped;
+                break;
+            default:
+                // Includes \" \\ and \/
+                segment += escaped;
+                break;
+            }
+        }
+        else
+        {
+            if (c == '\n')
+            {
+                ++m_line;
+            }
+            segment += c;
+        }
+    }
+
+    return setError("Unterminated string");
+}
+
+
+bool
+JsonParser::parseNumber(QVariant* value)
+{
+    const char* start = m_current;
+
+    bool negative = false;
+    if (*m_current == '-')
+    {
+        negative = true;
+        ++m_current;
+    }
+
+    if (m_current == m_end || !isDigit(*m_current))
+    {
+        return setError("Bad number");
+    }
+
+    // Accumulate up to 19 significant digits in an integer mantissa; the decimal
+    // exponent is adjusted for any digits dropped or after the decimal point.
+    quint64 mantissa = 0;
+    int digitCount = 0;
+    int exponent = 0;
+    bool truncated = false;
+
+    while (m_current != m_end && isDigit(*m_current))
+    {
+        if (digitCount < MaxMantissaDigits)
+        {
+            mantissa = mantissa * 10 + (*m_current - '0');
+            if (mantissa != 0)
+            {
+                ++digitCount;
+            }
+        }
+        else
+        {
+            ++exponent;
+            truncated = true;
+        }
+        ++m_current;
+    }
+
+    bool isInteger = true;
+    if (m_current != m_end && *m_current == '.')
+    {
+        isInteger = false;
+        ++m_current;
+        while (m_current != m_end && isDigit(*m_current))
+        {
+            if (digitCount < MaxMantissaDigits)
+            {
+                mantissa = mantissa * 10 + (*m_current - '0');
+                if (mantissa != 0)
+                {
+                    ++digitCount;
+                }
+                --exponent;
+            }
+            else
+            {
+                truncated = true;
+            }
+            ++m_current;
+        }
+    }
+
+    if (m_current != m_end && (*m_current == 'e' || *m_current == 'E'))
+    {
+        isInteger = false;
+        ++m_current;
+
+        bool negativeExponent = false;
+        if (m_current != m_end && (*m_current == '+' || *m_current == '-'))
+        {
+            negativeExponent = *m_current == '-';
+            ++m_current;
+        }
+
+        if (m_current == m_end || !isDigit(*m_current))
+        {
+            return setError("Bad exponent in number");
+        }
+
+        int explicitExponent = 0;
+        while (m_current != m_end && isDigit(*m_current))
+        {
+            if (explicitExponent < 100000)
+            {
+                explicitExponent = explicitExponent * 10 + (*m_current - '0');
+            }
+            ++m_current;
+        }
+
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    if (isInteger)
+    {
+        if (truncated || (negative && mantissa > MaxNegativeMantissa))
+        {
+            // Too large for a 64-bit integer; handle it the same way as qjson
+            QByteArray digits(start, int(m_current - start));
+            if (negative)
+            {
+                *value = digits.toLongLong();
+            }
+            else
+            {
+                *value = digits.toULongLong();
+            }
+        }
+        else if (negative)
+        {
+            // Negate in two steps so that the most negative value doesn't overflow
+            *value = mantissa == 0 ? qlonglong(0) : -qlonglong(mantissa - 1) - 1;
+        }
+        else
+        {
+            *value = qulonglong(mantissa);
+        }
+    }
+    else if (!truncated && mantissa <= MaxExactMantissa && exponent >= -MaxExactPowerOfTen && exponent <= MaxExactPowerOfTen)
+    {
+        // Both the mantissa and the power of ten are exact, so a single multiply or divide
+        // gives the correctly rounded result.
+        double d = double(mantissa);
+        if (exponent < 0)
+        {
+            d /= ExactPowersOfTen[-exponent];
+        }
+        else
+        {
+            d *= ExactPowersOfTen[exponent];
+        }
+        *value = negative ? -d : d;
+    }
+    else
+    {
+        *value = QByteArray(start, int(m_current - start)).toDouble();
+    }
+
+    return true;
+}
+
+
+// Parse true, false, or null. Like qjson, case is ignored.
+bool
+JsonParser::parseKeyword(QVariant* value)
+{
+    static const char* keywords[] = { "true", "false", "null" };
+
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        const char* keyword = keywords[i];
+        int length = int(qstrlen(keyword));
+        if (m_end - m_current >= length && qstrnicmp(m_current, keyword, length) == 0)
+        {
+            m_current += length;
+            if (i == 0)
+            {
+                *value = true;
+            }
+            else if (i == 1)
+            {
+                *value = false;
+            }
+            else
+            {
+                *value = QVariant();
+            }
+            return true;
+        }
+    }
+
+    return setError(QString("Unexpected character '%1'").arg(QChar::fromLatin1(*m_current)));
+}
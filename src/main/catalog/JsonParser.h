@@ -0,0 +1,82 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _JSON_PARSER_H_
+#define _JSON_PARSER_H_
+
+#include <QVariant>
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+
+/** JsonParser converts JSON text to a tree of QVariants in a single pass
+  * over the text. C and C++ style comments (outside of strings) are treated
+  * as whitespace.
+  *
+  * The variant types match the ones produced by qjson: objects are
+  * QVariantMaps, arrays are QVariantLists, integers are LongLong (negative)
+  * or ULongLong, and other numbers are Doubles. As with qjson, the keywords
+  * true, false, and null are not case sensitive and unrecognized escape
+  * sequences in strings are replaced by the escaped character. If a key
+  * appears more than once in an object, the first value is used.
+  */
+class JsonParser
+{
+public:
+    JsonParser();
+
+    QVariant parse(const QByteArray& text, bool* ok);
+    QVariant parse(QIODevice* device, bool* ok);
+
+    /** Get the line number (starting at 1) where the last error occurred.
+      */
+    int errorLine() const
+    {
+        return m_errorLine;
+    }
+
+    /** Get a description of the last error.
+      */
+    QString errorString() const
+    {
+        return m_errorString;
+    }
+
+    // Maximum nesting depth of arrays and objects
+    static const int MaxDepth = 256;
+
+private:
+    bool parseValue(QVariant* value);
+    bool parseObject(QVariant* value);
+    bool parseArray(QVariant* value);
+    bool parseString(QString* s);
+    bool parseNumber(QVariant* value);
+    bool parseKeyword(QVariant* value);
+    bool skipWhitespace();
+    bool setError(const QString& message);
+
+private:
+    const char* m_current;
+    const char* m_end;
+    int m_line;
+    int m_depth;
+    int m_errorLine;
+    QString m_errorString;
+};
+
+#endif // _JSON_PARSER_H_
@@ -0,0 +1,370 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SampledDataPack.h"
+#include "CompiledCache.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+using namespace vesta;
+
+
+/* A sampled data pack is a compiled, binary version of a table of time-tagged
+ * samples (.xyzv, .xyz, or .q file.) Packs are written the first time a table
+ * is parsed, either next to the source file or in the cache directory, and
+ * are memory mapped and used in place afterwards.
+ *
+ * The file has the following format:
+ *
+ * Header (64 bytes)
+ *   8 bytes - header "COSMPACK"
+ *   4 bytes - uint32 - format version (1)
+ *   4 bytes - uint32 - table count
+ *   8 bytes - int64 - size of the source file in bytes
+ *   8 bytes - int64 - modification time of the source file (seconds since 1970-01-01 UTC)
+ *  32 bytes - reserved (zero)
+ *
+ * Table index (48 bytes per table)
+ *   4 bytes - uint32 - table type (SampledDataPackTable)
+ *   4 bytes - uint32 - flags
+ *   8 bytes - uint64 - record count
+ *   8 bytes - uint64 - file offset of the time array
+ *   8 bytes - uint64 - file offset of the value array
+ *   8 bytes - double - bounding radius (km; zero for orientation tables)
+ *   8 bytes - reserved (zero)
+ *
+ * Times are seconds since J2000.0 TDB. For state and position tables, the
+ * value array holds all positions (x y z per record) followed by all velocities;
+ * velocities of position tables are the estimates computed when the table was
+ * parsed. For orientation tables, the value array holds unit quaternions (w x y z
+ * per record.) Arrays start on 8-byte boundaries.
+ *
+ * Byte order is little endian (Intel x86). Packs are neither read nor written
+ * on big endian systems.
+ */
+
+static const char PackMagic[8] = { 'C', 'O', 'S', 'M', 'P', 'A', 'C', 'K' };
+static const quint32 PackVersion = 1;
+
+struct PackHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 tableCount;
+    qint64 sourceSize;
+    qint64 sourceModifiedTime;
+    char reserved[32];
+};
+
+struct PackTableEntry
+{
+    quint32 type;
+    quint32 flags;
+    quint64 recordCount;
+    quint64 timeOffset;
+    quint64 valueOffset;
+    double boundingRadius;
+    quint64 reserved;
+};
+
+
+// A memory mapped pack file. The mapping stays valid for as long as any
+// trajectory or rotation model refers to it.
+class MappedPackFile : public Object
+{
+public:
+    MappedPackFile(const QString& fileName) :
+        m_file(fileName),
+        m_data(NULL),
+        m_size(0)
+    {
+    }
+
+    ~MappedPackFile()
+    {
+        if (m_data)
+        {
+            m_file.unmap(m_data);
+        }
+    }
+
+    bool map()
+    {
+        if (!m_file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+
+        m_size = m_file.size();
+        m_data = m_file.map(0, m_size);
+
+        return m_data != NULL;
+    }
+
+    const uchar* data() const
+    {
+        return m_data;
+    }
+
+    qint64 size() const
+    {
+        return m_size;
+    }
+
+private:
+    QFile m_file;
+    uchar* m_data;
+    qint64 m_size;
+};
+
+
+static bool
+packsSupported()
+{
+    return QSysInfo::ByteOrder == QSysInfo::LittleEndian;
+}
+
+
+// Get the possible locations of the pack for a source file: next to the
+// source file first, then in the cache directory.
+static QStringList
+packFileNames(const QString& sourceFileName)
+{
+    return CompiledFileNames(sourceFileName, "packs", ".pack");
+}
+
+
+// Check that a pack is up to date with respect to its source and find the
+// requested table.
+static bool
+findPackTable(const MappedPackFile* pack,
+              const QFileInfo& sourceInfo,
+              quint32 tableType,
+              quint32 flags,
+              PackTableEntry* entry)
+{
+    if (pack->size() < qint64(sizeof(PackHeader)))
+    {
+        return false;
+    }
+
+    PackHeader header;
+    memcpy(&header, pack->data(), sizeof(header));
+    if (memcmp(header.magic, PackMagic, sizeof(PackMagic)) != 0 ||
+        header.version != PackVersion ||
+        !SourceUnchanged(sourceInfo, header.sourceSize, header.sourceModifiedTime))
+    {
+        return false;
+    }
+
+    quint64 fileSize = quint64(pack->size());
+    if (sizeof(PackHeader) + quint64(header.tableCount) * sizeof(PackTableEntry) > fileSize)
+    {
+        return false;
+    }
+
+    for (quint32 i = 0; i < header.tableCount; ++i)
+    {
+        memcpy(entry, pack->data() + sizeof(PackHeader) + i * sizeof(PackTableEntry), sizeof(PackTableEntry));
+        if (entry->type == tableType && entry->flags == flags)
+        {
+            quint64 valuesPerRecord = tableType == PackOrientationTable ? 4 : 6;
+            return entry->recordCount > 0 &&
+                   entry->recordCount < 0x80000000u &&
+                   entry->timeOffset % sizeof(double) == 0 &&
+                   entry->valueOffset % sizeof(double) == 0 &&
+                   entry->timeOffset + entry->recordCount * sizeof(double) <= fileSize &&
+                   entry->valueOffset + entry->recordCount * valuesPerRecord * sizeof(double) <= fileSize;
+        }
+    }
+
+    return false;
+}
+
+
+// Map the pack for a source file. Returns null if there's no valid, up to
+// date pack containing the requested table.
+static MappedPackFile*
+openPack(const QString& sourceFileName, quint32 tableType, quint32 flags, PackTableEntry* entry)
+{
+    if (!packsSupported())
+    {
+        return NULL;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+    if (!sourceInfo.exists())
+    {
+        return NULL;
+    }
+
+    foreach (QString packFileName, packFileNames(sourceFileName))
+    {
+        if (QFile::exists(packFileName))
+        {
+            MappedPackFile* pack = new MappedPackFile(packFileName);
+            if (pack->map() && findPackTable(pack, sourceInfo, tableType, flags, entry))
+            {
+                return pack;
+            }
+
+            delete pack;
+        }
+    }
+
+    return NULL;
+}
+
+
+// Write a pack containing a single table. The pack is written next to the source
+// file if possible, and otherwise to the cache directory.
+static bool
+writePack(const QString& sourceFileName,
+          quint32 tableType,
+          quint32 flags,
+          unsigned int recordCount,
+          const double* times,
+          const double* values,
+          unsigned int valuesPerRecord,
+          double boundingRadius)
+{
+    if (!packsSupported() || recordCount == 0)
+    {
+        return false;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PackMagic, sizeof(PackMagic));
+    header.version = PackVersion;
+    header.tableCount = 1;
+    header.sourceSize = sourceInfo.size();
+    header.sourceModifiedTime = SourceModifiedTime(sourceInfo);
+
+    PackTableEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.type = tableType;
+    entry.flags = flags;
+    entry.recordCount = recordCount;
+    entry.timeOffset = sizeof(PackHeader) + sizeof(PackTableEntry);
+    entry.valueOffset = entry.timeOffset + recordCount * sizeof(double);
+    entry.boundingRadius = boundingRadius;
+
+    qint64 timeBytes = qint64(recordCount) * sizeof(double);
+    qint64 valueBytes = qint64(recordCount) * valuesPerRecord * sizeof(double);
+
+    QByteArray data;
+    data.reserve(int(entry.valueOffset + valueBytes));
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    data.append(reinterpret_cast<const char*>(times), int(timeBytes));
+    data.append(reinterpret_cast<const char*>(values), int(valueBytes));
+
+    foreach (QString packFileName, packFileNames(sourceFileName))
+    {
+        if (WriteCacheFile(packFileName, data))
+        {
+            return true;
+        }
+    }
+
+    qDebug() << "Unable to write sampled data pack for " << sourceFileName;
+
+    return false;
+}
+
+
+/** Load a trajectory from the compiled pack of an .xyzv or .xyz file. The
+  * records are used in place from the memory mapped pack. Returns null if
+  * there is no pack or if the pack is out of date with respect to the
+  * source file.
+  */
+InterpolatedStateTrajectory*
+LoadTrajectoryPack(const QString& sourceFileName, SampledDataPackTable tableType)
+{
+    PackTableEntry entry;
+    MappedPackFile* pack = openPack(sourceFileName, tableType, 0, &entry);
+    if (!pack)
+    {
+        return NULL;
+    }
+
+    unsigned int recordCount = (unsigned int) entry.recordCount;
+    const double* times = reinterpret_cast<const double*>(pack->data() + entry.timeOffset);
+    const double* positions = reinterpret_cast<const double*>(pack->data() + entry.valueOffset);
+    const double* velocities = positions + recordCount * 3;
+
+    return new InterpolatedStateTrajectory(recordCount, times, positions, velocities, entry.boundingRadius, pack);
+}
+
+
+/** Load a rotation model from the compiled pack of a .q file. Returns null if
+  * there is no pack, if the pack is out of date with respect to the source file,
+  * or if the pack was written with different flags.
+  */
+InterpolatedRotation*
+LoadRotationPack(const QString& sourceFileName, unsigned int flags)
+{
+    PackTableEntry entry;
+    MappedPackFile* pack = openPack(sourceFileName, PackOrientationTable, flags, &entry);
+    if (!pack)
+    {
+        return NULL;
+    }
+
+    const double* times = reinterpret_cast<const double*>(pack->data() + entry.timeOffset);
+    const double* orientations = reinterpret_cast<const double*>(pack->data() + entry.valueOffset);
+
+    return new InterpolatedRotation((unsigned int) entry.recordCount, times, orientations, pack);
+}
+
+
+/** Write the compiled pack for a trajectory loaded from an .xyzv or .xyz file.
+  */
+bool
+WriteTrajectoryPack(const QString& sourceFileName, SampledDataPackTable tableType, const InterpolatedStateTrajectory* trajectory)
+{
+    // Positions and velocities are adjacent in the trajectory's storage, but
+    // don't rely on that.
+    unsigned int recordCount = trajectory->stateCount();
+    std::vector<double> values(recordCount * 6);
+    if (recordCount > 0)
+    {
+        std::copy(trajectory->positionArray(), trajectory->positionArray() + recordCount * 3, values.begin());
+        std::copy(trajectory->velocityArray(), trajectory->velocityArray() + recordCount * 3, values.begin() + recordCount * 3);
+    }
+
+    return writePack(sourceFileName, tableType, 0,
+                     recordCount, trajectory->timeArray(), recordCount > 0 ? &values[0] : NULL, 6,
+                     trajectory->boundingSphereRadius());
+}
+
+
+/** Write the compiled pack for a rotation model loaded from a .q file.
+  */
+bool
+WriteRotationPack(const QString& sourceFileName, unsigned int flags, const InterpolatedRotation* rotation)
+{
+    return writePack(sourceFileName, PackOrientationTable, flags,
+                     rotation->recordCount(), rotation->timeArray(), rotation->orientationArray(), 4,
+                     0.0);
+}
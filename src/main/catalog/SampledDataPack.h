@@ -0,0 +1,44 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SAMPLED_DATA_PACK_H_
+#define _SAMPLED_DATA_PACK_H_
+
+#include "../InterpolatedStateTrajectory.h"
+#include "../InterpolatedRotation.h"
+#include <QString>
+
+/** Types of tables stored in sampled data packs */
+enum SampledDataPackTable
+{
+    PackStateTable       = 1,   // time/state records (.xyzv)
+    PackPositionTable    = 2,   // time/position records with estimated velocities (.xyz)
+    PackOrientationTable = 3,   // time/quaternion records (.q)
+};
+
+/** Flags for orientation tables */
+enum
+{
+    PackCelestiaConvention = 1  // Celestia's coordinate conventions were applied to the quaternions
+};
+
+InterpolatedStateTrajectory* LoadTrajectoryPack(const QString& sourceFileName, SampledDataPackTable tableType);
+InterpolatedRotation* LoadRotationPack(const QString& sourceFileName, unsigned int flags);
+
+bool WriteTrajectoryPack(const QString& sourceFileName, SampledDataPackTable tableType, const InterpolatedStateTrajectory* trajectory);
+bool WriteRotationPack(const QString& sourceFileName, unsigned int flags, const InterpolatedRotation* rotation);
+
+#endif // _SAMPLED_DATA_PACK_H_
@@ -0,0 +1,418 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "StarCatalogLoader.h"
+#include "CompiledCache.h"
+#include <vesta/Units.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QSysInfo>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+using namespace vesta;
+
+
+/* Star catalogs are read from files in one of two formats:
+ *
+ * The original star file format is a list of big endian records:
+ *   uint32 - identifier (Tycho or Hipparcos number)
+ *   float  - right ascension (degrees)
+ *   float  - declination (degrees)
+ *   float  - apparent V magnitude
+ *   float  - B-V color index
+ *
+ * An indexed star catalog contains the arrays of a StarCatalog after
+ * buildCatalogIndex() has been called, so that it can be memory mapped and
+ * used in place. Indexed catalogs are written the first time that a star
+ * file in the original format is loaded, either next to the source file or
+ * in the cache directory. An indexed catalog may also be loaded directly.
+ *
+ * Header (64 bytes)
+ *   8 bytes - header "COSMSTAR"
+ *   4 bytes - uint32 - format version (1)
+ *   4 bytes - uint32 - sky cell grid size (StarCatalog::CellGridSize)
+ *   8 bytes - uint64 - star count
+ *   8 bytes - int64 - size of the source file in bytes (zero if none)
+ *   8 bytes - int64 - modification time of the source file (seconds since 1970-01-01 UTC)
+ *  24 bytes - reserved (zero)
+ *
+ * Star records (20 bytes per star; StarCatalog::StarRecord, angles in radians)
+ * Sky cell starts (uint32, StarCatalog::CellCount + 1 entries)
+ * Identifier index (uint32, one per star)
+ *
+ * Byte order is little endian (Intel x86). Indexed catalogs are neither read
+ * nor written on big endian systems.
+ */
+
+static const char StarFileMagic[8] = { 'C', 'O', 'S', 'M', 'S', 'T', 'A', 'R' };
+static const quint32 StarFileVersion = 1;
+
+struct StarFileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 cellGridSize;
+    quint64 starCount;
+    qint64 sourceSize;
+    qint64 sourceModifiedTime;
+    char reserved[24];
+};
+
+// Size of a record in the original star file format
+static const unsigned int StarRecordSize = 20;
+
+
+// A memory mapped indexed star catalog. The mapping stays valid for as long as
+// the star catalog refers to it.
+class MappedStarFile : public Object
+{
+public:
+    MappedStarFile(const QString& fileName) :
+        m_file(fileName),
+        m_data(NULL),
+        m_size(0)
+    {
+    }
+
+    ~MappedStarFile()
+    {
+        if (m_data)
+        {
+            m_file.unmap(m_data);
+        }
+    }
+
+    bool map()
+    {
+        if (!m_file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+
+        m_size = m_file.size();
+        m_data = m_size > 0 ? m_file.map(0, m_size) : NULL;
+
+        return m_data != NULL;
+    }
+
+    const uchar* data() const
+    {
+        return m_data;
+    }
+
+    qint64 size() const
+    {
+        return m_size;
+    }
+
+    QString fileName() const
+    {
+        return m_file.fileName();
+    }
+
+private:
+    QFile m_file;
+    uchar* m_data;
+    qint64 m_size;
+};
+
+
+static bool
+indexedCatalogsSupported()
+{
+    return QSysInfo::ByteOrder == QSysInfo::LittleEndian && sizeof(StarCatalog::StarRecord) == StarRecordSize;
+}
+
+
+static qint64
+indexedCatalogSize(quint64 starCount)
+{
+    return sizeof(StarFileHeader) +
+           starCount * sizeof(StarCatalog::StarRecord) +
+           (StarCatalog::CellCount + 1) * sizeof(v_uint32) +
+           starCount * sizeof(v_uint32);
+}
+
+
+// Get the possible locations of the indexed version of a star file: next to
+// the star file first, then in the cache directory.
+static QStringList
+indexedCatalogFileNames(const QString& sourceFileName)
+{
+    return CompiledFileNames(sourceFileName, "stars", ".idx");
+}
+
+
+// Check that the sky cell starts and identifier index of an indexed catalog are
+// consistent with the star count, so that a damaged file can't send lookups
+// outside the star array.
+static bool
+validCatalogIndex(unsigned int starCount, const v_uint32* cellStarts, const v_uint32* identifierIndex)
+{
+    v_uint32 previousStart = 0;
+    for (unsigned int i = 0; i <= StarCatalog::CellCount; ++i)
+    {
+        if (cellStarts[i] < previousStart || cellStarts[i] > starCount)
+        {
+            return false;
+        }
+        previousStart = cellStarts[i];
+    }
+
+    if (cellStarts[StarCatalog::CellCount] != starCount)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < starCount; ++i)
+    {
+        if (identifierIndex[i] >= starCount)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Create a star catalog that refers to the arrays in a mapped indexed catalog file.
+// If sourceInfo is not null, the catalog is only created if it's up to date with
+// respect to the source file. Null is returned if the file is invalid, in which
+// case the caller rebuilds the catalog from the source file.
+static StarCatalog*
+mapIndexedCatalog(MappedStarFile* file, const QFileInfo* sourceInfo)
+{
+    if (!indexedCatalogsSupported() || file->size() < qint64(sizeof(StarFileHeader)))
+    {
+        return NULL;
+    }
+
+    StarFileHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, StarFileMagic, sizeof(StarFileMagic)) != 0 ||
+        header.version != StarFileVersion ||
+        header.cellGridSize != StarCatalog::CellGridSize ||
+        header.starCount > 0xffffffffu ||
+        indexedCatalogSize(header.starCount) != file->size())
+    {
+        return NULL;
+    }
+
+    if (sourceInfo && !SourceUnchanged(*sourceInfo, header.sourceSize, header.sourceModifiedTime))
+    {
+        return NULL;
+    }
+
+    unsigned int starCount = (unsigned int) header.starCount;
+    const uchar* stars = file->data() + sizeof(StarFileHeader);
+    const uchar* cellStarts = stars + starCount * sizeof(StarCatalog::StarRecord);
+    const uchar* identifierIndex = cellStarts + (StarCatalog::CellCount + 1) * sizeof(v_uint32);
+
+    if (!validCatalogIndex(starCount,
+                           reinterpret_cast<const v_uint32*>(cellStarts),
+                           reinterpret_cast<const v_uint32*>(identifierIndex)))
+    {
+        qDebug() << "Ignoring damaged indexed star catalog " << file->fileName();
+        return NULL;
+    }
+
+    return new StarCatalog(starCount,
+                           reinterpret_cast<const StarCatalog::StarRecord*>(stars),
+                           reinterpret_cast<const v_uint32*>(cellStarts),
+                           reinterpret_cast<const v_uint32*>(identifierIndex),
+                           file);
+}
+
+
+// Return true if a file starts with the indexed star catalog header
+static bool
+isIndexedCatalogFile(const QString& fileName)
+{
+    QFile file(fileName);
+    char magic[sizeof(StarFileMagic)];
+    return file.open(QIODevice::ReadOnly) &&
+           file.read(magic, sizeof(magic)) == qint64(sizeof(magic)) &&
+           memcmp(magic, StarFileMagic, sizeof(magic)) == 0;
+}
+
+
+static StarCatalog*
+loadIndexedCatalog(const QString& fileName, const QFileInfo* sourceInfo)
+{
+    counted_ptr<MappedStarFile> file(new MappedStarFile(fileName));
+    if (!file->map())
+    {
+        return NULL;
+    }
+
+    return mapIndexedCatalog(file.ptr(), sourceInfo);
+}
+
+
+/** Write an indexed star catalog file.
+  *
+  * \param sourceSize size of the file that the catalog was read from (zero if none)
+  * \param sourceModifiedTime modification time of the source file (seconds since 1970-01-01 UTC)
+  */
+bool
+WriteIndexedStarCatalog(const QString& fileName, const StarCatalog* catalog, qint64 sourceSize, qint64 sourceModifiedTime)
+{
+    if (!indexedCatalogsSupported())
+    {
+        return false;
+    }
+
+    StarFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, StarFileMagic, sizeof(StarFileMagic));
+    header.version = StarFileVersion;
+    header.cellGridSize = StarCatalog::CellGridSize;
+    header.starCount = catalog->size();
+    header.sourceSize = sourceSize;
+    header.sourceModifiedTime = sourceModifiedTime;
+
+    qint64 starBytes = qint64(catalog->size()) * sizeof(StarCatalog::StarRecord);
+    qint64 cellBytes = (StarCatalog::CellCount + 1) * sizeof(v_uint32);
+    qint64 identifierBytes = qint64(catalog->size()) * sizeof(v_uint32);
+
+    QByteArray data;
+    data.reserve(int(indexedCatalogSize(catalog->size())));
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(catalog->starArray()), int(starBytes));
+    data.append(reinterpret_cast<const char*>(catalog->cellStartArray()), int(cellBytes));
+    data.append(reinterpret_cast<const char*>(catalog->identifierIndexArray()), int(identifierBytes));
+
+    return WriteCacheFile(fileName, data);
+}
+
+
+// Read a star file in the original (big endian) format
+static StarCatalog*
+loadStarFile(const QString& fileName)
+{
+    QFile starFile(fileName);
+    if (!starFile.open(QFile::ReadOnly))
+    {
+        return NULL;
+    }
+
+    qint64 size = starFile.size();
+    const uchar* data = size > 0 ? starFile.map(0, size) : NULL;
+    if (!data)
+    {
+        return NULL;
+    }
+
+    StarCatalog* stars = new StarCatalog();
+
+    unsigned int recordCount = (unsigned int) (size / StarRecordSize);
+    for (unsigned int i = 0; i < recordCount; ++i)
+    {
+        const uchar* record = data + qint64(i) * StarRecordSize;
+
+        quint32 id = qFromBigEndian<quint32>(record);
+        float values[4];
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            quint32 bits = qFromBigEndian<quint32>(record + 4 + j * 4);
+            memcpy(&values[j], &bits, sizeof(bits));
+        }
+
+        float ra = values[0];
+        float dec = values[1];
+        float vmag = values[2];
+        float bv = values[3];
+
+        // Constrain maximum B-V color index; conversion to RGB color is not
+        // valid for large values. TODO: Fix this in VESTA
+        if (bv > 2.5f)
+        {
+            bv = 2.5f;
+        }
+
+        stars->addStar(id, (float) toRadians(ra), (float) toRadians(dec), vmag, bv);
+    }
+
+    starFile.unmap(const_cast<uchar*>(data));
+
+    stars->buildCatalogIndex();
+
+    return stars;
+}
+
+
+/** Load a star catalog. The file may be either an indexed star catalog or a star
+  * file in the original format. An indexed version of the latter is saved, and
+  * it's used instead of the star file until the star file is modified.
+  *
+  * \return the catalog, or null if the file couldn't be read
+  */
+StarCatalog*
+LoadStarCatalog(const QString& fileName)
+{
+    StarCatalog* stars = loadIndexedCatalog(fileName, NULL);
+    if (stars)
+    {
+        return stars;
+    }
+    else if (isIndexedCatalogFile(fileName))
+    {
+        // An invalid indexed catalog loaded directly has no source to rebuild from
+        return NULL;
+    }
+
+    QFileInfo sourceInfo(fileName);
+    if (!sourceInfo.exists())
+    {
+        return NULL;
+    }
+
+    QStringList indexedFileNames = indexedCatalogFileNames(fileName);
+    if (indexedCatalogsSupported())
+    {
+        foreach (QString indexedFileName, indexedFileNames)
+        {
+            stars = loadIndexedCatalog(indexedFileName, &sourceInfo);
+            if (stars)
+            {
+                return stars;
+            }
+        }
+    }
+
+    stars = loadStarFile(fileName);
+    if (stars && indexedCatalogsSupported())
+    {
+        bool written = false;
+        foreach (QString indexedFileName, indexedFileNames)
+        {
+            if (!written)
+            {
+                written = WriteIndexedStarCatalog(indexedFileName, stars, sourceInfo.size(), SourceModifiedTime(sourceInfo));
+            }
+        }
+
+        if (!written)
+        {
+            qDebug() << "Unable to write indexed star catalog for " << fileName;
+        }
+    }
+
+    return stars;
+}
@@ -0,0 +1,26 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _STAR_CATALOG_LOADER_H_
+#define _STAR_CATALOG_LOADER_H_
+
+#include <vesta/StarCatalog.h>
+#include <QString>
+
+vesta::StarCatalog* LoadStarCatalog(const QString& fileName);
+bool WriteIndexedStarCatalog(const QString& fileName, const vesta::StarCatalog* catalog, qint64 sourceSize, qint64 sourceModifiedTime);
+
+#endif // _STAR_CATALOG_LOADER_H_
@@ -39,6 +39,86 @@ bool UniverseCatalog::contains(const QString& name) const
 }
 
 
+// Characters that separate the words of a body name
+static bool
+isWordSeparator(QChar c)
+{
+    return c.isSpace() || c == '/' || c == '(' || c == ')' || c == '-' || c == '_' || c == ',';
+}
+
+
+static QString
+nameIndexKey(const QString& foldedText, const QString& name)
+{
+    return foldedText + QChar(0) + name;
+}
+
+
+// Get the positions of the starts of all words in a name except the first
+static QList<int>
+wordStarts(const QString& name)
+{
+    QList<int> starts;
+    for (int i = 1; i < name.length(); ++i)
+    {
+        if (isWordSeparator(name.at(i - 1)) && !isWordSeparator(name.at(i)))
+        {
+            starts << i;
+        }
+    }
+
+    return starts;
+}
+
+
+void
+UniverseCatalog::addToNameIndex(const QString& name)
+{
+    QString folded = name.toCaseFolded();
+    m_nameIndex.insert(nameIndexKey(folded, name), name);
+    foreach (int start, wordStarts(name))
+    {
+        m_wordIndex.insert(nameIndexKey(folded.mid(start), name), name);
+    }
+}
+
+
+void
+UniverseCatalog::removeFromNameIndex(const QString& name)
+{
+    QString folded = name.toCaseFolded();
+    m_nameIndex.remove(nameIndexKey(folded, name));
+    foreach (int start, wordStarts(name))
+    {
+        m_wordIndex.remove(nameIndexKey(folded.mid(start), name));
+    }
+}
+
+
+// Append the names in an index with keys that start with a prefix (which must
+// be case folded.) No more than maxNames names are appended if maxNames is
+// non-negative. Names already in the list are skipped when skipDuplicates is
+// true; this is only required for the word index, where a name may appear more
+// than once.
+static void
+appendIndexMatches(const QMap<QString, QString>& index,
+                   const QString& foldedPrefix,
+                   int maxNames,
+                   bool skipDuplicates,
+                   QStringList* names)
+{
+    for (QMap<QString, QString>::const_iterator iter = index.lowerBound(foldedPrefix);
+         iter != index.end() && iter.key().startsWith(foldedPrefix) && (maxNames < 0 || names->size() < maxNames);
+         ++iter)
+    {
+        if (!skipDuplicates || !names->contains(iter.value()))
+        {
+            *names << iter.value();
+        }
+    }
+}
+
+
 /** Lookup the VESTA body with the specified name.
   */
 Entity* UniverseCatalog::find(const QString& name, Qt::CaseSensitivity caseSensitivity) const
@@ -51,13 +131,12 @@ Entity* UniverseCatalog::find(const QString& name, Qt::CaseSensitivity caseSensi
     }
     else
     {
-        foreach (QString s, m_bodies.keys())
+        // Names that differ only in case are adjacent in the index
+        QString key = nameIndexKey(name.toCaseFolded(), QString());
+        QMap<QString, QString>::const_iterator iter = m_nameIndex.lowerBound(key);
+        if (iter != m_nameIndex.end() && iter.key().startsWith(key))
         {
-            if (name.compare(s, Qt::CaseInsensitive) == 0)
-            {
-                body = m_bodies.value(s).ptr();
-                break;
-            }
+            body = m_bodies.value(iter.value()).ptr();
         }
     }
 
@@ -88,13 +167,20 @@ BodyInfo* UniverseCatalog::findInfo(const Entity* body) const
 
 void UniverseCatalog::removeBody(const QString& name)
 {
-    m_bodies.remove(name);
+    if (m_bodies.remove(name) > 0)
+    {
+        removeFromNameIndex(name);
+    }
     m_info.remove(name);
 }
 
 
 void UniverseCatalog::addBody(const QString& name, vesta::Entity* body, BodyInfo* info)
 {
+    if (!m_bodies.contains(name))
+    {
+        addToNameIndex(name);
+    }
     m_bodies[name] = counted_ptr<Entity>(body);
     m_info[name] = info;
 }
@@ -121,11 +207,23 @@ QStringList UniverseCatalog::names() const
 
 
 /** Return a list of the names of all objects in the catalog that match the specified
-  * regular expression.
+  * regular expression (ignoring case.) Patterns of the form 'prefix.*' are handled
+  * with a search of the name index rather than by matching every name.
   */
 QStringList
 UniverseCatalog::matchingNames(const QString& pattern) const
 {
+    if (pattern.endsWith(".*"))
+    {
+        QString prefix = pattern.left(pattern.length() - 2);
+        if (QRegExp::escape(prefix) == prefix)
+        {
+            QStringList matches = namesWithPrefix(prefix);
+            matches.sort();
+            return matches;
+        }
+    }
+
     QRegExp regex(pattern, Qt::CaseInsensitive);
 
     QStringList matches;
@@ -141,6 +239,44 @@ UniverseCatalog::matchingNames(const QString& pattern) const
 }
 
 
+/** Return the names of objects that start with the specified prefix (ignoring case),
+  * sorted alphabetically without regard to case.
+  *
+  * \param maxNames the maximum number of names to return; all matches are returned
+  *                 if maxNames is negative
+  */
+QStringList
+UniverseCatalog::namesWithPrefix(const QString& prefix, int maxNames) const
+{
+    QStringList names;
+    appendIndexMatches(m_nameIndex, prefix.toCaseFolded(), maxNames, false, &names);
+
+    return names;
+}
+
+
+/** Return a ranked list of names to complete a partial name typed by the user.
+  * Names that start with the partial name come first, followed by names containing
+  * a word that starts with it (e.g. 'hal' matches '1P/Halley'.) Case is ignored, and
+  * names in each group are sorted alphabetically.
+  */
+QStringList
+UniverseCatalog::completions(const QString& partialName, int maxNames) const
+{
+    QStringList names;
+    if (maxNames <= 0)
+    {
+        return names;
+    }
+
+    QString foldedPrefix = partialName.toCaseFolded();
+    appendIndexMatches(m_nameIndex, foldedPrefix, maxNames, false, &names);
+    appendIndexMatches(m_wordIndex, foldedPrefix, maxNames, true, &names);
+
+    return names;
+}
+
+
 /** Look up the viewpoint with the specified name.
   */
 Viewpoint*
@@ -42,6 +42,8 @@ public:
 
     QStringList names() const;
     QStringList matchingNames(const QString& pattern) const;
+    QStringList namesWithPrefix(const QString& prefix, int maxNames = -1) const;
+    QStringList completions(const QString& partialName, int maxNames) const;
 
     Viewpoint* findViewpoint(const QString& name);
     void addViewpoint(const QString& name, Viewpoint* viewpoint);
@@ -50,8 +52,21 @@ public:
 
     QString getDescription(vesta::Entity* body);
 
+private:
+    void addToNameIndex(const QString& name);
+    void removeFromNameIndex(const QString& name);
+
 private:
     QMap<QString, vesta::counted_ptr<vesta::Entity> > m_bodies;
+
+    // Case folded body names and the case folded words within the names
+    // (e.g. 'halley' for '1P/Halley'), used for case insensitive lookups
+    // and prefix searches. The keys are the folded text, a null character,
+    // and the body name, so they're unique and sorted by folded text; the
+    // values are body names.
+    QMap<QString, QString> m_nameIndex;
+    QMap<QString, QString> m_wordIndex;
+
     QMap<QString, vesta::counted_ptr<BodyInfo> > m_info;
     QMap<QString, vesta::counted_ptr<Viewpoint> > m_viewpoints;
 };
@@ -16,8 +16,12 @@
 
 #include "UniverseLoader.h"
 #include "AstorbLoader.h"
+#include "CatalogFileReader.h"
 #include "ChebyshevPolyFileLoader.h"
+#include "CompiledMesh.h"
+#include "SampledDataPack.h"
 #include "../TleTrajectory.h"
+#include "../TleSwarm.h"
 #include "../InterpolatedStateTrajectory.h"
 #include "../InterpolatedRotation.h"
 #include "../LinearCombinationTrajectory.h"
@@ -30,8 +34,6 @@
 #include "../geometry/FeatureLabelSetGeometry.h"
 #include "../compatibility/Scanner.h"
 #include "../compatibility/CmodLoader.h"
-#include "../compatibility/CatalogParser.h"
-#include "../compatibility/TransformCatalog.h"
 #include "../compatibility/CelBodyFixedFrame.h"
 #include "../vext/SimpleRotationModel.h"
 #include "../vext/StripParticleGenerator.h"
@@ -71,6 +73,10 @@
 #ifdef SPICE_ENABLED
 #include "../spice/SpiceTrajectory.h"
 #include "../spice/SpiceRotationModel.h"
+#include "../spice/NativeSpiceTrajectory.h"
+#include "../spice/NativeSpiceRotationModel.h"
+#include "../spice/SpiceKernelIndex.h"
+#include "../spice/SpiceMutex.h"
 #endif
 
 #include <vesta/particlesys/ParticleEmitter.h>
@@ -78,14 +84,16 @@
 #include <vesta/particlesys/BoxGenerator.h>
 #include <vesta/particlesys/DiscGenerator.h>
 
-#include <qjson/parser.h>
 #include <qjson/serializer.h>
 
 #include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
+#include <QElapsedTimer>
 #include <QRegExp>
 #include <QBuffer>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QDebug>
 
 using namespace vesta;
@@ -1060,19 +1068,42 @@ UniverseLoader::loadInterpolatedStatesTrajectory(const QVariantMap& info)
         QString name = info.value("source").toString();
 
         QString fileName = dataFileName(name);
+        SampledDataPackTable tableType;
         if (name.toLower().endsWith(".xyzv"))
         {
-            return LoadXYZVTrajectory(fileName);
+            tableType = PackStateTable;
         }
         else if (name.toLower().endsWith(".xyz"))
         {
-            return LoadXYZTrajectory(fileName);
+            tableType = PackPositionTable;
         }
         else
         {
             errorMessage("Unknown sampled trajectory format.");
             return NULL;
         }
+
+        // Use the compiled version of the file if there's an up to date one;
+        // otherwise, parse the file and compile it for next time.
+        InterpolatedStateTrajectory* trajectory = LoadTrajectoryPack(fileName, tableType);
+        if (!trajectory)
+        {
+            if (tableType == PackStateTable)
+            {
+                trajectory = LoadXYZVTrajectory(fileName);
+            }
+            else
+            {
+                trajectory = LoadXYZTrajectory(fileName);
+            }
+
+            if (trajectory)
+            {
+                WriteTrajectoryPack(fileName, tableType, trajectory);
+            }
+        }
+
+        return trajectory;
     }
     else
     {
@@ -1359,6 +1390,7 @@ bool getNAIFCode(const QVariant& v, SpiceInt* code)
     }
     else if (v.canConvert(QVariant::String))
     {
+        QMutexLocker locker(cspiceMutex());
         SpiceBoolean found = SPICEFALSE;
         bodn2c_c(v.toString().toLatin1().data(), code, &found);
         return found == SPICETRUE;
@@ -1414,6 +1446,14 @@ UniverseLoader::loadSpiceTrajectory(const QVariantMap& map)
         return NULL;
     }
 
+    // Prefer native evaluation of the SPK data, which doesn't need to serialize
+    // on the CSPICE lock.
+    NativeSpiceTrajectory* nativeTrajectory = NativeSpiceTrajectory::Create(m_spiceKernelIndex.ptr(), targetID, centerID, spiceFrame.toLatin1().data());
+    if (nativeTrajectory)
+    {
+        return nativeTrajectory;
+    }
+
     SpiceTrajectory* trajectory = new SpiceTrajectory(targetID, centerID, spiceFrame.toLatin1().data());
 
     return trajectory;
@@ -1605,6 +1645,12 @@ UniverseLoader::loadSpiceRotationModel(const QVariantMap &map)
         toFrame = toFrameVar.toString();
     }
 
+    NativeSpiceRotationModel* nativeRotationModel = NativeSpiceRotationModel::Create(m_spiceKernelIndex.ptr(), fromFrame.toLatin1().data(), toFrame.toLatin1().data());
+    if (nativeRotationModel)
+    {
+        return nativeRotationModel;
+    }
+
     SpiceRotationModel* rotationModel = new SpiceRotationModel(fromFrame.toLatin1().data(), toFrame.toLatin1().data());
 
     return rotationModel;
@@ -1677,7 +1723,18 @@ UniverseLoader::loadInterpolatedRotationModel(const QVariantMap& info)
         QString fileName = dataFileName(name);
         if (name.toLower().endsWith(".q"))
         {
-            return LoadInterpolatedRotation(fileName, rotationConvention);
+            unsigned int packFlags = rotationConvention == Celestia_Rotation ? PackCelestiaConvention : 0;
+            InterpolatedRotation* rotation = LoadRotationPack(fileName, packFlags);
+            if (!rotation)
+            {
+                rotation = LoadInterpolatedRotation(fileName, rotationConvention);
+                if (rotation)
+                {
+                    WriteRotationPack(fileName, packFlags, rotation);
+                }
+            }
+
+            return rotation;
         }
         else
         {
@@ -2430,6 +2487,66 @@ loadTiledMap(const QVariantMap& map, PathRelativeTextureLoader* textureLoader)
 }
 
 
+// Task to weld vertices and reorder triangles for a single submesh. The submesh
+// optimizations don't touch any other part of the mesh, so submeshes can be
+// processed in parallel.
+class SubmeshOptimizeTask : public QRunnable
+{
+public:
+    SubmeshOptimizeTask(Submesh* submesh) :
+        m_submesh(submesh)
+    {
+    }
+
+    void run()
+    {
+        if (m_submesh->uniquifyVertices())
+        {
+            m_submesh->optimizeVertexCache();
+        }
+    }
+
+private:
+    Submesh* m_submesh;
+};
+
+
+// Optimize a freshly loaded mesh for rendering. The steps are done in the order
+// recommended by MeshGeometry.
+static void
+OptimizeMesh(MeshGeometry* meshGeometry, const QString& fileName)
+{
+#ifdef DEBUG
+    float acmrBefore = meshGeometry->averageCacheMissRatio();
+#endif
+
+    // Merging materials first lets the per-submesh steps treat triangles that
+    // share a material as a single list.
+    meshGeometry->mergeSubmeshes();
+    meshGeometry->mergeMaterials();
+
+    if (meshGeometry->submeshCount() == 1)
+    {
+        SubmeshOptimizeTask(meshGeometry->submesh(0)).run();
+    }
+    else
+    {
+        QThreadPool threadPool;
+        for (unsigned int i = 0; i < meshGeometry->submeshCount(); ++i)
+        {
+            threadPool.start(new SubmeshOptimizeTask(meshGeometry->submesh(i)));
+        }
+        threadPool.waitForDone();
+    }
+
+    meshGeometry->compressIndices();
+
+#ifdef DEBUG
+    qDebug() << "Optimized mesh" << fileName << "ACMR" << acmrBefore << "->" << meshGeometry->averageCacheMissRatio();
+#endif
+}
+
+
 Geometry*
 UniverseLoader::loadMeshFile(const QString& fileName)
 {
@@ -2451,8 +2568,15 @@ UniverseLoader::loadMeshFile(const QString& fileName)
             m_textureLoader->setSearchPath(info.absolutePath().toUtf8().data());
         }
 
-        MeshGeometry* meshGeometry = NULL;
-        if (fileName.toLower().endsWith(".cmod"))
+        // Use the compiled version of the mesh if it's up to date; it has already been optimized.
+        QString textureSearchPath = QString::fromUtf8(m_textureLoader->searchPath().c_str());
+        MeshGeometry* meshGeometry = LoadCompiledMesh(fileName, textureSearchPath, m_textureLoader.ptr());
+        if (meshGeometry)
+        {
+            m_geometryCache.insert(fileName, vesta::counted_ptr<Geometry>(meshGeometry));
+            geometry = meshGeometry;
+        }
+        else if (fileName.toLower().endsWith(".cmod"))
         {
             QFile cmodFile(fileName);
             if (!cmodFile.open(QIODevice::ReadOnly))
@@ -2474,15 +2598,14 @@ UniverseLoader::loadMeshFile(const QString& fileName)
             meshGeometry = MeshGeometry::loadFromFile(fileName.toUtf8().data(), m_textureLoader.ptr());
         }
 
-        if (meshGeometry)
+        if (meshGeometry && !geometry)
         {
             // Optimize the mesh. The optimizations can be expensive for large meshes, but they can dramatically
             // improve rendering performance. The best solution is to use mesh files that are already optimized, but
-            // the average model loaded off the web benefits from some preprocessing at load time.
-            meshGeometry->mergeSubmeshes();
-            meshGeometry->uniquifyVertices();
-            meshGeometry->mergeMaterials();
-            meshGeometry->compressIndices();
+            // the average model loaded off the web benefits from some preprocessing at load time. The optimized
+            // mesh is saved so that the work is only done the first time that the mesh is loaded.
+            OptimizeMesh(meshGeometry, fileName);
+            WriteCompiledMesh(fileName, textureSearchPath, meshGeometry);
             m_geometryCache.insert(fileName, vesta::counted_ptr<Geometry>(meshGeometry));
             geometry = meshGeometry;
         }
@@ -2968,6 +3091,67 @@ UniverseLoader::loadSwarmGeometry(const QVariantMap& map)
 }
 
 
+/** Load a catalog of two-line element sets as a swarm of points. The
+  * source file is in the usual text format: an optional name line
+  * followed by the two element lines for each object.
+  */
+Geometry*
+UniverseLoader::loadTleSwarmGeometry(const QVariantMap& map)
+{
+    QVariant sourceVar = map.value("source");
+    if (!sourceVar.isValid())
+    {
+        errorMessage("Missing source for TLE swarm geometry");
+        return NULL;
+    }
+
+    QString fileName = dataFileName(sourceVar.toString());
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        errorMessage(QString("Unable to open TLE file %1").arg(fileName));
+        return NULL;
+    }
+
+    TleSwarm* swarm = new TleSwarm();
+
+    QByteArray line1;
+    int badCount = 0;
+    while (!file.atEnd())
+    {
+        QByteArray line = file.readLine().trimmed();
+        if (line.startsWith("1 "))
+        {
+            line1 = line;
+        }
+        else if (line.startsWith("2 ") && !line1.isEmpty())
+        {
+            counted_ptr<TleTrajectory> tle(TleTrajectory::Create(line1.data(), line.data()));
+            if (tle.isValid())
+            {
+                swarm->addObject(tle.ptr());
+            }
+            else
+            {
+                ++badCount;
+            }
+            line1.clear();
+        }
+    }
+
+    if (badCount > 0)
+    {
+        errorMessage(QString("Skipped %1 invalid TLE sets in %2").arg(badCount).arg(fileName));
+    }
+
+    swarm->setColor(colorValue(map.value("color"), Spectrum::White()));
+    swarm->setOpacity(float(doubleValue(map.value("opacity"), 1.0)));
+    swarm->setPointSize(float(doubleValue(map.value("pointSize"), 1.0)));
+
+    return swarm;
+}
+
+
 static InitialStateGenerator*
 loadStripParticleGenerator(const QVariantMap& map)
 {
@@ -3445,6 +3629,10 @@ UniverseLoader::loadGeometry(const QVariantMap& map, const UniverseCatalog* cata
     {
         geometry = loadSwarmGeometry(map);
     }
+    else if (type == "TleSwarm")
+    {
+        geometry = loadTleSwarmGeometry(map);
+    }
     else if (type == "ParticleSystem")
     {
         geometry = loadParticleSystemGeometry(map);
@@ -4038,16 +4226,33 @@ CatalogContents*
 UniverseLoader::loadCatalogFile(const QString& fileName,
                                 UniverseCatalog* catalog)
 {
+    // Read and parse the whole require tree in parallel (or take it from the
+    // snapshot saved the last time that the catalog was loaded), then create
+    // the catalog objects in order.
+    QElapsedTimer timer;
+    timer.start();
+    m_catalogReader.readRequireTree(QFileInfo(dataFileName(fileName)).canonicalFilePath());
+    qint64 parseTime = timer.elapsed();
+
+    CatalogContents* contents = NULL;
     if (fileName.toLower().endsWith(".ssc"))
     {
         QStringList spiceKernels;
         QStringList bodyNames = loadSSC(fileName, catalog, 0);
-        return new CatalogContents(bodyNames, spiceKernels);
+        contents = new CatalogContents(bodyNames, spiceKernels);
     }
     else
     {
-        return loadCatalogFile(fileName, catalog, 0);
+        contents = loadCatalogFile(fileName, catalog, 0);
     }
+
+    qint64 buildTime = timer.elapsed() - parseTime;
+    m_catalogReader.updateSnapshot();
+    m_catalogReader.clear();
+
+    qDebug() << QString("Loaded %1: parse %2 ms, build %3 ms, total %4 ms").arg(fileName).arg(parseTime).arg(buildTime).arg(timer.elapsed());
+
+    return contents;
 }
 
 
@@ -4064,11 +4269,16 @@ UniverseLoader::loadSSC(const QString& fileName,
     QFileInfo info(path);
     path = info.canonicalFilePath();
 
-    QFile catalogFile(path);
-    if (!catalogFile.open(QIODevice::ReadOnly))
+    // The objects in the file have already been converted if the file is in
+    // the require tree of the top level catalog.
+    CatalogFileReader::ParsedFile parsedFile;
+    if (!m_catalogReader.find(path, &parsedFile))
     {
-        errorMessage(QString("Cannot open SSC file %1").arg(path));
-        return bodyNames;
+        if (!CatalogFileReader::ReadFile(path, &parsedFile))
+        {
+            errorMessage(QString("Cannot open SSC file %1").arg(path));
+            return bodyNames;
+        }
     }
 
     // Save search paths
@@ -4092,34 +4302,18 @@ UniverseLoader::loadSSC(const QString& fileName,
     }
     setTexturesInModelDirectory(false);
 
-    QVariantList items;
-
-    CatalogParser parser(&catalogFile);
-    QVariant obj = parser.nextSscObject();
-    while (obj.type() == QVariant::Map)
-    {
-        QJson::Serializer serializer;
-#if DEBUG_SSC_CONVERSION
-        qDebug() << serializer.serialize(obj);
-#endif
-
-        QVariantMap map = obj.toMap();
-        TransformSscObject(&map);
 #if DEBUG_SSC_CONVERSION
-        qDebug() << "Converted: " << serializer.serialize(map);
-#endif
-
-        QString fullName = map.value("_parent").toString() + "/" + map.value("name").toString();
-        map.insert("name", fullName);
-        items << map;
-
-        obj = parser.nextSscObject();
+    QJson::Serializer serializer;
+    foreach (QVariant item, parsedFile.contents.value("items").toList())
+    {
+        qDebug() << "Converted: " << serializer.serialize(item);
     }
+#endif
 
     QVariantMap contents;
     contents.insert("name", fileName);
     contents.insert("version", "1.0");
-    contents.insert("items", items);
+    contents.insert("items", parsedFile.contents.value("items"));
 
     CatalogContents* catalogContents = loadCatalogItems(contents, catalog, requireDepth + 1);
     bodyNames = catalogContents->bodyNames();
@@ -4163,33 +4357,29 @@ UniverseLoader::loadCatalogFile(const QString& fileName,
         return contents;
     }
 
-    QFile catalogFile(path);
-    if (!catalogFile.open(QIODevice::ReadOnly))
+    // Files in the require tree of the top level catalog have already been
+    // parsed; others (e.g. files that didn't exist when the tree was read)
+    // are parsed now.
+    CatalogFileReader::ParsedFile parsedFile;
+    if (!m_catalogReader.find(path, &parsedFile))
     {
-        errorMessage(QString("Cannot open required file %1").arg(path));
-        return contents;
+        if (!CatalogFileReader::ReadFile(path, &parsedFile))
+        {
+            errorMessage(QString("Cannot open required file %1").arg(path));
+            return contents;
+        }
     }
 
-    // Strip single-line C++ style comments from the JSON text. This is a
-    // temporary solution, as the regex used here doesn't properly distinguish
-    // and ignore comment characters in the middle of a string.
-    QString catalogText(catalogFile.readAll());
-    QRegExp stripComments("//[^\"]*[\n\r]");
-    stripComments.setMinimal(true);
-    QByteArray catalogBytes = catalogText.replace(stripComments, " ").toUtf8();
-    QBuffer buffer(&catalogBytes);
-
-    QJson::Parser parser;
-
-    bool parseOk = false;
-    QVariant result = parser.parse(&buffer, &parseOk);
-    if (!parseOk)
+    if (!parsedFile.error.isEmpty())
     {
-        errorMessage(QString("Error in %1, line %2: %3").arg(path).arg(parser.errorLine()).arg(parser.errorString()));
+        errorMessage(parsedFile.error);
         return contents;
     }
 
-    QVariantMap contentsMap = result.toMap();
+    QElapsedTimer buildTimer;
+    buildTimer.start();
+
+    QVariantMap contentsMap = parsedFile.contents;
     if (contentsMap.empty())
     {
         errorMessage("Solar system catalog is empty.");
@@ -4211,6 +4401,9 @@ UniverseLoader::loadCatalogFile(const QString& fileName,
     setDataSearchPath(saveDataSearchPath);
     setModelSearchPath(saveModelSearchPath);
 
+    // Build time includes the time to load required files
+    qDebug() << QString("Catalog %1: parse %2 ms, build %3 ms").arg(path).arg(parsedFile.parseTime).arg(buildTimer.elapsed());
+
     return contents;
 }
 
@@ -4531,10 +4724,15 @@ void
 UniverseLoader::loadSpiceKernels(const QStringList& kernelList)
 {
 #ifdef SPICE_ENABLED
-    foreach (QString kernel, kernelList)
     {
-        furnsh_c(kernel.toLatin1().data());
+        QMutexLocker locker(cspiceMutex());
+        foreach (QString kernel, kernelList)
+        {
+            furnsh_c(kernel.toLatin1().data());
+        }
     }
+
+    m_spiceKernelIndex = SpiceKernelIndex::fromLoadedKernels(m_spiceKernelIndex.ptr());
 #endif
 }
 
@@ -4564,11 +4762,16 @@ void
 UniverseLoader::unloadSpiceKernels(const QStringList& kernelList)
 {
 #ifdef SPICE_ENABLED
-    for (int i = kernelList.length() - 1; i >= 0; --i)
     {
-        QString kernel = kernelList.at(i);
-        unload_c(kernel.toLatin1().data());
+        QMutexLocker locker(cspiceMutex());
+        for (int i = kernelList.length() - 1; i >= 0; --i)
+        {
+            QString kernel = kernelList.at(i);
+            unload_c(kernel.toLatin1().data());
+        }
     }
+
+    m_spiceKernelIndex = SpiceKernelIndex::fromLoadedKernels(m_spiceKernelIndex.ptr());
 #endif
 }
 
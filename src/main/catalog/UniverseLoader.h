@@ -18,6 +18,7 @@
 #define _UNIVERSE_LOADER_H_
 
 #include "UniverseCatalog.h"
+#include "CatalogFileReader.h"
 #include <vesta/Entity.h>
 #include <vesta/Frame.h>
 #include <vesta/Trajectory.h>
@@ -42,6 +43,7 @@ namespace vesta
 class Viewpoint;
 class TwoVectorFrameDirection;
 class PathRelativeTextureLoader;
+class SpiceKernelIndex;
 
 class CatalogContents
 {
@@ -139,6 +141,7 @@ private:
     vesta::Geometry* loadSensorGeometry(const QVariantMap& map,
                                         const UniverseCatalog* catalog);
     vesta::Geometry* loadSwarmGeometry(const QVariantMap& map);
+    vesta::Geometry* loadTleSwarmGeometry(const QVariantMap& map);
     vesta::Geometry* loadParticleSystemGeometry(const QVariantMap& map);
     vesta::Geometry* loadTimeSwitchedGeometry(const QVariantMap& map,
                                               const UniverseCatalog* catalog);
@@ -241,9 +244,16 @@ private:
     QHash<QString, vesta::counted_ptr<vesta::Trajectory> > m_trajectoryCache;
 
     QSet<QString> m_loadedCatalogFiles;
+    CatalogFileReader m_catalogReader;
     QString m_messageLog;
 
     bool m_texturesInModelDirectory;
+
+#ifdef SPICE_ENABLED
+    // Snapshot of the loaded SPK and CK kernels, rebuilt whenever kernels
+    // are loaded or unloaded.
+    vesta::counted_ptr<SpiceKernelIndex> m_spiceKernelIndex;
+#endif
 };
 
 #endif // _UNIVERSE_LOADER_H_
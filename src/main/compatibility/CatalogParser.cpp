@@ -210,7 +210,7 @@ CatalogParser::readValue()
 
     case Scanner::Identifier:
         {
-            QString id = m_scanner->stringValue();
+            QByteArray id = m_scanner->tokenText();
             if (id == "true")
             {
                 v = true;
@@ -223,7 +223,7 @@ CatalogParser::readValue()
             {
                 if (m_topLevel)
                 {
-                    v = QVariant(id.toUtf8().data());
+                    v = QVariant(m_scanner->stringValue());
                 }
                 else
                 {
@@ -17,7 +17,8 @@
 #include "Scanner.h"
 #include <cstdlib>
 #include <cstdio>
-#include <cmath>
+#include <cstring>
+#include <cctype>
 
 using namespace std;
 
@@ -28,6 +29,9 @@ using namespace std;
 
 static const int EndOfFile = EOF;
 
+// Size of the blocks read from the input device
+static const int BlockSize = 65536;
+
 
 /** The Scanner class is intended to be used for parsing tokens in Celestia
   * text catalog files (SSC, STC, DSC).
@@ -35,8 +39,13 @@ static const int EndOfFile = EOF;
 Scanner::Scanner(QIODevice *in) :
     m_in(in),
     m_currentTokenType(NoToken),
-    m_skipRead(false),
-    m_nextChar(' '),
+    m_position(0),
+    m_end(0),
+    m_tokenStart(-1),
+    m_inputEnded(false),
+    m_readError(false),
+    m_tokenText(NULL),
+    m_tokenLength(0),
     m_doubleValue(0.0)
 {
 }
@@ -47,345 +56,496 @@ Scanner::~Scanner()
 }
 
 
-enum ScannerState
-{
-    BeginTokenState,
-    EndTokenState,
-    IntegerState,
-    ExponentSignState,
-    ExponentState,
-    FractionState,
-    IdentifierState,
-    CommentState,
-    StringState,
-    StringEscapeState,
-};
-
-
-static int digitValue(int c)
+static inline bool isDigit(int c)
 {
-    return int(c) - int('0');
+    return c >= '0' && c <= '9';
 }
 
-static bool isIdentifierCharacter(int c)
+static inline bool isIdentifierCharacter(int c)
 {
-    return isalpha(c) || isdigit(c) || c == '_';
+    return (c >= 0 && isalnum(c)) || c == '_';
 }
 
-static bool isTokenSeparator(int c)
+static inline bool isTokenSeparator(int c)
 {
     return !isIdentifierCharacter(c) && c != '.';
 }
 
 
-/** Read the next token and return its type.
-  *
-  * Once an error is reported by readNext(), no subsequent reads will succeed.
-  */
-Scanner::TokenType
-Scanner::readNext()
+static const double PowersOfTen[] =
 {
-    ScannerState state = BeginTokenState;
-
-    double exponentValue = 0.0;
-    double integerValue = 0.0;
-    double fractionValue = 0.0;
-    int fractionLength = 0;
-    int numberSign = 1;
-    int exponentSign = 1;
+    1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+    1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
 
-    m_stringValue = "";
-    m_doubleValue = 0.0;
+// Convert the text of a number token (which has already been checked by the
+// scanner) to a double. The result is correctly rounded: when the significant
+// digits fit in 53 bits and the power of ten is exactly representable, a single
+// multiplication or division gives the correctly rounded value. Other numbers
+// are converted by QByteArray::toDouble(), which is correctly rounded but slower.
+static double
+parseNumber(const char* text, int length)
+{
+    const char* s = text;
+    const char* end = text + length;
 
-    // Once an error has occurred, always report failure.
-    if (m_currentTokenType == Invalid)
-    {
-        return m_currentTokenType;
-    }
-    else if (m_nextChar == EndOfFile)
+    bool negative = false;
+    if (s != end && (*s == '-' || *s == '+'))
     {
-        m_currentTokenType = EndToken;
-        return m_currentTokenType;
+        negative = *s == '-';
+        ++s;
     }
 
-    while (state != EndTokenState)
+    quint64 mantissa = 0;
+    int significantDigits = 0;
+    int fractionDigits = 0;
+    bool inFraction = false;
+    for (; s != end; ++s)
     {
-        if (m_skipRead)
+        if (isDigit(*s))
         {
-            m_skipRead = false;
-        }
-        else
-        {
-            char c = 0;
-            bool ok = m_in->getChar(&c);
-            m_nextChar = c;
-
-            if (!ok)
+            if (significantDigits < 19)
             {
-                m_nextChar = EndOfFile;
-                if (!m_in->atEnd())
+                mantissa = mantissa * 10 + (*s - '0');
+                if (mantissa != 0)
                 {
-                    setErrorState("Error reading stream.");
-                    state = EndTokenState;
+                    ++significantDigits;
                 }
             }
-        }
-
-        switch (state)
-        {
-        case BeginTokenState:
-            if (m_nextChar == EndOfFile)
-            {
-                state = EndTokenState;
-                m_currentTokenType = EndToken;
-            }
-            else if (isspace(m_nextChar))
-            {
-                // Nothing
-            }
-            else if (isdigit(m_nextChar))
-            {
-                state = IntegerState;
-                integerValue = digitValue(m_nextChar);
-            }
-            else if (m_nextChar == '-')
-            {
-                state = IntegerState;
-                numberSign = -1;
-                integerValue = 0;
-            }
-            else if (m_nextChar == '+')
-            {
-                state = IntegerState;
-                integerValue = 0;
-            }
-            else if (m_nextChar == '.')
-            {
-                state = FractionState;
-            }
-            else if (isalpha(m_nextChar) || m_nextChar == '_')
-            {
-                state = IdentifierState;
-                m_stringValue += (char) m_nextChar;
-            }
-            else if (m_nextChar == '#')
-            {
-                state = CommentState;
-            }
-            else if (m_nextChar == '"')
-            {
-                state = StringState;
-            }
-            else if (m_nextChar == '{')
-            {
-                state = EndTokenState;
-                m_currentTokenType = OpenBrace;
-            }
-            else if (m_nextChar == '}')
-            {
-                state = EndTokenState;
-                m_currentTokenType = CloseBrace;
-            }
-            else if (m_nextChar == '[')
-            {
-                state = EndTokenState;
-                m_currentTokenType = OpenSquareBracket;
-            }
-            else if (m_nextChar == ']')
-            {
-                state = EndTokenState;
-                m_currentTokenType = CloseSquareBracket;
-            }
             else
             {
-                state = EndTokenState;
-                setErrorState(QString("Invalid character '%1' in stream").arg(m_nextChar));
+                // Too many digits for the mantissa
+                significantDigits = 20;
             }
-            break;
 
-        case IdentifierState:
-            if (isIdentifierCharacter(m_nextChar))
+            if (inFraction)
             {
-                m_stringValue += m_nextChar;
-            }
-            else
-            {
-                state = EndTokenState;
-                m_currentTokenType = Identifier;
+                ++fractionDigits;
             }
+        }
+        else if (*s == '.')
+        {
+            inFraction = true;
+        }
+        else
+        {
             break;
+        }
+    }
 
-        case IntegerState:
-            if (isdigit(m_nextChar))
-            {
-                integerValue = integerValue * 10.0 + digitValue(m_nextChar);
-            }
-            else if (m_nextChar == '.')
-            {
-                state = FractionState;
-            }
-            else if (m_nextChar == 'e' || m_nextChar == 'E')
-            {
-                state = ExponentSignState;
-            }
-            else if (isTokenSeparator(m_nextChar))
-            {
-                state = EndTokenState;
-                m_currentTokenType = Integer;
-                m_skipRead = true;
-            }
-            else
-            {
-                state = EndTokenState;
-                setErrorState("Invalid character in number");
-            }
-            break;
+    // Exponent (the e has already been seen)
+    int exponent = 0;
+    if (s != end)
+    {
+        ++s;
+        bool negativeExponent = false;
+        if (s != end && (*s == '-' || *s == '+'))
+        {
+            negativeExponent = *s == '-';
+            ++s;
+        }
 
-        case FractionState:
-            if (isdigit(m_nextChar))
-            {
-                fractionValue = fractionValue * 10.0 + digitValue(m_nextChar);
-                fractionLength++;
-            }
-            else if (m_nextChar == 'e' || m_nextChar == 'E')
-            {
-                state = ExponentSignState;
-            }
-            else if (isTokenSeparator(m_nextChar))
-            {
-                state = EndTokenState;
-                m_currentTokenType = Double;
-                m_skipRead = true;
-            }
-            else
+        for (; s != end; ++s)
+        {
+            // Limit the exponent to keep it from overflowing; any number with an
+            // exponent this large is zero or infinite anyway.
+            if (exponent < 100000)
             {
-                state = EndTokenState;
-                setErrorState("Invalid character in number");
+                exponent = exponent * 10 + (*s - '0');
             }
-            break;
+        }
 
-        case ExponentSignState:
-            if (m_nextChar == '-')
-            {
-                state = ExponentState;
-                exponentSign = -1;
-            }
-            else if (m_nextChar == '+')
-            {
-                state = ExponentState;
-            }
-            else if (isdigit(m_nextChar))
-            {
-                state = ExponentState;
-                exponentValue += ((int) m_nextChar - (int) '0');
-            }
-            else if (isTokenSeparator(m_nextChar))
-            {
-                state = EndTokenState;
-                m_currentTokenType = Double;
-                m_skipRead = true;
-            }
-            else
+        if (negativeExponent)
+        {
+            exponent = -exponent;
+        }
+    }
+
+    int powerOfTen = exponent - fractionDigits;
+
+    if (significantDigits <= 19 && mantissa <= (quint64(1) << 53))
+    {
+        double m = double(mantissa);
+        if (mantissa == 0)
+        {
+            return negative ? -0.0 : 0.0;
+        }
+        else if (powerOfTen >= 0 && powerOfTen <= 22)
+        {
+            return negative ? -(m * PowersOfTen[powerOfTen]) : m * PowersOfTen[powerOfTen];
+        }
+        else if (powerOfTen < 0 && powerOfTen >= -22)
+        {
+            return negative ? -(m / PowersOfTen[-powerOfTen]) : m / PowersOfTen[-powerOfTen];
+        }
+    }
+
+    // Slow path: rewrite the number as digits and an exponent, the form
+    // expected by QByteArray::toDouble(). This also takes care of forms like
+    // '1.e' and '.5' accepted by the scanner.
+    QByteArray normalized;
+    normalized.reserve(length + 8);
+    if (negative)
+    {
+        normalized += '-';
+    }
+    for (const char* digit = text; digit != end && *digit != 'e' && *digit != 'E'; ++digit)
+    {
+        if (isDigit(*digit))
+        {
+            normalized += *digit;
+        }
+    }
+    normalized += 'e';
+    normalized += QByteArray::number(powerOfTen);
+
+    return normalized.toDouble();
+}
+
+
+// Read the next block of input into the buffer. Returns false if there's no more input
+// (either because the end of the stream was reached or because of a read error.)
+bool
+Scanner::fillBuffer()
+{
+    if (m_inputEnded)
+    {
+        return false;
+    }
+
+    // Discard everything before the current token
+    int keep = m_tokenStart >= 0 ? m_tokenStart : m_position;
+    if (keep > 0)
+    {
+        memmove(m_buffer.data(), m_buffer.constData() + keep, m_end - keep);
+        m_position -= keep;
+        m_end -= keep;
+        if (m_tokenStart >= 0)
+        {
+            m_tokenStart = 0;
+        }
+    }
+
+    // Grow the buffer if a token is too long to leave room for a full block
+    if (m_buffer.size() - m_end < BlockSize)
+    {
+        m_buffer.resize(m_end + BlockSize);
+    }
+
+    qint64 bytesRead = m_in->read(m_buffer.data() + m_end, m_buffer.size() - m_end);
+    if (bytesRead <= 0)
+    {
+        m_inputEnded = true;
+        m_readError = bytesRead < 0 || !m_in->atEnd();
+        return false;
+    }
+
+    m_end += int(bytesRead);
+
+    return true;
+}
+
+
+// Get the next character without consuming it
+inline int
+Scanner::peekChar()
+{
+    if (m_position == m_end && !fillBuffer())
+    {
+        return EndOfFile;
+    }
+
+    return (unsigned char) m_buffer.constData()[m_position];
+}
+
+
+// Read the rest of a number token. The first character has already been consumed.
+Scanner::TokenType
+Scanner::readNumber()
+{
+    enum NumberPart
+    {
+        IntegerPart,
+        FractionPart,
+        ExponentSignPart,
+        ExponentPart,
+    };
+
+    NumberPart part = m_buffer.at(m_tokenStart) == '.' ? FractionPart : IntegerPart;
+    TokenType type = part == FractionPart ? Double : Integer;
+
+    for (;;)
+    {
+        // Skip runs of digits without the buffer checks in peekChar()
+        const char* data = m_buffer.constData();
+        while (m_position < m_end && isDigit(data[m_position]) && part != ExponentSignPart)
+        {
+            ++m_position;
+        }
+
+        int c = peekChar();
+        if (isDigit(c))
+        {
+            if (part == ExponentSignPart)
             {
-                state = EndTokenState;
-                setErrorState("Invalid character in exponent");
+                part = ExponentPart;
             }
+        }
+        else if (part == IntegerPart && c == '.')
+        {
+            part = FractionPart;
+            type = Double;
+        }
+        else if ((part == IntegerPart || part == FractionPart) && (c == 'e' || c == 'E'))
+        {
+            part = ExponentSignPart;
+            type = Double;
+        }
+        else if (part == ExponentSignPart && (c == '-' || c == '+'))
+        {
+            part = ExponentPart;
+        }
+        else if (isTokenSeparator(c))
+        {
             break;
+        }
+        else if (part == ExponentSignPart || part == ExponentPart)
+        {
+            setErrorState("Invalid character in exponent");
+            return m_currentTokenType;
+        }
+        else
+        {
+            setErrorState("Invalid character in number");
+            return m_currentTokenType;
+        }
 
-        case ExponentState:
-            if (isdigit(m_nextChar))
-            {
-                exponentValue = exponentValue * 10.0 + digitValue(m_nextChar);
-            }
-            else if (isTokenSeparator(m_nextChar))
-            {
-                state = EndTokenState;
-                m_currentTokenType = Double;
-                m_skipRead = true;
-            }
-            else
-            {
-                state = EndTokenState;
-                setErrorState("Invalid character in exponent");
-            }
+        ++m_position;
+    }
+
+    m_tokenText = m_buffer.constData() + m_tokenStart;
+    m_tokenLength = m_position - m_tokenStart;
+    m_doubleValue = parseNumber(m_tokenText, m_tokenLength);
+
+    return type;
+}
+
+
+// Read the rest of a string token. The opening quote has already been consumed. Strings
+// without escape sequences are left in the buffer; others are copied with the escape
+// sequences replaced.
+Scanner::TokenType
+Scanner::readString()
+{
+    bool escaped = false;
+    m_unescapedString.clear();
+
+    // Offset from the start of the token to the first character not yet copied
+    // to the unescaped string. Offsets are used because the token may move when
+    // the buffer is refilled.
+    int copyStart = 1;
+
+    for (;;)
+    {
+        int c = peekChar();
+        if (c == EndOfFile)
+        {
+            setErrorState("Unterminated string");
+            return m_currentTokenType;
+        }
+
+        if (c == '"')
+        {
             break;
+        }
+        else if (c == '\\')
+        {
+            m_unescapedString.append(m_buffer.constData() + m_tokenStart + copyStart, m_position - m_tokenStart - copyStart);
+            escaped = true;
 
-        case CommentState:
-            if (m_nextChar == '\n' || m_nextChar == '\r' || m_nextChar == EndOfFile)
+            ++m_position;
+            c = peekChar();
+            if (c == 'n')
             {
-                state = BeginTokenState;
+                m_unescapedString += '\n';
             }
-            break;
-
-        case StringState:
-            if (m_nextChar == '"')
+            else if (c == 't')
             {
-                // Finished the string
-                state = EndTokenState;
-                m_currentTokenType = String;
+                m_unescapedString += '\t';
             }
-            else if (m_nextChar == '\\')
+            else if (c == '\\' || c == '"')
             {
-                state = StringEscapeState;
+                m_unescapedString += char(c);
             }
-            else if (m_nextChar == EndOfFile)
+            else if (c == EndOfFile)
             {
                 setErrorState("Unterminated string");
+                return m_currentTokenType;
             }
             else
             {
-                // Add another character to the string
-                m_stringValue += m_nextChar;
+                setErrorState(QString("Invalid string escape \\%1").arg(QChar::fromLatin1(char(c))));
+                return m_currentTokenType;
             }
-            break;
 
-        case StringEscapeState:
-            if (m_nextChar == 'n')
-            {
-                m_stringValue += '\n';
-                state = StringState;
-            }
-            else if (m_nextChar == 't')
-            {
-                m_stringValue += '\n';
-                state = StringState;
-            }
-            else if (m_nextChar == '\\')
-            {
-                m_stringValue += '\\';
-                state = StringState;
-            }
-            else if (m_nextChar == '"')
-            {
-                m_stringValue += '"';
-                state = StringState;
-            }
-            else
+            copyStart = m_position + 1 - m_tokenStart;
+        }
+
+        ++m_position;
+    }
+
+    const char* stringStart = m_buffer.constData() + m_tokenStart + copyStart;
+    int stringLength = m_position - m_tokenStart - copyStart;
+
+    // Skip the closing quote
+    ++m_position;
+
+    if (escaped)
+    {
+        m_unescapedString.append(stringStart, stringLength);
+        m_tokenText = m_unescapedString.constData();
+        m_tokenLength = m_unescapedString.size();
+    }
+    else
+    {
+        m_tokenText = stringStart;
+        m_tokenLength = stringLength;
+    }
+
+    return String;
+}
+
+
+/** Read the next token and return its type.
+  *
+  * Once an error is reported by readNext(), no subsequent reads will succeed.
+  */
+Scanner::TokenType
+Scanner::readNext()
+{
+    m_doubleValue = 0.0;
+    m_tokenText = NULL;
+    m_tokenLength = 0;
+    m_tokenStart = -1;
+
+    // Once an error has occurred, always report failure.
+    if (m_currentTokenType == Invalid)
+    {
+        return m_currentTokenType;
+    }
+
+    // Skip white space and comments
+    int c = peekChar();
+    while (c != EndOfFile && (isspace(c) || c == '#'))
+    {
+        if (c == '#')
+        {
+            while (c != EndOfFile && c != '\n' && c != '\r')
             {
-                setErrorState(QString("Invalid string escape \\%1").arg((char) m_nextChar));
-                state = EndTokenState;
+                ++m_position;
+                c = peekChar();
             }
-            break;
+        }
+        else
+        {
+            ++m_position;
+            c = peekChar();
+        }
+    }
 
-        case EndTokenState:
-            break;
+    if (c == EndOfFile)
+    {
+        if (m_readError)
+        {
+            setErrorState("Error reading stream.");
         }
+        else
+        {
+            m_currentTokenType = EndToken;
+        }
+        return m_currentTokenType;
     }
 
-    if (m_currentTokenType == Integer)
+    m_tokenStart = m_position;
+    ++m_position;
+
+    TokenType type = NoToken;
+    if (isDigit(c) || c == '-' || c == '+' || c == '.')
+    {
+        type = readNumber();
+    }
+    else if (isalpha(c) || c == '_')
+    {
+        while (isIdentifierCharacter(peekChar()))
+        {
+            ++m_position;
+        }
+        m_tokenText = m_buffer.constData() + m_tokenStart;
+        m_tokenLength = m_position - m_tokenStart;
+        type = Identifier;
+    }
+    else if (c == '"')
+    {
+        type = readString();
+    }
+    else if (c == '{')
+    {
+        type = OpenBrace;
+    }
+    else if (c == '}')
+    {
+        type = CloseBrace;
+    }
+    else if (c == '[')
+    {
+        type = OpenSquareBracket;
+    }
+    else if (c == ']')
     {
-        m_doubleValue = integerValue * numberSign;
+        type = CloseSquareBracket;
     }
-    else if (m_currentTokenType == Double)
+    else
     {
-        double mantissa = numberSign * (integerValue + fractionValue * pow(10.0, double(-fractionLength)));
-        m_doubleValue = mantissa * pow(10.0, double(exponentValue * exponentSign));
+        setErrorState(QString("Invalid character '%1' in stream").arg(QChar::fromLatin1(char(c))));
+    }
+
+    // A read error in the middle of a token is reported instead of the token
+    if (m_readError && m_currentTokenType != Invalid)
+    {
+        setErrorState("Error reading stream.");
+    }
+
+    if (m_currentTokenType != Invalid)
+    {
+        m_currentTokenType = type;
     }
 
     return m_currentTokenType;
 }
 
 
+/** Get the value of the current token as a string. This is only meaningful
+  * for string and identifier tokens. String contents are UTF-8.
+  */
+QString
+Scanner::stringValue() const
+{
+    if (m_currentTokenType == String)
+    {
+        return QString::fromUtf8(m_tokenText, m_tokenLength);
+    }
+    else if (m_currentTokenType == Identifier)
+    {
+        return QString::fromLatin1(m_tokenText, m_tokenLength);
+    }
+    else
+    {
+        return QString();
+    }
+}
+
+
 void
 Scanner::setErrorState(const QString &message)
 {
@@ -18,6 +18,7 @@
 #define _COMPATIBILITY_SCANNER_H_
 
 #include <QIODevice>
+#include <QByteArray>
 
 
 class Scanner
@@ -48,9 +49,16 @@ public:
         return m_currentTokenType;
     }
 
-    QString stringValue() const
+    QString stringValue() const;
+
+    /** Get the text of the current token without copying it. For strings, this
+      * is the contents of the string with escape sequences replaced. The
+      * returned array refers to the scanner's buffer and is only valid until the
+      * next call to readNext().
+      */
+    QByteArray tokenText() const
     {
-        return m_stringValue;
+        return QByteArray::fromRawData(m_tokenText, m_tokenLength);
     }
 
     double doubleValue() const
@@ -75,17 +83,31 @@ public:
 
 private:
     void setErrorState(const QString& message);
+    inline int peekChar();
+    bool fillBuffer();
+    TokenType readNumber();
+    TokenType readString();
 
 private:
     QIODevice* m_in;
     TokenType m_currentTokenType;
     QString m_errorMessage;
 
-    bool m_skipRead;
-    int m_nextChar;
+    // Input is read in blocks. Bytes from the start of the current token (or
+    // from the read position when there's no token in progress) are kept
+    // when the buffer is refilled.
+    QByteArray m_buffer;
+    int m_position;
+    int m_end;
+    int m_tokenStart;
+    bool m_inputEnded;
+    bool m_readError;
+
+    const char* m_tokenText;
+    int m_tokenLength;
+    QByteArray m_unescapedString;
 
     double m_doubleValue;
-    QString m_stringValue;
 };
 
 #endif // _COMPATIBILITY_SCANNER_H_
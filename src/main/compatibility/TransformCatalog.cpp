@@ -23,6 +23,7 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <QDebug>
+#include <QMutex>
 
 using namespace Eigen;
 
@@ -93,11 +94,14 @@ static NameMapping SolarSystemNames[] =
     { "Sol/Earth/Moon", "Moon" },
 };
 
+// SSC files may be converted on several threads at once
+static QMutex SolarSystemMappingsMutex;
 static QMap<QString, QString> SolarSystemMappings;
 
 QString
 TransformSolarSystemName(const QString& name)
 {
+    QMutexLocker lock(&SolarSystemMappingsMutex);
     if (SolarSystemMappings.isEmpty())
     {
         for (unsigned int i = 0; i < sizeof(SolarSystemNames) / sizeof(SolarSystemNames[0]); ++i)
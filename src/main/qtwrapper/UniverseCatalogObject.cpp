@@ -46,23 +46,14 @@ UniverseCatalogObject::getMatchingNames(const QString& pattern) const
 }
 
 
-/** Get a comma separated list of names that start with the specified string.
+/** Get a comma separated list of names that complete the specified string:
+  * names that start with it, followed by names containing a word that starts
+  * with it.
   */
 QString
 UniverseCatalogObject::getCompletionString(const QString& partialName, int maxNames) const
 {
-    QStringList matches = m_catalog->matchingNames(partialName + ".*");
-    QString completionList;
-    for (int i = 0; i < std::min(maxNames, matches.length()); ++i)
-    {
-        if (i != 0)
-        {
-            completionList += ", ";
-        }
-        completionList += matches.at(i);
-    }
-
-    return completionList;
+    return m_catalog->completions(partialName, maxNames).join(", ");
 }
 
 
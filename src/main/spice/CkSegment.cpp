@@ -0,0 +1,243 @@
+// CkSegment.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CkSegment.h"
+#include <algorithm>
+
+using namespace Eigen;
+using namespace std;
+
+
+/** Create a segment from a CK array summary. The summary must have two double
+  * components (start and end ticks) and six integer components (instrument,
+  * reference frame, type, angular velocity flag, begin address, end address.)
+  */
+CkSegment::CkSegment(const DafFile* file, const DafSummary& summary) :
+    m_file(file),
+    m_valid(false),
+    m_instrument(0),
+    m_referenceFrame(0),
+    m_type(0),
+    m_hasAngularVelocity(false),
+    m_startTick(0.0),
+    m_endTick(0.0),
+    m_begin(0),
+    m_end(0),
+    m_recordCount(0),
+    m_recordSize(0),
+    m_times(0),
+    m_stopTimes(0),
+    m_intervalCount(0),
+    m_intervalStarts(0)
+{
+    if (summary.doubles.size() < 2 || summary.integers.size() < 6)
+    {
+        return;
+    }
+
+    m_startTick          = summary.doubles[0];
+    m_endTick            = summary.doubles[1];
+    m_instrument         = summary.integers[0];
+    m_referenceFrame     = summary.integers[1];
+    m_type               = summary.integers[2];
+    m_hasAngularVelocity = summary.integers[3] != 0;
+    m_begin              = (unsigned int) summary.integers[4];
+    m_end                = (unsigned int) summary.integers[5];
+
+    if (!isSupportedType(m_type) || m_begin == 0 || m_end <= m_begin || m_end > file->wordCount())
+    {
+        return;
+    }
+
+    unsigned int segmentSize = m_end - m_begin + 1;
+
+    if (m_type == 2)
+    {
+        // Records of quaternion, angular velocity, and clock rate, followed by the
+        // interval start times, stop times, and a directory of every 100th start
+        // time. The record count isn't stored, so solve for it: the segment size
+        // is 10 * N + (N - 1) / 100.
+        unsigned int n = segmentSize / 10;
+        while (n > 0 && 10 * n + (n - 1) / 100 > segmentSize)
+        {
+            --n;
+        }
+
+        m_recordCount = n;
+        m_recordSize = 8;
+        m_times = m_begin + n * m_recordSize;
+        m_stopTimes = m_times + n;
+        m_hasAngularVelocity = true;
+        m_valid = n > 0 && 10 * n + (n - 1) / 100 == segmentSize;
+    }
+    else if (m_type == 3)
+    {
+        double trailer[2];
+        file->readDoubles(m_end - 1, 2, trailer);
+        m_intervalCount = (unsigned int) trailer[0];
+        m_recordCount = (unsigned int) trailer[1];
+        m_recordSize = m_hasAngularVelocity ? 7 : 4;
+
+        unsigned int n = m_recordCount;
+        m_times = m_begin + n * m_recordSize;
+        m_intervalStarts = m_times + n + (n > 0 ? (n - 1) / 100 : 0);
+
+        unsigned int expectedSize = n * (m_recordSize + 1) + (n > 0 ? (n - 1) / 100 : 0) +
+                                    m_intervalCount + (m_intervalCount > 0 ? (m_intervalCount - 1) / 100 : 0) + 2;
+        m_valid = n > 0 && m_intervalCount > 0 && expectedSize == segmentSize;
+    }
+}
+
+
+bool
+CkSegment::isSupportedType(int type)
+{
+    return type == 2 || type == 3;
+}
+
+
+/** Compute the pointing at the specified time. The quaternion gives the rotation
+  * from the segment's reference frame to the instrument frame (the C-matrix), and
+  * the angular velocity of the instrument frame is expressed in the reference frame.
+  *
+  * \return true if the time is covered by the segment
+  */
+bool
+CkSegment::pointing(double ticks, Quaterniond* q, Vector3d* angularVelocity) const
+{
+    if (!m_valid || !covers(ticks))
+    {
+        return false;
+    }
+
+    if (m_type == 2)
+    {
+        return constantRatePointing(ticks, q, angularVelocity);
+    }
+    else
+    {
+        return interpolatedPointing(ticks, q, angularVelocity);
+    }
+}
+
+
+// Return the index of the last element of a sorted list that is less than or equal
+// to ticks, or count if ticks precedes the first element.
+unsigned int
+CkSegment::lastNotAfter(unsigned int address, unsigned int count, double ticks) const
+{
+    unsigned int low = 0;
+    unsigned int high = count;
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        if (m_file->readDouble(address + mid) <= ticks)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low > 0 ? low - 1 : count;
+}
+
+
+// Type 2: the instrument rotates at a constant angular velocity over each interval
+bool
+CkSegment::constantRatePointing(double ticks, Quaterniond* q, Vector3d* angularVelocity) const
+{
+    unsigned int index = lastNotAfter(m_times, m_recordCount, ticks);
+    if (index == m_recordCount || ticks > m_file->readDouble(m_stopTimes + index))
+    {
+        return false;
+    }
+
+    double record[8];
+    m_file->readDoubles(m_begin + index * m_recordSize, m_recordSize, record);
+
+    Quaterniond q0(record[0], record[1], record[2], record[3]);
+    Vector3d av(record[4], record[5], record[6]);
+    double secondsPerTick = record[7];
+
+    // Vectors fixed in the instrument frame rotate about the angular velocity
+    // vector, so the C-matrix is C0 * R(axis, -angle)
+    double seconds = (ticks - m_file->readDouble(m_times + index)) * secondsPerTick;
+    double rate = av.norm();
+    Quaterniond rotation = Quaterniond::Identity();
+    if (rate > 0.0)
+    {
+        rotation = Quaterniond(AngleAxis<double>(-seconds * rate, av / rate));
+    }
+
+    *q = q0 * rotation;
+    *angularVelocity = av;
+
+    return true;
+}
+
+
+// Type 3: linear interpolation between pointing instances within an interval
+bool
+CkSegment::interpolatedPointing(double ticks, Quaterniond* q, Vector3d* angularVelocity) const
+{
+    unsigned int index = lastNotAfter(m_times, m_recordCount, ticks);
+    if (index == m_recordCount)
+    {
+        return false;
+    }
+
+    double record0[7] = { 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    m_file->readDoubles(m_begin + index * m_recordSize, m_recordSize, record0);
+    Quaterniond q0(record0[0], record0[1], record0[2], record0[3]);
+    Vector3d av0(record0[4], record0[5], record0[6]);
+
+    double t0 = m_file->readDouble(m_times + index);
+    if (ticks == t0)
+    {
+        *q = q0;
+        *angularVelocity = av0;
+        return true;
+    }
+
+    if (index + 1 >= m_recordCount)
+    {
+        return false;
+    }
+
+    // Both pointing instances must lie in the same interpolation interval
+    double t1 = m_file->readDouble(m_times + index + 1);
+    unsigned int interval0 = lastNotAfter(m_intervalStarts, m_intervalCount, t0);
+    unsigned int interval1 = lastNotAfter(m_intervalStarts, m_intervalCount, t1);
+    if (interval0 != interval1 || t1 <= t0)
+    {
+        return false;
+    }
+
+    double record1[7] = { 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    m_file->readDoubles(m_begin + (index + 1) * m_recordSize, m_recordSize, record1);
+    Quaterniond q1(record1[0], record1[1], record1[2], record1[3]);
+    Vector3d av1(record1[4], record1[5], record1[6]);
+
+    // Rotate about a fixed axis from the first pointing to the second
+    double fraction = (ticks - t0) / (t1 - t0);
+    *q = q0.slerp(fraction, q1);
+    *angularVelocity = av0 + fraction * (av1 - av0);
+
+    return true;
+}
@@ -0,0 +1,114 @@
+// CkSegment.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CK_SEGMENT_H_
+#define _CK_SEGMENT_H_
+
+#include "DafFile.h"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+
+/** CkSegment evaluates a single segment of a binary CK file without going
+  * through CSPICE. Segment types 2 (constant angular velocity over intervals)
+  * and 3 (linear interpolation between pointing instances) are supported.
+  *
+  * Times are encoded spacecraft clock ticks. As with the SPICE frame system,
+  * pointing is only returned for times covered by an interval; no tolerance
+  * is applied.
+  *
+  * Evaluation only reads from the memory mapped file, so pointing() may be
+  * called from multiple threads simultaneously.
+  */
+class CkSegment
+{
+public:
+    CkSegment(const DafFile* file, const DafSummary& summary);
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    int instrument() const
+    {
+        return m_instrument;
+    }
+
+    int referenceFrame() const
+    {
+        return m_referenceFrame;
+    }
+
+    int type() const
+    {
+        return m_type;
+    }
+
+    bool hasAngularVelocity() const
+    {
+        return m_hasAngularVelocity;
+    }
+
+    double startTick() const
+    {
+        return m_startTick;
+    }
+
+    double endTick() const
+    {
+        return m_endTick;
+    }
+
+    bool covers(double ticks) const
+    {
+        return ticks >= m_startTick && ticks <= m_endTick;
+    }
+
+    bool pointing(double ticks, Eigen::Quaterniond* q, Eigen::Vector3d* angularVelocity) const;
+
+    static bool isSupportedType(int type);
+
+private:
+    bool constantRatePointing(double ticks, Eigen::Quaterniond* q, Eigen::Vector3d* angularVelocity) const;
+    bool interpolatedPointing(double ticks, Eigen::Quaterniond* q, Eigen::Vector3d* angularVelocity) const;
+    unsigned int lastNotAfter(unsigned int address, unsigned int count, double ticks) const;
+
+private:
+    const DafFile* m_file;
+    bool m_valid;
+    int m_instrument;
+    int m_referenceFrame;
+    int m_type;
+    bool m_hasAngularVelocity;
+    double m_startTick;
+    double m_endTick;
+    unsigned int m_begin;
+    unsigned int m_end;
+
+    unsigned int m_recordCount;
+    unsigned int m_recordSize;
+    unsigned int m_times;
+
+    // Type 2: address of interval stop times
+    unsigned int m_stopTimes;
+
+    // Type 3: interpolation intervals
+    unsigned int m_intervalCount;
+    unsigned int m_intervalStarts;
+};
+
+#endif // _CK_SEGMENT_H_
@@ -0,0 +1,256 @@
+// DafFile.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DafFile.h"
+#include <QSysInfo>
+#include <QDebug>
+#include <cstring>
+
+using namespace vesta;
+using namespace std;
+
+
+// Layout of the DAF file record
+static const unsigned int DafRecordLength    = 1024;
+static const unsigned int IdWordOffset       = 0;
+static const unsigned int NdOffset           = 8;
+static const unsigned int NiOffset           = 12;
+static const unsigned int ForwardOffset      = 76;
+static const unsigned int FormatOffset       = 88;
+
+// A summary record holds at most 125 double precision words, three of which
+// are used for the control words (next, previous, summary count.)
+static const unsigned int SummaryRecordWords = 128;
+static const unsigned int ControlWords       = 3;
+
+// Guard against loops in corrupted files
+static const unsigned int MaxSummaryRecords  = 1000000;
+
+
+DafFile::DafFile(const QString& fileName) :
+    m_file(fileName),
+    m_data(NULL),
+    m_size(0),
+    m_byteSwapped(false)
+{
+}
+
+
+DafFile::~DafFile()
+{
+    if (m_data)
+    {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+}
+
+
+/** Open and memory map a DAF file. Returns null if the file couldn't be opened
+  * or is not a valid binary DAF file.
+  */
+DafFile*
+DafFile::open(const QString& fileName)
+{
+    DafFile* daf = new DafFile(fileName);
+    if (!daf->load())
+    {
+        delete daf;
+        return NULL;
+    }
+
+    return daf;
+}
+
+
+bool
+DafFile::load()
+{
+    if (!m_file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size < qint64(DafRecordLength))
+    {
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+    {
+        qDebug() << "Unable to memory map DAF file " << m_file.fileName();
+        return false;
+    }
+
+    // The id word is "DAF/xxxx", where xxxx is the architecture (SPK, CK, PCK...)
+    // Very old files use "NAIF/DAF" and don't identify the architecture.
+    QString idWord = QString::fromLatin1(reinterpret_cast<const char*>(m_data + IdWordOffset), 8);
+    if (idWord.startsWith("DAF/"))
+    {
+        m_architecture = idWord.mid(4).trimmed();
+    }
+    else if (idWord != "NAIF/DAF")
+    {
+        return false;
+    }
+
+    QString format = QString::fromLatin1(reinterpret_cast<const char*>(m_data + FormatOffset), 8);
+    bool hostIsBigEndian = QSysInfo::ByteOrder == QSysInfo::BigEndian;
+    if (format == "BIG-IEEE")
+    {
+        m_byteSwapped = !hostIsBigEndian;
+    }
+    else if (format == "LTL-IEEE")
+    {
+        m_byteSwapped = hostIsBigEndian;
+    }
+    else
+    {
+        // Pre-N0050 files don't record their binary format; guess from the
+        // plausibility of the ND value.
+        int nd = readInt(NdOffset);
+        m_byteSwapped = nd < 0 || nd > 124;
+    }
+
+    int nd = readInt(NdOffset);
+    int ni = readInt(NiOffset);
+    if (nd < 0 || nd > 124 || ni < 2 || ni > 250)
+    {
+        return false;
+    }
+
+    unsigned int summaryWords = nd + (ni + 1) / 2;
+    unsigned int maxSummaries = (SummaryRecordWords - ControlWords) / summaryWords;
+
+    int record = readInt(ForwardOffset);
+    unsigned int recordsRead = 0;
+    while (record > 0 && recordsRead < MaxSummaryRecords)
+    {
+        qint64 recordOffset = qint64(record - 1) * DafRecordLength;
+        if (recordOffset + DafRecordLength > m_size)
+        {
+            qDebug() << "Bad summary record in DAF file " << m_file.fileName();
+            return false;
+        }
+
+        int nextRecord = int(readDoubleAt(recordOffset));
+        unsigned int summaryCount = (unsigned int) readDoubleAt(recordOffset + 2 * sizeof(double));
+        summaryCount = min(summaryCount, maxSummaries);
+
+        for (unsigned int i = 0; i < summaryCount; ++i)
+        {
+            qint64 summaryOffset = recordOffset + (ControlWords + i * summaryWords) * sizeof(double);
+
+            DafSummary summary;
+            for (int j = 0; j < nd; ++j)
+            {
+                summary.doubles.push_back(readDoubleAt(summaryOffset + j * sizeof(double)));
+            }
+
+            qint64 intOffset = summaryOffset + nd * sizeof(double);
+            for (int j = 0; j < ni; ++j)
+            {
+                summary.integers.push_back(readInt(intOffset + j * sizeof(qint32)));
+            }
+
+            m_summaries.push_back(summary);
+        }
+
+        record = nextRecord;
+        ++recordsRead;
+    }
+
+    return true;
+}
+
+
+int
+DafFile::readInt(qint64 byteOffset) const
+{
+    uchar bytes[sizeof(qint32)];
+    for (unsigned int i = 0; i < sizeof(qint32); ++i)
+    {
+        bytes[i] = m_byteSwapped ? m_data[byteOffset + sizeof(qint32) - 1 - i] : m_data[byteOffset + i];
+    }
+
+    qint32 x;
+    memcpy(&x, bytes, sizeof(x));
+    return x;
+}
+
+
+double
+DafFile::readDoubleAt(qint64 byteOffset) const
+{
+    uchar bytes[sizeof(double)];
+    for (unsigned int i = 0; i < sizeof(double); ++i)
+    {
+        bytes[i] = m_byteSwapped ? m_data[byteOffset + sizeof(double) - 1 - i] : m_data[byteOffset + i];
+    }
+
+    double x;
+    memcpy(&x, bytes, sizeof(x));
+    return x;
+}
+
+
+/** Read a single double precision word.
+  *
+  * \param address DAF word address (one-based, as stored in array summaries)
+  */
+double
+DafFile::readDouble(unsigned int address) const
+{
+    if (address == 0 || address > wordCount())
+    {
+        return 0.0;
+    }
+
+    return readDoubleAt(qint64(address - 1) * sizeof(double));
+}
+
+
+/** Read consecutive double precision words starting at the specified (one-based)
+  * DAF address. Words beyond the end of the file are read as zero.
+  */
+void
+DafFile::readDoubles(unsigned int address, unsigned int count, double* out) const
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (address == 0 || address + count - 1 > wordCount())
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            out[i] = readDouble(address + i);
+        }
+    }
+    else if (!m_byteSwapped)
+    {
+        memcpy(out, m_data + qint64(address - 1) * sizeof(double), count * sizeof(double));
+    }
+    else
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            out[i] = readDoubleAt(qint64(address - 1 + i) * sizeof(double));
+        }
+    }
+}
@@ -0,0 +1,95 @@
+// DafFile.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _DAF_FILE_H_
+#define _DAF_FILE_H_
+
+#include <vesta/Object.h>
+#include <QFile>
+#include <QString>
+#include <vector>
+
+
+/** DafSummary holds the descriptor of a single array in a DAF file.
+  */
+struct DafSummary
+{
+    std::vector<double> doubles;
+    std::vector<int> integers;
+};
+
+
+/** DafFile provides read-only access to a SPICE Double precision Array File
+  * (the container used for binary SPK and CK kernels.) The file is memory
+  * mapped and the array summaries are read when the file is opened; array
+  * data is only read on demand.
+  *
+  * All of the read methods are const and touch no shared state, so a DafFile
+  * may be read from multiple threads at once.
+  */
+class DafFile : public vesta::Object
+{
+public:
+    ~DafFile();
+
+    static DafFile* open(const QString& fileName);
+
+    /** Return the architecture of the file, e.g. "SPK" or "CK".
+      */
+    QString architecture() const
+    {
+        return m_architecture;
+    }
+
+    QString fileName() const
+    {
+        return m_file.fileName();
+    }
+
+    unsigned int summaryCount() const
+    {
+        return m_summaries.size();
+    }
+
+    const DafSummary& summary(unsigned int index) const
+    {
+        return m_summaries[index];
+    }
+
+    unsigned int wordCount() const
+    {
+        return (unsigned int) (m_size / sizeof(double));
+    }
+
+    double readDouble(unsigned int address) const;
+    void readDoubles(unsigned int address, unsigned int count, double* out) const;
+
+private:
+    DafFile(const QString& fileName);
+    bool load();
+    int readInt(qint64 byteOffset) const;
+    double readDoubleAt(qint64 byteOffset) const;
+
+private:
+    QFile m_file;
+    const uchar* m_data;
+    qint64 m_size;
+    bool m_byteSwapped;
+    QString m_architecture;
+    std::vector<DafSummary> m_summaries;
+};
+
+#endif // _DAF_FILE_H_
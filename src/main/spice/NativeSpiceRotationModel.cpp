@@ -0,0 +1,390 @@
+// NativeSpiceRotationModel.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "NativeSpiceRotationModel.h"
+#include "SpiceMutex.h"
+#include <SpiceUsr.h>
+#include <QDebug>
+#include <algorithm>
+#include <cstdio>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// SPICE frame classes
+static const SpiceInt InertialFrameClass = 1;
+static const SpiceInt CkFrameClass = 3;
+
+// Spacing and maximum count of samples in the ephemeris time to clock table
+static const double ClockSampleInterval = 86400.0;
+static const unsigned int MaxClockSamples = 100000;
+
+// Number of times sampled when checking native evaluation against CSPICE, and
+// the largest acceptable difference in orientation (radians)
+static const unsigned int ValidationSampleCount = 16;
+static const double OrientationTolerance = 1.0e-6;
+
+
+NativeSpiceRotationModel::NativeSpiceRotationModel(SpiceKernelIndex* index,
+                                                   int instrument,
+                                                   SpiceRotationModel* fallback) :
+    m_index(index),
+    m_instrument(instrument),
+    m_fallback(fallback)
+{
+}
+
+
+NativeSpiceRotationModel::~NativeSpiceRotationModel()
+{
+}
+
+
+/** Create a new native SPICE rotation model. Returns null if the rotation can't
+  * be evaluated natively or if the native results don't agree with CSPICE; the
+  * caller should use a SpiceRotationModel instead.
+  */
+NativeSpiceRotationModel*
+NativeSpiceRotationModel::Create(SpiceKernelIndex* index, const char* fromFrame, const char* toFrame)
+{
+    if (!index)
+    {
+        return NULL;
+    }
+
+    SpiceInt instrument = 0;
+    SpiceInt sclkID = 0;
+    {
+        QMutexLocker locker(cspiceMutex());
+
+        SpiceInt frameID = 0;
+        SpiceInt center = 0;
+        SpiceInt frameClass = 0;
+        SpiceBoolean found = SPICEFALSE;
+        namfrm_c(fromFrame, &frameID);
+        frinfo_c(frameID, &center, &frameClass, &instrument, &found);
+        if (!failed_c() && found && frameClass == CkFrameClass)
+        {
+            ckmeta_c(instrument, "SCLK", &sclkID);
+        }
+
+        if (failed_c())
+        {
+            reset_c();
+            return NULL;
+        }
+
+        if (!found || frameClass != CkFrameClass)
+        {
+            return NULL;
+        }
+    }
+
+    if (!index->hasCkData(instrument))
+    {
+        return NULL;
+    }
+
+    NativeSpiceRotationModel* rotationModel = new NativeSpiceRotationModel(index, instrument,
+                                                                           new SpiceRotationModel(fromFrame, toFrame));
+    if (!rotationModel->setup(toFrame) || !rotationModel->buildClockTable(sclkID))
+    {
+        delete rotationModel;
+        return NULL;
+    }
+
+    if (!rotationModel->validate(fromFrame, toFrame))
+    {
+        qDebug() << "Native CK evaluation disagrees with CSPICE for frame" << fromFrame << "; using CSPICE";
+        delete rotationModel;
+        return NULL;
+    }
+
+    return rotationModel;
+}
+
+
+// Compute the rotations from the reference frames of the CK segments to the
+// target frame. These are only constant when all frames are inertial.
+bool
+NativeSpiceRotationModel::setup(const char* toFrame)
+{
+    QMutexLocker locker(cspiceMutex());
+
+    vector<int> referenceFrames = m_index->ckReferenceFrames(m_instrument);
+    vector<int> frames = referenceFrames;
+
+    SpiceInt toFrameID = 0;
+    namfrm_c(toFrame, &toFrameID);
+    frames.push_back(toFrameID);
+
+    for (unsigned int i = 0; i < frames.size(); ++i)
+    {
+        SpiceInt center = 0;
+        SpiceInt frameClass = 0;
+        SpiceInt classID = 0;
+        SpiceBoolean found = SPICEFALSE;
+        frinfo_c(frames[i], &center, &frameClass, &classID, &found);
+        if (failed_c())
+        {
+            reset_c();
+            return false;
+        }
+
+        if (!found || frameClass != InertialFrameClass)
+        {
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < referenceFrames.size(); ++i)
+    {
+        SpiceChar frameName[64];
+        SpiceDouble transform[3][3];
+        frmnam_c(referenceFrames[i], sizeof(frameName), frameName);
+        pxform_c(frameName, toFrame, 0.0, transform);
+        if (failed_c())
+        {
+            reset_c();
+            return false;
+        }
+
+        Matrix3d R;
+        R << transform[0][0], transform[0][1], transform[0][2],
+             transform[1][0], transform[1][1], transform[1][2],
+             transform[2][0], transform[2][1], transform[2][2];
+        m_referenceRotations[referenceFrames[i]] = R;
+    }
+
+    return true;
+}
+
+
+// Sample the conversion from ephemeris time to spacecraft clock over the span of
+// the CK data. For type 1 clocks, the conversion is linear between the knots of
+// the coefficient table (apart from the tiny periodic TDT-TDB difference), so the
+// knots are always included.
+bool
+NativeSpiceRotationModel::buildClockTable(int sclkID)
+{
+    double startTick = 0.0;
+    double endTick = 0.0;
+    if (!m_index->ckCoverage(m_instrument, &startTick, &endTick))
+    {
+        return false;
+    }
+
+    QMutexLocker locker(cspiceMutex());
+
+    vector<pair<double, double> > samples;
+
+    SpiceDouble startEt = 0.0;
+    SpiceDouble endEt = 0.0;
+    sct2e_c(sclkID, startTick, &startEt);
+    sct2e_c(sclkID, endTick, &endEt);
+    samples.push_back(make_pair(startEt, startTick));
+    samples.push_back(make_pair(endEt, endTick));
+
+    char coefficientsName[64];
+    sprintf(coefficientsName, "SCLK01_COEFFICIENTS_%d", -sclkID);
+    SpiceBoolean found = SPICEFALSE;
+    SpiceInt coefficientCount = 0;
+    SpiceChar dataType[2];
+    dtpool_c(coefficientsName, &found, &coefficientCount, dataType);
+    if (found && coefficientCount >= 3)
+    {
+        vector<SpiceDouble> coefficients(coefficientCount);
+        gdpool_c(coefficientsName, 0, coefficientCount, &coefficientCount, &coefficients[0], &found);
+        for (SpiceInt i = 0; i + 2 < coefficientCount; i += 3)
+        {
+            double ticks = coefficients[i];
+            if (ticks > startTick && ticks < endTick)
+            {
+                SpiceDouble et = 0.0;
+                sct2e_c(sclkID, ticks, &et);
+                samples.push_back(make_pair(et, ticks));
+            }
+        }
+    }
+
+    double interval = max(ClockSampleInterval, (endEt - startEt) / MaxClockSamples);
+    for (double et = startEt + interval; et < endEt; et += interval)
+    {
+        SpiceDouble ticks = 0.0;
+        sce2c_c(sclkID, et, &ticks);
+        samples.push_back(make_pair(et, ticks));
+    }
+
+    if (failed_c())
+    {
+        reset_c();
+        return false;
+    }
+
+    sort(samples.begin(), samples.end());
+    for (unsigned int i = 0; i < samples.size(); ++i)
+    {
+        if (m_clockTimes.empty() || samples[i].first > m_clockTimes.back())
+        {
+            m_clockTimes.push_back(samples[i].first);
+            m_clockTicks.push_back(samples[i].second);
+        }
+    }
+
+    return m_clockTimes.size() >= 2;
+}
+
+
+// Compare native orientations with pxform_c over the span of the CK data. Times
+// where neither can compute an orientation are ignored, but an orientation that
+// can only be computed by one of them is a failure.
+bool
+NativeSpiceRotationModel::validate(const char* fromFrame, const char* toFrame) const
+{
+    double startTime = m_clockTimes.front();
+    double endTime = m_clockTimes.back();
+    unsigned int comparedCount = 0;
+
+    QMutexLocker locker(cspiceMutex());
+
+    for (unsigned int i = 0; i < ValidationSampleCount; ++i)
+    {
+        double et = startTime + (endTime - startTime) * (i + 0.5) / ValidationSampleCount;
+
+        Quaterniond q;
+        Vector3d w;
+        bool nativeOk = pointing(et, &q, &w);
+
+        SpiceDouble transform[3][3];
+        pxform_c(fromFrame, toFrame, et, transform);
+        bool spiceOk = !failed_c();
+        if (!spiceOk)
+        {
+            reset_c();
+        }
+
+        if (nativeOk != spiceOk)
+        {
+            return false;
+        }
+
+        if (nativeOk)
+        {
+            Matrix3d R;
+            R << transform[0][0], transform[0][1], transform[0][2],
+                 transform[1][0], transform[1][1], transform[1][2],
+                 transform[2][0], transform[2][1], transform[2][2];
+            if (q.angularDistance(Quaterniond(R)) > OrientationTolerance)
+            {
+                return false;
+            }
+            ++comparedCount;
+        }
+    }
+
+    return comparedCount > 0;
+}
+
+
+bool
+NativeSpiceRotationModel::clockTicks(double et, double* ticks) const
+{
+    if (m_clockTimes.empty() || et < m_clockTimes.front() || et > m_clockTimes.back())
+    {
+        return false;
+    }
+
+    unsigned int i = upper_bound(m_clockTimes.begin(), m_clockTimes.end(), et) - m_clockTimes.begin();
+    if (i == m_clockTimes.size())
+    {
+        *ticks = m_clockTicks.back();
+    }
+    else
+    {
+        double t = (et - m_clockTimes[i - 1]) / (m_clockTimes[i] - m_clockTimes[i - 1]);
+        *ticks = m_clockTicks[i - 1] + t * (m_clockTicks[i] - m_clockTicks[i - 1]);
+    }
+
+    return true;
+}
+
+
+// Compute the rotation from the CK frame to the target frame, and the angular
+// velocity of the CK frame expressed in the target frame.
+bool
+NativeSpiceRotationModel::pointing(double et, Quaterniond* q, Vector3d* angularVelocity) const
+{
+    double ticks = 0.0;
+    if (!clockTicks(et, &ticks))
+    {
+        return false;
+    }
+
+    Quaterniond c;
+    Vector3d w;
+    int referenceFrame = 0;
+    if (!m_index->ckPointing(m_instrument, ticks, &c, &w, &referenceFrame))
+    {
+        return false;
+    }
+
+    map<int, Matrix3d>::const_iterator iter = m_referenceRotations.find(referenceFrame);
+    if (iter == m_referenceRotations.end())
+    {
+        return false;
+    }
+
+    // The C-matrix rotates from the reference frame to the CK frame; we want
+    // the inverse, followed by the rotation into the target frame.
+    *q = Quaterniond(iter->second) * c.conjugate();
+    *angularVelocity = iter->second * w;
+
+    return true;
+}
+
+
+Quaterniond
+NativeSpiceRotationModel::orientation(double tdbSec) const
+{
+    Quaterniond q;
+    Vector3d w;
+    if (pointing(tdbSec, &q, &w))
+    {
+        return q;
+    }
+    else
+    {
+        return m_fallback->orientation(tdbSec);
+    }
+}
+
+
+Vector3d
+NativeSpiceRotationModel::angularVelocity(double tdbSec) const
+{
+    Quaterniond q;
+    Vector3d w;
+    if (pointing(tdbSec, &q, &w))
+    {
+        return w;
+    }
+    else
+    {
+        return m_fallback->angularVelocity(tdbSec);
+    }
+}
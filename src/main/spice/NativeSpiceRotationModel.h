@@ -0,0 +1,73 @@
+// NativeSpiceRotationModel.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _NATIVE_SPICE_ROTATION_MODEL_H_
+#define _NATIVE_SPICE_ROTATION_MODEL_H_
+
+#include "SpiceKernelIndex.h"
+#include "SpiceRotationModel.h"
+#include <vesta/RotationModel.h>
+#include <map>
+#include <vector>
+
+
+/** NativeSpiceRotationModel computes the orientation of a CK frame directly
+  * from memory mapped CK files rather than calling pxform_c, so it needs no
+  * lock and may be evaluated from any thread.
+  *
+  * Only CK frames whose segments are relative to inertial frames, with an
+  * inertial target frame, are handled natively. Conversion from ephemeris time
+  * to spacecraft clock ticks uses a table sampled from CSPICE when the model is
+  * created. Whenever native evaluation isn't possible, the model falls back to
+  * an ordinary SpiceRotationModel.
+  */
+class NativeSpiceRotationModel : public vesta::RotationModel
+{
+public:
+    ~NativeSpiceRotationModel();
+
+    static NativeSpiceRotationModel* Create(SpiceKernelIndex* index,
+                                            const char* fromFrame,
+                                            const char* toFrame);
+
+    virtual Eigen::Quaterniond orientation(double tdbSec) const;
+    virtual Eigen::Vector3d angularVelocity(double tdbSec) const;
+
+private:
+    NativeSpiceRotationModel(SpiceKernelIndex* index,
+                             int instrument,
+                             SpiceRotationModel* fallback);
+
+    bool setup(const char* toFrame);
+    bool buildClockTable(int sclkID);
+    bool validate(const char* fromFrame, const char* toFrame) const;
+    bool pointing(double et, Eigen::Quaterniond* q, Eigen::Vector3d* angularVelocity) const;
+    bool clockTicks(double et, double* ticks) const;
+
+private:
+    vesta::counted_ptr<SpiceKernelIndex> m_index;
+    int m_instrument;
+    vesta::counted_ptr<SpiceRotationModel> m_fallback;
+
+    // Constant rotations from each CK reference frame to the target frame
+    std::map<int, Eigen::Matrix3d> m_referenceRotations;
+
+    // Piecewise linear map from ephemeris time to encoded spacecraft clock
+    std::vector<double> m_clockTimes;
+    std::vector<double> m_clockTicks;
+};
+
+#endif // _NATIVE_SPICE_ROTATION_MODEL_H_
@@ -0,0 +1,200 @@
+// NativeSpiceTrajectory.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "NativeSpiceTrajectory.h"
+#include "SpiceMutex.h"
+#include <SpiceUsr.h>
+#include <QDebug>
+#include <algorithm>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Number of times sampled when checking native evaluation against CSPICE
+static const unsigned int ValidationSampleCount = 16;
+
+// Largest acceptable differences from CSPICE (km and km/s)
+static const double PositionTolerance = 1.0e-3;
+static const double VelocityTolerance = 1.0e-6;
+
+
+NativeSpiceTrajectory::NativeSpiceTrajectory(SpiceKernelIndex* index,
+                                             int targetID,
+                                             int centerID,
+                                             int frameID,
+                                             SpiceTrajectory* fallback) :
+    m_index(index),
+    m_targetID(targetID),
+    m_centerID(centerID),
+    m_frameID(frameID),
+    m_fallback(fallback)
+{
+}
+
+
+NativeSpiceTrajectory::~NativeSpiceTrajectory()
+{
+}
+
+
+/** Create a new native SPICE trajectory. Returns null if the trajectory can't
+  * be evaluated natively or if the native results don't agree with CSPICE; the
+  * caller should use a SpiceTrajectory instead.
+  */
+NativeSpiceTrajectory*
+NativeSpiceTrajectory::Create(SpiceKernelIndex* index,
+                              int targetID,
+                              int centerID,
+                              const char* spiceFrame)
+{
+    if (!index || !index->hasSpkData(targetID))
+    {
+        return NULL;
+    }
+
+    SpiceInt frameID = 0;
+    {
+        QMutexLocker locker(cspiceMutex());
+        namfrm_c(spiceFrame, &frameID);
+        if (failed_c())
+        {
+            reset_c();
+            return NULL;
+        }
+    }
+
+    if (!SpiceKernelIndex::isSupportedFrame(frameID))
+    {
+        return NULL;
+    }
+
+    NativeSpiceTrajectory* trajectory = new NativeSpiceTrajectory(index, targetID, centerID, frameID,
+                                                                  new SpiceTrajectory(targetID, centerID, spiceFrame));
+    if (!trajectory->validate())
+    {
+        qDebug() << "Native SPK evaluation disagrees with CSPICE for target" << targetID << "; using CSPICE";
+        delete trajectory;
+        return NULL;
+    }
+
+    return trajectory;
+}
+
+
+// Compare native states with spkgeo_c over the span of the target's data. Times
+// where neither can compute a state are ignored, but a state that can only be
+// computed by one of them is a failure.
+bool
+NativeSpiceTrajectory::validate() const
+{
+    double startTime = 0.0;
+    double endTime = 0.0;
+    if (!m_index->spkCoverage(m_targetID, &startTime, &endTime))
+    {
+        return false;
+    }
+
+    QMutexLocker locker(cspiceMutex());
+
+    std::string frameName = m_frameID == SpiceKernelIndex::EclipJ2000Frame ? "ECLIPJ2000" : "J2000";
+    unsigned int comparedCount = 0;
+
+    for (unsigned int i = 0; i < ValidationSampleCount; ++i)
+    {
+        double et = startTime + (endTime - startTime) * (i + 0.5) / ValidationSampleCount;
+
+        double nativeSv[6];
+        bool nativeOk = m_index->geometricState(m_targetID, m_centerID, m_frameID, et, nativeSv);
+
+        SpiceDouble sv[6];
+        SpiceDouble lightTime = 0.0;
+        spkgeo_c(m_targetID, et, frameName.c_str(), m_centerID, sv, &lightTime);
+        bool spiceOk = !failed_c();
+        if (!spiceOk)
+        {
+            reset_c();
+        }
+
+        if (nativeOk != spiceOk)
+        {
+            return false;
+        }
+
+        if (nativeOk)
+        {
+            Vector3d dr(nativeSv[0] - sv[0], nativeSv[1] - sv[1], nativeSv[2] - sv[2]);
+            Vector3d dv(nativeSv[3] - sv[3], nativeSv[4] - sv[4], nativeSv[5] - sv[5]);
+            if (dr.norm() > PositionTolerance || dv.norm() > VelocityTolerance)
+            {
+                return false;
+            }
+            ++comparedCount;
+        }
+    }
+
+    return comparedCount > 0;
+}
+
+
+StateVector
+NativeSpiceTrajectory::state(double tdbSec) const
+{
+    // Clamp time to valid range
+    double et = std::max(startTime(), std::min(endTime(), tdbSec));
+
+    double sv[6];
+    if (m_index->geometricState(m_targetID, m_centerID, m_frameID, et, sv))
+    {
+        return StateVector(Vector3d(sv[0], sv[1], sv[2]), Vector3d(sv[3], sv[4], sv[5]));
+    }
+    else
+    {
+        return m_fallback->state(et);
+    }
+}
+
+
+double
+NativeSpiceTrajectory::period() const
+{
+    return m_fallback->period();
+}
+
+
+/** Set the period of an orbit. This is only used for determining how best to plot
+ *  the orbit. Setting the period to 0 indicates a non-repeating trajectory.
+ */
+void
+NativeSpiceTrajectory::setPeriod(double periodSeconds)
+{
+    m_fallback->setPeriod(periodSeconds);
+}
+
+
+bool
+NativeSpiceTrajectory::isPeriodic() const
+{
+    return m_fallback->isPeriodic();
+}
+
+
+double
+NativeSpiceTrajectory::boundingSphereRadius() const
+{
+    return m_fallback->boundingSphereRadius();
+}
@@ -0,0 +1,67 @@
+// NativeSpiceTrajectory.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _NATIVE_SPICE_TRAJECTORY_H_
+#define _NATIVE_SPICE_TRAJECTORY_H_
+
+#include "SpiceKernelIndex.h"
+#include "SpiceTrajectory.h"
+#include <vesta/Trajectory.h>
+
+
+/** NativeSpiceTrajectory computes geometric states directly from memory mapped
+  * SPK files rather than calling spkgeo_c, so it needs no lock and may be
+  * evaluated from any thread. When a state can't be computed natively (e.g.
+  * an unsupported segment type is selected), the trajectory falls back to an
+  * ordinary SpiceTrajectory.
+  *
+  * Use Create() rather than the constructor: it checks the native evaluation
+  * against CSPICE before returning a trajectory.
+  */
+class NativeSpiceTrajectory : public vesta::Trajectory
+{
+public:
+    NativeSpiceTrajectory(SpiceKernelIndex* index,
+                          int targetID,
+                          int centerID,
+                          int frameID,
+                          SpiceTrajectory* fallback);
+    ~NativeSpiceTrajectory();
+
+    static NativeSpiceTrajectory* Create(SpiceKernelIndex* index,
+                                         int targetID,
+                                         int centerID,
+                                         const char* spiceFrame);
+
+    virtual vesta::StateVector state(double tdbSec) const;
+    virtual double boundingSphereRadius() const;
+    virtual bool isPeriodic() const;
+    virtual double period() const;
+
+    void setPeriod(double period);
+
+private:
+    bool validate() const;
+
+private:
+    vesta::counted_ptr<SpiceKernelIndex> m_index;
+    int m_targetID;
+    int m_centerID;
+    int m_frameID;
+    vesta::counted_ptr<SpiceTrajectory> m_fallback;
+};
+
+#endif // _NATIVE_SPICE_TRAJECTORY_H_
@@ -0,0 +1,430 @@
+// SpiceKernelIndex.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SpiceKernelIndex.h"
+#include "SpiceMutex.h"
+#include <SpiceUsr.h>
+#include <QHash>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Longest chain of centers followed when evaluating a state; SPICE uses the same limit.
+static const unsigned int MaxChainLength = 100;
+
+// Obliquity of the ecliptic used by SPICE for the ECLIPJ2000 frame (84381.448 arcsec)
+static const double EclipJ2000Obliquity = 84381.448 / 3600.0 * 3.14159265358979323846 / 180.0;
+
+
+// Rotate the position and velocity from the ecliptic frame into the
+// equatorial frame (toEquatorial = true) or the reverse.
+static void
+rotateEcliptic(double* sv, bool toEquatorial)
+{
+    double c = cos(EclipJ2000Obliquity);
+    double s = toEquatorial ? -sin(EclipJ2000Obliquity) : sin(EclipJ2000Obliquity);
+
+    for (unsigned int i = 0; i < 6; i += 3)
+    {
+        double y = sv[i + 1];
+        double z = sv[i + 2];
+        sv[i + 1] =  c * y + s * z;
+        sv[i + 2] = -s * y + c * z;
+    }
+}
+
+
+SpiceKernelIndex::SpiceKernelIndex()
+{
+}
+
+
+SpiceKernelIndex::~SpiceKernelIndex()
+{
+}
+
+
+/** Build an index of all SPK and CK files currently loaded in CSPICE. Files
+  * that were already opened by the previous index are shared rather than
+  * mapped again.
+  */
+SpiceKernelIndex*
+SpiceKernelIndex::fromLoadedKernels(const SpiceKernelIndex* previous)
+{
+    QHash<QString, DafFile*> openFiles;
+    if (previous)
+    {
+        for (unsigned int i = 0; i < previous->m_files.size(); ++i)
+        {
+            DafFile* file = previous->m_files[i].ptr();
+            openFiles.insert(file->fileName(), file);
+        }
+    }
+
+    QStringList fileNames;
+    {
+        QMutexLocker locker(cspiceMutex());
+
+        SpiceInt count = 0;
+        ktotal_c("SPK CK", &count);
+        for (SpiceInt i = 0; i < count; ++i)
+        {
+            SpiceChar fileName[1024];
+            SpiceChar fileType[32];
+            SpiceChar source[1024];
+            SpiceInt handle = 0;
+            SpiceBoolean found = SPICEFALSE;
+            kdata_c(i, "SPK CK", sizeof(fileName), sizeof(fileType), sizeof(source), fileName, fileType, source, &handle, &found);
+            if (found)
+            {
+                fileNames << QString::fromLatin1(fileName);
+            }
+        }
+
+        if (failed_c())
+        {
+            reset_c();
+        }
+    }
+
+    SpiceKernelIndex* index = new SpiceKernelIndex();
+
+    // kdata_c reports files in load order, which is lowest to highest priority
+    foreach (QString fileName, fileNames)
+    {
+        DafFile* file = openFiles.value(fileName);
+        if (!file)
+        {
+            file = DafFile::open(fileName);
+        }
+
+        if (file)
+        {
+            index->addFile(file);
+        }
+        else
+        {
+            qDebug() << "Unable to read SPICE kernel " << fileName << " natively";
+        }
+    }
+
+    return index;
+}
+
+
+void
+SpiceKernelIndex::addFile(DafFile* file)
+{
+    m_files.push_back(counted_ptr<DafFile>(file));
+
+    bool isSpk = file->architecture() == "SPK";
+    bool isCk = file->architecture() == "CK";
+    for (unsigned int i = 0; i < file->summaryCount(); ++i)
+    {
+        if (isSpk)
+        {
+            SpkSegment segment(file, file->summary(i));
+            m_spkSegments[segment.target()].push_back(segment);
+        }
+        else if (isCk)
+        {
+            CkSegment segment(file, file->summary(i));
+            m_ckSegments[segment.instrument()].push_back(segment);
+        }
+    }
+}
+
+
+bool
+SpiceKernelIndex::isSupportedFrame(int frame)
+{
+    return frame == J2000Frame || frame == EclipJ2000Frame;
+}
+
+
+/** Return true if there are any SPK segments for the specified target.
+  */
+bool
+SpiceKernelIndex::hasSpkData(int target) const
+{
+    return m_spkSegments.find(target) != m_spkSegments.end();
+}
+
+
+/** Get the earliest and latest times covered by SPK segments for the target.
+  * Note that there may be gaps in the coverage.
+  */
+bool
+SpiceKernelIndex::spkCoverage(int target, double* startTime, double* endTime) const
+{
+    map<int, vector<SpkSegment> >::const_iterator iter = m_spkSegments.find(target);
+    if (iter == m_spkSegments.end())
+    {
+        return false;
+    }
+
+    const vector<SpkSegment>& segments = iter->second;
+    *startTime = segments.front().startTime();
+    *endTime = segments.front().endTime();
+    for (unsigned int i = 1; i < segments.size(); ++i)
+    {
+        *startTime = min(*startTime, segments[i].startTime());
+        *endTime = max(*endTime, segments[i].endTime());
+    }
+
+    return true;
+}
+
+
+// Compute the J2000 state of a target relative to the center of the highest
+// priority segment covering the time.
+bool
+SpiceKernelIndex::segmentState(int target, double et, double* sv, int* center) const
+{
+    map<int, vector<SpkSegment> >::const_iterator iter = m_spkSegments.find(target);
+    if (iter == m_spkSegments.end())
+    {
+        return false;
+    }
+
+    const vector<SpkSegment>& segments = iter->second;
+    for (unsigned int i = segments.size(); i > 0; --i)
+    {
+        const SpkSegment& segment = segments[i - 1];
+        if (segment.covers(et))
+        {
+            // Only the highest priority segment may be used; if we can't evaluate
+            // it, CSPICE must.
+            if (!isSupportedFrame(segment.frame()) || !segment.state(et, sv))
+            {
+                return false;
+            }
+
+            if (segment.frame() == EclipJ2000Frame)
+            {
+                rotateEcliptic(sv, true);
+            }
+
+            *center = segment.center();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/** Compute the geometric state (no light time or aberration corrections) of the
+  * target relative to the center, equivalent to spkgeo_c.
+  *
+  * \param frame NAIF id of the output frame; must be J2000 or ECLIPJ2000
+  * \param sv array of six doubles that receives the position (km) and velocity (km/s)
+  * \return false if the state can't be computed from the indexed kernels
+  */
+bool
+SpiceKernelIndex::geometricState(int target, int center, int frame, double et, double* sv) const
+{
+    if (!isSupportedFrame(frame))
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        sv[i] = 0.0;
+    }
+
+    if (target == center)
+    {
+        return true;
+    }
+
+    // Walk the chain of centers from the target, recording the state of the target
+    // relative to each body along the way.
+    int chainBodies[MaxChainLength];
+    double chainStates[MaxChainLength][6];
+    unsigned int chainLength = 1;
+    chainBodies[0] = target;
+    for (unsigned int j = 0; j < 6; ++j)
+    {
+        chainStates[0][j] = 0.0;
+    }
+
+    while (chainLength < MaxChainLength)
+    {
+        double segmentSv[6];
+        int segmentCenter = 0;
+        if (!segmentState(chainBodies[chainLength - 1], et, segmentSv, &segmentCenter))
+        {
+            break;
+        }
+
+        chainBodies[chainLength] = segmentCenter;
+        for (unsigned int j = 0; j < 6; ++j)
+        {
+            chainStates[chainLength][j] = chainStates[chainLength - 1][j] + segmentSv[j];
+        }
+        ++chainLength;
+    }
+
+    // Now walk the chain from the center until it meets the target chain
+    double centerState[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    int body = center;
+    for (unsigned int step = 0; step < MaxChainLength; ++step)
+    {
+        for (unsigned int i = 0; i < chainLength; ++i)
+        {
+            if (chainBodies[i] == body)
+            {
+                for (unsigned int j = 0; j < 6; ++j)
+                {
+                    sv[j] = chainStates[i][j] - centerState[j];
+                }
+
+                if (frame == EclipJ2000Frame)
+                {
+                    rotateEcliptic(sv, false);
+                }
+
+                return true;
+            }
+        }
+
+        double segmentSv[6];
+        int segmentCenter = 0;
+        if (!segmentState(body, et, segmentSv, &segmentCenter))
+        {
+            return false;
+        }
+
+        for (unsigned int j = 0; j < 6; ++j)
+        {
+            centerState[j] += segmentSv[j];
+        }
+        body = segmentCenter;
+    }
+
+    return false;
+}
+
+
+/** Return true if there are any CK segments for the specified instrument.
+  */
+bool
+SpiceKernelIndex::hasCkData(int instrument) const
+{
+    return m_ckSegments.find(instrument) != m_ckSegments.end();
+}
+
+
+/** Get the earliest and latest encoded spacecraft clock times covered by CK
+  * segments for the instrument. Note that there may be gaps in the coverage.
+  */
+bool
+SpiceKernelIndex::ckCoverage(int instrument, double* startTick, double* endTick) const
+{
+    map<int, vector<CkSegment> >::const_iterator iter = m_ckSegments.find(instrument);
+    if (iter == m_ckSegments.end())
+    {
+        return false;
+    }
+
+    const vector<CkSegment>& segments = iter->second;
+    *startTick = segments.front().startTick();
+    *endTick = segments.front().endTick();
+    for (unsigned int i = 1; i < segments.size(); ++i)
+    {
+        *startTick = min(*startTick, segments[i].startTick());
+        *endTick = max(*endTick, segments[i].endTick());
+    }
+
+    return true;
+}
+
+
+/** Get the NAIF ids of all reference frames used by CK segments for the
+  * instrument.
+  */
+vector<int>
+SpiceKernelIndex::ckReferenceFrames(int instrument) const
+{
+    vector<int> frames;
+
+    map<int, vector<CkSegment> >::const_iterator iter = m_ckSegments.find(instrument);
+    if (iter != m_ckSegments.end())
+    {
+        const vector<CkSegment>& segments = iter->second;
+        for (unsigned int i = 0; i < segments.size(); ++i)
+        {
+            if (find(frames.begin(), frames.end(), segments[i].referenceFrame()) == frames.end())
+            {
+                frames.push_back(segments[i].referenceFrame());
+            }
+        }
+    }
+
+    return frames;
+}
+
+
+/** Compute the pointing of an instrument at the specified encoded spacecraft
+  * clock time. Unlike SPK data, a CK segment that covers the time may still
+  * have no pointing for it (because of gaps between interpolation intervals);
+  * in that case, lower priority segments are searched, as CSPICE does.
+  *
+  * \param q receives the rotation from the reference frame to the instrument frame
+  * \param angularVelocity receives the angular velocity in the reference frame
+  * \param referenceFrame receives the NAIF id of the segment's reference frame
+  */
+bool
+SpiceKernelIndex::ckPointing(int instrument,
+                             double ticks,
+                             Quaterniond* q,
+                             Vector3d* angularVelocity,
+                             int* referenceFrame) const
+{
+    map<int, vector<CkSegment> >::const_iterator iter = m_ckSegments.find(instrument);
+    if (iter == m_ckSegments.end())
+    {
+        return false;
+    }
+
+    const vector<CkSegment>& segments = iter->second;
+    for (unsigned int i = segments.size(); i > 0; --i)
+    {
+        const CkSegment& segment = segments[i - 1];
+        if (segment.covers(ticks))
+        {
+            if (!segment.isValid())
+            {
+                return false;
+            }
+
+            if (segment.pointing(ticks, q, angularVelocity))
+            {
+                *referenceFrame = segment.referenceFrame();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
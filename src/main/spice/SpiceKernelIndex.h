@@ -0,0 +1,80 @@
+// SpiceKernelIndex.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SPICE_KERNEL_INDEX_H_
+#define _SPICE_KERNEL_INDEX_H_
+
+#include "DafFile.h"
+#include "SpkSegment.h"
+#include "CkSegment.h"
+#include <vesta/Object.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <map>
+#include <vector>
+
+
+/** SpiceKernelIndex is an immutable snapshot of the binary SPK and CK kernels
+  * loaded into CSPICE. It memory maps the kernel files and evaluates segments
+  * directly, so that trajectories and rotation models can be evaluated without
+  * taking the CSPICE lock.
+  *
+  * Segment selection follows the SPICE rules: files loaded later take priority
+  * over files loaded earlier, and within a file later segments take priority over
+  * earlier ones. Segments of unsupported types are still indexed so that they
+  * correctly mask lower priority data; evaluation fails when such a segment is
+  * selected, and callers should fall back to CSPICE.
+  *
+  * Since the index is never modified after creation, it may be shared by
+  * multiple threads.
+  */
+class SpiceKernelIndex : public vesta::Object
+{
+public:
+    ~SpiceKernelIndex();
+
+    static SpiceKernelIndex* fromLoadedKernels(const SpiceKernelIndex* previous);
+
+    bool hasSpkData(int target) const;
+    bool spkCoverage(int target, double* startTime, double* endTime) const;
+    bool geometricState(int target, int center, int frame, double et, double* sv) const;
+
+    bool hasCkData(int instrument) const;
+    bool ckCoverage(int instrument, double* startTick, double* endTick) const;
+    std::vector<int> ckReferenceFrames(int instrument) const;
+    bool ckPointing(int instrument, double ticks, Eigen::Quaterniond* q, Eigen::Vector3d* angularVelocity, int* referenceFrame) const;
+
+    static bool isSupportedFrame(int frame);
+
+    // NAIF ids of the inertial frames that native SPK evaluation can produce
+    static const int J2000Frame = 1;
+    static const int EclipJ2000Frame = 17;
+
+private:
+    SpiceKernelIndex();
+    void addFile(DafFile* file);
+    bool segmentState(int target, double et, double* sv, int* center) const;
+
+private:
+    std::vector<vesta::counted_ptr<DafFile> > m_files;
+
+    // Segments are stored in load order; search from the back to find the
+    // highest priority data.
+    std::map<int, std::vector<SpkSegment> > m_spkSegments;
+    std::map<int, std::vector<CkSegment> > m_ckSegments;
+};
+
+#endif // _SPICE_KERNEL_INDEX_H_
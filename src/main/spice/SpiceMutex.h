@@ -0,0 +1,28 @@
+// SpiceMutex.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SPICE_MUTEX_H_
+#define _SPICE_MUTEX_H_
+
+#include <QMutex>
+
+// CSPICE keeps global state (the kernel pool, loaded file tables, and error
+// status) and is not thread safe. Every call into CSPICE must be made while
+// holding this mutex. The mutex is recursive so that helper functions that lock
+// it may be called by code that already holds it.
+QMutex* cspiceMutex();
+
+#endif // _SPICE_MUTEX_H_
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "SpiceRotationModel.h"
+#include "SpiceMutex.h"
 #include <SpiceUsr.h>
 
 using namespace vesta;
@@ -40,6 +41,7 @@ SpiceRotationModel::orientation(double tdbSec) const
     double et = tdbSec;
     SpiceDouble transform[3][3];
 
+    QMutexLocker locker(cspiceMutex());
     pxform_c(m_fromFrame.c_str(), m_toFrame.c_str(), et, transform);
     if (!failed_c())
     {
@@ -66,6 +68,7 @@ SpiceRotationModel::angularVelocity(double tdbSec) const
     double et = tdbSec;
     SpiceDouble transform[6][6];
 
+    QMutexLocker locker(cspiceMutex());
     sxform_c(m_fromFrame.c_str(), m_toFrame.c_str(), et, transform);
     if (!failed_c())
     {
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "SpiceTrajectory.h"
+#include "SpiceMutex.h"
 #include <algorithm>
 #include <iostream>
 
@@ -43,6 +44,8 @@ SpiceTrajectory::state(double tdbSec) const
     // Clamp time to valid range
     double et = std::max(startTime(), std::min(endTime(), tdbSec));
 
+    QMutexLocker locker(cspiceMutex());
+
     SpiceDouble sv[6];
     SpiceDouble lightTime;
     spkgeo_c(m_targetID, et, m_spiceFrame.c_str(), m_centerID, sv, &lightTime);
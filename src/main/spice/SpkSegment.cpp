@@ -0,0 +1,523 @@
+// SpkSegment.cpp
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SpkSegment.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+/** Create a segment from an SPK array summary. The summary must have two double
+  * components (start and end time) and six integer components (target, center,
+  * frame, type, begin address, end address.) Check isValid() to determine whether
+  * the segment is of a supported type and has a sensible layout.
+  */
+SpkSegment::SpkSegment(const DafFile* file, const DafSummary& summary) :
+    m_file(file),
+    m_valid(false),
+    m_target(0),
+    m_center(0),
+    m_frame(0),
+    m_type(0),
+    m_startTime(0.0),
+    m_endTime(0.0),
+    m_begin(0),
+    m_end(0),
+    m_initialEpoch(0.0),
+    m_intervalLength(0.0),
+    m_recordSize(0),
+    m_recordCount(0),
+    m_epochs(0),
+    m_windowSize(0),
+    m_differenceLineSize(0)
+{
+    if (summary.doubles.size() < 2 || summary.integers.size() < 6)
+    {
+        return;
+    }
+
+    m_startTime = summary.doubles[0];
+    m_endTime   = summary.doubles[1];
+    m_target    = summary.integers[0];
+    m_center    = summary.integers[1];
+    m_frame     = summary.integers[2];
+    m_type      = summary.integers[3];
+    m_begin     = (unsigned int) summary.integers[4];
+    m_end       = (unsigned int) summary.integers[5];
+
+    if (!isSupportedType(m_type) || m_begin == 0 || m_end <= m_begin || m_end > file->wordCount())
+    {
+        return;
+    }
+
+    unsigned int segmentSize = m_end - m_begin + 1;
+
+    if (m_type == 2 || m_type == 3)
+    {
+        // Directory at the end of the segment: INIT, INTLEN, RSIZE, N
+        double directory[4];
+        file->readDoubles(m_end - 3, 4, directory);
+        m_initialEpoch   = directory[0];
+        m_intervalLength = directory[1];
+        m_recordSize     = (unsigned int) directory[2];
+        m_recordCount    = (unsigned int) directory[3];
+
+        unsigned int componentCount = m_type == 2 ? 3 : 6;
+        m_valid = m_intervalLength > 0.0 &&
+                  m_recordCount > 0 &&
+                  m_recordSize > 2 + componentCount &&
+                  m_recordSize <= MaxRecordSize &&
+                  (m_recordSize - 2) % componentCount == 0 &&
+                  m_recordSize * m_recordCount + 4 <= segmentSize;
+    }
+    else if (m_type == 9 || m_type == 13)
+    {
+        // Trailer: degree (type 9) or window size - 1 (type 13), N
+        double trailer[2];
+        file->readDoubles(m_end - 1, 2, trailer);
+        m_windowSize  = (unsigned int) trailer[0] + 1;
+        m_recordCount = (unsigned int) trailer[1];
+        m_epochs = m_begin + m_recordCount * 6;
+
+        m_valid = m_recordCount > 0 &&
+                  m_windowSize >= 2 &&
+                  m_windowSize <= MaxWindowSize &&
+                  m_recordCount * 7 + 2 <= segmentSize;
+        m_windowSize = min(m_windowSize, m_recordCount);
+    }
+    else if (m_type == 21)
+    {
+        // Trailer: maximum difference line size, N
+        double trailer[2];
+        file->readDoubles(m_end - 1, 2, trailer);
+        m_differenceLineSize = (unsigned int) trailer[0];
+        m_recordCount = (unsigned int) trailer[1];
+        m_recordSize = 4 * m_differenceLineSize + 11;
+        m_epochs = m_begin + m_recordCount * m_recordSize;
+
+        m_valid = m_recordCount > 0 &&
+                  m_differenceLineSize >= 2 &&
+                  m_differenceLineSize <= MaxDifferenceLineSize &&
+                  m_recordCount * (m_recordSize + 1) + 2 <= segmentSize;
+    }
+}
+
+
+bool
+SpkSegment::isSupportedType(int type)
+{
+    return type == 2 || type == 3 || type == 9 || type == 13 || type == 21;
+}
+
+
+/** Compute the state of the target relative to the center at the specified time.
+  * The state is given in the segment's reference frame, with units of km and km/s.
+  *
+  * \param et time in seconds since J2000 TDB
+  * \param sv array to receive six state vector components (position then velocity)
+  * \return true if the state was calculated successfully
+  */
+bool
+SpkSegment::state(double et, double* sv) const
+{
+    if (!m_valid)
+    {
+        return false;
+    }
+
+    switch (m_type)
+    {
+    case 2:
+    case 3:
+        return chebyshevState(et, sv);
+    case 9:
+        return lagrangeState(et, sv);
+    case 13:
+        return hermiteState(et, sv);
+    case 21:
+        return differenceLineState(et, sv);
+    default:
+        return false;
+    }
+}
+
+
+// Types 2 and 3: Chebyshev polynomials over fixed length intervals. Each record is
+// MID, RADIUS, followed by coefficients for X, Y, Z (and VX, VY, VZ for type 3.)
+bool
+SpkSegment::chebyshevState(double et, double* sv) const
+{
+    int recordIndex = int(floor((et - m_initialEpoch) / m_intervalLength));
+    recordIndex = max(0, min(int(m_recordCount) - 1, recordIndex));
+
+    double record[MaxRecordSize];
+    m_file->readDoubles(m_begin + recordIndex * m_recordSize, m_recordSize, record);
+
+    double mid = record[0];
+    double radius = record[1];
+    if (radius == 0.0)
+    {
+        return false;
+    }
+
+    unsigned int componentCount = m_type == 2 ? 3 : 6;
+    unsigned int coeffCount = (m_recordSize - 2) / componentCount;
+    double u = (et - mid) / radius;
+
+    // Chebyshev polynomials and their derivatives
+    double t[MaxRecordSize];
+    double dt[MaxRecordSize];
+    t[0] = 1.0;
+    dt[0] = 0.0;
+    if (coeffCount > 1)
+    {
+        t[1] = u;
+        dt[1] = 1.0;
+    }
+    for (unsigned int i = 2; i < coeffCount; ++i)
+    {
+        t[i] = 2.0 * u * t[i - 1] - t[i - 2];
+        dt[i] = 2.0 * u * dt[i - 1] - dt[i - 2] + 2.0 * t[i - 1];
+    }
+
+    for (unsigned int component = 0; component < 3; ++component)
+    {
+        const double* coeffs = record + 2 + component * coeffCount;
+        double p = 0.0;
+        double v = 0.0;
+        for (unsigned int i = 0; i < coeffCount; ++i)
+        {
+            p += coeffs[i] * t[i];
+            v += coeffs[i] * dt[i];
+        }
+
+        sv[component] = p;
+        if (m_type == 2)
+        {
+            // Velocity is the derivative of the position polynomial
+            sv[component + 3] = v / radius;
+        }
+        else
+        {
+            const double* velocityCoeffs = record + 2 + (component + 3) * coeffCount;
+            double vel = 0.0;
+            for (unsigned int i = 0; i < coeffCount; ++i)
+            {
+                vel += velocityCoeffs[i] * t[i];
+            }
+            sv[component + 3] = vel;
+        }
+    }
+
+    return true;
+}
+
+
+// Return the index of the last epoch less than or equal to et, or zero if all
+// epochs are after et.
+unsigned int
+SpkSegment::lastEpochNotAfter(double et) const
+{
+    unsigned int low = 0;
+    unsigned int high = m_recordCount;
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        if (m_file->readDouble(m_epochs + mid) <= et)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low > 0 ? low - 1 : 0;
+}
+
+
+// Return the index of the first epoch greater than or equal to et; the last
+// epoch is returned if all epochs are before et.
+unsigned int
+SpkSegment::firstEpochNotBefore(double et) const
+{
+    unsigned int low = 0;
+    unsigned int high = m_recordCount;
+    while (low < high)
+    {
+        unsigned int mid = low + (high - low) / 2;
+        if (m_file->readDouble(m_epochs + mid) < et)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return min(low, m_recordCount - 1);
+}
+
+
+// Choose the first state of the interpolation window for types 9 and 13. As in
+// the SPICE toolkit, windows with an odd number of states are centered on the
+// epoch nearest to et, while even windows are centered on et.
+unsigned int
+SpkSegment::windowStart(double et) const
+{
+    int low = int(lastEpochNotAfter(et));
+    int first = 0;
+
+    if (m_windowSize % 2 == 1)
+    {
+        int nearest = low;
+        if (low + 1 < int(m_recordCount))
+        {
+            double lowEpoch = m_file->readDouble(m_epochs + low);
+            double highEpoch = m_file->readDouble(m_epochs + low + 1);
+            if (fabs(et - highEpoch) < fabs(et - lowEpoch))
+            {
+                nearest = low + 1;
+            }
+        }
+        first = nearest - int(m_windowSize / 2);
+    }
+    else
+    {
+        first = low - int(m_windowSize / 2) + 1;
+    }
+
+    return (unsigned int) max(0, min(first, int(m_recordCount) - int(m_windowSize)));
+}
+
+
+// Type 9: Lagrange interpolation of each state component separately
+bool
+SpkSegment::lagrangeState(double et, double* sv) const
+{
+    unsigned int first = windowStart(et);
+    unsigned int n = m_windowSize;
+
+    double epochs[MaxWindowSize];
+    double states[MaxWindowSize * 6];
+    m_file->readDoubles(m_epochs + first, n, epochs);
+    m_file->readDoubles(m_begin + first * 6, n * 6, states);
+
+    for (unsigned int component = 0; component < 6; ++component)
+    {
+        // Neville's algorithm
+        double work[MaxWindowSize];
+        for (unsigned int i = 0; i < n; ++i)
+        {
+            work[i] = states[i * 6 + component];
+        }
+
+        for (unsigned int j = 1; j < n; ++j)
+        {
+            for (unsigned int i = 0; i < n - j; ++i)
+            {
+                double c1 = epochs[i] - et;
+                double c2 = et - epochs[i + j];
+                double denom = epochs[i] - epochs[i + j];
+                if (denom == 0.0)
+                {
+                    return false;
+                }
+                work[i] = (c2 * work[i] + c1 * work[i + 1]) / denom;
+            }
+        }
+
+        sv[component] = work[0];
+    }
+
+    return true;
+}
+
+
+// Type 13: Hermite interpolation of the positions, using the velocities as the
+// derivatives. The velocity is the derivative of the interpolating polynomial.
+bool
+SpkSegment::hermiteState(double et, double* sv) const
+{
+    unsigned int first = windowStart(et);
+    unsigned int n = m_windowSize;
+
+    double epochs[MaxWindowSize];
+    double states[MaxWindowSize * 6];
+    m_file->readDoubles(m_epochs + first, n, epochs);
+    m_file->readDoubles(m_begin + first * 6, n * 6, states);
+
+    for (unsigned int component = 0; component < 3; ++component)
+    {
+        // Divided differences with every node repeated twice
+        double z[MaxWindowSize * 2];
+        double q[MaxWindowSize * 2];
+        unsigned int m = 2 * n;
+        for (unsigned int i = 0; i < n; ++i)
+        {
+            z[2 * i] = epochs[i];
+            z[2 * i + 1] = epochs[i];
+            q[2 * i] = states[i * 6 + component];
+            q[2 * i + 1] = states[i * 6 + component];
+        }
+
+        // Work from the bottom of each column up so that the table can be
+        // computed in place. q[k] ends up holding the leading coefficient
+        // f[z_0, ..., z_k].
+        for (unsigned int j = 1; j < m; ++j)
+        {
+            for (unsigned int k = m - 1; k >= j; --k)
+            {
+                if (j == 1 && k % 2 == 1)
+                {
+                    q[k] = states[(k / 2) * 6 + component + 3];
+                }
+                else
+                {
+                    double denom = z[k] - z[k - j];
+                    if (denom == 0.0)
+                    {
+                        return false;
+                    }
+                    q[k] = (q[k] - q[k - 1]) / denom;
+                }
+            }
+        }
+
+        // Evaluate the Newton form of the polynomial and its derivative
+        double p = q[m - 1];
+        double dp = 0.0;
+        for (int k = int(m) - 2; k >= 0; --k)
+        {
+            dp = dp * (et - z[k]) + p;
+            p = p * (et - z[k]) + q[k];
+        }
+
+        sv[component] = p;
+        sv[component + 3] = dp;
+    }
+
+    return true;
+}
+
+
+// Type 21: extended modified difference arrays. This is the same algorithm
+// as type 1, but with a variable maximum difference line size.
+bool
+SpkSegment::differenceLineState(double et, double* sv) const
+{
+    const unsigned int maxDim = m_differenceLineSize;
+
+    unsigned int recordIndex = firstEpochNotBefore(et);
+    double record[4 * MaxDifferenceLineSize + 11];
+    m_file->readDoubles(m_begin + recordIndex * m_recordSize, m_recordSize, record);
+
+    // Unpack the record
+    double tl = record[0];
+    const double* g = record + 1;
+    double refPos[3];
+    double refVel[3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        refPos[i] = record[maxDim + 1 + 2 * i];
+        refVel[i] = record[maxDim + 2 + 2 * i];
+    }
+    const double* dt = record + maxDim + 7;  // dt[j + i * maxDim] is DT(j + 1, i + 1)
+    int kqmax1 = int(record[4 * maxDim + 7]);
+    int kq[3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        kq[i] = int(record[4 * maxDim + 8 + i]);
+    }
+
+    if (kqmax1 < 2 || kqmax1 > int(maxDim) + 1)
+    {
+        return false;
+    }
+
+    // The arrays below use one-based indices to follow the SPICE documentation
+    double fc[MaxDifferenceLineSize + 2];
+    double wc[MaxDifferenceLineSize + 2];
+    double w[MaxDifferenceLineSize + 4];
+
+    double delta = et - tl;
+    double tp = delta;
+    int mq2 = kqmax1 - 2;
+    int ks = kqmax1 - 1;
+
+    fc[1] = 1.0;
+    for (int j = 1; j <= mq2; ++j)
+    {
+        if (g[j - 1] == 0.0)
+        {
+            return false;
+        }
+        fc[j + 1] = tp / g[j - 1];
+        wc[j] = delta / g[j - 1];
+        tp = delta + g[j - 1];
+    }
+
+    for (int j = 1; j <= kqmax1; ++j)
+    {
+        w[j] = 1.0 / double(j);
+    }
+
+    int jx = 0;
+    int ks1 = ks - 1;
+    while (ks >= 2)
+    {
+        jx++;
+        for (int j = 1; j <= jx; ++j)
+        {
+            w[j + ks] = fc[j + 1] * w[j + ks - 1] - wc[j] * w[j + ks];
+        }
+        ks = ks1;
+        ks1--;
+    }
+
+    // Position
+    for (int i = 0; i < 3; ++i)
+    {
+        double sum = 0.0;
+        for (int j = min(kq[i], int(maxDim)); j >= 1; --j)
+        {
+            sum += dt[(j - 1) + i * maxDim] * w[j + ks];
+        }
+        sv[i] = refPos[i] + delta * (refVel[i] + delta * sum);
+    }
+
+    // Velocity
+    for (int j = 1; j <= jx; ++j)
+    {
+        w[j + ks] = fc[j + 1] * w[j + ks - 1] - wc[j] * w[j + ks];
+    }
+    ks--;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        double sum = 0.0;
+        for (int j = min(kq[i], int(maxDim)); j >= 1; --j)
+        {
+            sum += dt[(j - 1) + i * maxDim] * w[j + ks];
+        }
+        sv[i + 3] = refVel[i] + delta * sum;
+    }
+
+    return true;
+}
@@ -0,0 +1,128 @@
+// SpkSegment.h
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SPK_SEGMENT_H_
+#define _SPK_SEGMENT_H_
+
+#include "DafFile.h"
+
+
+/** SpkSegment evaluates a single segment of a binary SPK file without going
+  * through CSPICE. The following segment types are supported:
+  *   2  - Chebyshev polynomials for position, fixed length intervals
+  *   3  - Chebyshev polynomials for position and velocity, fixed length intervals
+  *   9  - Lagrange interpolation of states, unequal time steps
+  *   13 - Hermite interpolation of states, unequal time steps
+  *   21 - Extended modified difference arrays
+  *
+  * Evaluation only reads from the memory mapped file, so state() may be called
+  * from multiple threads simultaneously.
+  */
+class SpkSegment
+{
+public:
+    SpkSegment(const DafFile* file, const DafSummary& summary);
+
+    bool isValid() const
+    {
+        return m_valid;
+    }
+
+    int target() const
+    {
+        return m_target;
+    }
+
+    int center() const
+    {
+        return m_center;
+    }
+
+    int frame() const
+    {
+        return m_frame;
+    }
+
+    int type() const
+    {
+        return m_type;
+    }
+
+    double startTime() const
+    {
+        return m_startTime;
+    }
+
+    double endTime() const
+    {
+        return m_endTime;
+    }
+
+    bool covers(double et) const
+    {
+        return et >= m_startTime && et <= m_endTime;
+    }
+
+    bool state(double et, double* sv) const;
+
+    static bool isSupportedType(int type);
+
+    // Limits on the size of data records, chosen to be comfortably larger than
+    // anything written by the SPICE toolkit.
+    static const unsigned int MaxRecordSize = 1024;
+    static const unsigned int MaxWindowSize = 32;
+    static const unsigned int MaxDifferenceLineSize = 25;
+
+private:
+    bool chebyshevState(double et, double* sv) const;
+    bool lagrangeState(double et, double* sv) const;
+    bool hermiteState(double et, double* sv) const;
+    bool differenceLineState(double et, double* sv) const;
+    unsigned int windowStart(double et) const;
+    unsigned int lastEpochNotAfter(double et) const;
+    unsigned int firstEpochNotBefore(double et) const;
+
+private:
+    const DafFile* m_file;
+    bool m_valid;
+    int m_target;
+    int m_center;
+    int m_frame;
+    int m_type;
+    double m_startTime;
+    double m_endTime;
+    unsigned int m_begin;
+    unsigned int m_end;
+
+    // Types 2 and 3
+    double m_initialEpoch;
+    double m_intervalLength;
+    unsigned int m_recordSize;
+
+    // All types
+    unsigned int m_recordCount;
+
+    // Types 9, 13, and 21: address of the epoch list
+    unsigned int m_epochs;
+
+    // Types 9 and 13
+    unsigned int m_windowSize;
+
+    // Type 21
+    unsigned int m_differenceLineSize;
+};
+
+#endif // _SPK_SEGMENT_H_
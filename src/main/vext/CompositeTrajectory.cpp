@@ -91,6 +91,21 @@ CompositeTrajectory::state(double tdbSec) const
 }
 
 
+bool
+CompositeTrajectory::isThreadSafe() const
+{
+    for (unsigned int i = 0; i < m_segments.size(); ++i)
+    {
+        if (!m_segments[i]->isThreadSafe())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 CompositeTrajectory*
 CompositeTrajectory::Create(const vector<Trajectory*>& segments,
                             const vector<double>& segmentDurations,
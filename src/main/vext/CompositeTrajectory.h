@@ -48,6 +48,8 @@ public:
         return m_period;
     }
 
+    virtual bool isThreadSafe() const;
+
     static CompositeTrajectory* Create(const std::vector<vesta::Trajectory*>& segments,
                                        const std::vector<double>& segmentDurations,
                                        double startTime);
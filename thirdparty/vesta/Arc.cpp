@@ -50,6 +50,7 @@ void
 Arc::setDuration(double t)
 {
     m_duration = t;
+    Entity::invalidateStateCache();
 }
 
 
@@ -59,6 +60,7 @@ void
 Arc::setCenter(Entity* center)
 {
     m_center = center;
+    Entity::invalidateStateCache();
 }
 
 
@@ -68,6 +70,7 @@ void
 Arc::setTrajectoryFrame(Frame* f)
 {
     m_trajectoryFrame = f;
+    Entity::invalidateStateCache();
 }
 
 
@@ -77,6 +80,7 @@ void
 Arc::setBodyFrame(Frame* f)
 {
     m_bodyFrame = f;
+    Entity::invalidateStateCache();
 }
 
 
@@ -87,6 +91,7 @@ void
 Arc::setTrajectory(Trajectory* trajectory)
 {
     m_trajectory = trajectory;
+    Entity::invalidateStateCache();
 }
 
 
@@ -98,5 +103,6 @@ void
 Arc::setRotationModel(RotationModel* rm)
 {
     m_rotationModel = rm;
+    Entity::invalidateStateCache();
 }
 
@@ -27,6 +27,11 @@ public:
     virtual Eigen::Quaterniond orientation(double t) const;
     virtual Eigen::Vector3d angularVelocity(double t) const;
 
+    virtual bool isThreadSafe() const
+    {
+        return false;
+    }
+
     Entity* body() const;
 
 private:
@@ -10,6 +10,7 @@
 
 #include "Chronology.h"
 #include "Arc.h"
+#include "Entity.h"
 
 using namespace vesta;
 using namespace std;
@@ -36,6 +37,9 @@ Chronology::clearArcs()
     m_beginning = 0.0;
     m_duration = 0.0;
     m_arcSequence.clear();
+    m_arcStartTimes.clear();
+    m_arcDurations.clear();
+    Entity::invalidateStateCache();
 }
 
 
@@ -47,6 +51,8 @@ void
 Chronology::setBeginning(double t)
 {
     m_beginning = t;
+    updateArcStartTimes();
+    Entity::invalidateStateCache();
 }
 
 
@@ -55,6 +61,9 @@ Chronology::setBeginning(double t)
   * is considered active when startTime <= t < endTime. The exception is
   * the last arc, which is also active when t is exactly equal to the end
   * time.
+  *
+  * The arc is found with a binary search. No state is kept between calls,
+  * so activeArc() may be called from several threads at once.
   */
 Arc*
 Chronology::activeArc(double t) const
@@ -63,23 +72,32 @@ Chronology::activeArc(double t) const
     {
         return NULL;
     }
-    else
+
+    unsigned int arcCount = m_arcSequence.size();
+
+    // Find the first arc that ends after t
+    unsigned int low = 0;
+    unsigned int high = arcCount;
+    while (low < high)
     {
-        double m_arcBeginning = m_beginning;
-        for (vector<counted_ptr<Arc> >::const_iterator iter = m_arcSequence.begin(); iter != m_arcSequence.end(); iter++)
+        unsigned int mid = low + (high - low) / 2;
+        if (endsAfter(mid, t))
         {
-            counted_ptr<Arc> arc = *iter;
-            if (t - m_arcBeginning < arc->duration())
-            {
-                return &*arc;
-            }
-
-            m_arcBeginning += arc->duration();
+            high = mid;
         }
+        else
+        {
+            low = mid + 1;
+        }
+    }
 
-        // Only reached when t == ending
-        return &*m_arcSequence.back();
+    // No arc ends after t only when t == ending
+    if (low == arcCount)
+    {
+        low = arcCount - 1;
     }
+
+    return m_arcSequence[low].ptr();
 }
 
 
@@ -137,6 +155,26 @@ Chronology::arcCount() const
 void
 Chronology::addArc(Arc* arc)
 {
+    double startTime = m_arcStartTimes.empty() ? m_beginning : m_arcStartTimes.back() + m_arcDurations.back();
+
     m_arcSequence.push_back(counted_ptr<Arc>(arc));
+    m_arcStartTimes.push_back(startTime);
+    m_arcDurations.push_back(arc->duration());
     m_duration += arc->duration();
+    Entity::invalidateStateCache();
+}
+
+
+// Recompute the start times of all arcs (required when the beginning of the
+// chronology changes.) Start times are accumulated in the same order as the
+// durations are added, so that arc boundaries are consistent with the ending time.
+void
+Chronology::updateArcStartTimes()
+{
+    double startTime = m_beginning;
+    for (unsigned int i = 0; i < m_arcStartTimes.size(); ++i)
+    {
+        m_arcStartTimes[i] = startTime;
+        startTime += m_arcDurations[i];
+    }
 }
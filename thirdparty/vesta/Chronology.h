@@ -83,10 +83,24 @@ public:
 
     void clearArcs();
 
+private:
+    void updateArcStartTimes();
+
+    // True if the arc at index ends after time t
+    bool endsAfter(unsigned int index, double t) const
+    {
+        return t - m_arcStartTimes[index] < m_arcDurations[index];
+    }
+
 private:
     std::vector<counted_ptr<Arc> > m_arcSequence;
     double m_beginning;
     double m_duration;
+
+    // Start times and durations of the arcs, recorded when the arcs are added
+    // so that activeArc() can do a binary search.
+    std::vector<double> m_arcStartTimes;
+    std::vector<double> m_arcDurations;
 };
 
 } // namespace
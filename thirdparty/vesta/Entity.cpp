@@ -21,11 +21,20 @@ using namespace Eigen;
 using namespace std;
 
 
+// Generation zero is never current, so that new entities start with an empty cache
+static unsigned int StateCacheGeneration = 1;
+static Entity::StateCacheStatistics StateCacheCounters = { 0, 0 };
+
+
 /** Create a new entity with an empty chronology.
   */
 Entity::Entity() :
     m_visible(true),
-    m_visualizers(NULL)
+    m_visualizers(NULL),
+    m_cachedState(Vector3d::Zero(), Vector3d::Zero()),
+    m_cachedTime(0.0),
+    m_cacheGeneration(0),
+    m_cachedVelocity(false)
 {
     m_chronology = new Chronology();
 }
@@ -37,41 +46,94 @@ Entity::~Entity()
 }
 
 
-/** Get the position of the entity in universal coordinates.
+/** Get the position of the entity in universal coordinates. Cache hits
+  * and misses are counted in the global state cache statistics, so this
+  * method must only be called from one thread at a time.
+  *
   * \param t the time in seconds since J2000 TDB
   */
 Vector3d
 Entity::position(double t) const
 {
+    return position(t, &StateCacheCounters);
+}
+
+
+/** Get the position of the entity in universal coordinates, counting state
+  * cache hits and misses in the specified statistics instead of the global
+  * ones. Threads evaluating entities in parallel each pass their own
+  * statistics and add them to the global statistics when they're done.
+  *
+  * \param t the time in seconds since J2000 TDB
+  * \param statistics counters updated with the cache hits and misses
+  */
+Vector3d
+Entity::position(double t, StateCacheStatistics* statistics) const
+{
+    if (m_cacheGeneration == StateCacheGeneration && m_cachedTime == t)
+    {
+        ++statistics->hits;
+        return m_cachedState.position();
+    }
+    ++statistics->misses;
+
+    Vector3d position = Vector3d::Zero();
     Arc* arc = m_chronology->activeArc(t);
     if (arc)
     {
         Vector3d centerPosition = Vector3d::Zero();
         if (arc->center())
-            centerPosition = arc->center()->position(t);
-        return centerPosition + arc->trajectoryFrame()->orientation(t) * arc->trajectory()->position(t);
-    }
-    else
-    {
-        return Vector3d::Zero();
+            centerPosition = arc->center()->position(t, statistics);
+        position = centerPosition + arc->trajectoryFrame()->orientation(t) * arc->trajectory()->position(t);
     }
+
+    m_cachedState = StateVector(position, Vector3d::Zero());
+    m_cachedTime = t;
+    m_cacheGeneration = StateCacheGeneration;
+    m_cachedVelocity = false;
+
+    return position;
 }
 
 
 /** Get the state vector of the entity in the fundamental coordinate
-  * system (J200).
+  * system (J200). Like position(), this updates the global state cache
+  * statistics and must only be called from one thread at a time.
+  *
   * \param t the time in seconds since J2000 TDB
   */
 StateVector
 Entity::state(double t) const
 {
+    return state(t, &StateCacheCounters);
+}
+
+
+/** Get the state vector of the entity in the fundamental coordinate
+  * system (J200), counting state cache hits and misses in the specified
+  * statistics.
+  *
+  * \param t the time in seconds since J2000 TDB
+  * \param statistics counters updated with the cache hits and misses
+  */
+StateVector
+Entity::state(double t, StateCacheStatistics* statistics) const
+{
+    if (m_cacheGeneration == StateCacheGeneration && m_cachedTime == t && m_cachedVelocity)
+    {
+        ++statistics->hits;
+        return m_cachedState;
+    }
+    ++statistics->misses;
+
+    StateVector result(Vector3d::Zero(), Vector3d::Zero());
     Arc* arc = m_chronology->activeArc(t);
     if (arc)
     {
         StateVector centerState(Vector3d::Zero(), Vector3d::Zero());
         if (arc->center())
         {
-            centerState = arc->center()->state(t);
+            centerState = arc->center()->state(t, statistics);
         }
 
         StateVector state = arc->trajectory()->state(t);
@@ -81,15 +143,85 @@ Entity::state(double t) const
         Vector3d position = m * state.position();
         Vector3d velocity = m * state.velocity() + omega.cross(state.position());
 
-        return centerState + StateVector(position, velocity);
+        result = centerState + StateVector(position, velocity);
     }
-    else
+
+    m_cachedState = result;
+    m_cachedTime = t;
+    m_cacheGeneration = StateCacheGeneration;
+    m_cachedVelocity = true;
+
+    return result;
+}
+
+
+/** Discard the cached states of all entities. Entities remember the last state
+  * computed, so that the position of an object (and of every object in the chain
+  * of centers below it) is only evaluated once per time step no matter how many
+  * times it is needed. The cache is keyed on time, so it doesn't need to be
+  * invalidated when the time changes; it must however be invalidated whenever
+  * a trajectory or frame changes. Modifying an arc or chronology invalidates the
+  * cache automatically, and UniverseRenderer invalidates it at the start of every
+  * view set.
+  *
+  * The cache isn't locked. Threads may compute the positions of different
+  * entities at once only if the center chains of those entities are already
+  * cached and none of their trajectories or frames depend on other entities;
+  * EntityBoundingHierarchy relies on this to evaluate entities in parallel one
+  * level of centers at a time, counting cache hits and misses separately for
+  * each chunk of entities.
+  */
+void
+Entity::invalidateStateCache()
+{
+    ++StateCacheGeneration;
+    if (StateCacheGeneration == 0)
     {
-        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+        StateCacheGeneration = 1;
     }
 }
 
 
+/** Get the current generation of the state cache. The generation changes
+  * every time that the cache is invalidated, so objects derived from entity
+  * positions can compare generations to tell whether they're out of date.
+  */
+unsigned int
+Entity::stateCacheGeneration()
+{
+    return StateCacheGeneration;
+}
+
+
+/** Get the number of state cache hits and misses since the statistics were
+  * last reset.
+  */
+Entity::StateCacheStatistics
+Entity::stateCacheStatistics()
+{
+    return StateCacheCounters;
+}
+
+
+/** Add counts gathered by position() or state() calls with explicit
+  * statistics to the global state cache statistics.
+  */
+void
+Entity::addStateCacheStatistics(const StateCacheStatistics& statistics)
+{
+    StateCacheCounters.hits += statistics.hits;
+    StateCacheCounters.misses += statistics.misses;
+}
+
+
+void
+Entity::resetStateCacheStatistics()
+{
+    StateCacheCounters.hits = 0;
+    StateCacheCounters.misses = 0;
+}
+
+
 /** Get the orientation of the entity in universal coordinates.
   * \param t the time in seconds since J2000 TDB
   */
@@ -33,11 +33,29 @@ public:
     Entity();
     ~Entity();
 
+    /** Counters for the entity state cache. A hit is counted whenever position()
+      * or state() is satisfied from the cache instead of evaluating the trajectory
+      * and the chain of center objects.
+      */
+    struct StateCacheStatistics
+    {
+        unsigned long hits;
+        unsigned long misses;
+    };
+
     Eigen::Vector3d position(double t) const;
+    Eigen::Vector3d position(double t, StateCacheStatistics* statistics) const;
     StateVector state(double t) const;
+    StateVector state(double t, StateCacheStatistics* statistics) const;
     Eigen::Quaterniond orientation(double t) const;
     Eigen::Vector3d angularVelocity(double t) const;
 
+    static void invalidateStateCache();
+    static unsigned int stateCacheGeneration();
+    static StateCacheStatistics stateCacheStatistics();
+    static void addStateCacheStatistics(const StateCacheStatistics& statistics);
+    static void resetStateCacheStatistics();
+
     /** Return the geometry object assigned to this entity. It is
       * legal for an entity not to have any geometry at all (for
       * entities such as barycenters, other dynamical points, and
@@ -113,6 +131,13 @@ private:
     counted_ptr<LightSource> m_lightSource;
 
     VisualizerTable* m_visualizers;
+
+    // The most recently computed state, valid only while m_cacheGeneration matches
+    // the current cache generation and the requested time matches exactly.
+    mutable StateVector m_cachedState;
+    mutable double m_cachedTime;
+    mutable unsigned int m_cacheGeneration;
+    mutable bool m_cachedVelocity;
 };
 
 }
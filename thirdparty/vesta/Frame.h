@@ -57,6 +57,16 @@ public:
       */
     virtual Eigen::Vector3d angularVelocity(double tsec) const = 0;
 
+    /** Return true if the frame may be evaluated by several threads at once.
+      * Frames defined by the states or orientations of entities aren't thread
+      * safe, because evaluating them may update the state caches of those
+      * entities; such frames must override this method to return false.
+      */
+    virtual bool isThreadSafe() const
+    {
+        return true;
+    }
+
     StateTransform stateTransform(double tsec) const;
     StateTransform inverseStateTransform(double tsec) const;
 
@@ -23,6 +23,12 @@ public:
 
     virtual StateVector state(double t) const;
     virtual double boundingSphereRadius() const;
+
+    // Calls into the Java VM must be made from the thread that owns it
+    virtual bool isThreadSafe() const
+    {
+        return false;
+    }
 };
 
 }
@@ -206,8 +206,8 @@ MeshGeometry::handleRayPick(const Eigen::Vector3d& pickOrigin,
     {
         double submeshDistance = 0.0;
 
-        // TODO: Check the bounding volume of the submesh before doing the actual mesh
-        // intersection test.
+        // The submesh pick hierarchy rejects rays that miss its bounding box
+        // before testing any triangles.
         if ((*iter)->rayPick(origin, direction, &submeshDistance))
         {
             if (submeshDistance < closestHit)
@@ -368,6 +368,49 @@ MeshGeometry::uniquifyVertices(float positionTolerance, float normalTolerance, f
 }
 
 
+/** Reorder the triangles and vertices of all submeshes for better vertex
+  * cache performance. See Submesh::optimizeVertexCache.
+  */
+bool
+MeshGeometry::optimizeVertexCache()
+{
+    for (vector<counted_ptr<Submesh> >::const_iterator iter = m_submeshes.begin(); iter != m_submeshes.end(); ++iter)
+    {
+        bool ok = iter->ptr()->optimizeVertexCache();
+        if (!ok)
+        {
+            VESTA_WARNING("Error occurred while optimizing mesh for the vertex cache.");
+            return false;
+        }
+    }
+
+    setMeshChanged();
+
+    return true;
+}
+
+
+/** Get the average cache miss ratio for all indexed triangle lists in the
+  * mesh, i.e. the expected number of vertex shader invocations per triangle.
+  * See Submesh::averageCacheMissRatio.
+  */
+float
+MeshGeometry::averageCacheMissRatio() const
+{
+    double misses = 0.0;
+    unsigned int totalTriangleCount = 0;
+    for (vector<counted_ptr<Submesh> >::const_iterator iter = m_submeshes.begin(); iter != m_submeshes.end(); ++iter)
+    {
+        unsigned int triangleCount = 0;
+        float acmr = iter->ptr()->averageCacheMissRatio(&triangleCount);
+        misses += double(acmr) * triangleCount;
+        totalTriangleCount += triangleCount;
+    }
+
+    return totalTriangleCount == 0 ? 0.0f : float(misses / totalTriangleCount);
+}
+
+
 /** Compress indices to 16-bit where possible. This can improve rendering performance
   * on some hardware, and some mobile GPUs can only use 16-bit vertex indices.
   */
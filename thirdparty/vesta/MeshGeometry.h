@@ -31,16 +31,24 @@ class GLVertexBuffer;
   * Often, 3D mesh files are not well-conditioned for rendering on
   * graphics hardware. They may contain redundant vertexes and materials.
   * Or, the geometry may be split into many small chunks that result
-  * in extra overhead for the hardware or driver. MeshGeometry has three
+  * in extra overhead for the hardware or driver. MeshGeometry has four
   * methods to preprocess meshes for better hardware performance:
   *
   * - mergeSubmeshes
-  * - unquifyVertices
   * - mergeMaterials
+  * - uniquifyVertices
+  * - optimizeVertexCache
   *
-  * For the best possible results, all three methods should be called
+  * For the best possible results, all four methods should be called
   * after a model is loaded. The sequence is important: the methods should
-  * be called in the order given above.
+  * be called in the order given above. Merging materials before welding
+  * lets the per-submesh steps treat all triangles that share a material
+  * as a single list. The last two steps work on each submesh separately,
+  * so Submesh::uniquifyVertices and Submesh::optimizeVertexCache may be
+  * called instead to process submeshes in parallel. compressIndices can
+  * be called afterward to switch to 16-bit indices where possible.
+  * averageCacheMissRatio may be used to measure the effect of
+  * optimizeVertexCache.
   *
   * If mesh files are saved in optimized form, then preprocessing at load
   * time can be skipped. This is ideal, as the optimization functions can
@@ -65,6 +73,23 @@ public:
     void addSubmesh(Submesh* submesh);
     void addMaterial(Material* material);
 
+    unsigned int submeshCount() const
+    {
+        return m_submeshes.size();
+    }
+
+    Submesh* submesh(unsigned int index) const
+    {
+        if (index < m_submeshes.size())
+        {
+            return m_submeshes[index].ptr();
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
     unsigned int materialCount() const
     {
         return m_materials.size();
@@ -114,8 +139,11 @@ public:
     bool mergeSubmeshes();
     bool uniquifyVertices(float positionTolerance = 0.0f, float normalTolerance = 0.0f, float texCoordTolerance = 0.0f);
     bool mergeMaterials();
+    bool optimizeVertexCache();
     void compressIndices();
 
+    float averageCacheMissRatio() const;
+
     static MeshGeometry* loadFromFile(const std::string& filename, TextureMapLoader* textureLoader);
 
 private:
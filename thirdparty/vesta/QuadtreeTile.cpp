@@ -15,6 +15,8 @@
 #include "TiledMap.h"
 #include "WorldLayer.h"
 #include "Debug.h"
+#include "internal/TileMeshCache.h"
+#include "glhelp/GLVertexBuffer.h"
 #include <vector>
 #include <algorithm>
 #include <cassert>
@@ -78,6 +80,14 @@ using namespace std;
 // it is only the triangulation that changes. There are sixteen different triangulations
 // possible: all combinations of transitional or normal edges in the north, south, east
 // and west directions.
+//
+// The quadtree persists from frame to frame. Each call to tessellate() refines the
+// tiles that have become too coarse and merges those that have become finer than
+// necessary, so that only tiles that weren't visible in the previous frame need new
+// geometry. Tile vertices lie on the unit sphere (the ellipsoid scale is applied with
+// the modelview matrix), so a tile mesh depends only on the position of the tile in
+// the quadtree and its texture coordinates. Meshes are kept in a cache of vertex
+// buffers shared by all worlds.
 
 
 // Indices for all 16 possible tile triangulations. These are generated once and reused.
@@ -85,9 +95,20 @@ using namespace std;
 v_uint16* QuadtreeTile::ms_tileMeshIndices[16];
 unsigned int QuadtreeTile::ms_tileMeshTriangleCounts[16];
 bool QuadtreeTile::ms_indicesInitialized = false;
+TileMeshCache* QuadtreeTile::ms_meshCache = NULL;
 
 static const float SquareSize = 1.0f / float(QuadtreeTile::TileSubdivision);
 
+// All cached tile meshes have the same vertex layout: position, normal, texture
+// coordinate, and tangent. Tiles that don't need every attribute are drawn with
+// a vertex spec that skips the unused ones.
+static const unsigned int TileVertexCount = (QuadtreeTile::TileSubdivision + 1) * (QuadtreeTile::TileSubdivision + 1);
+static const unsigned int TileVertexSize = 11;
+static const unsigned int TileVertexStride = TileVertexSize * sizeof(float);
+
+// Memory used for cached tile meshes; enough for roughly 2600 tiles
+static const unsigned int DefaultMeshCacheBudget = 32 * 1024 * 1024;
+
 
 static VertexAttribute posNormTexTangentAttributes[] = {
     VertexAttribute(VertexAttribute::Position,     VertexAttribute::Float3),
@@ -98,6 +119,98 @@ static VertexAttribute posNormTexTangentAttributes[] = {
 
 static VertexSpec PositionNormalTexTangent(4, posNormTexTangentAttributes);
 
+static VertexAttribute posTexAttributes[] = {
+    VertexAttribute(VertexAttribute::Position,     VertexAttribute::Float3),
+    VertexAttribute(VertexAttribute::TextureCoord, VertexAttribute::Float2),
+};
+
+// Offsets of the position and texture coordinate in the tile vertex layout
+static unsigned int tilePosTexOffsets[] = { 0, 24 };
+
+static VertexSpec TilePositionTex(2, posTexAttributes, tilePosTexOffsets);
+
+
+// Get the vertex spec for drawing a tile mesh with the specified features
+static const VertexSpec&
+TileVertexSpec(unsigned int features)
+{
+    if ((features & QuadtreeTile::NormalMap) != 0)
+    {
+        return PositionNormalTexTangent;
+    }
+    else if ((features & QuadtreeTile::Normals) != 0)
+    {
+        return VertexSpec::PositionNormalTex;
+    }
+    else
+    {
+        return TilePositionTex;
+    }
+}
+
+
+// Generate the vertices for a tile with the specified southwest corner and extent. The
+// texture coordinate of the vertex in column j and row i is (s0 + j * ds, t0 + i * dt).
+static void
+GenerateTileVertices(float* vertexData,
+                     const Vector2f& southwest,
+                     float extent,
+                     float s0, float t0, float ds, float dt)
+{
+    const unsigned int n = QuadtreeTile::TileSubdivision;
+
+    float tileArc = float(PI) * extent;
+    float lonWest = float(PI) * southwest.x();
+    float latSouth = float(PI) * southwest.y();
+    float dlon = tileArc / float(n);
+    float dlat = tileArc / float(n);
+
+    // Precompute a trig table for this patch
+    float sines[n + 1];
+    float cosines[n + 1];
+    for (unsigned int i = 0; i <= n; ++i)
+    {
+        float lon = lonWest + i * dlon;
+        sines[i] = sin(lon);
+        cosines[i] = cos(lon);
+    }
+
+    float* vertex = vertexData;
+    for (unsigned int i = 0; i <= n; ++i)
+    {
+        float t = t0 + i * dt;
+        float lat = latSouth + i * dlat;
+        float cosLat = cos(lat);
+        float sinLat = sin(lat);
+
+        for (unsigned int j = 0; j <= n; ++j)
+        {
+            Vector3f p(cosLat * cosines[j], cosLat * sines[j], sinLat);
+
+            // Position
+            vertex[0]  = p.x();
+            vertex[1]  = p.y();
+            vertex[2]  = p.z();
+
+            // Vertex normal
+            vertex[3]  = p.x();
+            vertex[4]  = p.y();
+            vertex[5]  = p.z();
+
+            // Texture coordinate
+            vertex[6]  = s0 + j * ds;
+            vertex[7]  = t;
+
+            // Tangent (we use dP/du), where P(u,v) is the sphere parametrization
+            vertex[8]  = -sines[j];
+            vertex[9]  = cosines[j];
+            vertex[10] = 0.0f;
+
+            vertex += TileVertexSize;
+        }
+    }
+}
+
 
 // TileTriangulationBuilder is a utility class used to construct tile meshes. Only 16
 // unique tile meshes are used, and they are generated just once.
@@ -348,7 +461,8 @@ QuadtreeTile::QuadtreeTile() :
     m_parent(NULL),
     m_level(NULL),
     m_approxPixelSize(0.0f),
-    m_isCulled(false)
+    m_isCulled(false),
+    m_splitRequired(false)
 {
     for (unsigned int i = 0; i < 4; ++i)
     {
@@ -364,7 +478,8 @@ QuadtreeTile::QuadtreeTile(QuadtreeTile* parent, unsigned int quadrant, const Ve
     m_level(parent->m_level + 1),
     m_extent(parent->m_extent * 0.5f),
     m_approxPixelSize(parent->m_approxPixelSize),
-    m_isCulled(parent->m_isCulled)
+    m_isCulled(parent->m_isCulled),
+    m_splitRequired(false)
 {
     for (unsigned int i = 0; i < 4; ++i)
     {
@@ -400,6 +515,15 @@ QuadtreeTile::QuadtreeTile(QuadtreeTile* parent, unsigned int quadrant, const Ve
 }
 
 
+/** Update the tessellation of this tile and its descendants for a new view. Tiles
+  * that are too coarse are split, and tiles that are finer than necessary are
+  * merged. Tiles outside the view frustum are marked as culled and never split;
+  * their children are discarded when possible.
+  *
+  * A tile can't be merged while a neighbor outside it is still finer, so after
+  * all root tiles have been tessellated, coarsen() should be called on each of
+  * them until no more tiles are merged.
+  */
 void
 QuadtreeTile::tessellate(const Vector3f& eyePosition,
                          const CullingPlaneSet& cullPlanes,
@@ -407,6 +531,12 @@ QuadtreeTile::tessellate(const Vector3f& eyePosition,
                          float splitThreshold,
                          float pixelSize)
 {
+    // Root tiles are never culled
+    if (!isRoot())
+    {
+        m_isCulled = m_parent->m_isCulled || cull(cullPlanes);
+    }
+
     float tileArc = float(PI) * m_extent;
 
     // Compute the approximate altitude of the eye point. This is the exact altitude when the
@@ -432,17 +562,32 @@ QuadtreeTile::tessellate(const Vector3f& eyePosition,
     float curveApproxError = globeSemiAxes.maxCoeff() * (1.0f - cos(tileArc * SquareSize * 0.5f));
     float curveErrorPixels = curveApproxError / (distanceToTile * pixelSize);
 
-    // Tessellate when the tile is too large or the curve approximation error is too great
-    if (apparentTileSize > splitThreshold || curveErrorPixels > 0.5f)
+    // Tessellate when the tile is too large or the curve approximation error is too great.
+    // Only split tiles that lie inside the view frustum.
+    bool needsSplit = apparentTileSize > splitThreshold || curveErrorPixels > 0.5f;
+    m_splitRequired = needsSplit && !m_isCulled;
+    if (m_splitRequired)
     {
-        // Only split tiles that lie inside the view frustum.
-        if (!m_isCulled)
+        split(cullPlanes, globeSemiAxes);
+        for (unsigned int i = 0; i < 4; ++i)
         {
-            split(cullPlanes, globeSemiAxes);
-            for (unsigned int i = 0; i < 4; ++i)
-            {
-                m_children[i]->tessellate(eyePosition, cullPlanes, globeSemiAxes, splitThreshold, pixelSize);
-            }
+            m_children[i]->tessellate(eyePosition, cullPlanes, globeSemiAxes, splitThreshold, pixelSize);
+        }
+    }
+    else if (hasChildren())
+    {
+        // The tile was split for an earlier view. Coarsen the children first, then
+        // discard them if the level of detail restriction allows it. A tile that
+        // can't be merged yet because of finer neighbors is merged by coarsen()
+        // once those neighbors have been coarsened.
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            m_children[i]->tessellate(eyePosition, cullPlanes, globeSemiAxes, splitThreshold, pixelSize);
+        }
+
+        if (canMerge())
+        {
+            merge();
         }
     }
 }
@@ -519,6 +664,109 @@ QuadtreeTile::split(const CullingPlaneSet& cullPlanes, const Vector3f& semiAxes)
 }
 
 
+/** Return true if the children of this tile can be merged without violating
+  * the restriction that adjacent tiles differ by at most one level. That is
+  * the case when none of the children have children of their own, and no
+  * neighbor of a child outside this tile has been split.
+  */
+bool
+QuadtreeTile::canMerge() const
+{
+    if (!hasChildren())
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        const QuadtreeTile* child = m_children[i];
+        if (child->hasChildren())
+        {
+            return false;
+        }
+
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            const QuadtreeTile* neighbor = child->m_neighbors[j];
+            if (neighbor && neighbor->m_parent != this && neighbor->hasChildren())
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/** Merge every tile in this tree that was split for an earlier view and
+  * that can now be merged. Tiles are coarsened from the leaves up.
+  *
+  * Merging a tile may allow one of its neighbors to be merged. The neighbor
+  * may lie in a part of the tree that has already been visited, or under
+  * another root tile, so coarsen() should be called on all root tiles until
+  * it returns false. The tessellation is then the same as one built from
+  * scratch for the current view.
+  *
+  * \return true if any tiles were merged
+  */
+bool
+QuadtreeTile::coarsen()
+{
+    if (!hasChildren())
+    {
+        return false;
+    }
+
+    bool merged = false;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        if (m_children[i]->coarsen())
+        {
+            merged = true;
+        }
+    }
+
+    if (!m_splitRequired && canMerge())
+    {
+        merge();
+        merged = true;
+    }
+
+    return merged;
+}
+
+
+/** Discard the children of this tile, returning them to the tile allocator.
+  * canMerge() must be true.
+  */
+void
+QuadtreeTile::merge()
+{
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        QuadtreeTile* child = m_children[i];
+
+        // Remove links to the child from neighbors outside this tile
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            QuadtreeTile* neighbor = child->m_neighbors[j];
+            if (neighbor && neighbor->m_parent != this)
+            {
+                QuadtreeTile*& backLink = neighbor->m_neighbors[(j + 2) & 0x3];
+                if (backLink == child)
+                {
+                    backLink = NULL;
+                }
+            }
+        }
+
+        m_allocator->freeTile(child);
+        m_children[i] = NULL;
+    }
+}
+
+
 // Return true if this tile lies outside the convex volume given by
 // the intersection of half-spaces.
 bool
@@ -669,138 +917,12 @@ QuadtreeTile::renderWorldLayer(RenderContext& rc, const WorldGeometry* world, co
 void
 QuadtreeTile::drawPatch(RenderContext& rc, unsigned int features) const
 {
-    const unsigned int MaxVertexSize = 11;
-    unsigned int vertexStride = 5;
-
-    if ((features & NormalMap) != 0)
-    {
-        vertexStride = 11;
-    }
-    else if ((features & Normals) != 0)
-    {
-        vertexStride = 8;
-    }
-
-    const unsigned int vertexCount = (TileSubdivision + 1) * (TileSubdivision + 1);
-
-    float vertexData[vertexCount * MaxVertexSize];
-    unsigned int vertexIndex = 0;
-
-    float tileArc = float(PI) * m_extent;
-    float lonWest = float(PI) * m_southwest.x();
-    float latSouth = float(PI) * m_southwest.y();
-    float dlon = tileArc / float(TileSubdivision);
-    float dlat = tileArc / float(TileSubdivision);
-    float du = m_extent / float(TileSubdivision);
-    float dv = m_extent / float(TileSubdivision);
-
-    // Precompute a trig table for this patch
-    float sines[TileSubdivision + 1];
-    float cosines[TileSubdivision + 1];
-    for (unsigned int i = 0; i <= TileSubdivision; ++i)
-    {
-        float lon = lonWest + i * dlon;
-        sines[i] = sin(lon);
-        cosines[i] = cos(lon);
-    }
-
-    for (unsigned int i = 0; i <= TileSubdivision; ++i)
-    {
-        float v = m_southwest.y() + i * dv;
-        float lat = latSouth + i * dlat;
-        float cosLat = cos(lat);
-        float sinLat = sin(lat);
-
-        if ((features & NormalMap) != 0)
-        {
-            for (unsigned int j = 0; j <= TileSubdivision; ++j)
-            {
-                unsigned int vertexStart = vertexStride * vertexIndex;
-
-                float u = m_southwest.x() + j * du;
-
-                float cosLon = cosines[j];
-                float sinLon = sines[j];
-
-                Vector3f p(cosLat * cosLon, cosLat * sinLon, sinLat);
-
-                // Position
-                vertexData[vertexStart + 0]  = p.x();
-                vertexData[vertexStart + 1]  = p.y();
-                vertexData[vertexStart + 2]  = p.z();
-
-                // Vertex normal
-                vertexData[vertexStart + 3]  = p.x();
-                vertexData[vertexStart + 4]  = p.y();
-                vertexData[vertexStart + 5]  = p.z();
-
-                // Texture coordinate
-                vertexData[vertexStart + 6]  = u * 0.5f + 0.5f;
-                vertexData[vertexStart + 7]  = 0.5f - v;
-
-                // Tangent (we use dP/du), where P(u,v) is the sphere parametrization
-                vertexData[vertexStart + 8]  = -sinLon;
-                vertexData[vertexStart + 9]  = cosLon;
-                vertexData[vertexStart + 10] = 0.0f;
-
-                ++vertexIndex;
-            }
-        }
-        else if ((features & Normals) != 0)
-        {
-            for (unsigned int j = 0; j <= TileSubdivision; ++j)
-            {
-                unsigned int vertexStart = vertexStride * vertexIndex;
-
-                float u = m_southwest.x() + j * du;
-
-                Vector3f p(cosLat * cosines[j], cosLat * sines[j], sinLat);
-                vertexData[vertexStart + 0] = p.x();
-                vertexData[vertexStart + 1] = p.y();
-                vertexData[vertexStart + 2] = p.z();
-                vertexData[vertexStart + 3] = p.x();
-                vertexData[vertexStart + 4] = p.y();
-                vertexData[vertexStart + 5] = p.z();
-                vertexData[vertexStart + 6] = u * 0.5f + 0.5f;
-                vertexData[vertexStart + 7] = 0.5f - v;
-
-                ++vertexIndex;
-            }
-        }
-        else
-        {
-            for (unsigned int j = 0; j <= TileSubdivision; ++j)
-            {
-                unsigned int vertexStart = vertexStride * vertexIndex;
-
-                float u = m_southwest.x() + j * du;
-
-                Vector3f p(cosLat * cosines[j], cosLat * sines[j], sinLat);
-                vertexData[vertexStart + 0] = p.x();
-                vertexData[vertexStart + 1] = p.y();
-                vertexData[vertexStart + 2] = p.z();
-                vertexData[vertexStart + 3] = u * 0.5f + 0.5f;
-                vertexData[vertexStart + 4] = 0.5f - v;
-
-                ++vertexIndex;
-            }
-        }
-    }
-
-    if ((features & NormalMap) != 0)
-    {
-        rc.bindVertexArray(PositionNormalTexTangent, vertexData, vertexStride * 4);
-    }
-    else if ((features & Normals) != 0)
-    {
-        rc.bindVertexArray(VertexSpec::PositionNormalTex, vertexData, vertexStride * 4);
-    }
-    else
-    {
-        rc.bindVertexArray(VertexSpec::PositionTex, vertexData, vertexStride * 4);
-    }
+    float ds = m_extent / float(TileSubdivision);
+    float dt = m_extent / float(TileSubdivision);
 
-    drawTriangles(rc);
+    drawMesh(rc, TileVertexSpec(features),
+             m_southwest.x() * 0.5f + 0.5f, 0.5f - m_southwest.y(),
+             ds * 0.5f, -dt);
 }
 
 
@@ -808,20 +930,6 @@ QuadtreeTile::drawPatch(RenderContext& rc, unsigned int features) const
 void
 QuadtreeTile::drawPatch(RenderContext& rc, Material& material, TiledMap* baseMap, unsigned int features) const
 {
-    const unsigned int MaxVertexSize = 11;
-    unsigned int vertexStride = 8;
-
-    const unsigned int vertexCount = (TileSubdivision + 1) * (TileSubdivision + 1);
-
-    float vertexData[vertexCount * MaxVertexSize];
-    unsigned int vertexIndex = 0;
-
-    float tileArc = float(PI) * m_extent;
-    float lonWest = float(PI) * m_southwest.x();
-    float latSouth = float(PI) * m_southwest.y();
-    float dlon = tileArc / float(TileSubdivision);
-    float dlat = tileArc / float(TileSubdivision);
-
     float tileSize = static_cast<float>(baseMap->tileSize());
 
     unsigned int mapLevel = m_level;
@@ -870,60 +978,10 @@ QuadtreeTile::drawPatch(RenderContext& rc, Material& material, TiledMap* baseMap
         dv = vExt / float(TileSubdivision);
     }
 
-    // Precompute a trig table for this patch
-    float sines[TileSubdivision + 1];
-    float cosines[TileSubdivision + 1];
-    for (unsigned int i = 0; i <= TileSubdivision; ++i)
-    {
-        float lon = lonWest + i * dlon;
-        sines[i] = sin(lon);
-        cosines[i] = cos(lon);
-    }
-
-    for (unsigned int i = 0; i <= TileSubdivision; ++i)
-    {
-        float v = v0 + i * dv;
-        float lat = latSouth + i * dlat;
-        float cosLat = cos(lat);
-        float sinLat = sin(lat);
-
-        for (unsigned int j = 0; j <= TileSubdivision; ++j)
-        {
-            unsigned int vertexStart = vertexStride * vertexIndex;
-
-            float u = u0 + j * du;
-
-            Vector3f p(cosLat * cosines[j], cosLat * sines[j], sinLat);
-            vertexData[vertexStart + 0] = p.x();
-            vertexData[vertexStart + 1] = p.y();
-            vertexData[vertexStart + 2] = p.z();
-            vertexData[vertexStart + 3] = p.x();
-            vertexData[vertexStart + 4] = p.y();
-            vertexData[vertexStart + 5] = p.z();
-            vertexData[vertexStart + 6] = u;
-            vertexData[vertexStart + 7] = 1.0f - v;
-
-            ++vertexIndex;
-        }
-    }
-
     material.setBaseTexture(r.texture);
     rc.bindMaterial(&material);
 
-    if ((features & NormalMap) != 0)
-    {
-        rc.bindVertexArray(PositionNormalTexTangent, vertexData, vertexStride * 4);
-    }
-    else if ((features & Normals) != 0)
-    {
-        rc.bindVertexArray(VertexSpec::PositionNormalTex, vertexData, vertexStride * 4);
-    }
-    else
-    {
-        rc.bindVertexArray(VertexSpec::PositionTex, vertexData, vertexStride * 4);
-    }
-
-    drawTriangles(rc);
+    drawMesh(rc, TileVertexSpec(features), u0, 1.0f - v0, du, -dv);
 }
 
 
@@ -931,20 +989,6 @@ QuadtreeTile::drawPatch(RenderContext& rc, Material& material, TiledMap* baseMap
 void
 QuadtreeTile::drawPatch(RenderContext& rc, Material& material, TiledMap* baseMap, TiledMap* normalMap) const
 {
-    const unsigned int MaxVertexSize = 11;
-    unsigned int vertexStride = 11;
-
-    const unsigned int vertexCount = (TileSubdivision + 1) * (TileSubdivision + 1);
-
-    float vertexData[vertexCount * MaxVertexSize];
-    unsigned int vertexIndex = 0;
-
-    float tileArc = float(PI) * m_extent;
-    float lonWest = float(PI) * m_southwest.x();
-    float latSouth = float(PI) * m_southwest.y();
-    float dlon = tileArc / float(TileSubdivision);
-    float dlat = tileArc / float(TileSubdivision);
-
     float tileSize = static_cast<float>(baseMap->tileSize());
 
     unsigned int mapLevel = m_level;
@@ -1022,53 +1066,11 @@ QuadtreeTile::drawPatch(RenderContext& rc, Material& material, TiledMap* baseMap
         dv = vExt / float(TileSubdivision);
     }
 
-    // Precompute a trig table for this patch
-    float sines[TileSubdivision + 1];
-    float cosines[TileSubdivision + 1];
-    for (unsigned int i = 0; i <= TileSubdivision; ++i)
-    {
-        float lon = lonWest + i * dlon;
-        sines[i] = sin(lon);
-        cosines[i] = cos(lon);
-    }
-
-    for (unsigned int i = 0; i <= TileSubdivision; ++i)
-    {
-        float v = v0 + i * dv;
-        float lat = latSouth + i * dlat;
-        float cosLat = cos(lat);
-        float sinLat = sin(lat);
-
-        for (unsigned int j = 0; j <= TileSubdivision; ++j)
-        {
-            unsigned int vertexStart = vertexStride * vertexIndex;
-
-            float u = u0 + j * du;
-
-            Vector3f p(cosLat * cosines[j], cosLat * sines[j], sinLat);
-            vertexData[vertexStart + 0] = p.x();
-            vertexData[vertexStart + 1] = p.y();
-            vertexData[vertexStart + 2] = p.z();
-            vertexData[vertexStart + 3] = p.x();
-            vertexData[vertexStart + 4] = p.y();
-            vertexData[vertexStart + 5] = p.z();
-            vertexData[vertexStart + 6] = u;
-            vertexData[vertexStart + 7] = 1.0f - v;
-            vertexData[vertexStart + 8]  = -sines[j];
-            vertexData[vertexStart + 9]  = cosines[j];
-            vertexData[vertexStart + 10] = 0.0f;
-
-            ++vertexIndex;
-        }
-    }
-
     material.setBaseTexture(baseRect.texture);
     material.setNormalTexture(normalMapRect.texture);
     rc.bindMaterial(&material);
 
-    rc.bindVertexArray(PositionNormalTexTangent, vertexData, vertexStride * 4);
-
-    drawTriangles(rc);
+    drawMesh(rc, PositionNormalTexTangent, u0, 1.0f - v0, du, -dv);
 }
 
 
@@ -1311,6 +1313,78 @@ QuadtreeTile::drawPatch(RenderContext& rc, const MapLayer& layer, unsigned int f
 }
 
 
+/** Get the cache of tile meshes shared by all quadtrees.
+  */
+TileMeshCache*
+QuadtreeTile::meshCache()
+{
+    if (!ms_meshCache)
+    {
+        ms_meshCache = new TileMeshCache(TileVertexCount * TileVertexStride, DefaultMeshCacheBudget);
+    }
+
+    return ms_meshCache;
+}
+
+
+/** Delete the cache of tile meshes. This should be called while the graphics
+  * context is still current. The cache is created again if it's needed later.
+  */
+void
+QuadtreeTile::releaseMeshCache()
+{
+    delete ms_meshCache;
+    ms_meshCache = NULL;
+}
+
+
+// Draw the tile with the specified texture coordinate mapping. The mesh is taken
+// from the tile mesh cache, and only generated if it isn't already there.
+void
+QuadtreeTile::drawMesh(RenderContext& rc, const VertexSpec& spec, float s0, float t0, float ds, float dt) const
+{
+    TileMeshCache::Key key;
+    key.level = m_level;
+    key.row = m_row;
+    key.column = m_column;
+    key.s0 = s0;
+    key.t0 = t0;
+    key.ds = ds;
+    key.dt = dt;
+
+    TileMeshCache* cache = meshCache();
+    const VertexBuffer* vertexBuffer = cache->find(key);
+    if (vertexBuffer)
+    {
+        rc.bindVertexBuffer(spec, vertexBuffer, TileVertexStride);
+        drawTriangles(rc);
+    }
+    else
+    {
+        float vertexData[TileVertexCount * TileVertexSize];
+        GenerateTileVertices(vertexData, m_southwest, m_extent, s0, t0, ds, dt);
+
+        vertexBuffer = cache->insert(key, vertexData);
+        if (vertexBuffer)
+        {
+            rc.bindVertexBuffer(spec, vertexBuffer, TileVertexStride);
+        }
+        else
+        {
+            rc.bindVertexArray(spec, vertexData, TileVertexStride);
+        }
+
+        drawTriangles(rc);
+    }
+
+    // Unbind the buffer so that later vertex arrays aren't interpreted as offsets
+    if (vertexBuffer && vertexBuffer->vbo())
+    {
+        vertexBuffer->vbo()->unbind();
+    }
+}
+
+
 // Draw the tile mesh. This method assumes that the vertex arrays have already been set up.
 void
 QuadtreeTile::drawTriangles(RenderContext& rc) const
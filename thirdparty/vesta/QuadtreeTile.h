@@ -14,6 +14,7 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <deque>
+#include <vector>
 
 
 // The QuadtreeTile class is used for level of detail when rendering
@@ -31,6 +32,8 @@ class MapLayer;
 class QuadtreeTileAllocator;
 class WorldLayer;
 class WorldGeometry;
+class VertexSpec;
+class TileMeshCache;
 
 struct CullingPlaneSet
 {
@@ -80,6 +83,9 @@ public:
                     float splitThreshold,
                     float pixelSize);
     void split(const CullingPlaneSet& cullFrustum, const Eigen::Vector3f& semiAxes);
+    void merge();
+    bool canMerge() const;
+    bool coarsen();
     bool cull(const CullingPlaneSet& cullFrustum) const;
     void render(RenderContext& rc, unsigned int features) const;
     void render(RenderContext& rc, Material& material, TiledMap* tiledMap, unsigned int features) const;
@@ -131,8 +137,12 @@ public:
       */
     static const unsigned int TileSubdivision = 16;
 
+    static TileMeshCache* meshCache();
+    static void releaseMeshCache();
+
 private:
     void computeCenterAndRadius(const Eigen::Vector3f& semiAxes);
+    void drawMesh(RenderContext& rc, const VertexSpec& spec, float s0, float t0, float ds, float dt) const;
     void drawTriangles(RenderContext& rc) const;
 
     static bool createTileMeshIndices();
@@ -151,17 +161,25 @@ private:
     float m_boundingSphereRadius;
     float m_approxPixelSize;
     bool m_isCulled;
+    bool m_splitRequired;
 
     static v_uint16* ms_tileMeshIndices[16];
     static unsigned int ms_tileMeshTriangleCounts[16];
     static bool ms_indicesInitialized;
+    static TileMeshCache* ms_meshCache;
 };
 
 
+/** QuadtreeTileAllocator owns the tiles of a quadtree. The tree persists from
+  * one frame to the next: tiles are refined and coarsened as the view changes,
+  * and the storage of merged tiles is reused for new ones. The tree is only
+  * rebuilt from its roots when the allocator is cleared.
+  */
 class QuadtreeTileAllocator
 {
 public:
-    QuadtreeTileAllocator()
+    QuadtreeTileAllocator() :
+        m_semiAxes(Eigen::Vector3f::Zero())
     {
     }
 
@@ -185,18 +203,58 @@ public:
                           const Eigen::Vector3f& semiAxes)
     {
         QuadtreeTile tile(parent, whichChild, semiAxes);
+        if (!m_freeTiles.empty())
+        {
+            QuadtreeTile* reused = m_freeTiles.back();
+            m_freeTiles.pop_back();
+            *reused = tile;
+            return reused;
+        }
+
         m_tilePool.push_back(tile);
         return &m_tilePool.back();
     }
 
+    /** Get one of the root tiles. Root tiles are never freed, so the roots
+      * are always the first tiles in the pool.
+      */
+    QuadtreeTile* rootTile(unsigned int index)
+    {
+        return &m_tilePool[index];
+    }
+
+    /** Return a tile to the allocator. Freed tiles are marked as culled so that
+      * they're ignored when iterating over all tiles.
+      */
+    void freeTile(QuadtreeTile* tile)
+    {
+        tile->m_isCulled = true;
+        m_freeTiles.push_back(tile);
+    }
+
+    /** Get the number of tiles in use.
+      */
     unsigned int tileCount() const
     {
-        return m_tilePool.size();
+        return m_tilePool.size() - m_freeTiles.size();
     }
 
     void clear()
     {
         m_tilePool.clear();
+        m_freeTiles.clear();
+    }
+
+    /** Get the semi-axes of the ellipsoid that the tiles were created for.
+      */
+    Eigen::Vector3f semiAxes() const
+    {
+        return m_semiAxes;
+    }
+
+    void setSemiAxes(const Eigen::Vector3f& semiAxes)
+    {
+        m_semiAxes = semiAxes;
     }
 
     typedef std::deque<QuadtreeTile> TileArray;
@@ -208,6 +266,8 @@ public:
 
 private:
     TileArray m_tilePool;
+    std::vector<QuadtreeTile*> m_freeTiles;
+    Eigen::Vector3f m_semiAxes;
 };
 
 } // namespace vesta
@@ -35,6 +35,15 @@ public:
      *  @param t the number of seconds since 1 Jan 2000 12:00:00 UTC.
      */
     virtual Eigen::Vector3d angularVelocity(double t) const = 0;
+
+    /*! Return true if the rotation model may be evaluated by several threads
+     *  at once. Subclasses that call non-reentrant code or depend on the
+     *  orientations of entities must override this method to return false.
+     */
+    virtual bool isThreadSafe() const
+    {
+        return true;
+    }
 };
 
 }
@@ -94,22 +94,36 @@ SkyImageLayer::render(RenderContext& rc)
     // tiles might be more appropriate.
     Vector3f semiAxes = Vector3f::Constant(1.0f);
 
-    m_tileAllocator->clear();
-    QuadtreeTile* westHemi = m_tileAllocator->newRootTile(0, 0, Vector2f(-1.0f, -0.5f), 1.0f, semiAxes);
-    QuadtreeTile* eastHemi = m_tileAllocator->newRootTile(0, 1, Vector2f( 0.0f, -0.5f), 1.0f, semiAxes);
-
-    // Set up the neighbor connections for the root nodes. Since the map wraps,
-    // the eastern hemisphere is both the east and west neighbor of the western
-    // hemisphere (and vice versa.) There are no north and south neighbors.
-    westHemi->setNeighbor(QuadtreeTile::West, eastHemi);
-    westHemi->setNeighbor(QuadtreeTile::East, eastHemi);
-    eastHemi->setNeighbor(QuadtreeTile::West, westHemi);
-    eastHemi->setNeighbor(QuadtreeTile::East, westHemi);
+    // The quadtree is kept from one frame to the next, so the roots are only
+    // created the first time that the layer is drawn.
+    QuadtreeTile* westHemi = NULL;
+    QuadtreeTile* eastHemi = NULL;
+    if (m_tileAllocator->tileCount() == 0)
+    {
+        westHemi = m_tileAllocator->newRootTile(0, 0, Vector2f(-1.0f, -0.5f), 1.0f, semiAxes);
+        eastHemi = m_tileAllocator->newRootTile(0, 1, Vector2f( 0.0f, -0.5f), 1.0f, semiAxes);
+
+        // Set up the neighbor connections for the root nodes. Since the map wraps,
+        // the eastern hemisphere is both the east and west neighbor of the western
+        // hemisphere (and vice versa.) There are no north and south neighbors.
+        westHemi->setNeighbor(QuadtreeTile::West, eastHemi);
+        westHemi->setNeighbor(QuadtreeTile::East, eastHemi);
+        eastHemi->setNeighbor(QuadtreeTile::West, westHemi);
+        eastHemi->setNeighbor(QuadtreeTile::East, westHemi);
+    }
+    else
+    {
+        westHemi = m_tileAllocator->rootTile(0);
+        eastHemi = m_tileAllocator->rootTile(1);
+    }
 
     // TODO: Consider map tile resolution when setting the split threshold
     float splitThreshold = rc.pixelSize() * MaxSkyImageTileSquareSize * QuadtreeTile::TileSubdivision;
     westHemi->tessellate(eyePosition, cullingPlanes, semiAxes, splitThreshold, rc.pixelSize());
     eastHemi->tessellate(eyePosition, cullingPlanes, semiAxes, splitThreshold, rc.pixelSize());
+    while (westHemi->coarsen() || eastHemi->coarsen())
+    {
+    }
 
     glCullFace(GL_FRONT);
     westHemi->render(rc, tileFeatures);
@@ -10,6 +10,7 @@
 
 #include "StarCatalog.h"
 #include "Spectrum.h"
+#include "Units.h"
 #include "Debug.h"
 #include <Eigen/Core>
 #include <cmath>
@@ -22,7 +23,37 @@ using namespace std;
 
 /** Create an empty star catalog.
   */
-StarCatalog::StarCatalog()
+StarCatalog::StarCatalog() :
+    m_starCount(0),
+    m_stars(NULL),
+    m_cellStarts(NULL),
+    m_identifierIndex(NULL)
+{
+    m_cellStartData.resize(CellCount + 1, 0);
+    setOwnedArrays();
+}
+
+
+/** Create a star catalog from arrays that are already indexed (see buildCatalogIndex().)
+  * The arrays are not copied; the storage object is retained for as long as the
+  * catalog refers to them.
+  *
+  * \param starCount the number of stars
+  * \param stars array of starCount stars, grouped by sky cell and sorted by magnitude within each cell
+  * \param cellStarts index of the first star in each sky cell (CellCount + 1 entries)
+  * \param identifierIndex indices of the stars sorted by identifier (starCount entries)
+  * \param storage the owner of the arrays (may be null for static data)
+  */
+StarCatalog::StarCatalog(unsigned int starCount,
+                         const StarRecord* stars,
+                         const v_uint32* cellStarts,
+                         const v_uint32* identifierIndex,
+                         Object* storage) :
+    m_starCount(starCount),
+    m_stars(stars),
+    m_cellStarts(cellStarts),
+    m_identifierIndex(identifierIndex),
+    m_storage(storage)
 {
 }
 
@@ -32,6 +63,31 @@ StarCatalog::~StarCatalog()
 }
 
 
+void
+StarCatalog::setOwnedArrays()
+{
+    m_starCount = (unsigned int) m_starData.size();
+    m_stars = m_starData.empty() ? NULL : &m_starData[0];
+    m_cellStarts = &m_cellStartData[0];
+    m_identifierIndex = m_identifierIndexData.empty() ? NULL : &m_identifierIndexData[0];
+}
+
+
+// Copy stars from external storage so that the catalog can be modified
+void
+StarCatalog::detach()
+{
+    if (m_cellStartData.empty() || m_cellStarts != &m_cellStartData[0])
+    {
+        m_starData.assign(m_stars, m_stars + m_starCount);
+        m_cellStartData.assign(m_cellStarts, m_cellStarts + CellCount + 1);
+        m_identifierIndexData.assign(m_identifierIndex, m_identifierIndex + m_starCount);
+        m_storage = NULL;
+        setOwnedArrays();
+    }
+}
+
+
 // Convert a Johnson B-V color index to the effective surface temperature. Uses the
 // relation from Sekiguchi and Fukugita, "A Study of the B-V Color-Temperature Relation."
 // (Astronomical Journal, Aug 2000).
@@ -134,6 +190,8 @@ static Spectrum linearSrgbStarColor(float bv)
 void
 StarCatalog::addStar(v_uint32 identifier, double ra, double dec, double vmag, double bv)
 {
+    detach();
+
     StarRecord star;
     star.identifier = identifier;
     star.RA = float(ra);
@@ -142,6 +200,7 @@ StarCatalog::addStar(v_uint32 identifier, double ra, double dec, double vmag, do
     star.bvColorIndex = float(bv);
 
     m_starData.push_back(star);
+    setOwnedArrays();
 }
 
 
@@ -158,24 +217,176 @@ Spectrum StarCatalog::StarColor(float bv)
 }
 
 
+// Get the direction to a point on a face of the unit cube. Faces are numbered
+// +x, -x, +y, -y, +z, -z; u and v are in [-1, 1].
+static Vector3f cubeFacePoint(unsigned int face, float u, float v)
+{
+    float sign = (face & 1) ? -1.0f : 1.0f;
+    switch (face / 2)
+    {
+    case 0:
+        return Vector3f(sign, u, v);
+    case 1:
+        return Vector3f(u, sign, v);
+    default:
+        return Vector3f(u, v, sign);
+    }
+}
+
+
+static unsigned int gridIndex(float t)
+{
+    int i = int((t + 1.0f) * 0.5f * StarCatalog::CellGridSize);
+    return (unsigned int) std::max(0, std::min(int(StarCatalog::CellGridSize) - 1, i));
+}
+
+
+/** Get the sky cell containing a direction (which needn't be normalized.)
+  */
+unsigned int
+StarCatalog::SkyCell(const Vector3f& direction)
+{
+    Vector3f a = direction.cwise().abs();
+
+    unsigned int face;
+    float u;
+    float v;
+    if (a.x() >= a.y() && a.x() >= a.z())
+    {
+        face = direction.x() >= 0.0f ? 0 : 1;
+        u = direction.y() / a.x();
+        v = direction.z() / a.x();
+    }
+    else if (a.y() >= a.z())
+    {
+        face = direction.y() >= 0.0f ? 2 : 3;
+        u = direction.x() / a.y();
+        v = direction.z() / a.y();
+    }
+    else if (a.z() > 0.0f)
+    {
+        face = direction.z() >= 0.0f ? 4 : 5;
+        u = direction.x() / a.z();
+        v = direction.y() / a.z();
+    }
+    else
+    {
+        return 0;
+    }
+
+    return (face * CellGridSize + gridIndex(v)) * CellGridSize + gridIndex(u);
+}
+
+
+// Compute the position of a star on the unit sphere.
+static Vector3f StarPositionCartesian(const StarCatalog::StarRecord& star)
+{
+    float cosDec = cos(star.declination);
+    return Vector3f(cosDec * cos(star.RA), cosDec * sin(star.RA), sin(star.declination));
+}
+
+
+// A star with its sky cell, used for sorting the catalog
+struct CellStar
+{
+    unsigned int cell;
+    StarCatalog::StarRecord star;
+};
+
+
+class CellStarPredicate
+{
+public:
+    CellStarPredicate() {}
+    bool operator()(const CellStar& s0, const CellStar& s1) const
+    {
+        if (s0.cell != s1.cell)
+        {
+            return s0.cell < s1.cell;
+        }
+        else if (s0.star.apparentMagnitude != s1.star.apparentMagnitude)
+        {
+            return s0.star.apparentMagnitude < s1.star.apparentMagnitude;
+        }
+        else
+        {
+            return s0.star.identifier < s1.star.identifier;
+        }
+    }
+};
+
+
 class StarIdPredicate
 {
 public:
-    StarIdPredicate() {}
-    bool operator()(const StarCatalog::StarRecord& star0, const StarCatalog::StarRecord& star1) const
+    StarIdPredicate(const StarCatalog::StarRecord* stars) : m_stars(stars) {}
+    bool operator()(v_uint32 index0, v_uint32 index1) const
+    {
+        return m_stars[index0].identifier < m_stars[index1].identifier;
+    }
+
+private:
+    const StarCatalog::StarRecord* m_stars;
+};
+
+
+class IdLessPredicate
+{
+public:
+    IdLessPredicate(const StarCatalog::StarRecord* stars) : m_stars(stars) {}
+    bool operator()(v_uint32 index, v_uint32 id) const
     {
-        return star0.identifier < star1.identifier;
+        return m_stars[index].identifier < id;
     }
+
+private:
+    const StarCatalog::StarRecord* m_stars;
 };
 
 
-/** Index the star catalog by identifier. This method must be called before star lookups by identifier
-  * will work.
+/** Index the star catalog. Stars are grouped by sky cell and sorted by magnitude
+  * within each cell, and an index by identifier is built. This method must be
+  * called after stars are added and before stars are looked up by identifier or
+  * sky region. Note that it changes the indices of stars.
   */
 void
 StarCatalog::buildCatalogIndex()
 {
-    sort(m_starData.begin(), m_starData.end(), StarIdPredicate());
+    detach();
+
+    vector<CellStar> cellStars(m_starData.size());
+    for (unsigned int i = 0; i < m_starData.size(); ++i)
+    {
+        cellStars[i].cell = SkyCell(StarPositionCartesian(m_starData[i]));
+        cellStars[i].star = m_starData[i];
+    }
+
+    sort(cellStars.begin(), cellStars.end(), CellStarPredicate());
+
+    m_cellStartData.assign(CellCount + 1, 0);
+    for (unsigned int i = 0; i < cellStars.size(); ++i)
+    {
+        m_starData[i] = cellStars[i].star;
+        m_cellStartData[cellStars[i].cell + 1]++;
+    }
+
+    for (unsigned int cell = 0; cell < CellCount; ++cell)
+    {
+        m_cellStartData[cell + 1] += m_cellStartData[cell];
+    }
+
+    m_identifierIndexData.resize(m_starData.size());
+    for (unsigned int i = 0; i < m_starData.size(); ++i)
+    {
+        m_identifierIndexData[i] = i;
+    }
+
+    if (!m_starData.empty())
+    {
+        sort(m_identifierIndexData.begin(), m_identifierIndexData.end(), StarIdPredicate(&m_starData[0]));
+    }
+
+    setOwnedArrays();
 }
 
 
@@ -184,18 +395,154 @@ StarCatalog::buildCatalogIndex()
   * work.
   */
 const StarCatalog::StarRecord*
-StarCatalog::findStarIdentifier(v_uint32 id)
+StarCatalog::findStarIdentifier(v_uint32 id) const
 {
-    StarRecord match;
-    match.identifier = id;
+    if (!m_identifierIndex)
+    {
+        return NULL;
+    }
 
-    vector<StarRecord>::const_iterator pos = lower_bound(m_starData.begin(), m_starData.end(), match, StarIdPredicate());
-    if (pos == m_starData.end() || pos->identifier != id)
+    const v_uint32* end = m_identifierIndex + m_starCount;
+    const v_uint32* pos = lower_bound(m_identifierIndex, end, id, IdLessPredicate(m_stars));
+    if (pos == end || m_stars[*pos].identifier != id)
     {
         return NULL;
     }
     else
     {
-        return &(*pos);
+        return &m_stars[*pos];
+    }
+}
+
+
+// Get the number of stars in a cell at least as bright as the limiting magnitude
+unsigned int
+StarCatalog::brightStarCount(unsigned int cell, float limitingMagnitude) const
+{
+    unsigned int begin = m_cellStarts[cell];
+    unsigned int end = m_cellStarts[cell + 1];
+
+    // Binary search for the first star fainter than the limit
+    unsigned int first = begin;
+    unsigned int count = end - begin;
+    while (count > 0)
+    {
+        unsigned int step = count / 2;
+        if (m_stars[first + step].apparentMagnitude <= limitingMagnitude)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return first - begin;
+}
+
+
+/** Find all stars at least as bright as the limiting magnitude. The stars are
+  * returned as ranges of star indices (one for each non-empty sky cell.)
+  */
+void
+StarCatalog::findStars(float limitingMagnitude, vector<StarRange>* ranges) const
+{
+    ranges->clear();
+    for (unsigned int cell = 0; cell < CellCount; ++cell)
+    {
+        unsigned int count = brightStarCount(cell, limitingMagnitude);
+        if (count > 0)
+        {
+            StarRange range;
+            range.start = m_cellStarts[cell];
+            range.count = count;
+            ranges->push_back(range);
+        }
+    }
+}
+
+
+// Bounding cones of the sky cells, computed once
+class SkyCellBounds
+{
+public:
+    SkyCellBounds()
+    {
+        const float cellSize = 2.0f / StarCatalog::CellGridSize;
+        for (unsigned int face = 0; face < 6; ++face)
+        {
+            for (unsigned int j = 0; j < StarCatalog::CellGridSize; ++j)
+            {
+                for (unsigned int i = 0; i < StarCatalog::CellGridSize; ++i)
+                {
+                    float u0 = -1.0f + i * cellSize;
+                    float v0 = -1.0f + j * cellSize;
+                    Vector3f center = cubeFacePoint(face, u0 + cellSize * 0.5f, v0 + cellSize * 0.5f).normalized();
+
+                    // The corner farthest from the center is the one nearest the
+                    // edge of the face, but checking all four is simpler.
+                    float minCos = 1.0f;
+                    for (unsigned int corner = 0; corner < 4; ++corner)
+                    {
+                        Vector3f p = cubeFacePoint(face, u0 + (corner & 1) * cellSize, v0 + (corner >> 1) * cellSize).normalized();
+                        minCos = std::min(minCos, center.dot(p));
+                    }
+
+                    unsigned int cell = (face * StarCatalog::CellGridSize + j) * StarCatalog::CellGridSize + i;
+                    m_centers[cell] = center;
+                    m_radii[cell] = acos(std::max(-1.0f, std::min(1.0f, minCos)));
+                }
+            }
+        }
+    }
+
+    Vector3f m_centers[StarCatalog::CellCount];
+    float m_radii[StarCatalog::CellCount];
+};
+
+static const SkyCellBounds& skyCellBounds()
+{
+    static SkyCellBounds bounds;
+    return bounds;
+}
+
+
+/** Find all stars at least as bright as the limiting magnitude in the cells that
+  * overlap a cone. The stars are returned as ranges of star indices. Since whole
+  * cells are tested, some stars outside the cone are also returned.
+  *
+  * \param direction the unit vector along the axis of the cone, in the frame of
+  *                  the catalog (the J2000 equatorial frame)
+  * \param halfAngle the half angle of the cone in radians
+  * \param limitingMagnitude magnitude of the faintest stars to return
+  * \param ranges the list of star ranges, replaced by this method
+  */
+void
+StarCatalog::findStarsInCone(const Vector3f& direction,
+                             float halfAngle,
+                             float limitingMagnitude,
+                             vector<StarRange>* ranges) const
+{
+    ranges->clear();
+
+    const SkyCellBounds& bounds = skyCellBounds();
+    for (unsigned int cell = 0; cell < CellCount; ++cell)
+    {
+        float maxAngle = halfAngle + bounds.m_radii[cell];
+        if (maxAngle < float(PI) && bounds.m_centers[cell].dot(direction) < cos(maxAngle))
+        {
+            continue;
+        }
+
+        unsigned int count = brightStarCount(cell, limitingMagnitude);
+        if (count > 0)
+        {
+            StarRange range;
+            range.start = m_cellStarts[cell];
+            range.count = count;
+            ranges->push_back(range);
+        }
     }
 }
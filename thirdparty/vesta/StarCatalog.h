@@ -14,46 +14,124 @@
 #include "Entity.h"
 #include "Spectrum.h"
 #include "IntegerTypes.h"
+#include <Eigen/Core>
 #include <vector>
 
 namespace vesta
 {
 
+/** StarCatalog is a list of stars organized for fast visibility queries.
+  *
+  * After buildCatalogIndex() is called, the stars are grouped by sky cell
+  * and sorted by apparent magnitude within each cell. Sky cells are formed
+  * by projecting a grid on each face of a cube onto the celestial sphere.
+  * The stars brighter than some magnitude in a region of the sky are thus
+  * a set of contiguous ranges of star indices: one range at the start of
+  * each cell that overlaps the region.
+  *
+  * A catalog can either own its stars or refer to arrays stored elsewhere
+  * (typically a memory mapped file), which must already be indexed.
+  */
 class StarCatalog : public Object
 {
 public:
+    struct StarRecord
+    {
+        v_uint32 identifier;
+        float RA;
+        float declination;
+        float apparentMagnitude;
+        float bvColorIndex;
+    };
+
+    /** A range of star indices. */
+    struct StarRange
+    {
+        unsigned int start;
+        unsigned int count;
+    };
+
     StarCatalog();
+    StarCatalog(unsigned int starCount,
+                const StarRecord* stars,
+                const v_uint32* cellStarts,
+                const v_uint32* identifierIndex,
+                Object* storage);
     ~StarCatalog();
 
     unsigned int size() const
     {
-        return m_starData.size();
+        return m_starCount;
     }
 
     void addStar(v_uint32 identifier, double ra, double dec, double vmag, double bv);
     void buildCatalogIndex();
 
-public:
-    struct StarRecord
+    /** Return true if the catalog has been indexed since the last star was added.
+      */
+    bool isIndexed() const
     {
-        v_uint32 identifier;
-        float RA;
-        float declination;
-        float apparentMagnitude;
-        float bvColorIndex;
-    };
+        return m_cellStarts[CellCount] == m_starCount && (m_identifierIndex != NULL || m_starCount == 0);
+    }
+
+    const StarRecord& star(unsigned int index) const
+    {
+        return m_stars[index];
+    }
+
+    const StarRecord* findStarIdentifier(v_uint32 id) const;
+
+    void findStars(float limitingMagnitude, std::vector<StarRange>* ranges) const;
+    void findStarsInCone(const Eigen::Vector3f& direction,
+                         float halfAngle,
+                         float limitingMagnitude,
+                         std::vector<StarRange>* ranges) const;
+
+    /** Get the array of star records (size() records.) */
+    const StarRecord* starArray() const
+    {
+        return m_stars;
+    }
+
+    /** Get the index of the first star in each sky cell. The array has
+      * CellCount + 1 entries; the last is the total number of stars.
+      */
+    const v_uint32* cellStartArray() const
+    {
+        return m_cellStarts;
+    }
 
-    const StarRecord& star(unsigned int index)
+    /** Get the indices of the stars sorted by identifier (size() entries.) */
+    const v_uint32* identifierIndexArray() const
     {
-        return m_starData[index];
+        return m_identifierIndex;
     }
 
-    const StarRecord* findStarIdentifier(v_uint32 id);
+    static unsigned int SkyCell(const Eigen::Vector3f& direction);
 
     static Spectrum StarColor(float bv);
 
+    // Number of sky cells along each edge of a cube face
+    static const unsigned int CellGridSize = 32;
+    static const unsigned int CellCount = 6 * CellGridSize * CellGridSize;
+
+private:
+    void detach();
+    void setOwnedArrays();
+    unsigned int brightStarCount(unsigned int cell, float limitingMagnitude) const;
+
 private:
+    unsigned int m_starCount;
+    const StarRecord* m_stars;
+    const v_uint32* m_cellStarts;
+    const v_uint32* m_identifierIndex;
+
+    // Star data is either stored in the vectors below or in memory
+    // owned by m_storage.
     std::vector<StarRecord> m_starData;
+    std::vector<v_uint32> m_cellStartData;
+    std::vector<v_uint32> m_identifierIndexData;
+    counted_ptr<Object> m_storage;
 };
 
 }
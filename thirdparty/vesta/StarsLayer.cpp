@@ -12,6 +12,7 @@
 #include "RenderContext.h"
 #include "OGLHeaders.h"
 #include "ShaderBuilder.h"
+#include "Units.h"
 #include "Debug.h"
 #include "glhelp/GLVertexBuffer.h"
 #include "glhelp/GLShaderProgram.h"
@@ -202,13 +203,25 @@ static const char* PassthroughSRGBSource =
 
 static const float DefaultLimitingMagnitude = 7.0f;
 
+// Brightness of stars drawn without the star shader is fixed when the vertex
+// buffer is created; stars fainter than this magnitude are invisible.
+static const float FixedFunctionLimitingMagnitude = 7.0f;
+
+// Views with a field of view wider than this (in radians, measured from the
+// center to the corners) aren't culled.
+static const float MaxCulledHalfAngle = float(toRadians(80.0));
+
+const float StarsLayer::ReferenceFieldOfView = float(toRadians(45.0));
+
 StarsLayer::StarsLayer() :
     m_vertexArray(NULL),
     m_vertexBufferCurrent(false),
     m_starShaderCompiled(false),
     m_style(GaussianStars),
     m_limitingMagnitude(DefaultLimitingMagnitude),
-    m_diffractionSpikeBrightness(0.0f)
+    m_diffractionSpikeBrightness(0.0f),
+    m_fieldOfViewMagnitudeGain(0.0f),
+    m_drawnStarCount(0)
 {
 }
 
@@ -220,7 +233,9 @@ StarsLayer::StarsLayer(StarCatalog* starCatalog) :
     m_starShaderCompiled(false),
     m_style(GaussianStars),
     m_limitingMagnitude(DefaultLimitingMagnitude),
-    m_diffractionSpikeBrightness(0.0f)
+    m_diffractionSpikeBrightness(0.0f),
+    m_fieldOfViewMagnitudeGain(0.0f),
+    m_drawnStarCount(0)
 {
 }
 
@@ -312,7 +327,7 @@ CreateStarVertexArrayFF(StarCatalog* starCatalog)
         va[i].y = position.y();
         va[i].z = position.z();
         SetStarColorSRGB(star, va[i].color);
-        SetStarBrightness(star, 7.0f, 0.0f, va[i]);
+        SetStarBrightness(star, FixedFunctionLimitingMagnitude, 0.0f, va[i]);
     }
 
     return reinterpret_cast<char*>(va);
@@ -460,6 +475,22 @@ StarsLayer::render(RenderContext& rc)
     bool enableSRGBExt = GLEW_EXT_framebuffer_sRGB == GL_TRUE;
 #endif
 
+    // Stars fainter than the limiting magnitude are invisible, so only the
+    // bright stars in sky cells that overlap the view are drawn. Narrow fields
+    // of view may show fainter stars.
+    float limitingMagnitude = FixedFunctionLimitingMagnitude;
+    if (useStarShader)
+    {
+        limitingMagnitude = m_limitingMagnitude;
+        float fieldOfView = 2.0f * viewConeHalfAngle(rc);
+        if (m_fieldOfViewMagnitudeGain > 0.0f && fieldOfView < ReferenceFieldOfView)
+        {
+            limitingMagnitude += m_fieldOfViewMagnitudeGain * log(ReferenceFieldOfView / fieldOfView) / log(2.0f);
+        }
+    }
+
+    findVisibleStars(rc, limitingMagnitude);
+
     Material starMaterial;
     starMaterial.setDiffuse(Spectrum(1.0f, 1.0f, 1.0f));
     starMaterial.setBlendMode(Material::AdditiveBlend);
@@ -510,8 +541,8 @@ StarsLayer::render(RenderContext& rc)
         // brightness pixels.
         float visibilityThreshold = 1.0f / 255.0f;
         float logMVisThreshold = log(visibilityThreshold) / log(2.512f);
-        float saturationMag = m_limitingMagnitude - 4.5f; //+ logMVisThreshold;
-        float magScale = (logMVisThreshold) / (saturationMag - m_limitingMagnitude);
+        float saturationMag = limitingMagnitude - 4.5f; //+ logMVisThreshold;
+        float magScale = (logMVisThreshold) / (saturationMag - limitingMagnitude);
         starShader->setConstant("thresholdBrightness", visibilityThreshold);
         starShader->setConstant("exposure", pow(2.512f, magScale * saturationMag));
         starShader->setConstant("magScale", magScale);
@@ -535,7 +566,10 @@ StarsLayer::render(RenderContext& rc)
 #endif
     }
 
-    rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, m_starCatalog->size()));
+    for (vector<StarCatalog::StarRange>::const_iterator iter = m_drawRanges.begin(); iter != m_drawRanges.end(); ++iter)
+    {
+        rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, iter->count, iter->start));
+    }
 
     rc.unbindVertexBuffer();
 
@@ -610,3 +644,90 @@ StarsLayer::updateVertexBuffer()
 
     m_vertexBufferCurrent = true;
 }
+
+
+// Get the angle between the view direction and the corners of the view frustum
+float
+StarsLayer::viewConeHalfAngle(const RenderContext& rc) const
+{
+    const Matrix4f& projection = rc.projection().matrix();
+    if (projection(3, 3) != 0.0f || projection(0, 0) == 0.0f || projection(1, 1) == 0.0f)
+    {
+        // Not a perspective projection
+        return float(PI);
+    }
+
+    // Tangents of the angles between the view direction and the frustum
+    // edges (allowing for an off-center projection.)
+    float maxTan2 = 0.0f;
+    for (unsigned int corner = 0; corner < 4; ++corner)
+    {
+        float x = (corner & 1) ? 1.0f : -1.0f;
+        float y = (corner & 2) ? 1.0f : -1.0f;
+        float tx = (x + projection(0, 2)) / projection(0, 0);
+        float ty = (y + projection(1, 2)) / projection(1, 1);
+        maxTan2 = max(maxTan2, tx * tx + ty * ty);
+    }
+
+    return atan(sqrt(maxTan2));
+}
+
+
+// Find the ranges of the vertex buffer that contain the stars brighter than the
+// limiting magnitude in sky cells overlapping the view.
+void
+StarsLayer::findVisibleStars(const RenderContext& rc, float limitingMagnitude)
+{
+    m_drawRanges.clear();
+    m_drawnStarCount = 0;
+
+    if (m_starCatalog.isNull() || m_starCatalog->size() == 0)
+    {
+        return;
+    }
+
+    if (!m_starCatalog->isIndexed())
+    {
+        // Draw everything
+        StarCatalog::StarRange range;
+        range.start = 0;
+        range.count = m_starCatalog->size();
+        m_drawRanges.push_back(range);
+    }
+    else
+    {
+        float halfAngle = viewConeHalfAngle(rc);
+        if (halfAngle > MaxCulledHalfAngle)
+        {
+            m_starCatalog->findStars(limitingMagnitude, &m_drawRanges);
+        }
+        else
+        {
+            // Sky layers are drawn with a modelview matrix that is just a
+            // rotation, so the inverse is the transpose.
+            Vector3f viewDirection = -rc.modelview().linear().row(2).transpose();
+            m_starCatalog->findStarsInCone(viewDirection.normalized(), halfAngle, limitingMagnitude, &m_drawRanges);
+        }
+
+        // Merge adjacent ranges (when all of the stars in a cell are bright enough)
+        unsigned int mergedCount = 0;
+        for (unsigned int i = 0; i < m_drawRanges.size(); ++i)
+        {
+            if (mergedCount > 0 &&
+                m_drawRanges[mergedCount - 1].start + m_drawRanges[mergedCount - 1].count == m_drawRanges[i].start)
+            {
+                m_drawRanges[mergedCount - 1].count += m_drawRanges[i].count;
+            }
+            else
+            {
+                m_drawRanges[mergedCount++] = m_drawRanges[i];
+            }
+        }
+        m_drawRanges.resize(mergedCount);
+    }
+
+    for (vector<StarCatalog::StarRange>::const_iterator iter = m_drawRanges.begin(); iter != m_drawRanges.end(); ++iter)
+    {
+        m_drawnStarCount += iter->count;
+    }
+}
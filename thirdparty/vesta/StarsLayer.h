@@ -90,8 +90,47 @@ public:
         m_diffractionSpikeBrightness = brightness;
     }
 
+    /** Get the number of magnitudes added to the limiting magnitude each time
+      * the field of view is halved (starting from ReferenceFieldOfView.) The
+      * gain is zero by default.
+      */
+    float fieldOfViewMagnitudeGain() const
+    {
+        return m_fieldOfViewMagnitudeGain;
+    }
+
+    /** Set the number of magnitudes added to the limiting magnitude each time
+      * the field of view is halved. A positive gain shows fainter stars in
+      * narrow fields of view, as in a telescope.
+      */
+    void setFieldOfViewMagnitudeGain(float gain)
+    {
+        m_fieldOfViewMagnitudeGain = gain;
+    }
+
+    /** Get the number of stars submitted for drawing in the last frame.
+      */
+    unsigned int drawnStarCount() const
+    {
+        return m_drawnStarCount;
+    }
+
+    /** Get the number of ranges of stars (at most one per sky cell) drawn
+      * in the last frame.
+      */
+    unsigned int drawRangeCount() const
+    {
+        return (unsigned int) m_drawRanges.size();
+    }
+
+    // Diagonal field of view (in radians) above which the magnitude gain
+    // has no effect
+    static const float ReferenceFieldOfView;
+
 private:
     void updateVertexBuffer();
+    void findVisibleStars(const RenderContext& rc, float limitingMagnitude);
+    float viewConeHalfAngle(const RenderContext& rc) const;
 
 private:
     counted_ptr<StarCatalog> m_starCatalog;
@@ -104,6 +143,11 @@ private:
     StarStyle m_style;
     float m_limitingMagnitude;
     float m_diffractionSpikeBrightness;
+    float m_fieldOfViewMagnitudeGain;
+
+    // Ranges of the vertex buffer drawn in the current frame
+    std::vector<StarCatalog::StarRange> m_drawRanges;
+    unsigned int m_drawnStarCount;
 };
 
 }
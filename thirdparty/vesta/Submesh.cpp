@@ -10,6 +10,7 @@
 
 #include "Submesh.h"
 #include "Debug.h"
+#include "internal/TriangleBVH.h"
 #include <Eigen/LU>
 #include <Eigen/Geometry>
 #include <algorithm>
@@ -24,7 +25,8 @@ using namespace std;
 
 
 Submesh::Submesh(VertexArray* vertices) :
-    m_vertices(vertices)
+    m_vertices(vertices),
+    m_pickHierarchy(NULL)
 {
     m_boundingBox = vertices->computeBoundingBox();
     m_boundingSphereRadius = vertices->computeBoundingSphereRadius();
@@ -33,6 +35,7 @@ Submesh::Submesh(VertexArray* vertices) :
 
 Submesh::~Submesh()
 {
+    delete m_pickHierarchy;
     delete m_vertices;
     for (vector<PrimitiveBatch*>::iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
     {
@@ -49,6 +52,7 @@ Submesh::addPrimitiveBatch(PrimitiveBatch* batch, unsigned int materialIndex)
 {
     m_primitiveBatches.push_back(batch);
     m_materials.push_back(materialIndex);
+    invalidatePickHierarchy();
 
 #if 0
     // Code to compute the bounding sphere radius based only on
@@ -217,98 +221,6 @@ Submesh::mergeSubmeshes(const std::vector<Submesh*>& submeshes)
 }
 
 
-// Predicate to define an order on vertices
-class VertexOrderingPredicate
-{
-public:
-    VertexOrderingPredicate(const VertexArray* vertexArray) :
-        m_vertexArray(vertexArray),
-        m_vertexSpec(vertexArray->vertexSpec())
-    {
-    }
-
-    bool operator()(unsigned int index0, unsigned int index1) const
-    {
-        const VertexAttribute::Component* vertex0 = m_vertexArray->vertex(index0);
-        const VertexAttribute::Component* vertex1 = m_vertexArray->vertex(index1);
-
-        for (unsigned int attributeIndex = 0; attributeIndex < m_vertexSpec.attributeCount(); ++attributeIndex)
-        {
-            unsigned int attributeOffset = m_vertexSpec.attributeOffset(attributeIndex);
-            const VertexAttribute::Component* attr0 = vertex0 + (attributeOffset >> 2);
-            const VertexAttribute::Component* attr1 = vertex1 + (attributeOffset >> 2);
-
-            switch (m_vertexSpec.attribute(attributeIndex).format())
-            {
-            case VertexAttribute::Float4:
-                if (attr0[3].f < attr1[3].f)
-                {
-                    return true;
-                }
-                else if (attr0[3].f > attr1[3].f)
-                {
-                    return false;
-                }
-                // intentional fallthrough
-
-            case VertexAttribute::Float3:
-                if (attr0[2].f < attr1[2].f)
-                {
-                    return true;
-                }
-                else if (attr0[2].f > attr1[2].f)
-                {
-                    return false;
-                }
-                // intentional fallthrough
-
-            case VertexAttribute::Float2:
-                if (attr0[1].f < attr1[1].f)
-                {
-                    return true;
-                }
-                else if (attr0[1].f > attr1[1].f)
-                {
-                    return false;
-                }
-                // intentional fallthrough
-
-            case VertexAttribute::Float1:
-                if (attr0[0].f < attr1[0].f)
-                {
-                    return true;
-                }
-                else if (attr0[0].f > attr1[0].f)
-                {
-                    return false;
-                }
-                break;
-
-            case VertexAttribute::UByte4:
-                if (attr0[0].u < attr1[0].u)
-                {
-                    return true;
-                }
-                else if (attr0[0].u > attr1[0].u)
-                {
-                    return false;
-                }
-                break;
-
-            default:
-                break;
-            }
-        }
-
-        return false;
-    }
-
-private:
-    const VertexArray* m_vertexArray;
-    const VertexSpec& m_vertexSpec;
-};
-
-
 // See if f0 is a distance of tolerance or less from f1. This simple
 // test is used instead of a constant precision test because for testing
 // vertex equality we want the same 'granularity' over all vertices
@@ -418,7 +330,184 @@ private:
 };
 
 
-/** Remove duplicate vertices in this submesh.
+// Hash table used to find duplicate vertices. Vertices are bucketed by their
+// quantized positions. When the position tolerance is nonzero, the size of a
+// cell is equal to the tolerance, so that a vertex within tolerance of another
+// vertex must lie either in the same cell or in one of the adjacent cells.
+// With zero tolerance, the cell coordinates are just the bits of the position
+// components.
+class VertexWeldingTable
+{
+public:
+    VertexWeldingTable(const VertexArray* vertexArray, float positionTolerance, const VertexEqualityPredicate& equal) :
+        m_vertexArray(vertexArray),
+        m_equal(equal),
+        m_cellSize(positionTolerance),
+        m_positionOffset(0),
+        m_positionComponents(0),
+        m_neighborCount(1),
+        m_bucketMask(0)
+    {
+        const VertexSpec& spec = vertexArray->vertexSpec();
+        unsigned int positionIndex = spec.attributeIndex(VertexAttribute::Position);
+        if (positionIndex < spec.attributeCount())
+        {
+            m_positionOffset = spec.attributeOffset(positionIndex) >> 2;
+            switch (spec.attribute(positionIndex).format())
+            {
+            case VertexAttribute::Float1: m_positionComponents = 1; break;
+            case VertexAttribute::Float2: m_positionComponents = 2; break;
+            case VertexAttribute::Float3: m_positionComponents = 3; break;
+            case VertexAttribute::Float4: m_positionComponents = 4; break;
+            default: break;
+            }
+        }
+
+        // Cells are only distinguished by position; with no position attribute,
+        // all vertices share a single cell.
+        if (m_cellSize > 0.0f)
+        {
+            for (unsigned int i = 0; i < m_positionComponents; ++i)
+            {
+                m_neighborCount *= 3;
+            }
+        }
+
+        unsigned int bucketCount = 16;
+        while (bucketCount < vertexArray->count() * 2)
+        {
+            bucketCount *= 2;
+        }
+        m_buckets.resize(bucketCount, NotFound);
+        m_bucketMask = bucketCount - 1;
+    }
+
+    // Find a previously added vertex equal to the specified one. Returns the
+    // index of the entry (equal to the order in which entries were added) or
+    // NotFound if there's no matching vertex.
+    v_uint32 find(unsigned int vertexIndex) const
+    {
+        v_uint32 cell[4];
+        getCell(vertexIndex, cell);
+
+        // Neighbor zero is the vertex's own cell, which is where matches are most
+        // likely to be found.
+        for (unsigned int neighbor = 0; neighbor < m_neighborCount; ++neighbor)
+        {
+            v_uint32 neighborCell[4];
+            unsigned int n = neighbor;
+            for (unsigned int i = 0; i < m_positionComponents; ++i)
+            {
+                static const v_uint32 offsets[3] = { 0, v_uint32(-1), 1 };
+                neighborCell[i] = cell[i] + offsets[n % 3];
+                n /= 3;
+            }
+
+            for (v_uint32 entry = m_buckets[hashCell(neighborCell)]; entry != NotFound; entry = m_next[entry])
+            {
+                if (m_equal(m_vertexIndices[entry], vertexIndex))
+                {
+                    return entry;
+                }
+            }
+        }
+
+        return NotFound;
+    }
+
+    // Add a new vertex to the table. Returns the index of the new entry.
+    v_uint32 add(unsigned int vertexIndex)
+    {
+        v_uint32 cell[4];
+        getCell(vertexIndex, cell);
+
+        v_uint32 bucket = hashCell(cell);
+        v_uint32 entry = v_uint32(m_vertexIndices.size());
+        m_vertexIndices.push_back(vertexIndex);
+        m_next.push_back(m_buckets[bucket]);
+        m_buckets[bucket] = entry;
+
+        return entry;
+    }
+
+    // Get the number of vertices added to the table
+    unsigned int size() const
+    {
+        return (unsigned int) m_vertexIndices.size();
+    }
+
+    static const v_uint32 NotFound = 0xffffffff;
+
+private:
+    void getCell(unsigned int vertexIndex, v_uint32* cell) const
+    {
+        const VertexAttribute::Component* position = m_vertexArray->vertex(vertexIndex) + m_positionOffset;
+        for (unsigned int i = 0; i < m_positionComponents; ++i)
+        {
+            float f = position[i].f;
+            if (m_cellSize > 0.0f)
+            {
+                // Clamp so that cell coordinates of huge (or NaN) values can't overflow
+                double c = floor(double(f) / double(m_cellSize));
+                if (!(c > -2.0e9))
+                {
+                    c = -2.0e9;
+                }
+                else if (c > 2.0e9)
+                {
+                    c = 2.0e9;
+                }
+                cell[i] = v_uint32(v_int32(c));
+            }
+            else
+            {
+                // Treat negative zero as equal to zero
+                if (f == 0.0f)
+                {
+                    f = 0.0f;
+                }
+
+                VertexAttribute::Component component;
+                component.f = f;
+                cell[i] = component.u;
+            }
+        }
+    }
+
+    v_uint32 hashCell(const v_uint32* cell) const
+    {
+        // FNV-1a, with the component words as input
+        v_uint32 h = 2166136261u;
+        for (unsigned int i = 0; i < m_positionComponents; ++i)
+        {
+            h = (h ^ cell[i]) * 16777619u;
+        }
+        h ^= h >> 15;
+
+        return h & m_bucketMask;
+    }
+
+private:
+    const VertexArray* m_vertexArray;
+    const VertexEqualityPredicate& m_equal;
+    float m_cellSize;
+    unsigned int m_positionOffset;
+    unsigned int m_positionComponents;
+    unsigned int m_neighborCount;
+    v_uint32 m_bucketMask;
+    vector<v_uint32> m_buckets;
+    vector<v_uint32> m_vertexIndices;
+    vector<v_uint32> m_next;
+};
+
+
+/** Remove duplicate vertices in this submesh. Vertices are welded using a hash table
+  * of quantized vertex positions, so the cost is linear in the number of vertices. Each
+  * vertex is merged with the first vertex in the submesh that matches it within the
+  * specified tolerances.
+  *
+  * This method only modifies the submesh, so it may be called for different submeshes
+  * of a mesh in parallel.
   *
   * \return true if unquification was successful, false if an error occurred (should only happen
   * in a low memory situation.)
@@ -426,74 +515,68 @@ private:
 bool
 Submesh::uniquifyVertices(float positionTolerance, float normalTolerance, float texCoordTolerance)
 {
-    vector<unsigned int> vertexIndices;
-    vertexIndices.resize(m_vertices->count());
-    for (unsigned int i = 0; i < m_vertices->count(); ++i)
-    {
-        vertexIndices[i] = i;
-    }
-
-    // Order the vertices so that identical ones will be close to each other.
-    sort(vertexIndices.begin(), vertexIndices.end(), VertexOrderingPredicate(m_vertices));
-
     VertexEqualityPredicate equal(m_vertices);
     equal.setTolerance(VertexAttribute::Position,     positionTolerance);
     equal.setTolerance(VertexAttribute::Normal,       normalTolerance);
     equal.setTolerance(VertexAttribute::TextureCoord, texCoordTolerance);
     equal.setTolerance(VertexAttribute::Tangent,      normalTolerance);
 
-    // Count the number of unique vertices so that we know how much space to allocate
-    unsigned int uniqueVertexCount = 0;
+    // Build the map that associates vertices in the old vertex array with unique indices.
+    VertexWeldingTable weldingTable(m_vertices, positionTolerance, equal);
+    vector<v_uint32> vertexMap;
+    vertexMap.resize(m_vertices->count());
+
     for (unsigned int i = 0; i < m_vertices->count(); ++i)
     {
-        if (i == 0 || !equal(vertexIndices[i - 1], vertexIndices[i]))
+        v_uint32 uniqueIndex = weldingTable.find(i);
+        if (uniqueIndex == VertexWeldingTable::NotFound)
         {
-            uniqueVertexCount++;
+            uniqueIndex = weldingTable.add(i);
         }
+        vertexMap[i] = uniqueIndex;
     }
 
+    unsigned int uniqueVertexCount = weldingTable.size();
+
     // Don't continue if we can't shrink the amount of vertex data
     if (uniqueVertexCount == m_vertices->count())
     {
         return true;
     }
 
-    // Build the map that associates vertices in the old vertex array with unique indices.
-    // In the same loop, copy the unique vertex data from the old vertex array to the
-    // new one.
-    vector<v_uint32> vertexMap;
-    vertexMap.resize(m_vertices->count());
+    //VESTA_LOG("%d of %d vertices unique.", uniqueVertexCount, m_vertices->count());
 
+    return remapVertices(vertexMap, uniqueVertexCount);
+}
+
+
+// Replace the vertex array with a new one containing newVertexCount vertices,
+// with vertex i of the old array moved to vertexMap[i]. When several vertices
+// map to the same new vertex, the lowest numbered one is kept.
+bool
+Submesh::remapVertices(const vector<v_uint32>& vertexMap, unsigned int newVertexCount)
+{
     unsigned int vertexStride = m_vertices->stride();
-    char* newVertexData = new char[uniqueVertexCount * m_vertices->stride()];
+    char* newVertexData = new char[newVertexCount * vertexStride];
     const char* currentVertexData = reinterpret_cast<const char*>(m_vertices->data());
 
-    v_uint32 newVertexIndex = 0;
-    for (unsigned int i = 0; i < m_vertices->count(); ++i)
+    // Copy in reverse order so that the lowest numbered of the merged vertices is
+    // the last one written.
+    for (unsigned int i = m_vertices->count(); i > 0; --i)
     {
-        if (i == 0 || !equal(vertexIndices[i - 1], vertexIndices[i]))
-        {
-            if (i > 0)
-            {
-                newVertexIndex++;
-            }
-
-            assert(newVertexIndex < uniqueVertexCount);
-            const char* vertexStart = currentVertexData + vertexIndices[i] * vertexStride;
-            copy(vertexStart, vertexStart + vertexStride, newVertexData + newVertexIndex * vertexStride);
-        }
-
-        vertexMap[vertexIndices[i]] = newVertexIndex;
+        const char* vertexStart = currentVertexData + (i - 1) * vertexStride;
+        assert(vertexMap[i - 1] < newVertexCount);
+        copy(vertexStart, vertexStart + vertexStride, newVertexData + vertexMap[i - 1] * vertexStride);
     }
 
-    VertexArray* newVertexArray = new VertexArray(newVertexData, uniqueVertexCount, m_vertices->vertexSpec(), m_vertices->stride());
+    VertexArray* newVertexArray = new VertexArray(newVertexData, newVertexCount, m_vertices->vertexSpec(), m_vertices->stride());
 
     // Remap all vertex indices
     for (vector<PrimitiveBatch*>::iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
     {
         // Vertex remapping might require us to promote 16-bit indices to 32-bit,
         // even though the total number of vertices has been reduced.
-        if (uniqueVertexCount > PrimitiveBatch::MaxIndex16 && (*iter)->indexSize() == PrimitiveBatch::Index16)
+        if (newVertexCount > PrimitiveBatch::MaxIndex16 && (*iter)->indexSize() == PrimitiveBatch::Index16)
         {
             if (!(*iter)->promoteTo32Bit())
             {
@@ -515,8 +598,7 @@ Submesh::uniquifyVertices(float positionTolerance, float normalTolerance, float
 
     delete m_vertices;
     m_vertices = newVertexArray;
-
-    //VESTA_LOG("%d of %d vertices unique.", uniqueVertexCount, vertexIndices.size());
+    invalidatePickHierarchy();
 
     return true;
 }
@@ -539,6 +621,400 @@ Submesh::compressIndices()
 }
 
 
+// Size of the LRU cache modeled when optimizing triangle order
+static const unsigned int OptimizedVertexCacheSize = 32;
+
+// Size of the FIFO cache used to measure the average cache miss ratio
+static const unsigned int SimulatedVertexCacheSize = 16;
+
+// Maximum valence for which vertex score is precomputed
+static const unsigned int MaxScoreTableValence = 32;
+
+
+// Score tables used by optimizeTriangleOrder; see the description of that function
+// for the meaning of the constants.
+class VertexScoreTable
+{
+public:
+    VertexScoreTable()
+    {
+        const float CacheDecayPower = 1.5f;
+        const float LastTriangleScore = 0.75f;
+        const float ValenceBoostScale = 2.0f;
+
+        for (unsigned int i = 0; i < OptimizedVertexCacheSize; ++i)
+        {
+            if (i < 3)
+            {
+                // Vertices of the most recently added triangle get a fixed score so that
+                // the optimizer doesn't favor triangles using just one of them.
+                m_cacheScore[i] = LastTriangleScore;
+            }
+            else
+            {
+                float scaler = 1.0f / float(OptimizedVertexCacheSize - 3);
+                m_cacheScore[i] = pow(1.0f - float(i - 3) * scaler, CacheDecayPower);
+            }
+        }
+
+        m_valenceScore[0] = 0.0f;
+        for (unsigned int i = 1; i <= MaxScoreTableValence; ++i)
+        {
+            m_valenceScore[i] = ValenceBoostScale / sqrt(float(i));
+        }
+    }
+
+    float score(int cachePosition, unsigned int remainingValence) const
+    {
+        if (remainingValence == 0)
+        {
+            // No triangles need this vertex
+            return -1.0f;
+        }
+
+        float s = cachePosition < 0 ? 0.0f : m_cacheScore[cachePosition];
+        if (remainingValence <= MaxScoreTableValence)
+        {
+            s += m_valenceScore[remainingValence];
+        }
+        else
+        {
+            s += m_valenceScore[1] / sqrt(float(remainingValence));
+        }
+
+        return s;
+    }
+
+private:
+    float m_cacheScore[OptimizedVertexCacheSize];
+    float m_valenceScore[MaxScoreTableValence + 1];
+};
+
+
+// Reorder the triangles in a triangle list to improve post-transform vertex cache
+// locality. This is Tom Forsyth's 'Linear-Speed Vertex Cache Optimisation': triangles
+// are added greedily, choosing at each step the one with the highest score among
+// triangles that use vertices in a simulated LRU cache. A vertex's score rises when
+// it's near the front of the cache and when few unadded triangles use it (so that
+// isolated triangles get cleaned up rather than left for later.)
+static void
+optimizeTriangleOrder(vector<v_uint32>& indices, unsigned int vertexCount)
+{
+    static const VertexScoreTable scoreTable;
+
+    unsigned int triangleCount = (unsigned int) indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Build the list of triangles adjacent to each vertex
+    vector<unsigned int> remainingValence(vertexCount, 0);
+    for (unsigned int i = 0; i < triangleCount * 3; ++i)
+    {
+        remainingValence[indices[i]]++;
+    }
+
+    vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; ++v)
+    {
+        adjacencyStart[v + 1] = adjacencyStart[v] + remainingValence[v];
+    }
+
+    vector<unsigned int> adjacentTriangles(triangleCount * 3);
+    {
+        vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (unsigned int i = 0; i < triangleCount * 3; ++i)
+        {
+            adjacentTriangles[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; ++v)
+    {
+        vertexScore[v] = scoreTable.score(-1, remainingValence[v]);
+    }
+
+    vector<bool> triangleAdded(triangleCount, false);
+
+    // Room for the full cache plus the three vertices of a newly added triangle
+    v_uint32 cache[OptimizedVertexCacheSize + 3];
+    unsigned int cacheCount = 0;
+
+    vector<v_uint32> orderedIndices;
+    orderedIndices.reserve(triangleCount * 3);
+
+    unsigned int bestTriangle = 0;
+    unsigned int nextUnaddedTriangle = 0;
+    for (unsigned int addedCount = 0; addedCount < triangleCount; ++addedCount)
+    {
+        if (bestTriangle == triangleCount)
+        {
+            // No triangles share a vertex with the cache. Rather than searching every
+            // remaining triangle for the best one, just take the next unadded triangle.
+            while (triangleAdded[nextUnaddedTriangle])
+            {
+                ++nextUnaddedTriangle;
+            }
+            bestTriangle = nextUnaddedTriangle;
+        }
+
+        unsigned int t = bestTriangle;
+        triangleAdded[t] = true;
+
+        v_uint32 newCache[OptimizedVertexCacheSize + 3];
+        unsigned int newCacheCount = 0;
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            v_uint32 v = indices[t * 3 + i];
+            orderedIndices.push_back(v);
+
+            // Remove the triangle from the vertex's list of remaining triangles
+            unsigned int* adjacent = &adjacentTriangles[adjacencyStart[v]];
+            unsigned int valence = remainingValence[v];
+            for (unsigned int j = 0; j < valence; ++j)
+            {
+                if (adjacent[j] == t)
+                {
+                    adjacent[j] = adjacent[valence - 1];
+                    break;
+                }
+            }
+            remainingValence[v]--;
+
+            // Move the vertex to the front of the cache (degenerate triangles may
+            // contain the same vertex more than once.)
+            if (find(newCache, newCache + newCacheCount, v) == newCache + newCacheCount)
+            {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        for (unsigned int i = 0; i < cacheCount; ++i)
+        {
+            v_uint32 v = cache[i];
+            if (find(newCache, newCache + newCacheCount, v) == newCache + newCacheCount)
+            {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        // Update the scores of all vertices in the cache, including the ones that were
+        // just pushed out of it.
+        for (unsigned int i = 0; i < newCacheCount; ++i)
+        {
+            v_uint32 v = newCache[i];
+            cachePosition[v] = i < OptimizedVertexCacheSize ? int(i) : -1;
+            vertexScore[v] = scoreTable.score(cachePosition[v], remainingValence[v]);
+        }
+
+        // Rescore the triangles that use cached vertices and pick the best
+        bestTriangle = triangleCount;
+        float bestScore = -1.0f;
+        for (unsigned int i = 0; i < newCacheCount; ++i)
+        {
+            v_uint32 v = newCache[i];
+            const unsigned int* adjacent = &adjacentTriangles[adjacencyStart[v]];
+            for (unsigned int j = 0; j < remainingValence[v]; ++j)
+            {
+                unsigned int u = adjacent[j];
+                float score = vertexScore[indices[u * 3]] + vertexScore[indices[u * 3 + 1]] + vertexScore[indices[u * 3 + 2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = u;
+                }
+            }
+        }
+
+        cacheCount = min(newCacheCount, OptimizedVertexCacheSize);
+        copy(newCache, newCache + cacheCount, cache);
+    }
+
+    indices.swap(orderedIndices);
+}
+
+
+/** Reorder triangles and vertices to make effective use of the GPU's post-transform
+  * vertex cache and pre-transform vertex fetch. The triangles of each indexed triangle
+  * list are reordered so that vertices are reused while they're still in the cache,
+  * then the vertices are renumbered in the order that they are first used. This
+  * should be called after uniquifyVertices and mergeMaterials, since both merge
+  * data that the reordering would otherwise treat separately.
+  *
+  * Like uniquifyVertices, this may be called for different submeshes in parallel.
+  *
+  * \return true if optimization was successful, false if an error occurred
+  */
+bool
+Submesh::optimizeVertexCache()
+{
+    unsigned int vertexCount = m_vertices->count();
+    bool allIndexed = true;
+
+    for (vector<PrimitiveBatch*>::iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
+    {
+        PrimitiveBatch* batch = *iter;
+        if (!batch->isIndexed())
+        {
+            allIndexed = false;
+            continue;
+        }
+
+        if (batch->primitiveType() != PrimitiveBatch::Triangles || batch->maxVertexIndex() >= vertexCount)
+        {
+            continue;
+        }
+
+        unsigned int indexCount = batch->indexCount();
+        vector<v_uint32> indices(indexCount);
+        if (batch->indexSize() == PrimitiveBatch::Index16)
+        {
+            const v_uint16* index16 = reinterpret_cast<const v_uint16*>(batch->indexData());
+            copy(index16, index16 + indexCount, indices.begin());
+        }
+        else
+        {
+            const v_uint32* index32 = reinterpret_cast<const v_uint32*>(batch->indexData());
+            copy(index32, index32 + indexCount, indices.begin());
+        }
+
+        optimizeTriangleOrder(indices, vertexCount);
+
+        // The reordered indices have the same values, so they can be written back in place
+        if (batch->indexSize() == PrimitiveBatch::Index16)
+        {
+            v_uint16* index16 = reinterpret_cast<v_uint16*>(batch->indexData());
+            for (unsigned int i = 0; i < indexCount; ++i)
+            {
+                index16[i] = v_uint16(indices[i]);
+            }
+        }
+        else
+        {
+            copy(indices.begin(), indices.end(), reinterpret_cast<v_uint32*>(batch->indexData()));
+        }
+    }
+
+    // Unindexed batches depend on the order of vertices, so vertex reordering is
+    // only possible when every batch is indexed.
+    if (!allIndexed || vertexCount == 0)
+    {
+        return true;
+    }
+
+    // Number vertices in the order of first use. Unused vertices are moved to the end.
+    const v_uint32 Unmapped = PrimitiveBatch::MaxIndex32;
+    vector<v_uint32> vertexMap(vertexCount, Unmapped);
+    v_uint32 nextVertex = 0;
+    for (vector<PrimitiveBatch*>::iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
+    {
+        PrimitiveBatch* batch = *iter;
+        unsigned int indexCount = batch->indexCount();
+        for (unsigned int i = 0; i < indexCount; ++i)
+        {
+            v_uint32 index;
+            if (batch->indexSize() == PrimitiveBatch::Index16)
+            {
+                index = reinterpret_cast<const v_uint16*>(batch->indexData())[i];
+            }
+            else
+            {
+                index = reinterpret_cast<const v_uint32*>(batch->indexData())[i];
+            }
+
+            if (index < vertexCount && vertexMap[index] == Unmapped)
+            {
+                vertexMap[index] = nextVertex++;
+            }
+        }
+    }
+
+    bool identity = true;
+    for (unsigned int v = 0; v < vertexCount; ++v)
+    {
+        if (vertexMap[v] == Unmapped)
+        {
+            vertexMap[v] = nextVertex++;
+        }
+        identity = identity && vertexMap[v] == v;
+    }
+
+    if (identity)
+    {
+        return true;
+    }
+
+    return remapVertices(vertexMap, vertexCount);
+}
+
+
+/** Compute the average cache miss ratio (ACMR) of the indexed triangle lists in this
+  * submesh: the number of vertices that must be transformed per triangle, assuming a
+  * 16 entry FIFO post-transform cache. The value ranges from 3 for no reuse down to
+  * about 0.5 for a large, ideally ordered regular mesh. Zero is returned if the
+  * submesh contains no indexed triangle lists.
+  *
+  * \param triangleCount if not NULL, set to the number of triangles measured
+  */
+float
+Submesh::averageCacheMissRatio(unsigned int* triangleCount) const
+{
+    unsigned int vertexCount = m_vertices->count();
+    unsigned int misses = 0;
+    unsigned int triangles = 0;
+
+    // A vertex is in the cache if fewer than cache size misses have occurred
+    // since it was last loaded.
+    vector<unsigned int> loadTime(vertexCount, 0);
+    unsigned int time = SimulatedVertexCacheSize + 1;
+
+    for (vector<PrimitiveBatch*>::const_iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
+    {
+        const PrimitiveBatch* batch = *iter;
+        if (!batch->isIndexed() || batch->primitiveType() != PrimitiveBatch::Triangles)
+        {
+            continue;
+        }
+
+        unsigned int indexCount = batch->indexCount();
+        for (unsigned int i = 0; i < indexCount; ++i)
+        {
+            v_uint32 index;
+            if (batch->indexSize() == PrimitiveBatch::Index16)
+            {
+                index = reinterpret_cast<const v_uint16*>(batch->indexData())[i];
+            }
+            else
+            {
+                index = reinterpret_cast<const v_uint32*>(batch->indexData())[i];
+            }
+
+            if (index >= vertexCount || time - loadTime[index] > SimulatedVertexCacheSize)
+            {
+                if (index < vertexCount)
+                {
+                    loadTime[index] = time;
+                }
+                ++time;
+                ++misses;
+            }
+        }
+
+        triangles += batch->primitiveCount();
+    }
+
+    if (triangleCount)
+    {
+        *triangleCount = triangles;
+    }
+
+    return triangles == 0 ? 0.0f : float(misses) / float(triangles);
+}
+
+
 // Helper function to get the vertex indices of a triangle
 // Handles unindexed primitive batches, all triangle primitives types, and
 // 16- and 32-bit vertex indices.
@@ -633,6 +1109,64 @@ static void getTriangleVertexIndices(const PrimitiveBatch* primitives,
 }
 
 
+// Get the bounding volume hierarchy used for ray picking, building it if
+// necessary. The hierarchy is built on the first pick rather than at load time,
+// since most meshes are never picked. Not thread safe.
+const TriangleBVH*
+Submesh::pickHierarchy() const
+{
+    if (!m_pickHierarchy)
+    {
+        vector<TriangleBVH::Triangle> triangles;
+
+        // Only primitives that have non-zero area (i.e. triangles) can be picked
+        unsigned int positionIndex = m_vertices->vertexSpec().attributeIndex(VertexAttribute::Position);
+        if (positionIndex != VertexSpec::InvalidAttribute)
+        {
+            for (vector<PrimitiveBatch*>::const_iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
+            {
+                const PrimitiveBatch* prims = *iter;
+                if (prims->primitiveType() == PrimitiveBatch::Triangles ||
+                    prims->primitiveType() == PrimitiveBatch::TriangleStrip ||
+                    prims->primitiveType() == PrimitiveBatch::TriangleFan)
+                {
+                    for (unsigned int triIndex = 0; triIndex < prims->primitiveCount(); ++triIndex)
+                    {
+                        // Get the indices of the triangle vertices
+                        unsigned int index0 = 0;
+                        unsigned int index1 = 0;
+                        unsigned int index2 = 0;
+                        getTriangleVertexIndices(prims, triIndex, &index0, &index1, &index2);
+
+                        if (index0 < m_vertices->count() && index1 < m_vertices->count() && index2 < m_vertices->count())
+                        {
+                            TriangleBVH::Triangle triangle;
+                            triangle.v0 = m_vertices->position(index0);
+                            triangle.v1 = m_vertices->position(index1);
+                            triangle.v2 = m_vertices->position(index2);
+                            triangles.push_back(triangle);
+                        }
+                    }
+                }
+            }
+        }
+
+        m_pickHierarchy = new TriangleBVH(triangles);
+    }
+
+    return m_pickHierarchy;
+}
+
+
+// Discard the pick hierarchy after a change to the submesh geometry
+void
+Submesh::invalidatePickHierarchy()
+{
+    delete m_pickHierarchy;
+    m_pickHierarchy = NULL;
+}
+
+
 /** Test whether this submesh is intersected by the given pick
   * ray. The pickOrigin and pickDirection are local coordinate
   * system of the submesh. Only triangles are tested for intersection.
@@ -640,6 +1174,10 @@ static void getTriangleVertexIndices(const PrimitiveBatch* primitives,
   * intersection test to return hits on completely transparent
   * geometry.
   *
+  * The first pick builds a bounding volume hierarchy for the
+  * submesh triangles, after which the cost of a pick is roughly
+  * logarithmic in the number of triangles.
+  *
   * @param pickOrigin origin of the pick ray in model space
   * @param pickDirection direction of the pick ray in model space (must be normalized)
   * @param distance filled in with the distance to the geometry if the ray hits
@@ -649,97 +1187,64 @@ Submesh::rayPick(const Vector3d& pickOrigin,
                  const Vector3d& pickDirection,
                  double* distance) const
 {
-    // Verify that we have a valid position attribute
-    unsigned int positionIndex = m_vertices->vertexSpec().attributeIndex(VertexAttribute::Position);
-    if (positionIndex == VertexSpec::InvalidAttribute)
+    float hitDistance = 0.0f;
+    if (pickHierarchy()->rayPick(pickOrigin.cast<float>(), pickDirection.cast<float>(), &hitDistance))
+    {
+        *distance = hitDistance;
+        return true;
+    }
+    else
     {
+        // No intersection
         return false;
     }
+}
 
-    Vector3f pickOriginf = pickOrigin.cast<float>();
-    Vector3f pickDirectionf = pickDirection.cast<float>();
 
-    float closestHit = numeric_limits<float>::infinity();
+/** Test multiple pick rays for intersection with this submesh. This is
+  * more efficient than picking the rays one at a time when the rays are
+  * coherent, e.g. picks in a small region of the screen.
+  *
+  * @param pickOrigins array of rayCount pick ray origins in model space
+  * @param pickDirections array of rayCount pick ray directions in model space (must be normalized)
+  * @param distances array of rayCount distances, filled in with the distance to the geometry
+  *                  for rays that hit, and infinity for rays that miss
+  * @return the number of rays that hit the submesh
+  */
+unsigned int
+Submesh::rayPick(const Vector3d* pickOrigins,
+                 const Vector3d* pickDirections,
+                 unsigned int rayCount,
+                 double* distances) const
+{
+    const TriangleBVH* hierarchy = pickHierarchy();
+    unsigned int hitCount = 0;
 
-    for (vector<PrimitiveBatch*>::const_iterator iter = m_primitiveBatches.begin(); iter != m_primitiveBatches.end(); ++iter)
+    for (unsigned int first = 0; first < rayCount; first += TriangleBVH::MaxPacketSize)
     {
-        const PrimitiveBatch* prims = *iter;
-
-        // Only check for intersections with primitives that have non-zero area (i.e. triangles)
-        if (prims->primitiveType() == PrimitiveBatch::Triangles ||
-            prims->primitiveType() == PrimitiveBatch::TriangleStrip ||
-            prims->primitiveType() == PrimitiveBatch::TriangleFan)
+        unsigned int count = rayCount - first;
+        if (count > TriangleBVH::MaxPacketSize)
         {
-            for (unsigned int triIndex = 0; triIndex < prims->primitiveCount(); ++triIndex)
-            {
-                // Get the indices of the triangle vertices
-                unsigned int index0 = 0;
-                unsigned int index1 = 0;
-                unsigned int index2 = 0;
-                getTriangleVertexIndices(prims, triIndex, &index0, &index1, &index2);
+            count = TriangleBVH::MaxPacketSize;
+        }
 
-                if (index0 < m_vertices->count() && index1 < m_vertices->count() && index2 < m_vertices->count())
-                {
-                    // We have valid vertex indices, now perform the intersection test
-                    Vector3f v0 = m_vertices->position(index0);
-                    Vector3f v1 = m_vertices->position(index1);
-                    Vector3f v2 = m_vertices->position(index2);
-
-                    Vector3f edge0 = v1 - v0;
-                    Vector3f edge1 = v2 - v0;
-                    Vector3f normal = edge0.cross(edge1);
-
-                    // If the triangle normal and direction are perpendicular, the ray is parallel to the triangle.
-                    // Treat this as always being a miss (even when the direction vector lies in the plane of the
-                    // triangle.)
-                    float d = normal.dot(pickDirectionf);
-                    if (d != 0.0f)
-                    {
-                        float planeIntersect = normal.dot(v0 - pickOriginf) / d;
+        Vector3f origins[TriangleBVH::MaxPacketSize];
+        Vector3f directions[TriangleBVH::MaxPacketSize];
+        float hitDistances[TriangleBVH::MaxPacketSize];
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            origins[i] = pickOrigins[first + i].cast<float>();
+            directions[i] = pickDirections[first + i].cast<float>();
+        }
 
-                        // See if the intersection point is in front of the ray origin and
-                        // closer than the closest hit so far.
-                        if (planeIntersect > 0.0f && planeIntersect < closestHit)
-                        {
-                            Matrix2f e;
-                            e << edge0.dot(edge0), edge0.dot(edge1),
-                                 edge1.dot(edge0), edge1.dot(edge1);
-                            float a = e.determinant();
-                            if (a != 0.0f)
-                            {
-                                e *= (1.0f / a);
-
-                                // Compute the point at which the the pick ray intersects the triangle plane
-                                Vector3f p = pickOriginf + pickDirectionf * planeIntersect - v0;
-                                float p0 = p.dot(edge0);
-                                float p1 = p.dot(edge1);
-
-                                // Compute the barycentric coordinates (s, t) of the intersection point.
-                                // (s, t) lies in the triangle if s >= 0 and t >= 0 and s + t <= 1
-                                float s = e(1, 1) * p0 - e(0, 1) * p1;
-                                float t = e(0, 0) * p1 - e(1, 0) * p0;
-                                if (s >= 0.0f && t >= 0.0f && s + t <= 1.0f)
-                                {
-                                    closestHit = planeIntersect;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+        hitCount += hierarchy->rayPick(origins, directions, count, hitDistances);
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            distances[first + i] = hitDistances[i];
         }
     }
 
-    if (closestHit < numeric_limits<float>::infinity())
-    {
-        *distance = closestHit;
-        return true;
-    }
-    else
-    {
-        // No intersection
-        return false;
-    }
+    return hitCount;
 }
 
 
@@ -20,6 +20,8 @@
 namespace vesta
 {
 
+class TriangleBVH;
+
 class Submesh : public Object
 {
 public:
@@ -67,21 +69,34 @@ public:
     rayPick(const Eigen::Vector3d& pickOrigin,
             const Eigen::Vector3d& pickDirection,
             double* distance) const;
+    unsigned int
+    rayPick(const Eigen::Vector3d* pickOrigins,
+            const Eigen::Vector3d* pickDirections,
+            unsigned int rayCount,
+            double* distances) const;
 
     static Submesh* mergeSubmeshes(const std::vector<Submesh*>& submeshes);
     bool uniquifyVertices(float positionTolerance = 0.0f, float normalTolerance = 0.0f, float texCoordTolerance = 0.0f);
     void compressIndices();
+    bool optimizeVertexCache();
+    float averageCacheMissRatio(unsigned int* triangleCount = NULL) const;
 
     bool mergeMaterials();
 
     static const unsigned int DefaultMaterialIndex = 0xffffffff;
 
+private:
+    bool remapVertices(const std::vector<v_uint32>& vertexMap, unsigned int newVertexCount);
+    const TriangleBVH* pickHierarchy() const;
+    void invalidatePickHierarchy();
+
 private:
     VertexArray* m_vertices;
     std::vector<PrimitiveBatch*> m_primitiveBatches;
     std::vector<unsigned int> m_materials;
     BoundingBox m_boundingBox;
     float m_boundingSphereRadius;
+    mutable TriangleBVH* m_pickHierarchy;
 };
 
 }
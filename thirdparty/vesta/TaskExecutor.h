@@ -0,0 +1,61 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_TASK_EXECUTOR_H_
+#define _VESTA_TASK_EXECUTOR_H_
+
+#include "Object.h"
+
+
+namespace vesta
+{
+
+/** A ParallelTask is a piece of work divided into a number of independent
+  * items, which may be run concurrently and in any order.
+  */
+class ParallelTask
+{
+public:
+    virtual ~ParallelTask() {}
+
+    /** Run a single item of the task.
+      */
+    virtual void run(unsigned int item) = 0;
+};
+
+
+/** TaskExecutor is the interface through which vesta runs work on multiple
+  * threads. Vesta doesn't create any threads itself: applications that want
+  * parallel evaluation must provide a subclass built on the threading library
+  * of their choice.
+  */
+class TaskExecutor : public Object
+{
+public:
+    TaskExecutor() {}
+    virtual ~TaskExecutor() {}
+
+    /** Get the maximum number of threads that will run a task at once,
+      * including the calling thread.
+      */
+    virtual unsigned int threadCount() const = 0;
+
+    /** Run items 0 through itemCount - 1 of a task on up to threadCount()
+      * threads, and return only after every item has finished. Each item
+      * must be run exactly once. Threads should claim items as they become
+      * free rather than divide them up in advance, so that a thread given
+      * expensive items doesn't hold up the others. The calling thread may be
+      * one of the threads that runs the task. All memory written by the task
+      * must be visible to the caller when execute() returns.
+      */
+    virtual void execute(ParallelTask* task, unsigned int itemCount) = 0;
+};
+
+}
+
+#endif // _VESTA_TASK_EXECUTOR_H_
@@ -60,6 +60,30 @@ public:
         return state(t).velocity();
     }
 
+    /*! Compute state vectors at count instants. The default implementation
+     *  simply calls state() for each time. Subclasses that can share work
+     *  between nearby times (e.g. by fetching interpolation coefficients
+     *  just once) should override this method.
+     */
+    virtual void states(const double* t, unsigned int count, StateVector* out) const
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            out[i] = state(t[i]);
+        }
+    }
+
+    /*! Compute positions at count instants. The default implementation calls
+     *  position() for each time.
+     */
+    virtual void positions(const double* t, unsigned int count, Eigen::Vector3d* out) const
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            out[i] = position(t[i]);
+        }
+    }
+
     /*! Return true if the trajectory is periodic.
      */
     virtual bool isPeriodic() const
@@ -75,6 +99,15 @@ public:
         return 0.0;
     }
 
+    /*! Return true if the trajectory may be evaluated by several threads
+     *  at once. Subclasses that call non-reentrant code or depend on the
+     *  states of entities must override this method to return false.
+     */
+    virtual bool isThreadSafe() const
+    {
+        return true;
+    }
+
     /** Return the start of the valid time range for this trajectory.
       */
     double startTime() const
@@ -22,6 +22,10 @@ using namespace Eigen;
 using namespace std;
 
 
+// Number of samples evaluated with a single call to TrajectoryPlotGenerator::states()
+static const unsigned int SampleBatchSize = 64;
+
+
 TrajectoryGeometry::TrajectoryGeometry() :
     m_color(Spectrum(1.0f, 1.0f, 1.0f)),
     m_opacity(1.0f),
@@ -185,6 +189,32 @@ TrajectoryGeometry::addSample(double t, const StateVector& s)
 }
 
 
+// Evaluate the generator at a list of times and add the results to the curve
+// plot. Unlike addSample(), samples may be added before the start of the plot.
+void
+TrajectoryGeometry::addGeneratedSamples(const TrajectoryPlotGenerator* generator, const double* times, unsigned int count)
+{
+#ifndef VESTA_OGLES2
+    StateVector states[SampleBatchSize];
+    for (unsigned int batchStart = 0; batchStart < count; batchStart += SampleBatchSize)
+    {
+        unsigned int batchCount = min(SampleBatchSize, count - batchStart);
+        generator->states(times + batchStart, batchCount, states);
+
+        for (unsigned int i = 0; i < batchCount; ++i)
+        {
+            CurvePlotSample sample;
+            sample.t = times[batchStart + i];
+            sample.position = states[i].position();
+            sample.velocity = states[i].velocity();
+            m_curvePlot->addSample(sample);
+            m_boundingRadius = std::max(m_boundingRadius, states[i].position().norm());
+        }
+    }
+#endif
+}
+
+
 /** Remove all trajectory plot samples.
   */
 void
@@ -218,6 +248,11 @@ public:
         return m_trajectory->state(t);
     }
 
+    void states(const double* t, unsigned int count, StateVector* out) const
+    {
+        m_trajectory->states(t, count, out);
+    }
+
     double startTime() const
     {
         return m_trajectory->startTime();
@@ -299,11 +334,23 @@ TrajectoryGeometry::computeSamples(const TrajectoryPlotGenerator* generator, dou
     m_endTime = endTime;
     double dt = (endTime - startTime) / steps;
 
-    for (unsigned int i = 0; i <= steps; ++i)
+    // Evaluate the generator in batches so that trajectories with a batched
+    // evaluation path can share work between neighboring samples.
+    double times[SampleBatchSize];
+    StateVector states[SampleBatchSize];
+    for (unsigned int batchStart = 0; batchStart <= steps; batchStart += SampleBatchSize)
     {
-        double t = m_startTime + i * dt;
-        StateVector state = generator->state(t);
-        addSample(t, state);
+        unsigned int batchCount = min(SampleBatchSize, steps + 1 - batchStart);
+        for (unsigned int i = 0; i < batchCount; ++i)
+        {
+            times[i] = startTime + (batchStart + i) * dt;
+        }
+
+        generator->states(times, batchCount, states);
+        for (unsigned int i = 0; i < batchCount; ++i)
+        {
+            addSample(times[i], states[i]);
+        }
     }
 
     // Adjust the bounding radius slightly to prevent culling when the
@@ -343,21 +390,23 @@ TrajectoryGeometry::updateSamples(const TrajectoryPlotGenerator* generator, doub
     }
     else
     {
+        double times[SampleBatchSize];
+        unsigned int batchCount = 0;
+
         if (startTime < m_curvePlot->startTime())
         {
             // Add samples at the beginning
             for (double t = m_curvePlot->startTime() - dt; t > windowStartTime; t -= dt)
             {
-                t = max(t, windowStartTime);
-                StateVector sv = generator->state(t);
-
-                CurvePlotSample sample;
-                sample.t = t;
-                sample.position = sv.position();
-                sample.velocity = sv.velocity();
-                m_curvePlot->addSample(sample);
-                m_boundingRadius = std::max(m_boundingRadius, sv.position().norm());
+                times[batchCount++] = max(t, windowStartTime);
+                if (batchCount == SampleBatchSize)
+                {
+                    addGeneratedSamples(generator, times, batchCount);
+                    batchCount = 0;
+                }
             }
+            addGeneratedSamples(generator, times, batchCount);
+            batchCount = 0;
         }
 
         if (endTime > m_curvePlot->endTime())
@@ -365,16 +414,15 @@ TrajectoryGeometry::updateSamples(const TrajectoryPlotGenerator* generator, doub
             // Add samples at the end
             for (double t = m_curvePlot->endTime() + dt; t < windowEndTime; t += dt)
             {
-                t = min(t, windowEndTime);
-                StateVector sv = generator->state(t);
-
-                CurvePlotSample sample;
-                sample.t = t;
-                sample.position = sv.position();
-                sample.velocity = sv.velocity();
-                m_curvePlot->addSample(sample);
-                m_boundingRadius = std::max(m_boundingRadius, sv.position().norm());
+                times[batchCount++] = min(t, windowEndTime);
+                if (batchCount == SampleBatchSize)
+                {
+                    addGeneratedSamples(generator, times, batchCount);
+                    batchCount = 0;
+                }
             }
+            addGeneratedSamples(generator, times, batchCount);
+            batchCount = 0;
         }
 
         // Remove samples
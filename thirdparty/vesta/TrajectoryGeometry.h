@@ -28,6 +28,18 @@ class TrajectoryPlotGenerator
 {
 public:
     virtual StateVector state(double tsec) const = 0;
+
+    /** Compute states at count instants. The default implementation calls state()
+      * for each time.
+      */
+    virtual void states(const double* tsec, unsigned int count, StateVector* out) const
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            out[i] = state(tsec[i]);
+        }
+    }
+
     virtual double startTime() const = 0;
     virtual double endTime() const = 0;
 };
@@ -236,6 +248,9 @@ public:
         m_lineWidth = width;
     }
 
+private:
+    void addGeneratedSamples(const TrajectoryPlotGenerator* generator, const double* times, unsigned int count);
+
 private:
     counted_ptr<Frame> m_frame;
     Spectrum m_color;
@@ -41,6 +41,11 @@ public:
     virtual Eigen::Quaterniond orientation(double t) const;
     virtual Eigen::Vector3d angularVelocity(double t) const;
 
+    virtual bool isThreadSafe() const
+    {
+        return false;
+    }
+
     /** Get the central object of the two-body frame. */
     Entity* primary() const
     {
@@ -15,6 +15,7 @@
 #include "SkyLayer.h"
 #include "PickContext.h"
 #include "Viewport.h"
+#include "internal/EntityBoundingHierarchy.h"
 #include <algorithm>
 #include <limits>
 
@@ -23,13 +24,15 @@ using namespace Eigen;
 using namespace std;
 
 
-Universe::Universe()
+Universe::Universe() :
+    m_boundingHierarchy(NULL)
 {
 }
 
 
 Universe::~Universe()
 {
+    delete m_boundingHierarchy;
 }
 
 
@@ -47,25 +50,100 @@ Universe::entities() const
 }
 
 
-/** Add a new entity to the universe. Null entities are ignored.
+/** Add a new entity to the universe. Null entities are ignored. The entity
+  * should be named before it is added: findFirst() looks up entities by the
+  * name that they had when they were added.
   * @param entity pointer to an entity.
   */
 void
 Universe::addEntity(Entity* entity)
 {
-    m_entities.push_back(counted_ptr<Entity>(entity));
+    if (entity)
+    {
+        m_nameIndex[entity->name()].push_back((unsigned int) m_entities.size());
+        m_entities.push_back(counted_ptr<Entity>(entity));
+        m_indexedNames.push_back(entity->name());
+
+        if (m_boundingHierarchy)
+        {
+            m_boundingHierarchy->invalidateEntityTable();
+        }
+    }
+}
+
+
+// Find the index of an entity in the entity table. Returns entityCount() if the entity
+// isn't in the universe.
+unsigned int
+Universe::entityIndex(const Entity* entity) const
+{
+    NameIndex::const_iterator nameIter = m_nameIndex.find(entity->name());
+    if (nameIter != m_nameIndex.end())
+    {
+        const vector<unsigned int>& indices = nameIter->second;
+        for (vector<unsigned int>::const_iterator iter = indices.begin(); iter != indices.end(); ++iter)
+        {
+            if (m_entities[*iter].ptr() == entity)
+            {
+                return *iter;
+            }
+        }
+    }
+
+    // The entity may have been renamed after it was added
+    for (unsigned int i = 0; i < m_entities.size(); ++i)
+    {
+        if (m_entities[i].ptr() == entity)
+        {
+            return i;
+        }
+    }
+
+    return entityCount();
 }
 
 
-/** Remove an entity from the universe.
+/** Remove an entity from the universe. The last entity in the universe is moved
+  * into the slot of the removed one, so removal doesn't require the entity table
+  * to be shifted.
   */
 void
 Universe::removeEntity(Entity* entity)
 {
-    EntityTable::iterator iter = find(m_entities.begin(), m_entities.end(), counted_ptr<Entity>(entity));
-    if (iter != m_entities.end())
+    if (!entity)
     {
-        m_entities.erase(iter);
+        return;
+    }
+
+    unsigned int index = entityIndex(entity);
+    if (index == entityCount())
+    {
+        return;
+    }
+
+    NameIndex::iterator nameIter = m_nameIndex.find(m_indexedNames[index]);
+    vector<unsigned int>& indices = nameIter->second;
+    indices.erase(find(indices.begin(), indices.end(), index));
+    if (indices.empty())
+    {
+        m_nameIndex.erase(nameIter);
+    }
+
+    unsigned int lastIndex = entityCount() - 1;
+    if (index != lastIndex)
+    {
+        vector<unsigned int>& lastIndices = m_nameIndex[m_indexedNames[lastIndex]];
+        *find(lastIndices.begin(), lastIndices.end(), lastIndex) = index;
+
+        m_entities[index] = m_entities[lastIndex];
+        m_indexedNames[index] = m_indexedNames[lastIndex];
+    }
+    m_entities.pop_back();
+    m_indexedNames.pop_back();
+
+    if (m_boundingHierarchy)
+    {
+        m_boundingHierarchy->invalidateEntityTable();
     }
 }
 
@@ -83,15 +161,15 @@ Universe::findFirst(const std::string& name)
         return NULL;
     }
 
-    for (EntityTable::iterator iter = m_entities.begin(); iter != m_entities.end(); ++iter)
+    NameIndex::const_iterator iter = m_nameIndex.find(name);
+    if (iter == m_nameIndex.end())
     {
-        if (name == (*iter)->name())
-        {
-            return iter->ptr();
-        }
+        return NULL;
     }
 
-    return NULL;
+    // Names are removed from the index when their last entity is removed,
+    // so the list of indices is never empty.
+    return m_entities[iter->second.front()].ptr();
 }
 
 
@@ -198,15 +276,40 @@ Universe::pickObject(PickContext* pc,
     double closest = numeric_limits<double>::infinity();
     PickResult closestResult;
 
-    for (EntityTable::const_iterator iter = m_entities.begin(); iter != m_entities.end(); ++iter)
+    // Walk the bounding hierarchy, skipping subtrees that can't contain anything
+    // closer than the closest hit so far.
+    const EntityBoundingHierarchy* hierarchy = boundingHierarchy(t);
+    unsigned int nodeIndex = 0;
+    while (nodeIndex < hierarchy->nodeCount())
     {
-        Entity* entity = iter->ptr();
+        const EntityBoundingHierarchy::Node& node = hierarchy->node(nodeIndex);
+
+        Vector3d toCenter = node.bounds.center() - pc->pickOrigin();
+        double centerDistance = toCenter.dot(pc->pickDirection());
+        double radius = node.bounds.radius();
+
+        bool cull = centerDistance + radius <= 0.0 || centerDistance - radius >= closest;
+        if (!cull && (node.flags & EntityBoundingHierarchy::HasVisualizers) == 0)
+        {
+            // Without visualizers, which may be picked when the ray passes anywhere
+            // near them, only a ray that intersects the bounds can hit something.
+            cull = toCenter.squaredNorm() - centerDistance * centerDistance > radius * radius;
+        }
+
+        if (cull)
+        {
+            nodeIndex += node.subtreeSize;
+            continue;
+        }
+        ++nodeIndex;
+
+        Entity* entity = node.entity;
 
         if (entity->geometry() || entity->hasVisualizers())
         {
-            if (entity->isVisible() && entity->chronology()->includesTime(t))
+            if (entity->isVisible())
             {
-                Vector3d position = entity->position(t);
+                Vector3d position = node.position;
 
                 if (entity->geometry())
                 {
@@ -221,7 +324,7 @@ Universe::pickObject(PickContext* pc,
                         if (intersectionDistance < closest)
                         {
                             // Transform the pick ray into the local coordinate system of body
-                            Matrix3d invRotation = entity->orientation(t).conjugate().toRotationMatrix();
+                            Matrix3d invRotation = node.orientation.conjugate().toRotationMatrix();
                             Vector3d relativePickOrigin = invRotation * (pc->pickOrigin() - position);
                             Vector3d relativePickDirection = invRotation * pc->pickDirection();
 
@@ -282,6 +385,38 @@ Universe::pickObject(PickContext* pc,
 }
 
 
+/** Get the bounding sphere hierarchy of the entities in the universe at time t.
+  * The hierarchy is built on demand and reused until the time changes, entities
+  * are added or removed, or the entity state cache is invalidated. Changes to
+  * the geometry or visualizers of entities don't invalidate the hierarchy;
+  * UniverseRenderer invalidates the state cache at the start of each view set,
+  * so the hierarchy is rebuilt at least once per frame.
+  *
+  * The returned pointer remains valid for the lifetime of the universe, but
+  * the hierarchy may be rebuilt by any subsequent call to boundingHierarchy()
+  * or pickObject().
+  *
+  * @param t the time in seconds since J2000 TDB
+  * @param executor optional executor used to evaluate entities in parallel
+  * when the hierarchy needs to be rebuilt
+  */
+const EntityBoundingHierarchy*
+Universe::boundingHierarchy(double t, TaskExecutor* executor) const
+{
+    if (!m_boundingHierarchy)
+    {
+        m_boundingHierarchy = new EntityBoundingHierarchy();
+    }
+
+    if (!m_boundingHierarchy->isCurrent(t))
+    {
+        m_boundingHierarchy->build(this, t, executor);
+    }
+
+    return m_boundingHierarchy;
+}
+
+
 StarCatalog*
 Universe::starCatalog() const
 {
@@ -24,6 +24,8 @@ class SkyLayer;
 class PlanarProjection;
 class Viewport;
 class PickContext;
+class EntityBoundingHierarchy;
+class TaskExecutor;
 
 class Universe : public Object
 {
@@ -36,6 +38,23 @@ public:
     void removeEntity(Entity* entity);
     Entity* findFirst(const std::string& name);
 
+    /** Get the number of entities in the universe.
+      */
+    unsigned int entityCount() const
+    {
+        return (unsigned int) m_entities.size();
+    }
+
+    /** Get the entity at the specified index, which must be less than entityCount().
+      * Together with entityCount(), this allows iteration over all entities without
+      * the copy made by entities(). Indices aren't preserved when entities are
+      * removed from the universe.
+      */
+    Entity* entity(unsigned int index) const
+    {
+        return m_entities[index].ptr();
+    }
+
     StarCatalog* starCatalog() const;
     void setStarCatalog(StarCatalog* starCatalog);
 
@@ -55,6 +74,8 @@ public:
                     double t,
                     PickResult* result) const;
 
+    const EntityBoundingHierarchy* boundingHierarchy(double t, TaskExecutor* executor = NULL) const;
+
     typedef std::map<std::string, counted_ptr<SkyLayer> > SkyLayerTable;
     const SkyLayerTable* layers() const
     {
@@ -70,9 +91,22 @@ public:
 private:
     typedef std::vector<counted_ptr<Entity> > EntityTable;
 
+    // Indices in m_entities of the entities with each name, in the order that
+    // they were added.
+    typedef std::map<std::string, std::vector<unsigned int> > NameIndex;
+
+    unsigned int entityIndex(const Entity* entity) const;
+
     EntityTable m_entities;
+    NameIndex m_nameIndex;
+
+    // Names under which the entities in m_entities are indexed
+    std::vector<std::string> m_indexedNames;
     counted_ptr<StarCatalog> m_starCatalog;
     SkyLayerTable m_layers;
+
+    // Built on demand for the most recently requested time
+    mutable EntityBoundingHierarchy* m_boundingHierarchy;
 };
 
 }
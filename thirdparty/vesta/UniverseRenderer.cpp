@@ -25,7 +25,10 @@
 #include "LabelGeometry.h"
 #include "glhelp/GLFramebuffer.h"
 #include "Units.h"
+#include "QuadtreeTile.h"
 #include "internal/EclipseShadowVolumeSet.h"
+#include "internal/EntityBoundingHierarchy.h"
+#include "internal/TileMeshCache.h"
 #include <Eigen/Geometry>
 #include <algorithm>
 
@@ -97,6 +100,7 @@ UniverseRenderer::UniverseRenderer() :
 
 UniverseRenderer::~UniverseRenderer()
 {
+    QuadtreeTile::releaseMeshCache();
     delete m_renderContext;
 }
 
@@ -184,6 +188,19 @@ UniverseRenderer::setDefaultSunEnabled(bool enable)
 }
 
 
+/** Set the executor used to evaluate the positions and orientations of
+  * entities in parallel at the start of each view set. Entities with
+  * trajectories, rotation models, or frames that aren't thread safe are
+  * always evaluated on the calling thread. Setting the executor to null
+  * (the default) evaluates all entities on the calling thread.
+  */
+void
+UniverseRenderer::setTaskExecutor(TaskExecutor* executor)
+{
+    m_taskExecutor = executor;
+}
+
+
 /** Initialize all graphics resources. This method must only be called once OpenGL has
   * been initialized and a GL context has been set. The renderer cannot be used for
   * drawing until initializeGraphics is called successfully.
@@ -378,8 +395,17 @@ UniverseRenderer::beginViewSet(const Universe* universe, double tsec)
     m_universe = universe;
     m_currentTime = tsec;
 
-    // TODO: maintain a bounding sphere hierarchy in order to avoid having to do a linear
-    // traversal of all objects.
+    // Objects may have been modified since the last view set, so cached states
+    // can't be trusted even if the time hasn't changed.
+    Entity::invalidateStateCache();
+
+    // Update stage: build the bounding hierarchy of entities for this time. This
+    // evaluates the position and orientation of every entity, and is shared by all
+    // views in the set.
+    const EntityBoundingHierarchy* hierarchy = m_universe->boundingHierarchy(m_currentTime, m_taskExecutor.ptr());
+
+    // Planet tile meshes drawn in earlier view sets may now be replaced by new ones
+    QuadtreeTile::meshCache()->beginFrame();
 
     // Build the light source list
     m_lightSources.clear();
@@ -395,19 +421,18 @@ UniverseRenderer::beginViewSet(const Universe* universe, double tsec)
         m_lightSources.push_back(sunItem);
     }
 
-    const vector<Entity*>& entities = m_universe->entities();
-    for (vector<Entity*>::const_iterator iter = entities.begin(); iter != entities.end(); ++iter)
+    // Entities that don't exist at the current time aren't in the hierarchy
+    for (unsigned int nodeIndex = 0; nodeIndex < hierarchy->nodeCount(); ++nodeIndex)
     {
-        const Entity* entity = *iter;
+        const EntityBoundingHierarchy::Node& node = hierarchy->node(nodeIndex);
+        const Entity* entity = node.entity;
         const LightSource* light = entity->lightSource();
 
-        if (light && entity->isVisible(m_currentTime))
+        if (light && entity->isVisible())
         {
-            Vector3d position = entity->position(m_currentTime);
-
             LightSourceItem lsi;
             lsi.lightSource = light;
-            lsi.position = position;
+            lsi.position = node.position;
             lsi.radius = entity->geometry() ? entity->geometry()->boundingSphereRadius() : 0.0;
             m_lightSources.push_back(lsi);
         }
@@ -528,6 +553,55 @@ showOmniShadowMap(CubeMapFramebuffer* shadowMap,
 #endif // DEBUG_OMNI_SHADOW_MAP
 
 
+// Return true if nothing in a subtree of the entity hierarchy can contribute
+// to the view: either the subtree lies entirely outside the view frustum, or
+// it's too small to be visible. The test is conservative; it never culls
+// shadow casters, which may affect the view even when outside the frustum,
+// nor visualizers, which aren't culled by size.
+static bool
+isSubtreeCulled(const EntityBoundingHierarchy::Node& node,
+                const Vector3d& cameraPosition,
+                const Matrix3f& toCameraSpace,
+                const Frustum& viewFrustum,
+                float pixelSize,
+                bool eclipseShadowsRequired)
+{
+    if (eclipseShadowsRequired && (node.flags & EntityBoundingHierarchy::HasEllipsoidalShadowCasters) != 0)
+    {
+        return false;
+    }
+
+    Vector3d cameraRelativeCenter = node.bounds.center() - cameraPosition;
+    double centerDistance = cameraRelativeCenter.norm();
+
+    // Allow for the error in converting the camera relative center to single precision
+    float radius = float(node.bounds.radius() + centerDistance * 1.0e-6);
+
+    if ((node.flags & EntityBoundingHierarchy::HasShadowCasters) == 0)
+    {
+        Vector3f cameraSpaceCenter = toCameraSpace * cameraRelativeCenter.cast<float>();
+        if (!viewFrustum.intersects(BoundingSphere<float>(cameraSpaceCenter, radius)))
+        {
+            return true;
+        }
+    }
+
+    // Size culling only applies to the geometry of entities; visualizers are drawn
+    // at any size.
+    if ((node.flags & EntityBoundingHierarchy::HasVisualizers) == 0)
+    {
+        float nearestDistance = float(centerDistance) - radius;
+        if (nearestDistance > 0.0f &&
+            (node.maxGeometryRadius / nearestDistance) / pixelSize < 0.5f)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
 static bool skyLayerOrderPredicate(const SkyLayer* layer0, const SkyLayer* layer1)
 {
     return layer0->drawOrder() < layer1->drawOrder();
@@ -647,8 +721,6 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
     // doesn't intersect the geometry of a body.
     float nearPlaneFovAdjustment = (float) (cos(fieldOfView / 2.0) / sqrt(1.0 + aspectRatio * aspectRatio));
 
-    const vector<Entity*>& entities = m_universe->entities();
-
     m_visibleItems.clear();
     m_splittableItems.clear();
 
@@ -656,16 +728,27 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
 
     buildVisibleLightSourceList(cameraPosition);
 
-    // Simply scan through all entities in the universe.
-    // TODO: For better performance with many entities, we could maintain a
-    // bounding sphere hierarchy.
-    for (vector<Entity*>::const_iterator iter = entities.begin(); iter != entities.end(); ++iter)
+    // Walk the entity bounding hierarchy, skipping subtrees that can't contribute
+    // anything to the view.
+    bool eclipseShadowsRequired = m_eclipseShadowsEnabled && m_viewIndependentInitializationRequired;
+    const EntityBoundingHierarchy* hierarchy = m_universe->boundingHierarchy(m_currentTime);
+    unsigned int nodeIndex = 0;
+    while (nodeIndex < hierarchy->nodeCount())
     {
-        const Entity* entity = *iter;
+        const EntityBoundingHierarchy::Node& node = hierarchy->node(nodeIndex);
+        if (isSubtreeCulled(node, cameraPosition, toCameraSpace,
+                            m_viewFrustum, m_renderContext->pixelSize(), eclipseShadowsRequired))
+        {
+            nodeIndex += node.subtreeSize;
+            continue;
+        }
+        ++nodeIndex;
+
+        const Entity* entity = node.entity;
 
-        if (entity->isVisible(m_currentTime))
+        if (entity->isVisible())
         {
-            Vector3d position = entity->position(m_currentTime);
+            Vector3d position = node.position;
 
             // Calculate the difference at double precision, then convert to single
             // precision for the rest of the work.
@@ -697,7 +780,7 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
             {
                 addVisibleItem(entity, entity->geometry(),
                                position, cameraRelativePosition, cameraSpacePosition,
-                               entity->orientation(m_currentTime).cast<float>(),
+                               node.orientation.cast<float>(),
                                nearPlaneFovAdjustment);
             }
 
@@ -716,7 +799,7 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
                 {
                     m_eclipseShadows->addShadow(entity,
                                                 position,
-                                                entity->orientation(m_currentTime).cast<float>(),
+                                                node.orientation.cast<float>(),
                                                 m_lightSources.front().position,
                                                 m_lightSources.front().radius);
                 }
@@ -18,6 +18,7 @@
 #include "Frustum.h"
 #include "LightingEnvironment.h"
 #include "PlanarProjection.h"
+#include "TaskExecutor.h"
 #include <Eigen/StdVector>
 #include <vector>
 
@@ -170,6 +171,16 @@ public:
         return m_defaultSunEnabled;
     }
 
+    /** Get the executor used to evaluate entities in parallel at the
+      * start of each view set. Returns null if entities are evaluated
+      * on the calling thread.
+      */
+    TaskExecutor* taskExecutor() const
+    {
+        return m_taskExecutor.ptr();
+    }
+    void setTaskExecutor(TaskExecutor* executor);
+
     GlareOverlay* createGlareOverlay();
 
 public:
@@ -293,6 +304,8 @@ private:
 
     counted_ptr<TextureFont> m_defaultFont;
     PlanarProjection m_lastProjection;
+
+    counted_ptr<TaskExecutor> m_taskExecutor;
 };
 
 }
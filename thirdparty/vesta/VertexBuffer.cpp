@@ -38,6 +38,7 @@ VertexBuffer::VertexBuffer(unsigned int size, GLVertexBuffer* vbo) :
 
 VertexBuffer::~VertexBuffer()
 {
+    delete[] m_data;
 }
 
 
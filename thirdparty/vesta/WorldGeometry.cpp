@@ -54,7 +54,9 @@ WorldGeometry::WorldGeometry() :
     m_specularReflectance(Spectrum(0.0f, 0.0f, 0.0f)),
     m_specularPower(20.0f),
     m_cloudAltitude(0.0f),
-    m_tileAllocator(NULL)
+    m_tileAllocator(NULL),
+    m_cloudTileAllocator(NULL),
+    m_atmosphereTileAllocator(NULL)
 {
     setClippingPolicy(Geometry::PreventClipping);
     setShadowCaster(true);
@@ -63,12 +65,16 @@ WorldGeometry::WorldGeometry() :
     m_material->setDiffuse(Spectrum(1.0f, 1.0f, 1.0f));
 
     m_tileAllocator = new QuadtreeTileAllocator;
+    m_cloudTileAllocator = new QuadtreeTileAllocator;
+    m_atmosphereTileAllocator = new QuadtreeTileAllocator;
 }
 
 
 WorldGeometry::~WorldGeometry()
 {
     delete m_tileAllocator;
+    delete m_cloudTileAllocator;
+    delete m_atmosphereTileAllocator;
 }
 
 
@@ -291,7 +297,7 @@ WorldGeometry::render(RenderContext& rc, double clock) const
         rc.bindMaterial(&material);
     }
 
-    // Create the root quadtree nodes. Presently, we always start with two root
+    // Get the root quadtree nodes. Presently, we always start with two root
     // tiles: one for the western hemisphere and one for the eastern hemisphere.
     // But, depending on what sort of tiles we have, a different set of root
     // tiles might be more appropriate.
@@ -299,7 +305,7 @@ WorldGeometry::render(RenderContext& rc, double clock) const
 
     QuadtreeTile* westHemi = NULL;
     QuadtreeTile* eastHemi = NULL;
-    initQuadtree(semiAxes, &westHemi, &eastHemi);
+    initQuadtree(semiAxes, m_tileAllocator, &westHemi, &eastHemi);
 
     float splitThreshold = rc.pixelSize() * MaxTileSquareSize * QuadtreeTile::TileSubdivision;
     if (m_baseTiledMap.isValid())
@@ -319,6 +325,11 @@ WorldGeometry::render(RenderContext& rc, double clock) const
     westHemi->tessellate(eyePosition, cullingPlanes, semiAxes, splitThreshold, rc.pixelSize());
     eastHemi->tessellate(eyePosition, cullingPlanes, semiAxes, splitThreshold, rc.pixelSize());
 
+    // Merge tiles that were held back by finer neighbors during tessellation
+    while (westHemi->coarsen() || eastHemi->coarsen())
+    {
+    }
+
     if (m_baseTiledMap.isNull())
     {
         westHemi->render(rc, tileFeatures);
@@ -429,7 +440,7 @@ WorldGeometry::render(RenderContext& rc, double clock) const
         
         QuadtreeTile* westHemi = NULL;
         QuadtreeTile* eastHemi = NULL;
-        initQuadtree(cloudSemiAxes, &westHemi, &eastHemi);
+        initQuadtree(cloudSemiAxes, m_cloudTileAllocator, &westHemi, &eastHemi);
         
         // Adjust the distance of the far plane.
         float maxCloudDistance = CloudShellDistance(eyePosition, m_ellipsoidAxes, m_cloudAltitude);
@@ -439,6 +450,9 @@ WorldGeometry::render(RenderContext& rc, double clock) const
         float splitThreshold = rc.pixelSize() * MaxTileSquareSize * QuadtreeTile::TileSubdivision;
         westHemi->tessellate(eyePosition, cullingPlanes, cloudSemiAxes, splitThreshold, rc.pixelSize());
         eastHemi->tessellate(eyePosition, cullingPlanes, cloudSemiAxes, splitThreshold, rc.pixelSize());
+        while (westHemi->coarsen() || eastHemi->coarsen())
+        {
+        }
         
         // Only draw the cloud layer if the cloud texture is resident; otherwise, the cloud
         // layer is drawn as an opaque shell until texture loading is complete.
@@ -492,7 +506,7 @@ WorldGeometry::render(RenderContext& rc, double clock) const
 
         QuadtreeTile* westHemi = NULL;
         QuadtreeTile* eastHemi = NULL;
-        initQuadtree(atmSemiAxes, &westHemi, &eastHemi);
+        initQuadtree(atmSemiAxes, m_atmosphereTileAllocator, &westHemi, &eastHemi);
 
         // Adjust the distance of the near and far planes so that as much of the atmosphere
         // shell geometry as possible is culled.
@@ -508,6 +522,9 @@ WorldGeometry::render(RenderContext& rc, double clock) const
         float splitThreshold = rc.pixelSize() * MaxTileSquareSize * QuadtreeTile::TileSubdivision * 2;
         westHemi->tessellate(eyePosition, cullingPlanes, atmSemiAxes, splitThreshold, rc.pixelSize());
         eastHemi->tessellate(eyePosition, cullingPlanes, atmSemiAxes, splitThreshold, rc.pixelSize());
+        while (westHemi->coarsen() || eastHemi->coarsen())
+        {
+        }
 
         westHemi->render(rc, QuadtreeTile::Normals);
         eastHemi->render(rc, QuadtreeTile::Normals);
@@ -570,12 +587,26 @@ WorldGeometry::render(RenderContext& rc, double clock) const
 }
 
 
+// Get the root tiles of the quadtree kept by the specified allocator. The quadtree
+// is only rebuilt when it's empty or was built for an ellipsoid with different axes;
+// otherwise the tessellation from the previous frame is reused.
 void
-WorldGeometry::initQuadtree(const Vector3f& semiAxes, QuadtreeTile **westHemi, QuadtreeTile **eastHemi) const
+WorldGeometry::initQuadtree(const Vector3f& semiAxes,
+                            QuadtreeTileAllocator* allocator,
+                            QuadtreeTile **westHemi,
+                            QuadtreeTile **eastHemi) const
 {
-    m_tileAllocator->clear();
-    *westHemi = m_tileAllocator->newRootTile(0, 0, Vector2f(-1.0f, -0.5f), 1.0f, semiAxes);
-    *eastHemi = m_tileAllocator->newRootTile(0, 1, Vector2f( 0.0f, -0.5f), 1.0f, semiAxes);
+    if (allocator->tileCount() != 0 && allocator->semiAxes() == semiAxes)
+    {
+        *westHemi = allocator->rootTile(0);
+        *eastHemi = allocator->rootTile(1);
+        return;
+    }
+
+    allocator->clear();
+    allocator->setSemiAxes(semiAxes);
+    *westHemi = allocator->newRootTile(0, 0, Vector2f(-1.0f, -0.5f), 1.0f, semiAxes);
+    *eastHemi = allocator->newRootTile(0, 1, Vector2f( 0.0f, -0.5f), 1.0f, semiAxes);
 
     // Set up the neighbor connections for the root nodes. Since the map wraps,
     // the eastern hemisphere is both the east and west neighbor of the western
@@ -291,7 +291,10 @@ private:
                     float tStart,
                     float tEnd) const;
 
-    void initQuadtree(const Eigen::Vector3f& semiAxes, QuadtreeTile** westHemi, QuadtreeTile** eastHemi) const;
+    void initQuadtree(const Eigen::Vector3f& semiAxes,
+                      QuadtreeTileAllocator* allocator,
+                      QuadtreeTile** westHemi,
+                      QuadtreeTile** eastHemi) const;
 
 private:
     Eigen::Vector3f m_ellipsoidAxes;
@@ -312,7 +315,11 @@ private:
     counted_ptr<TiledMap> m_tiledCloudMap;
     float m_cloudAltitude;
 
+    // Separate quadtrees are kept for the surface, cloud layer, and atmosphere
+    // shell, since each is tessellated differently.
     QuadtreeTileAllocator* m_tileAllocator;
+    QuadtreeTileAllocator* m_cloudTileAllocator;
+    QuadtreeTileAllocator* m_atmosphereTileAllocator;
 
     static bool ms_atmospheresVisible;
     static bool ms_cloudLayersVisible;
@@ -0,0 +1,456 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "EntityBoundingHierarchy.h"
+#include "../Universe.h"
+#include "../Arc.h"
+#include "../Geometry.h"
+#include "../Visualizer.h"
+#include "../Frame.h"
+#include "../Trajectory.h"
+#include "../RotationModel.h"
+#include "../TaskExecutor.h"
+#include <algorithm>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+static const unsigned int NoParent = 0xffffffff;
+static const unsigned int NotPresent = 0xfffffffe;
+
+// Bounding spheres are enlarged slightly to cover roundoff error in the
+// merged sphere centers.
+static const double RelativeBoundsPadding = 1.0e-9;
+
+// Levels of the center tree with fewer thread safe entities than this are
+// evaluated on the calling thread.
+static const unsigned int ParallelUpdateThreshold = 256;
+
+// Number of entities claimed at a time by a thread of a parallel update
+static const unsigned int UpdateChunkSize = 64;
+
+
+// Return true if the state and orientation of an entity may be evaluated
+// on any thread.
+static bool
+isThreadSafe(const Arc* arc)
+{
+    return arc->trajectory()->isThreadSafe() &&
+           arc->trajectoryFrame()->isThreadSafe() &&
+           arc->rotationModel()->isThreadSafe() &&
+           arc->bodyFrame()->isThreadSafe();
+}
+
+
+// Evaluate the position and orientation of an entity at time t. The radius of
+// the node bounds must already be set to the radius of the entity's items.
+// State cache hits and misses are counted in the specified statistics.
+static void
+updateNode(EntityBoundingHierarchy::Node& node, double t, Entity::StateCacheStatistics* statistics)
+{
+    node.position = node.entity->position(t, statistics);
+    node.orientation = node.entity->orientation(t);
+    node.bounds = BoundingSphere<double>(node.position, node.bounds.radius());
+}
+
+
+// Task that updates a list of nodes. Each item of the task is a chunk of
+// the list. State cache statistics are kept separately for every chunk and
+// only added up once all chunks are done.
+class EntityUpdateTask : public ParallelTask
+{
+public:
+    EntityUpdateTask(EntityBoundingHierarchy::Node* nodes,
+                     const unsigned int* nodeIndices,
+                     unsigned int nodeCount,
+                     double t) :
+        m_nodes(nodes),
+        m_nodeIndices(nodeIndices),
+        m_nodeCount(nodeCount),
+        m_time(t)
+    {
+        Entity::StateCacheStatistics empty = { 0, 0 };
+        m_chunkStatistics.assign(chunkCount(), empty);
+    }
+
+    unsigned int chunkCount() const
+    {
+        return (m_nodeCount + UpdateChunkSize - 1) / UpdateChunkSize;
+    }
+
+    void run(unsigned int chunk)
+    {
+        unsigned int begin = chunk * UpdateChunkSize;
+        unsigned int end = min(m_nodeCount, begin + UpdateChunkSize);
+
+        // Count on the stack and store once, so that threads working on
+        // neighboring chunks don't write to the same cache line per entity.
+        Entity::StateCacheStatistics statistics = { 0, 0 };
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            updateNode(m_nodes[m_nodeIndices[i]], m_time, &statistics);
+        }
+        m_chunkStatistics[chunk] = statistics;
+    }
+
+    // Add the state cache statistics of all chunks to the given totals. Only
+    // valid after the task has finished.
+    void addStatistics(Entity::StateCacheStatistics* totals) const
+    {
+        for (unsigned int i = 0; i < m_chunkStatistics.size(); ++i)
+        {
+            totals->hits += m_chunkStatistics[i].hits;
+            totals->misses += m_chunkStatistics[i].misses;
+        }
+    }
+
+private:
+    EntityBoundingHierarchy::Node* m_nodes;
+    const unsigned int* m_nodeIndices;
+    unsigned int m_nodeCount;
+    double m_time;
+    vector<Entity::StateCacheStatistics> m_chunkStatistics;
+};
+
+
+// Compute the sphere containing the geometry and all visualizers of an entity,
+// and set the flags describing them. Visualizers are included whether or not
+// they're currently visible, so that toggling one doesn't require the hierarchy
+// to be rebuilt.
+static double
+itemBoundingRadius(const Entity* entity, float* geometryRadius, unsigned int* flags)
+{
+    double radius = 0.0;
+    *geometryRadius = 0.0f;
+    *flags = 0;
+
+    const Geometry* geometry = entity->geometry();
+    if (geometry)
+    {
+        *geometryRadius = geometry->boundingSphereRadius();
+        radius = *geometryRadius;
+
+        if (geometry->isShadowCaster())
+        {
+            *flags |= EntityBoundingHierarchy::HasShadowCasters;
+            if (geometry->isEllipsoidal() && !entity->lightSource())
+            {
+                *flags |= EntityBoundingHierarchy::HasEllipsoidalShadowCasters;
+            }
+        }
+    }
+
+    if (entity->hasVisualizers())
+    {
+        *flags |= EntityBoundingHierarchy::HasVisualizers;
+
+        // Visualizers drawn in front of the entity are moved toward the camera
+        // along the line of sight by about the radius of the entity geometry.
+        double visualizerRadius = 0.0;
+        for (Entity::VisualizerTable::const_iterator iter = entity->visualizers()->begin();
+             iter != entity->visualizers()->end(); ++iter)
+        {
+            const Geometry* visualizerGeometry = iter->second->geometry();
+            if (visualizerGeometry)
+            {
+                visualizerRadius = max(visualizerRadius, double(visualizerGeometry->boundingSphereRadius()));
+                if (visualizerGeometry->isShadowCaster())
+                {
+                    *flags |= EntityBoundingHierarchy::HasShadowCasters;
+                }
+            }
+        }
+
+        radius = *geometryRadius + visualizerRadius;
+    }
+
+    return radius;
+}
+
+
+EntityBoundingHierarchy::EntityBoundingHierarchy() :
+    m_time(0.0),
+    m_stateCacheGeneration(0),
+    m_valid(false),
+    m_entityTableValid(false),
+    m_parallelNodeCount(0)
+{
+}
+
+
+/** Return true if the hierarchy was built for time t and is still valid. The
+  * hierarchy remains valid as long as the entity state cache does: it must
+  * be rebuilt whenever the time changes, entities are added or removed, or the
+  * state cache is invalidated.
+  */
+bool
+EntityBoundingHierarchy::isCurrent(double t) const
+{
+    return m_valid && m_time == t && m_stateCacheGeneration == Entity::stateCacheGeneration();
+}
+
+
+/** Mark the hierarchy as out of date.
+  */
+void
+EntityBoundingHierarchy::invalidate()
+{
+    m_valid = false;
+}
+
+
+/** Mark the hierarchy as out of date because entities have been added to or
+  * removed from the universe.
+  */
+void
+EntityBoundingHierarchy::invalidateEntityTable()
+{
+    m_valid = false;
+    m_entityTableValid = false;
+}
+
+
+// Find the index of an entity in the universe, or return NoParent if it's not
+// in the universe.
+unsigned int
+EntityBoundingHierarchy::findEntity(const Entity* entity) const
+{
+    vector<EntityTableEntry>::const_iterator iter =
+            lower_bound(m_entityTable.begin(), m_entityTable.end(), EntityTableEntry(entity, 0));
+    if (iter != m_entityTable.end() && iter->first == entity)
+    {
+        return iter->second;
+    }
+    else
+    {
+        return NoParent;
+    }
+}
+
+
+/** Rebuild the hierarchy for the entities of a universe at time t. The
+  * position and orientation of every entity that exists at time t are computed.
+  *
+  * \param universe the universe containing the entities
+  * \param t the time in seconds since J2000 TDB
+  * \param executor optional executor used to evaluate entities in parallel
+  */
+void
+EntityBoundingHierarchy::build(const Universe* universe, double t, TaskExecutor* executor)
+{
+    unsigned int entityCount = universe->entityCount();
+
+    if (!m_entityTableValid)
+    {
+        m_entityTable.resize(entityCount);
+        for (unsigned int i = 0; i < entityCount; ++i)
+        {
+            m_entityTable[i] = EntityTableEntry(universe->entity(i), i);
+        }
+        sort(m_entityTable.begin(), m_entityTable.end());
+        m_entityTableValid = true;
+    }
+
+    // Find the parent of every entity that exists at time t. An entity is a
+    // root when it has no center or when its center doesn't exist.
+    m_parents.resize(entityCount);
+    for (unsigned int i = 0; i < entityCount; ++i)
+    {
+        m_parents[i] = universe->entity(i)->chronology()->includesTime(t) ? NoParent : NotPresent;
+    }
+
+    m_childStart.assign(entityCount + 1, 0);
+    m_threadSafe.assign(entityCount, 0);
+    for (unsigned int i = 0; i < entityCount; ++i)
+    {
+        if (m_parents[i] != NotPresent)
+        {
+            const Arc* arc = universe->entity(i)->chronology()->activeArc(t);
+            if (arc)
+            {
+                m_threadSafe[i] = isThreadSafe(arc) ? 1 : 0;
+            }
+
+            if (arc && arc->center())
+            {
+                unsigned int parent = findEntity(arc->center());
+                if (parent != NoParent && m_parents[parent] != NotPresent)
+                {
+                    m_parents[i] = parent;
+                    m_childStart[parent + 1]++;
+                }
+            }
+        }
+    }
+
+    // Gather the children of each entity into a single array
+    for (unsigned int i = 0; i < entityCount; ++i)
+    {
+        m_childStart[i + 1] += m_childStart[i];
+    }
+
+    m_children.resize(m_childStart[entityCount]);
+    for (unsigned int i = 0; i < entityCount; ++i)
+    {
+        unsigned int parent = m_parents[i];
+        if (parent < entityCount)
+        {
+            m_children[m_childStart[parent]++] = i;
+        }
+    }
+
+    // The fill loop advanced each start to the start of the next entity's children
+    for (unsigned int i = entityCount; i > 0; --i)
+    {
+        m_childStart[i] = m_childStart[i - 1];
+    }
+    m_childStart[0] = 0;
+
+    // Emit the nodes in depth first order. Children are pushed in reverse so that
+    // they appear in the same order as in the universe. The radius of each node's
+    // bounds is set to the radius of the entity's own items.
+    m_nodes.clear();
+    m_parentNodes.clear();
+    m_levels.clear();
+    unsigned int levelCount = 0;
+    for (unsigned int root = 0; root < entityCount; ++root)
+    {
+        if (m_parents[root] != NoParent)
+        {
+            continue;
+        }
+
+        m_stack.clear();
+        m_stack.push_back(root);
+        m_stack.push_back(NoParent);
+
+        while (!m_stack.empty())
+        {
+            unsigned int parentNode = m_stack.back();
+            m_stack.pop_back();
+            unsigned int entityIndex = m_stack.back();
+            m_stack.pop_back();
+
+            Entity* entity = universe->entity(entityIndex);
+
+            Node node;
+            node.entity = entity;
+            node.position = Vector3d::Zero();
+            node.orientation = Quaterniond::Identity();
+            node.bounds = BoundingSphere<double>(Vector3d::Zero(),
+                                                 itemBoundingRadius(entity, &node.maxGeometryRadius, &node.flags));
+            node.subtreeSize = 1;
+
+            // Roots are always evaluated on the calling thread, since their centers
+            // (if any) aren't in the hierarchy and may be shared.
+            unsigned int level = parentNode == NoParent ? 0 : m_levels[parentNode] + 1;
+            if (m_threadSafe[entityIndex] && level > 0)
+            {
+                node.flags |= ThreadSafeUpdate;
+            }
+
+            unsigned int nodeIndex = (unsigned int) m_nodes.size();
+            m_nodes.push_back(node);
+            m_parentNodes.push_back(parentNode);
+            m_levels.push_back(level);
+            levelCount = max(levelCount, level + 1);
+
+            for (unsigned int i = m_childStart[entityIndex + 1]; i > m_childStart[entityIndex]; --i)
+            {
+                m_stack.push_back(m_children[i - 1]);
+                m_stack.push_back(nodeIndex);
+            }
+        }
+    }
+
+    // Sort the nodes by level, with the thread safe nodes of each level first
+    unsigned int nodeCount = (unsigned int) m_nodes.size();
+    m_levelStart.assign(levelCount * 2 + 1, 0);
+    for (unsigned int i = 0; i < nodeCount; ++i)
+    {
+        unsigned int bucket = m_levels[i] * 2 + ((m_nodes[i].flags & ThreadSafeUpdate) ? 0 : 1);
+        m_levelStart[bucket + 1]++;
+    }
+
+    for (unsigned int i = 0; i < levelCount * 2; ++i)
+    {
+        m_levelStart[i + 1] += m_levelStart[i];
+    }
+
+    m_levelOrder.resize(nodeCount);
+    m_stack.assign(m_levelStart.begin(), m_levelStart.end() - 1);
+    for (unsigned int i = 0; i < nodeCount; ++i)
+    {
+        unsigned int bucket = m_levels[i] * 2 + ((m_nodes[i].flags & ThreadSafeUpdate) ? 0 : 1);
+        m_levelOrder[m_stack[bucket]++] = i;
+    }
+
+    // Evaluate the entities one level at a time. The centers of all entities in
+    // a level have already been evaluated, so the entities only read the cached
+    // states of their centers and write their own.
+    bool parallel = executor && executor->threadCount() > 1;
+    m_parallelNodeCount = 0;
+    Entity::StateCacheStatistics statistics = { 0, 0 };
+    for (unsigned int level = 0; level < levelCount; ++level)
+    {
+        unsigned int safeBegin = m_levelStart[level * 2];
+        unsigned int safeEnd = m_levelStart[level * 2 + 1];
+        unsigned int levelEnd = m_levelStart[level * 2 + 2];
+
+        if (parallel && safeEnd - safeBegin >= ParallelUpdateThreshold)
+        {
+            EntityUpdateTask task(&m_nodes[0], &m_levelOrder[safeBegin], safeEnd - safeBegin, t);
+            executor->execute(&task, task.chunkCount());
+            task.addStatistics(&statistics);
+            m_parallelNodeCount += safeEnd - safeBegin;
+        }
+        else
+        {
+            for (unsigned int i = safeBegin; i < safeEnd; ++i)
+            {
+                updateNode(m_nodes[m_levelOrder[i]], t, &statistics);
+            }
+        }
+
+        // Entities that aren't thread safe may evaluate other entities, so they are
+        // only evaluated while no tasks are running.
+        for (unsigned int i = safeEnd; i < levelEnd; ++i)
+        {
+            updateNode(m_nodes[m_levelOrder[i]], t, &statistics);
+        }
+    }
+
+    Entity::addStateCacheStatistics(statistics);
+
+    // Every node follows its parent, so traversing the nodes in reverse order
+    // completes each subtree before it is merged into its parent.
+    for (unsigned int i = (unsigned int) m_nodes.size(); i > 0; --i)
+    {
+        Node& node = m_nodes[i - 1];
+        node.flags &= ~ThreadSafeUpdate;
+        double radius = node.bounds.radius();
+        node.bounds = BoundingSphere<double>(node.bounds.center(),
+                                             radius + (radius + node.bounds.center().norm()) * RelativeBoundsPadding);
+
+        unsigned int parentNode = m_parentNodes[i - 1];
+        if (parentNode != NoParent)
+        {
+            Node& parent = m_nodes[parentNode];
+            parent.bounds.merge(node.bounds);
+            parent.maxGeometryRadius = max(parent.maxGeometryRadius, node.maxGeometryRadius);
+            parent.subtreeSize += node.subtreeSize;
+            parent.flags |= node.flags;
+        }
+    }
+
+    m_time = t;
+    m_stateCacheGeneration = Entity::stateCacheGeneration();
+    m_valid = true;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_ENTITY_BOUNDING_HIERARCHY_H_
+#define _VESTA_ENTITY_BOUNDING_HIERARCHY_H_
+
+#include "../BoundingSphere.h"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <vector>
+#include <utility>
+
+
+namespace vesta
+{
+
+class Entity;
+class Universe;
+class TaskExecutor;
+
+/** EntityBoundingHierarchy is a hierarchy of bounding spheres over the entities
+  * in a universe at a single instant. The hierarchy follows the tree of center
+  * objects: the children of a node are the entities whose active arc is centered
+  * on it, and the bounding sphere of a node contains the geometry and visualizers
+  * of every entity in its subtree. Entities whose center isn't part of the universe
+  * (or doesn't exist at the time) are roots.
+  *
+  * Nodes are stored in depth first order, so that the subtree of a node occupies
+  * the subtreeSize nodes starting at the node itself. A subtree can thus be skipped
+  * by advancing the node index by subtreeSize.
+  *
+  * Building the hierarchy is the update stage of a frame: it evaluates the position
+  * and orientation of every entity, and the renderer reads them from the nodes
+  * instead of evaluating them again. Entities are evaluated one level of the center
+  * tree at a time, so that the center of an entity is always evaluated before it.
+  * If a task executor is given, the entities at each level are evaluated in
+  * parallel, except for those whose arcs aren't thread safe.
+  */
+class EntityBoundingHierarchy
+{
+public:
+    EntityBoundingHierarchy();
+
+    /** Flags summarizing the contents of a subtree.
+      */
+    enum
+    {
+        HasVisualizers              = 0x1,
+        HasShadowCasters            = 0x2,
+        HasEllipsoidalShadowCasters = 0x4,
+
+        // Set while building for nodes that may be evaluated in parallel
+        ThreadSafeUpdate            = 0x8
+    };
+
+    struct Node
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Entity* entity;
+
+        // Position and orientation of the entity at the time the hierarchy was built
+        Eigen::Vector3d position;
+        Eigen::Quaterniond orientation;
+
+        // Sphere containing the geometry and visualizers of all entities in the subtree
+        BoundingSphere<double> bounds;
+
+        // Largest geometry bounding radius of any entity in the subtree
+        float maxGeometryRadius;
+
+        unsigned int subtreeSize;
+        unsigned int flags;
+    };
+
+    void build(const Universe* universe, double t, TaskExecutor* executor = NULL);
+    bool isCurrent(double t) const;
+    void invalidate();
+    void invalidateEntityTable();
+
+    /** Get the number of nodes in the hierarchy. This is the number of entities
+      * that existed at the time the hierarchy was built.
+      */
+    unsigned int nodeCount() const
+    {
+        return (unsigned int) m_nodes.size();
+    }
+
+    /** Get the node at the specified index, which must be less than nodeCount().
+      */
+    const Node& node(unsigned int index) const
+    {
+        return m_nodes[index];
+    }
+
+    /** Get the number of nodes that were evaluated by parallel tasks the last
+      * time that the hierarchy was built.
+      */
+    unsigned int parallelNodeCount() const
+    {
+        return m_parallelNodeCount;
+    }
+
+private:
+    typedef std::pair<const Entity*, unsigned int> EntityTableEntry;
+    typedef std::vector<Node, Eigen::aligned_allocator<Node> > NodeVector;
+
+    unsigned int findEntity(const Entity* entity) const;
+
+private:
+    NodeVector m_nodes;
+
+    double m_time;
+    unsigned int m_stateCacheGeneration;
+    bool m_valid;
+
+    // Entities of the universe sorted by address, used to look up the
+    // index of the center of each entity.
+    std::vector<EntityTableEntry> m_entityTable;
+    bool m_entityTableValid;
+
+    // Scratch space for build(), kept to avoid reallocating every time
+    std::vector<unsigned int> m_parents;
+    std::vector<unsigned int> m_childStart;
+    std::vector<unsigned int> m_children;
+    std::vector<unsigned int> m_parentNodes;
+    std::vector<unsigned int> m_stack;
+    std::vector<unsigned int> m_levels;
+    std::vector<unsigned int> m_levelStart;
+    std::vector<unsigned int> m_levelOrder;
+    std::vector<char> m_threadSafe;
+
+    unsigned int m_parallelNodeCount;
+};
+
+}
+
+#endif // _VESTA_ENTITY_BOUNDING_HIERARCHY_H_
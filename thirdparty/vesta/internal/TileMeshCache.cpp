@@ -0,0 +1,179 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "TileMeshCache.h"
+#include <cstring>
+
+using namespace vesta;
+using namespace std;
+
+
+bool
+TileMeshCache::Key::operator<(const Key& other) const
+{
+    if (level != other.level)
+        return level < other.level;
+    if (row != other.row)
+        return row < other.row;
+    if (column != other.column)
+        return column < other.column;
+    if (s0 != other.s0)
+        return s0 < other.s0;
+    if (t0 != other.t0)
+        return t0 < other.t0;
+    if (ds != other.ds)
+        return ds < other.ds;
+    return dt < other.dt;
+}
+
+
+/** Create a new tile mesh cache.
+  *
+  * \param meshSize the size in bytes of the vertex data for a single tile
+  * \param memoryBudget the maximum number of bytes of vertex data to keep
+  */
+TileMeshCache::TileMeshCache(unsigned int meshSize, unsigned int memoryBudget) :
+    m_meshSize(meshSize),
+    m_memoryBudget(memoryBudget),
+    m_frame(0),
+    m_meshCount(0),
+    m_hitCount(0),
+    m_missCount(0)
+{
+}
+
+
+TileMeshCache::~TileMeshCache()
+{
+}
+
+
+/** Look up a tile mesh, marking it as used in the current frame if found.
+  *
+  * \return the vertex buffer holding the mesh, or null if the mesh isn't cached
+  */
+const VertexBuffer*
+TileMeshCache::find(const Key& key)
+{
+    EntryTable::iterator iter = m_table.find(key);
+    if (iter == m_table.end())
+    {
+        ++m_missCount;
+        return NULL;
+    }
+
+    ++m_hitCount;
+
+    // Move the entry to the front of the LRU list
+    EntryList::iterator entry = iter->second;
+    entry->lastUsedFrame = m_frame;
+    m_entries.splice(m_entries.begin(), m_entries, entry);
+
+    return entry->buffer.ptr();
+}
+
+
+/** Add a tile mesh to the cache. The key must not already be present. The
+  * buffer of the least recently used mesh is reused when the cache is full.
+  *
+  * \param key the tile and texture coordinate mapping of the mesh
+  * \param vertexData meshSize() bytes of vertex data
+  * \return the vertex buffer holding the mesh, or null if no buffer could be created
+  */
+const VertexBuffer*
+TileMeshCache::insert(const Key& key, const void* vertexData)
+{
+    counted_ptr<VertexBuffer> buffer;
+
+    if (!m_entries.empty() &&
+        memoryUsed() + m_meshSize > m_memoryBudget &&
+        m_entries.back().lastUsedFrame != m_frame)
+    {
+        buffer = m_entries.back().buffer;
+        m_table.erase(m_entries.back().key);
+        m_entries.pop_back();
+        --m_meshCount;
+
+        void* data = buffer->mapWriteOnly(true);
+        if (data)
+        {
+            memcpy(data, vertexData, m_meshSize);
+        }
+
+        if (!data || !buffer->unmap())
+        {
+            buffer = NULL;
+        }
+    }
+
+    if (buffer.isNull())
+    {
+        buffer = VertexBuffer::Create(m_meshSize, VertexBuffer::StaticDraw, vertexData);
+        if (buffer.isNull())
+        {
+            return NULL;
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.buffer = buffer;
+    entry.lastUsedFrame = m_frame;
+    m_entries.push_front(entry);
+    m_table[key] = m_entries.begin();
+    ++m_meshCount;
+
+    return buffer.ptr();
+}
+
+
+/** Start a new frame. Meshes used before this call may be evicted to make
+  * room for new ones.
+  */
+void
+TileMeshCache::beginFrame()
+{
+    ++m_frame;
+    trim();
+}
+
+
+/** Remove all meshes from the cache.
+  */
+void
+TileMeshCache::clear()
+{
+    m_table.clear();
+    m_entries.clear();
+    m_meshCount = 0;
+}
+
+
+/** Set the maximum number of bytes of vertex data to keep in the cache.
+  */
+void
+TileMeshCache::setMemoryBudget(unsigned int bytes)
+{
+    m_memoryBudget = bytes;
+    trim();
+}
+
+
+// Release least recently used meshes until the cache is within its budget
+void
+TileMeshCache::trim()
+{
+    while (!m_entries.empty() &&
+           memoryUsed() > m_memoryBudget &&
+           m_entries.back().lastUsedFrame != m_frame)
+    {
+        m_table.erase(m_entries.back().key);
+        m_entries.pop_back();
+        --m_meshCount;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_TILE_MESH_CACHE_H_
+#define _VESTA_TILE_MESH_CACHE_H_
+
+#include "../Object.h"
+#include "../VertexBuffer.h"
+#include <list>
+#include <map>
+
+
+namespace vesta
+{
+
+/** TileMeshCache keeps the vertices of recently drawn planet tiles in vertex
+  * buffers, so that a tile's vertices are only generated when it first becomes
+  * visible. Every tile mesh has the same size. When the memory budget is
+  * exceeded, the buffer of the least recently used tile is reused for the new
+  * tile. Tiles used since the last call to beginFrame() are never evicted, so
+  * the cache may temporarily grow past its budget rather than thrash.
+  */
+class TileMeshCache
+{
+public:
+    /** A tile mesh is identified by the position of the tile in the quadtree and
+      * the mapping from tile vertices to texture coordinates. The texture coordinate
+      * of the vertex in column j and row i is (s0 + j * ds, t0 + i * dt).
+      */
+    struct Key
+    {
+        unsigned int level;
+        unsigned int row;
+        unsigned int column;
+        float s0;
+        float t0;
+        float ds;
+        float dt;
+
+        bool operator<(const Key& other) const;
+    };
+
+    TileMeshCache(unsigned int meshSize, unsigned int memoryBudget);
+    ~TileMeshCache();
+
+    const VertexBuffer* find(const Key& key);
+    const VertexBuffer* insert(const Key& key, const void* vertexData);
+    void beginFrame();
+    void clear();
+
+    /** Get the size in bytes of a single tile mesh.
+      */
+    unsigned int meshSize() const
+    {
+        return m_meshSize;
+    }
+
+    /** Get the number of bytes of vertex data that the cache tries to stay under.
+      */
+    unsigned int memoryBudget() const
+    {
+        return m_memoryBudget;
+    }
+
+    void setMemoryBudget(unsigned int bytes);
+
+    /** Get the number of bytes of vertex data currently held by the cache.
+      */
+    unsigned int memoryUsed() const
+    {
+        return m_meshCount * m_meshSize;
+    }
+
+    /** Get the number of tile meshes currently in the cache.
+      */
+    unsigned int meshCount() const
+    {
+        return m_meshCount;
+    }
+
+    /** Get the number of lookups that found the tile mesh in the cache. */
+    unsigned long hitCount() const { return m_hitCount; }
+    /** Get the number of lookups that didn't find the tile mesh in the cache. */
+    unsigned long missCount() const { return m_missCount; }
+
+private:
+    struct Entry
+    {
+        Key key;
+        counted_ptr<VertexBuffer> buffer;
+        unsigned int lastUsedFrame;
+    };
+
+    // Most recently used entries are at the front of the list
+    typedef std::list<Entry> EntryList;
+    typedef std::map<Key, EntryList::iterator> EntryTable;
+
+    void trim();
+
+private:
+    unsigned int m_meshSize;
+    unsigned int m_memoryBudget;
+    unsigned int m_frame;
+    EntryList m_entries;
+    EntryTable m_table;
+    unsigned int m_meshCount;
+    unsigned long m_hitCount;
+    unsigned long m_missCount;
+};
+
+}
+
+#endif // _VESTA_TILE_MESH_CACHE_H_
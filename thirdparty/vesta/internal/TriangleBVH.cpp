@@ -0,0 +1,657 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "TriangleBVH.h"
+#include <Eigen/LU>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cassert>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VESTA_BVH_USE_SSE 1
+#include <xmmintrin.h>
+#else
+#define VESTA_BVH_USE_SSE 0
+#endif
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Maximum number of triangles in a leaf when splitting is no more expensive
+// according to the SAH.
+static const unsigned int MaxLeafTriangles = 16;
+
+// Leaves with this many triangles or fewer are never split
+static const unsigned int MinSplitTriangles = 4;
+
+static const unsigned int SahBinCount = 16;
+
+// Below this depth, the builder falls back to median splits. SAH splits may be
+// arbitrarily unbalanced, but each median split halves the triangle count, so
+// at most 32 more levels follow for a 32-bit triangle count. The traversal
+// stack holds at most one node per level.
+static const unsigned int MaxSahDepth = 48;
+static const unsigned int MaxTraversalDepth = MaxSahDepth + 32;
+
+// Cost of traversing a node relative to the cost of a triangle test
+static const float TraversalCost = 1.0f;
+
+
+struct TriangleBVH::BuildTriangle
+{
+    float minBound[3];
+    float maxBound[3];
+    float centroid[3];
+    unsigned int index;
+};
+
+
+namespace
+{
+
+struct Bounds
+{
+    Bounds()
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            minBound[i] = numeric_limits<float>::infinity();
+            maxBound[i] = -numeric_limits<float>::infinity();
+        }
+    }
+
+    void extend(const float* minPoint, const float* maxPoint)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            minBound[i] = min(minBound[i], minPoint[i]);
+            maxBound[i] = max(maxBound[i], maxPoint[i]);
+        }
+    }
+
+    // Half of the surface area, which is all that the SAH needs
+    float halfArea() const
+    {
+        if (minBound[0] > maxBound[0])
+        {
+            return 0.0f;
+        }
+
+        float dx = maxBound[0] - minBound[0];
+        float dy = maxBound[1] - minBound[1];
+        float dz = maxBound[2] - minBound[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    float minBound[3];
+    float maxBound[3];
+};
+
+
+class CentroidBinPredicate
+{
+public:
+    CentroidBinPredicate(unsigned int axis, float minCentroid, float binScale, unsigned int splitBin) :
+        m_axis(axis),
+        m_minCentroid(minCentroid),
+        m_binScale(binScale),
+        m_splitBin(splitBin)
+    {
+    }
+
+    bool operator()(const TriangleBVH::BuildTriangle& t) const
+    {
+        return centroidBin(t.centroid[m_axis], m_minCentroid, m_binScale) < m_splitBin;
+    }
+
+    static unsigned int centroidBin(float centroid, float minCentroid, float binScale)
+    {
+        unsigned int bin = (unsigned int) ((centroid - minCentroid) * binScale);
+        return min(bin, SahBinCount - 1);
+    }
+
+private:
+    unsigned int m_axis;
+    float m_minCentroid;
+    float m_binScale;
+    unsigned int m_splitBin;
+};
+
+
+class CentroidOrderPredicate
+{
+public:
+    CentroidOrderPredicate(unsigned int axis) :
+        m_axis(axis)
+    {
+    }
+
+    bool operator()(const TriangleBVH::BuildTriangle& t0, const TriangleBVH::BuildTriangle& t1) const
+    {
+        return t0.centroid[m_axis] < t1.centroid[m_axis];
+    }
+
+private:
+    unsigned int m_axis;
+};
+
+
+// Ray with precomputed reciprocal direction for box tests. Zero direction
+// components are replaced with tiny ones so that the slab distances are never
+// NaN.
+struct BoxTestRay
+{
+    void set(const Vector3f& origin, const Vector3f& direction)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            float d = direction[i];
+            if (abs(d) < 1.0e-20f)
+            {
+                d = d < 0.0f ? -1.0e-20f : 1.0e-20f;
+            }
+            o[i] = origin[i];
+            invD[i] = 1.0f / d;
+        }
+        o[3] = 0.0f;
+        invD[3] = 0.0f;
+    }
+
+    float o[4];
+    float invD[4];
+};
+
+} // anonymous namespace
+
+
+// Slab test of a ray against a node's bounds. Returns true if the ray enters the box
+// at a distance no greater than maxDistance. The exit distance is scaled up slightly
+// so that rounding in the test can't cause triangles touching the box to be missed.
+static inline bool
+rayHitsBox(const float* minBound, const float* maxBound, const BoxTestRay& ray, float maxDistance)
+{
+    const float RobustScale = 1.0f + 1.0e-5f;
+
+#if VESTA_BVH_USE_SSE
+    // Lane 3 holds unrelated node data and is ignored
+    __m128 o = _mm_loadu_ps(ray.o);
+    __m128 invD = _mm_loadu_ps(ray.invD);
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minBound), o), invD);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxBound), o), invD);
+    __m128 tmin = _mm_min_ps(t0, t1);
+    __m128 tmax = _mm_max_ps(t0, t1);
+
+    __m128 tnear = _mm_max_ss(tmin, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(1, 1, 1, 1)));
+    tnear = _mm_max_ss(tnear, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(2, 2, 2, 2)));
+    __m128 tfar = _mm_min_ss(tmax, _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(1, 1, 1, 1)));
+    tfar = _mm_min_ss(tfar, _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(2, 2, 2, 2)));
+
+    float nearDistance = max(_mm_cvtss_f32(tnear), 0.0f);
+    float farDistance = _mm_cvtss_f32(tfar) * RobustScale;
+#else
+    float nearDistance = 0.0f;
+    float farDistance = numeric_limits<float>::infinity();
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        float t0 = (minBound[i] - ray.o[i]) * ray.invD[i];
+        float t1 = (maxBound[i] - ray.o[i]) * ray.invD[i];
+        nearDistance = max(nearDistance, min(t0, t1));
+        farDistance = min(farDistance, max(t0, t1));
+    }
+    farDistance *= RobustScale;
+#endif
+
+    return nearDistance <= farDistance && nearDistance <= maxDistance;
+}
+
+
+/** Build a bounding volume hierarchy for a list of triangles.
+  */
+TriangleBVH::TriangleBVH(const vector<Triangle>& triangles)
+{
+    if (triangles.empty())
+    {
+        return;
+    }
+
+    vector<BuildTriangle> buildTriangles(triangles.size());
+    for (unsigned int i = 0; i < triangles.size(); ++i)
+    {
+        const Triangle& tri = triangles[i];
+        BuildTriangle& t = buildTriangles[i];
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            t.minBound[j] = min(tri.v0[j], min(tri.v1[j], tri.v2[j]));
+            t.maxBound[j] = max(tri.v0[j], max(tri.v1[j], tri.v2[j]));
+            t.centroid[j] = 0.5f * (t.minBound[j] + t.maxBound[j]);
+        }
+        t.index = i;
+    }
+
+    m_nodes.reserve(triangles.size() / 2 + 1);
+    build(buildTriangles, 0, (unsigned int) buildTriangles.size(), 0);
+
+    // Store the triangles in the order referenced by the leaves
+    m_triangles.resize(triangles.size());
+    for (unsigned int i = 0; i < buildTriangles.size(); ++i)
+    {
+        m_triangles[i] = triangles[buildTriangles[i].index];
+    }
+
+    // Grow the node bounds slightly so that hits on the edges of triangles aren't
+    // lost to rounding.
+    const Node& root = m_nodes[0];
+    float maxExtent = 0.0f;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        maxExtent = max(maxExtent, root.maxBound[i] - root.minBound[i]);
+    }
+    float epsilon = maxExtent * 1.0e-5f;
+    for (vector<Node>::iterator iter = m_nodes.begin(); iter != m_nodes.end(); ++iter)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            iter->minBound[i] -= epsilon;
+            iter->maxBound[i] += epsilon;
+        }
+    }
+}
+
+
+// Recursively build the hierarchy for buildTriangles[first, first + count). Returns
+// the index of the new node.
+unsigned int
+TriangleBVH::build(vector<BuildTriangle>& buildTriangles, unsigned int first, unsigned int count, unsigned int depth)
+{
+    unsigned int nodeIndex = (unsigned int) m_nodes.size();
+    m_nodes.push_back(Node());
+
+    Bounds bounds;
+    Bounds centroidBounds;
+    for (unsigned int i = first; i < first + count; ++i)
+    {
+        bounds.extend(buildTriangles[i].minBound, buildTriangles[i].maxBound);
+        centroidBounds.extend(buildTriangles[i].centroid, buildTriangles[i].centroid);
+    }
+
+    Node node;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        node.minBound[i] = bounds.minBound[i];
+        node.maxBound[i] = bounds.maxBound[i];
+    }
+    node.index = first;
+    node.triangleCount = (v_uint16) count;
+    node.axis = 0;
+
+    if (count <= MinSplitTriangles)
+    {
+        m_nodes[nodeIndex] = node;
+        return nodeIndex;
+    }
+
+    // Find the best split with a binned surface area heuristic
+    unsigned int bestAxis = 3;
+    unsigned int bestSplit = 0;
+    float bestCost = numeric_limits<float>::infinity();
+    if (depth < MaxSahDepth)
+    {
+        // Bin the triangles along all three axes in a single pass
+        float binScales[3];
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            float extent = centroidBounds.maxBound[axis] - centroidBounds.minBound[axis];
+            binScales[axis] = extent > 0.0f ? float(SahBinCount) / extent : 0.0f;
+        }
+
+        Bounds binBounds[3][SahBinCount];
+        unsigned int binCounts[3][SahBinCount] = { { 0 } };
+        for (unsigned int i = first; i < first + count; ++i)
+        {
+            const BuildTriangle& t = buildTriangles[i];
+            for (unsigned int axis = 0; axis < 3; ++axis)
+            {
+                unsigned int bin = CentroidBinPredicate::centroidBin(t.centroid[axis], centroidBounds.minBound[axis], binScales[axis]);
+                binBounds[axis][bin].extend(t.minBound, t.maxBound);
+                binCounts[axis][bin]++;
+            }
+        }
+
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            if (binScales[axis] == 0.0f)
+            {
+                continue;
+            }
+
+            // Sweep from the right to get the cost of everything above each split
+            float rightAreas[SahBinCount];
+            unsigned int rightCounts[SahBinCount];
+            Bounds right;
+            unsigned int rightCount = 0;
+            for (unsigned int bin = SahBinCount - 1; bin > 0; --bin)
+            {
+                right.extend(binBounds[axis][bin].minBound, binBounds[axis][bin].maxBound);
+                rightCount += binCounts[axis][bin];
+                rightAreas[bin] = right.halfArea();
+                rightCounts[bin] = rightCount;
+            }
+
+            Bounds left;
+            unsigned int leftCount = 0;
+            for (unsigned int split = 1; split < SahBinCount; ++split)
+            {
+                left.extend(binBounds[axis][split - 1].minBound, binBounds[axis][split - 1].maxBound);
+                leftCount += binCounts[axis][split - 1];
+                if (leftCount == 0 || rightCounts[split] == 0)
+                {
+                    continue;
+                }
+
+                float cost = left.halfArea() * leftCount + rightAreas[split] * rightCounts[split];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+    }
+
+    unsigned int leftCount = 0;
+    if (bestAxis < 3)
+    {
+        float parentArea = bounds.halfArea();
+        float splitCost = TraversalCost + (parentArea > 0.0f ? bestCost / parentArea : float(count));
+        if (splitCost >= float(count) && count <= MaxLeafTriangles)
+        {
+            // Splitting won't make picking any faster
+            m_nodes[nodeIndex] = node;
+            return nodeIndex;
+        }
+
+        float extent = centroidBounds.maxBound[bestAxis] - centroidBounds.minBound[bestAxis];
+        CentroidBinPredicate predicate(bestAxis, centroidBounds.minBound[bestAxis], float(SahBinCount) / extent, bestSplit);
+        vector<BuildTriangle>::iterator middle = partition(buildTriangles.begin() + first, buildTriangles.begin() + first + count, predicate);
+        leftCount = (unsigned int) (middle - (buildTriangles.begin() + first));
+    }
+
+    if (leftCount == 0 || leftCount == count)
+    {
+        // No usable SAH split (e.g. all centroids coincide); split at the median
+        // along the longest axis instead.
+        unsigned int axis = 0;
+        for (unsigned int i = 1; i < 3; ++i)
+        {
+            if (bounds.maxBound[i] - bounds.minBound[i] > bounds.maxBound[axis] - bounds.minBound[axis])
+            {
+                axis = i;
+            }
+        }
+        bestAxis = axis;
+        leftCount = count / 2;
+        nth_element(buildTriangles.begin() + first,
+                    buildTriangles.begin() + first + leftCount,
+                    buildTriangles.begin() + first + count,
+                    CentroidOrderPredicate(axis));
+    }
+
+    build(buildTriangles, first, leftCount, depth + 1);
+    unsigned int secondChild = build(buildTriangles, first + leftCount, count - leftCount, depth + 1);
+
+    node.index = secondChild;
+    node.triangleCount = 0;
+    node.axis = (v_uint16) bestAxis;
+    m_nodes[nodeIndex] = node;
+
+    return nodeIndex;
+}
+
+
+/** Find the closest intersection of a ray with the triangles in the hierarchy.
+  *
+  * @param origin origin of the pick ray
+  * @param direction direction of the pick ray (must be normalized)
+  * @param distance filled in with the distance to the closest triangle if the ray hits
+  * @return true if the ray hits any triangle
+  */
+bool
+TriangleBVH::rayPick(const Vector3f& origin,
+                     const Vector3f& direction,
+                     float* distance) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    BoxTestRay ray;
+    ray.set(origin, direction);
+
+    float closestHit = numeric_limits<float>::infinity();
+
+    unsigned int stack[MaxTraversalDepth];
+    unsigned int stackSize = 0;
+    unsigned int nodeIndex = 0;
+    for (;;)
+    {
+        const Node& node = m_nodes[nodeIndex];
+        if (rayHitsBox(node.minBound, node.maxBound, ray, closestHit))
+        {
+            if (node.triangleCount == 0)
+            {
+                // Visit the nearer child first; the farther one can often be skipped
+                // once a hit is found.
+                unsigned int nearChild = nodeIndex + 1;
+                unsigned int farChild = node.index;
+                if (direction[node.axis] < 0.0f)
+                {
+                    swap(nearChild, farChild);
+                }
+
+                assert(stackSize < MaxTraversalDepth);
+                stack[stackSize++] = farChild;
+                nodeIndex = nearChild;
+                continue;
+            }
+
+            for (unsigned int i = node.index; i < node.index + node.triangleCount; ++i)
+            {
+                intersectTriangle(m_triangles[i], origin, direction, &closestHit);
+            }
+        }
+
+        if (stackSize == 0)
+        {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    if (closestHit < numeric_limits<float>::infinity())
+    {
+        *distance = closestHit;
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+
+/** Find the closest intersections for a batch of rays. Rays are traversed in packets
+  * of up to MaxPacketSize, sharing the node visits; this is most effective when
+  * the rays are coherent (e.g. they have nearby origins and similar directions.)
+  *
+  * @param distances array of rayCount distances, filled in with the distance to the closest
+  *                  hit for each ray, or infinity for rays that miss
+  * @return the number of rays that hit a triangle
+  */
+unsigned int
+TriangleBVH::rayPick(const Vector3f* origins,
+                     const Vector3f* directions,
+                     unsigned int rayCount,
+                     float* distances) const
+{
+    unsigned int hitCount = 0;
+
+    for (unsigned int packetStart = 0; packetStart < rayCount; packetStart += MaxPacketSize)
+    {
+        unsigned int packetSize = rayCount - packetStart;
+        if (packetSize > MaxPacketSize)
+        {
+            packetSize = MaxPacketSize;
+        }
+        const Vector3f* packetOrigins = origins + packetStart;
+        const Vector3f* packetDirections = directions + packetStart;
+        float* closestHits = distances + packetStart;
+
+        BoxTestRay rays[MaxPacketSize];
+        for (unsigned int i = 0; i < packetSize; ++i)
+        {
+            rays[i].set(packetOrigins[i], packetDirections[i]);
+            closestHits[i] = numeric_limits<float>::infinity();
+        }
+
+        if (m_nodes.empty())
+        {
+            continue;
+        }
+
+        unsigned int stack[MaxTraversalDepth];
+        unsigned int stackSize = 0;
+        unsigned int nodeIndex = 0;
+        for (;;)
+        {
+            const Node& node = m_nodes[nodeIndex];
+
+            bool active[MaxPacketSize];
+            bool anyActive = false;
+            for (unsigned int i = 0; i < packetSize; ++i)
+            {
+                active[i] = rayHitsBox(node.minBound, node.maxBound, rays[i], closestHits[i]);
+                anyActive = anyActive || active[i];
+            }
+
+            if (anyActive)
+            {
+                if (node.triangleCount == 0)
+                {
+                    // Order children by the direction of the first ray in the packet
+                    unsigned int nearChild = nodeIndex + 1;
+                    unsigned int farChild = node.index;
+                    if (packetDirections[0][node.axis] < 0.0f)
+                    {
+                        swap(nearChild, farChild);
+                    }
+
+                    assert(stackSize < MaxTraversalDepth);
+                    stack[stackSize++] = farChild;
+                    nodeIndex = nearChild;
+                    continue;
+                }
+
+                for (unsigned int i = node.index; i < node.index + node.triangleCount; ++i)
+                {
+                    for (unsigned int j = 0; j < packetSize; ++j)
+                    {
+                        if (active[j])
+                        {
+                            intersectTriangle(m_triangles[i], packetOrigins[j], packetDirections[j], &closestHits[j]);
+                        }
+                    }
+                }
+            }
+
+            if (stackSize == 0)
+            {
+                break;
+            }
+            nodeIndex = stack[--stackSize];
+        }
+
+        for (unsigned int i = 0; i < packetSize; ++i)
+        {
+            if (closestHits[i] < numeric_limits<float>::infinity())
+            {
+                ++hitCount;
+            }
+        }
+    }
+
+    return hitCount;
+}
+
+
+/** Test a ray for intersection with a triangle. If the ray hits the triangle in
+  * front of the ray origin and closer than closestHit, closestHit is set to the
+  * distance of the intersection and the function returns true.
+  */
+bool
+TriangleBVH::intersectTriangle(const Triangle& triangle,
+                               const Vector3f& origin,
+                               const Vector3f& direction,
+                               float* closestHit)
+{
+    const Vector3f& v0 = triangle.v0;
+    Vector3f edge0 = triangle.v1 - v0;
+    Vector3f edge1 = triangle.v2 - v0;
+    Vector3f normal = edge0.cross(edge1);
+
+    // If the triangle normal and direction are perpendicular, the ray is parallel to the triangle.
+    // Treat this as always being a miss (even when the direction vector lies in the plane of the
+    // triangle.)
+    float d = normal.dot(direction);
+    if (d == 0.0f)
+    {
+        return false;
+    }
+
+    float planeIntersect = normal.dot(v0 - origin) / d;
+
+    // See if the intersection point is in front of the ray origin and
+    // closer than the closest hit so far.
+    if (!(planeIntersect > 0.0f && planeIntersect < *closestHit))
+    {
+        return false;
+    }
+
+    Matrix2f e;
+    e << edge0.dot(edge0), edge0.dot(edge1),
+         edge1.dot(edge0), edge1.dot(edge1);
+    float a = e.determinant();
+    if (a == 0.0f)
+    {
+        return false;
+    }
+
+    e *= (1.0f / a);
+
+    // Compute the point at which the the pick ray intersects the triangle plane
+    Vector3f p = origin + direction * planeIntersect - v0;
+    float p0 = p.dot(edge0);
+    float p1 = p.dot(edge1);
+
+    // Compute the barycentric coordinates (s, t) of the intersection point.
+    // (s, t) lies in the triangle if s >= 0 and t >= 0 and s + t <= 1
+    float s = e(1, 1) * p0 - e(0, 1) * p1;
+    float t = e(0, 0) * p1 - e(1, 0) * p0;
+    if (s >= 0.0f && t >= 0.0f && s + t <= 1.0f)
+    {
+        *closestHit = planeIntersect;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_INTERNAL_TRIANGLE_BVH_H_
+#define _VESTA_INTERNAL_TRIANGLE_BVH_H_
+
+#include "../IntegerTypes.h"
+#include <Eigen/Core>
+#include <vector>
+
+
+namespace vesta
+{
+
+/** TriangleBVH is a bounding volume hierarchy over a set of triangles, used to
+  * accelerate ray picking of meshes. The hierarchy is built with the surface
+  * area heuristic and stored as a flat array of nodes in depth first order,
+  * so that the first child of an interior node immediately follows it. The
+  * triangle vertices are copied into the hierarchy in leaf order.
+  */
+class TriangleBVH
+{
+public:
+    struct Triangle
+    {
+        Eigen::Vector3f v0;
+        Eigen::Vector3f v1;
+        Eigen::Vector3f v2;
+    };
+
+    explicit TriangleBVH(const std::vector<Triangle>& triangles);
+
+    bool rayPick(const Eigen::Vector3f& origin,
+                 const Eigen::Vector3f& direction,
+                 float* distance) const;
+    unsigned int rayPick(const Eigen::Vector3f* origins,
+                         const Eigen::Vector3f* directions,
+                         unsigned int rayCount,
+                         float* distances) const;
+
+    static bool intersectTriangle(const Triangle& triangle,
+                                  const Eigen::Vector3f& origin,
+                                  const Eigen::Vector3f& direction,
+                                  float* closestHit);
+
+    /** Get the number of nodes in the hierarchy.
+      */
+    unsigned int nodeCount() const
+    {
+        return (unsigned int) m_nodes.size();
+    }
+
+    /** Get the number of triangles in the hierarchy.
+      */
+    unsigned int triangleCount() const
+    {
+        return (unsigned int) m_triangles.size();
+    }
+
+    /** Maximum number of rays traversed together by the multiple ray version
+      * of rayPick.
+      */
+    static const unsigned int MaxPacketSize = 8;
+
+    // Per-triangle data used while building the hierarchy
+    struct BuildTriangle;
+
+private:
+    // 32 byte node. For a leaf node, index is the first triangle and
+    // triangleCount is nonzero. For an interior node, index is the
+    // second child and axis is the split axis.
+    struct Node
+    {
+        float minBound[3];
+        v_uint32 index;
+        float maxBound[3];
+        v_uint16 triangleCount;
+        v_uint16 axis;
+    };
+
+    unsigned int build(std::vector<BuildTriangle>& buildTriangles,
+                       unsigned int first,
+                       unsigned int count,
+                       unsigned int depth);
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<Triangle> m_triangles;
+};
+
+}
+
+#endif // _VESTA_INTERNAL_TRIANGLE_BVH_H_
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2013 by Chris Laurel
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ */
+
+/** samplepack - Compile an .xyzv, .xyz, or .q file into a sampled data pack
+ *
+ * The binary output file has the following format:
+ *
+ * Header (64 bytes)
+ *   8 bytes - header "COSMPACK"
+ *   4 bytes - uint32 - format version (1)
+ *   4 bytes - uint32 - table count
+ *   8 bytes - int64 - size of the source file in bytes
+ *   8 bytes - int64 - modification time of the source file (seconds since 1970-01-01 UTC)
+ *  32 bytes - reserved (zero)
+ *
+ * Table index (48 bytes per table)
+ *   4 bytes - uint32 - table type (1 = states, 2 = positions, 3 = orientations)
+ *   4 bytes - uint32 - flags (1 = Celestia rotation convention)
+ *   8 bytes - uint64 - record count
+ *   8 bytes - uint64 - file offset of the time array
+ *   8 bytes - uint64 - file offset of the value array
+ *   8 bytes - double - bounding radius (km; zero for orientation tables)
+ *   8 bytes - reserved (zero)
+ *
+ * Times are seconds since J2000.0 TDB. For state and position tables, the
+ * value array holds all positions (x y z per record) followed by all velocities.
+ * For orientation tables, the value array holds unit quaternions (w x y z per
+ * record.)
+ *
+ * Byte order is little endian (Intel x86)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace std;
+
+typedef int int32;
+typedef unsigned int uint32;
+typedef long long int64;
+typedef unsigned long long uint64;
+
+static const double J2000 = 2451545.0;
+static const double SecondsPerDay = 86400.0;
+
+enum TableType
+{
+    StateTable       = 1,
+    PositionTable    = 2,
+    OrientationTable = 3,
+};
+
+static const uint32 CelestiaConvention = 1;
+
+struct PackHeader
+{
+    char magic[8];
+    uint32 version;
+    uint32 tableCount;
+    int64 sourceSize;
+    int64 sourceModifiedTime;
+    char reserved[32];
+};
+
+struct PackTableEntry
+{
+    uint32 type;
+    uint32 flags;
+    uint64 recordCount;
+    uint64 timeOffset;
+    uint64 valueOffset;
+    double boundingRadius;
+    uint64 reserved;
+};
+
+
+// Read all of the numbers from a file; hash comments extend to the end of the line.
+bool
+readValues(const string& fileName, vector<double>& values)
+{
+    ifstream in(fileName.c_str(), ios::in | ios::binary);
+    if (!in.good())
+    {
+        cerr << "Error opening input file " << fileName << endl;
+        return false;
+    }
+
+    string line;
+    unsigned int lineNumber = 0;
+    while (getline(in, line))
+    {
+        ++lineNumber;
+
+        string::size_type commentStart = line.find('#');
+        if (commentStart != string::npos)
+        {
+            line.erase(commentStart);
+        }
+
+        const char* s = line.c_str();
+        for (;;)
+        {
+            while (*s == ' ' || *s == '\t' || *s == '\r' || *s == ',')
+            {
+                ++s;
+            }
+
+            if (*s == '\0')
+            {
+                break;
+            }
+
+            char* end = NULL;
+            double x = strtod(s, &end);
+            if (end == s)
+            {
+                cerr << "Bad value on line " << lineNumber << " of " << fileName << endl;
+                return false;
+            }
+
+            values.push_back(x);
+            s = end;
+        }
+    }
+
+    return true;
+}
+
+
+// Velocity estimate used by Cosmographia for trajectories given as positions only:
+// three-point differences for all records other than the ends.
+void
+estimateVelocities(const vector<double>& times, const vector<double>& positions, vector<double>& velocities)
+{
+    unsigned int n = times.size();
+    velocities.assign(n * 3, 0.0);
+    if (n < 2)
+    {
+        return;
+    }
+
+    for (unsigned int index = 0; index < n; ++index)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            double v = 0.0;
+            if (index == 0)
+            {
+                v = (positions[3 + i] - positions[i]) / (times[1] - times[0]);
+            }
+            else if (index == n - 1)
+            {
+                v = (positions[index * 3 + i] - positions[(index - 1) * 3 + i]) / (times[index] - times[index - 1]);
+            }
+            else
+            {
+                double h0 = times[index] - times[index - 1];
+                double h1 = times[index + 1] - times[index];
+                v = 0.5 * ((positions[index * 3 + i] - positions[(index - 1) * 3 + i]) / h0 +
+                           (positions[(index + 1) * 3 + i] - positions[index * 3 + i]) / h1);
+            }
+            velocities[index * 3 + i] = v;
+        }
+    }
+}
+
+
+// Normalize a quaternion (w x y z) and optionally convert it from the Celestia
+// convention: q' = conjugate(xRotation(90 deg) * q)
+void
+convertQuaternion(double* q, bool celestia)
+{
+    double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (norm > 0.0)
+    {
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            q[i] /= norm;
+        }
+    }
+
+    if (celestia)
+    {
+        double aw = cos(M_PI / 4.0);
+        double ax = sin(M_PI / 4.0);
+        double w = aw * q[0] - ax * q[1];
+        double x = aw * q[1] + ax * q[0];
+        double y = aw * q[2] - ax * q[3];
+        double z = aw * q[3] + ax * q[2];
+        q[0] = w;
+        q[1] = -x;
+        q[2] = -y;
+        q[3] = -z;
+    }
+}
+
+
+bool
+hasSuffix(const string& s, const string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+void
+usage()
+{
+    cerr << "Usage: samplepack [-celestia] <input file> [output file]" << endl;
+    cerr << "   input file must be .xyzv, .xyz, or .q" << endl;
+    cerr << "   -celestia: quaternions use the Celestia rotation convention" << endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    bool celestia = false;
+    vector<string> fileNames;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "-celestia")
+        {
+            celestia = true;
+        }
+        else
+        {
+            fileNames.push_back(arg);
+        }
+    }
+
+    if (fileNames.empty() || fileNames.size() > 2)
+    {
+        usage();
+        return 1;
+    }
+
+    string inputFileName = fileNames[0];
+    string outputFileName = fileNames.size() > 1 ? fileNames[1] : inputFileName + ".pack";
+
+    TableType tableType;
+    unsigned int valuesPerRecord = 0;
+    if (hasSuffix(inputFileName, ".xyzv"))
+    {
+        tableType = StateTable;
+        valuesPerRecord = 6;
+    }
+    else if (hasSuffix(inputFileName, ".xyz"))
+    {
+        tableType = PositionTable;
+        valuesPerRecord = 3;
+    }
+    else if (hasSuffix(inputFileName, ".q"))
+    {
+        tableType = OrientationTable;
+        valuesPerRecord = 4;
+    }
+    else
+    {
+        usage();
+        return 1;
+    }
+
+    if (celestia && tableType != OrientationTable)
+    {
+        cerr << "-celestia only applies to quaternion (.q) files" << endl;
+        return 1;
+    }
+
+    // The pack is tied to the size and modification time of the source file
+    struct stat sourceInfo;
+    if (stat(inputFileName.c_str(), &sourceInfo) != 0)
+    {
+        cerr << "Error opening input file " << inputFileName << endl;
+        return 1;
+    }
+
+    vector<double> values;
+    if (!readValues(inputFileName, values))
+    {
+        return 1;
+    }
+
+    unsigned int recordSize = valuesPerRecord + 1;
+    if (values.empty() || values.size() % recordSize != 0)
+    {
+        cerr << "Incomplete record in " << inputFileName << endl;
+        return 1;
+    }
+
+    unsigned int recordCount = values.size() / recordSize;
+    vector<double> times(recordCount);
+    vector<double> data;
+    double boundingRadius = 0.0;
+
+    if (tableType == OrientationTable)
+    {
+        data.resize(recordCount * 4);
+        for (unsigned int i = 0; i < recordCount; ++i)
+        {
+            times[i] = (values[i * recordSize] - J2000) * SecondsPerDay;
+            copy(&values[i * recordSize + 1], &values[i * recordSize + 5], &data[i * 4]);
+            convertQuaternion(&data[i * 4], celestia);
+        }
+    }
+    else
+    {
+        vector<double> positions(recordCount * 3);
+        vector<double> velocities(recordCount * 3);
+        for (unsigned int i = 0; i < recordCount; ++i)
+        {
+            const double* record = &values[i * recordSize];
+            times[i] = (record[0] - J2000) * SecondsPerDay;
+            copy(record + 1, record + 4, &positions[i * 3]);
+            if (tableType == StateTable)
+            {
+                copy(record + 4, record + 7, &velocities[i * 3]);
+            }
+
+            boundingRadius = max(boundingRadius, sqrt(record[1] * record[1] + record[2] * record[2] + record[3] * record[3]));
+        }
+
+        if (tableType == PositionTable)
+        {
+            estimateVelocities(times, positions, velocities);
+        }
+
+        data = positions;
+        data.insert(data.end(), velocities.begin(), velocities.end());
+    }
+
+    for (unsigned int i = 1; i < recordCount; ++i)
+    {
+        if (times[i] < times[i - 1])
+        {
+            cerr << "Records in " << inputFileName << " are not in time order" << endl;
+            return 1;
+        }
+    }
+
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "COSMPACK", 8);
+    header.version = 1;
+    header.tableCount = 1;
+    header.sourceSize = sourceInfo.st_size;
+    header.sourceModifiedTime = sourceInfo.st_mtime;
+
+    PackTableEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.type = tableType;
+    entry.flags = celestia ? CelestiaConvention : 0;
+    entry.recordCount = recordCount;
+    entry.timeOffset = sizeof(PackHeader) + sizeof(PackTableEntry);
+    entry.valueOffset = entry.timeOffset + recordCount * sizeof(double);
+    entry.boundingRadius = boundingRadius;
+
+    ofstream out(outputFileName.c_str(), ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening output file " << outputFileName << endl;
+        return 1;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    out.write(reinterpret_cast<const char*>(&times[0]), times.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(&data[0]), data.size() * sizeof(double));
+    if (!out.good())
+    {
+        cerr << "Error writing output file " << outputFileName << endl;
+        return 1;
+    }
+
+    return 0;
+}